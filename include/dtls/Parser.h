@@ -65,7 +65,8 @@ namespace dtls {
     BIO* out_bio;                                               /* we use memory write bios. */
     ParserState state;/* @todo - check if we can't use the ssl member to tack state. */                                          /* used to state and makes sure the on_data callback is called at the right time. */
     ParserMode mode;                                            /* is this a client or server implementation */
-    uint8_t* buffer;                                            /* is used to copy data out our out_bio/in_bio */
+    uint8_t* buffer;                                            /* is used to copy data out our out_bio/in_bio; DTLS_BUFFER_SIZE bytes. Set it before init() to share one between the parsers of a thread (we don't take ownership), otherwise init() allocates one. */
+    bool owns_buffer;                                           /* true when init() allocated the buffer */
     dtls_parser_on_data_callback on_data;                       /* is called when there is data that needs to be send to the other party */ 
     void* user;                                                 /* gets passed into the callbacks */
     uint8_t keying_material[DTLS_SRTP_MASTER_LEN * 2];          /* contains the keying material. */ 
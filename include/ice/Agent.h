@@ -29,6 +29,22 @@
   </example>
 
 
+  Candidate pairs:
+  ----------------
+  We create a pair for every authenticated binding request from an address
+  we didn't know yet (succeeded, or nominated with USE-CANDIDATE); that's
+  the only way a pair is created, so dtls and media from an address that
+  didn't pass a check are dropped. Of the nominated pairs the one with the
+  highest priority is selected (a later nomination with the same priority
+  wins, e.g. when the peer roams); media is only sent on the selected pair.
+  The dtls association and the srtp keys belong to the stream, so they keep
+  working on every pair and when the selection changes. Once a pair is
+  selected, the pairs that weren't nominated are removed; the nominated
+  ones stay as fallback. A pair that isn't selected
+  and doesn't receive anything for ICE_PAIR_IDLE_TIMEOUT is removed, the
+  selected pair when it loses consent; both expire. When the selected pair
+  is removed the next best nominated pair is selected.
+
   References:
   -----------
   - Agent states: http://docs.webplatform.org/wiki/apis/webrtc/RTCPeerConnection/iceState
@@ -40,30 +56,60 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 #include <ice/Stream.h>
-#include <dtls/Context.h>
-#include <stun/Reader.h>
+#include <ice/PortMux.h>
+#include <ice/AgentContext.h>
+#include <rtc/Runtime.h>
+#include <stun/MessageView.h>
 #include <stun/Writer.h>
 
+#define ICE_AGENT_MAX_TRANSACTIONS 4096                                                    /* the number of stun transactions (e.g. consent checks) we can have outstanding. */
+#define ICE_CONSENT_INTERVAL 5000                                                          /* we send a consent check every 5 seconds (randomized by +/- 20%), see http://tools.ietf.org/html/rfc7675#section-5.1 */
+#define ICE_CONSENT_TIMEOUT 30000                                                          /* consent expires when we didn't get it for 30 seconds. */
+#define ICE_PAIR_IDLE_TIMEOUT 10000                                                        /* a pair that isn't selected is removed when it didn't receive anything for this long (we check on a timer, so it can take up to twice as long). */
+#define ICE_AGENT_PRIORITY 2130706431                                                      /* the priority we use in our own binding requests (same as our host candidates in the SDP). */
+
 namespace ice {
 
+  class Worker;
+  class SessionManager;
+
   class Agent {
   public:
     Agent();
     ~Agent();
     bool init();                                                                           /* After adding streams (and candidates to streams), call init to kick off everythign */
-    void update();                                                                         /* This must be called often as it fetches new data from the socket and parses any incoming data */
+    void update();                                                                         /* The polled API: fetches new data from the socket, parses any incoming data and runs the timers; must be called often. Not needed when the agent runs on a rtc::Runtime. */
     void addStream(Stream* stream);                                                        /* Add a new stream, this class takes ownership */
+    void setPortMux(PortMux* mux);                                                         /* Run all streams on the shared socket of the mux (see PortMux.h); call before init(), we don't take ownership. */
+    void setRuntime(rtc::Runtime* runtime);                                                /* Run on the loop of the runtime, which also runs our timers, so you don't call update(); call before init(), we don't take ownership. */
+    void setContext(AgentContext* context);                                                /* Use the certificate, timers and stun transactions of a shared context (see AgentContext.h); call before init(), we don't take ownership. */
     void setCredentials(std::string ufrag, std::string pwd);                               /* set the credentials (ice-ufrag, ice-pwd) for all streams. */
-    void handleStunMessage(Stream* stream, stun::Message* msg, std::string rip, uint16_t rport, std::string lip, uint16_t lport);       /* Handles incoming stun messages for the given stream and candidates. It will make sure the correct action will be taken. */
-    void handleStreamData(Stream* stream, std::string rip, uint16_t rport, std::string lip, uint16_t lport, uint8_t* data, uint32_t nbytes) ;
+    void setRemoteCredentials(std::string ufrag, std::string pwd);                         /* set the credentials (ice-ufrag, ice-pwd) of the other agent for all streams; when set we send consent checks ourself. */
+    void handleStunMessage(Stream* stream, stun::MessageView* msg, rtc::Packet* pkt);     /* Handles incoming stun messages for the given stream and candidates. It will make sure the correct action will be taken. */
+    void handleDtlsData(Stream* stream, rtc::Packet* pkt);                                /* Handles the DTLS handshake of the stream (we answer on the pair the record arrived on, records from an address without a pair are dropped) and sets up SRTP when it's finished. */
+    void handleRtpData(Stream* stream, rtc::Packet* pkt);                                 /* Unprotects SRTP in place and passes it to Stream::on_rtp. */
+    void handleRtcpData(Stream* stream, rtc::Packet* pkt);                                /* Unprotects SRTCP (rtcp-mux) in place and passes it to Stream::on_rtcp. */
+    void startConsent(CandidatePair* pair);                                                /* starts the consent freshness and idle timers for a new pair. */
+    void refreshConsent(CandidatePair* pair);                                              /* we got consent for the pair (authenticated request or response); restarts the expire timer. */
+    void sendConsentCheck(CandidatePair* pair);                                            /* sends a consent check (binding request) to the remote candidate of a nominated pair. */
+    void selectPair(CandidatePair* pair);                                                  /* sends media on this (nominated) pair from now on and removes the pairs that weren't nominated. */
+    void removePair(CandidatePair* pair);                                                  /* stops the timers and removes the pair from its stream; selects another nominated pair when it was the selected one. */
     std::string getSDP();                                                                  /* Experimental: based on the added streams / candidates, this will return an SDP that can be shared the other agents. */
+    size_t getMemoryUsage();                                                               /* returns the number of bytes we (and our streams, candidates and pairs) use; a context of our own and the openssl/srtp state of a handshake aren't included. */
 
   public:
     std::vector<Stream*> streams;         
-    dtls::Context dtls_ctx;                                                                /* The dtls::Context is used to handle the dtls communication */
-    stun::Reader stun;                                                                     /* Used to parse incoming data and detect stun messages */
     bool is_lite;                                                                          /* At this moment we only support ice-lite. */
+    PortMux* mux;                                                                          /* when set, the streams use this shared socket instead of their own. */
+    std::atomic<Worker*> worker;                                                           /* the worker that runs this agent when it's added to a WorkerPool, see WorkerPool.h; set once, read without a lock. */
+    rtc::Runtime* runtime;                                                                 /* when set, the runtime runs our sockets and timers, see setRuntime(). */
+    AgentContext* context;                                                                 /* the dtls::Context, timers and stun transactions we use; shared or our own, see setContext(). */
+    bool owns_context;                                                                     /* true when we created the context in init() */
+    SessionManager* manager;                                                               /* the manager when this agent is one of its sessions, see SessionManager.h */
+    uint32_t session_index;                                                                /* our index in SessionManager::sessions */
+    uint64_t tie_breaker;                                                                  /* the ICE-CONTROLLED tie breaker we use in our requests. */
   };
 } /* namespace ice */
 
@@ -0,0 +1,64 @@
+/*
+
+  AgentContext
+  ------------
+
+  The state that doesn't belong to a single session and that all agents
+  running on the same thread can share: the certificate and SSL_CTX for
+  DTLS, the timer wheel for the consent timers and stun retransmissions,
+  the pool of stun transactions for our own requests and the buffer the
+  dtls parsers copy their output into. Each of these is big compared to an
+  idle session (the wheel has TIMER_WHEEL_SLOTS slots, the transactions
+  are preallocated, the SSL_CTX holds the certificate and key and the dtls
+  buffer is DTLS_BUFFER_SIZE bytes), so when a process serves many peers
+  they must not be per agent, see ice::SessionManager. The dtls buffer is
+  only allocated when the first handshake starts.
+
+  An agent that isn't given a context creates one of its own in init(),
+  which loads ./server-cert.pem and ./server-key.pem. A shared context
+  must outlive its agents and isn't thread safe: use one per thread.
+
+  Whoever owns the context advances the timers; add them to the runtime
+  (rtc::Runtime::addTimers()) or call timers.update() when you poll.
+
+  <example>
+
+     ice::AgentContext context;
+     context.init(ICE_AGENT_MAX_TRANSACTIONS);
+     context.dtls_ctx.init("./server-cert.pem", "./server-key.pem");
+
+     agent.setContext(&context);              // before agent.init()
+     agent.init();
+
+  </example>
+
+ */
+#ifndef ICE_AGENT_CONTEXT_H
+#define ICE_AGENT_CONTEXT_H
+
+#include <stdint.h>
+#include <dtls/Context.h>
+#include <dtls/Parser.h>
+#include <rtc/TimerWheel.h>
+#include <stun/TransactionTable.h>
+
+namespace ice {
+
+  class AgentContext {
+  public:
+    AgentContext();
+    ~AgentContext();
+    int init(uint32_t maxTransactions);                                                    /* starts the timers and preallocates the stun transactions; the certificate is loaded with dtls_ctx.init(). Returns 0 on success. */
+    uint8_t* getDtlsBuffer();                                                              /* returns the scratch buffer for dtls::Parser::buffer, allocates it the first time. */
+
+  public:
+    dtls::Context dtls_ctx;                                                                /* the certificate, key and SSL_CTX; every DTLS session uses them */
+    rtc::TimerWheel timers;                                                                /* the consent timers and stun retransmissions */
+    stun::TransactionTable transactions;                                                   /* the stun requests we sent and for which we're waiting for a response */
+    uint8_t* dtls_buffer;                                                                  /* shared by the dtls parsers, see getDtlsBuffer() */
+    bool is_initialized;
+  };
+
+} /* namespace ice */
+
+#endif
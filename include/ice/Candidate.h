@@ -4,32 +4,88 @@
 #include <stdint.h>
 #include <string>
 #include <rtc/Connection.h>
+#include <rtc/Endpoint.h>
+#include <rtc/Demux.h>
+#include <rtc/TimerWheel.h>
 #include <dtls/Context.h>
 #include <dtls/Parser.h>
 #include <srtp/ParserSRTP.h>
+#include <stun/TransactionTable.h>
 
 namespace ice {
 
+  class Stream;
+  class CandidatePair;
+
+  /* 
+     The states of a candidate pair. We're a lite agent, so the controlling
+     agent does the checks and we learn the state from its requests; a pair
+     is only created for an authenticated check and we only send checks for
+     consent. See Agent.h for how a pair goes from one state to the next and
+     when it's removed.
+  */
+  enum CandidatePairState {
+    CANDIDATE_PAIR_STATE_SUCCEEDED = 0,                               /* we answered an authenticated check */
+    CANDIDATE_PAIR_STATE_NOMINATED = 1,                               /* the controlling agent sent USE-CANDIDATE on it */
+    CANDIDATE_PAIR_STATE_EXPIRED = 2                                  /* consent expired or the pair was idle; the pair is removed right after */
+  };
+
+  const char* candidate_pair_state_to_string(int state);
+
   /* -------------------------------------------------- */
 
+  /* a local candidate: an address we receive on and send from. */
   class Candidate {
   public:
     Candidate(std::string ip, uint16_t port);
+    Candidate(const rtc::Endpoint& ep);                               /* creates a candidate for the given local endpoint. */
     bool init(connection_on_data_callback cb, void* user);            /* pass in the function which will receive the data from the socket. */
+    bool initShared(rtc::ConnectionUDP* shared);                      /* use a shared socket (see ice::PortMux) instead of our own; the ip and port are taken from the shared socket. */
     void update();                                                    /* read data from the socket + process */
 
   public:
     std::string ip;                                                   /* the ip to which we can send data */ 
     uint16_t port;                                                    /* the port to which we can send data */
+    rtc::Endpoint endpoint;                                           /* ip and port as endpoint; this is what we compare and send to on the data path. */
     uint8_t component_id;                                             /* compoment id */
     rtc::ConnectionUDP conn;                                          /* the (udp for now) connection on which we receive data; later we can decouple this if necessary. */
+    rtc::ConnectionUDP* transport;                                    /* the connection we send with; points to conn or to the shared socket. */
     connection_on_data_callback on_data;                              /* will be called whenever we receive data from the socket. */
     void* user;                                                       /* user data */
+  };
+
+  /* -------------------------------------------------- */
+
+  /* 
+     A remote candidate: an address of the other agent that sent us data. 
+     We create one for every address a peer sends from (e.g. when it roams
+     or retries from another port), so it's only the endpoint; the sockets
+     are local and the dtls and srtp state belongs to the stream.
+  */
+  class RemoteCandidate {
+  public:
+    RemoteCandidate(const rtc::Endpoint& ep);
+
+  public:
+    rtc::Endpoint endpoint;                                           /* the address of the other agent */
+  };
+
+  /* -------------------------------------------------- */
+
+  /* 
+     The dtls association and the srtp contexts it keys; one per stream
+     (component), shared by its pairs. A record that arrives on a new path
+     continues the same handshake and the keys work on every pair.
+  */
+  class DtlsTransport {
+  public:
+    DtlsTransport();
 
-    /* only local candidates initialize these contexts */
-    dtls::Parser dtls;                                                /* a local candidate sets up dtls context */
+  public:
+    dtls::Parser parser;                                              /* the handshake; its buffer is the scratch of the AgentContext */
     srtp::ParserSRTP srtp_out;                                        /* used to protect outgoing data. */
     srtp::ParserSRTP srtp_in;                                         /* used to unprotect incoming data. */
+    CandidatePair* pair;                                              /* the pair the last record arrived on, we send our records on it; NULL when it was removed. */
   };
 
   /* -------------------------------------------------- */
@@ -37,12 +93,31 @@ namespace ice {
   class CandidatePair {
   public:
     CandidatePair();
-    CandidatePair(Candidate* local, Candidate* remote);
+    CandidatePair(Candidate* local, RemoteCandidate* remote);
     ~CandidatePair();
 
   public:
     Candidate* local;                                                 /* local candidate; which has a socket (ConnectionUDP) */
-    Candidate* remote;                                                /* the remote party from which we receive data and send data towards. */
+    RemoteCandidate* remote;                                          /* the remote party from which we receive data and send data towards. */
+    rtc::Endpoint remote_endpoint;                                    /* a copy of remote->endpoint, so sending doesn't need to touch the remote candidate. */
+    Stream* stream;                                                   /* the stream that owns this pair. */
+    int state;                                                        /* the CandidatePairState */
+    uint64_t priority;                                                /* the pair priority (RFC 8445, 6.1.2.3) from the PRIORITY of the last check and ours; selects between nominated pairs. */
+    DtlsTransport* dtls;                                              /* the dtls transport of the stream (not ours); NULL until the stream received a dtls record. */
+
+    /* consent freshness, see http://tools.ietf.org/html/rfc7675 */
+    rtc::Timer consent_timer;                                         /* fires when we need to send the next consent check */
+    rtc::Timer expire_timer;                                          /* fires when we didn't get consent in time; the pair is removed then */
+    stun::Transaction* consent_transaction;                           /* the outstanding consent check, or NULL */
+    uint64_t consent_time;                                            /* the last time (millis) we got consent */
+
+    /* idle timeout, for the pairs that aren't selected */
+    rtc::Timer idle_timer;                                            /* fires every ICE_PAIR_IDLE_TIMEOUT; the pair is removed when it didn't receive anything since the last time */
+    uint64_t idle_npackets;                                           /* the number of packets we had received when the idle timer was started */
+
+    /* stats */
+    rtc::PacketCounters recv_counters;                                /* the packets and bytes we received on this pair, per rtc::PacketClass */
+    uint64_t nsrtp_errors;                                            /* number of RTP and RTCP packets we couldn't unprotect */
   };
 
 } /* namespace ice */
@@ -0,0 +1,97 @@
+/*
+
+  FlowTable
+  ---------
+
+  Maps the 5-tuple of a datagram to whatever belongs to it; ice::Stream
+  uses it to find the candidate pair (and the local and remote candidates)
+  for the data it receives. A stream can have thousands of pairs, e.g.
+  when a peer sends from many ports, and we look one up for every packet,
+  so a linear scan over the pairs doesn't do.
+
+  The key is the local and remote endpoint packed into a FlowKey; the
+  transport is always UDP so we don't store it. The hash is combined from
+  the hashes the endpoints already carry, so building a key doesn't parse
+  or format anything. The table is an ice::HashTable on that key.
+
+  A key with an unset endpoint is fine, e.g. to index the candidates on
+  one endpoint only, or the routes of a PortMux on the remote endpoint.
+
+  <example>
+
+     ice::FlowTable table;
+     ice::FlowKey key(remote, local);
+
+     table.insert(key, pair);
+     CandidatePair* found = static_cast<CandidatePair*>(table.find(key));
+     table.remove(key);
+
+  </example>
+
+ */
+#ifndef ICE_FLOW_TABLE_H
+#define ICE_FLOW_TABLE_H
+
+#include <stdint.h>
+#include <rtc/Endpoint.h>
+#include <ice/HashTable.h>
+
+namespace ice {
+
+  /* --------------------------------------------------------------------- */
+
+  class FlowKey {
+  public:
+    FlowKey();
+    FlowKey(const rtc::Endpoint& remote, const rtc::Endpoint& local);
+    void set(const rtc::Endpoint& remote, const rtc::Endpoint& local);
+    bool operator==(const FlowKey& other) const;
+
+  public:
+    uint32_t remote_addr;                                                                /* network byte order */
+    uint32_t local_addr;                                                                 /* network byte order */
+    uint16_t remote_port;                                                                /* network byte order */
+    uint16_t local_port;                                                                 /* network byte order */
+    uint32_t hash;                                                                       /* combined from the hashes of the endpoints */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  typedef HashTable<FlowKey> FlowTable;
+  typedef HashSlot<FlowKey> FlowSlot;
+
+  /* --------------------------------------------------------------------- */
+
+  inline FlowKey::FlowKey()
+    :remote_addr(0)
+    ,local_addr(0)
+    ,remote_port(0)
+    ,local_port(0)
+    ,hash(0)
+  {
+  }
+
+  inline FlowKey::FlowKey(const rtc::Endpoint& remote, const rtc::Endpoint& local) {
+    set(remote, local);
+  }
+
+  inline void FlowKey::set(const rtc::Endpoint& remote, const rtc::Endpoint& local) {
+    remote_addr = remote.addr.sin_addr.s_addr;
+    remote_port = remote.addr.sin_port;
+    local_addr = local.addr.sin_addr.s_addr;
+    local_port = local.addr.sin_port;
+    uint32_t h = remote.hash ^ (local.hash * 0xC2B2AE3Du);
+    hash = h ^ (h >> 15);
+  }
+
+  inline bool FlowKey::operator==(const FlowKey& other) const {
+    return hash == other.hash
+      && remote_addr == other.remote_addr
+      && remote_port == other.remote_port
+      && local_addr == other.local_addr
+      && local_port == other.local_port;
+  }
+
+} /* namespace ice */
+
+#endif
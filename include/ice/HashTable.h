@@ -0,0 +1,258 @@
+/*
+
+  HashTable
+  ---------
+
+  An open addressing hash table (linear probing, backward shift deletion,
+  see stun::TransactionTable) that maps a small key to a pointer. It's
+  what the lookups on the receive path use: ice::FlowTable (the pairs and
+  candidates of a stream, the routes of a PortMux) and the ufrag index of
+  ice::PortMux. The table grows when it's half full and the slots are only
+  allocated with the first insert, so an empty table costs nothing.
+
+  The key is copied into the slot; it must have a `hash` member and an
+  operator==. A NULL value marks an empty slot, so you can't store NULL.
+
+  <example>
+
+     ice::HashTable<ice::FlowKey> table;
+
+     table.insert(key, pair);
+     CandidatePair* found = static_cast<CandidatePair*>(table.find(key));
+     table.remove(key);
+
+  </example>
+
+ */
+#ifndef ICE_HASH_TABLE_H
+#define ICE_HASH_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HASH_TABLE_INITIAL_SLOTS 8                                                       /* the number of slots we allocate with the first insert, must be a power of two; the table grows when it's half full. */
+
+namespace ice {
+
+  /* --------------------------------------------------------------------- */
+
+  template<class Key>
+  class HashSlot {
+  public:
+    Key key;
+    void* value;                                                                         /* NULL for an empty slot */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  template<class Key>
+  class HashTable {
+  public:
+    HashTable();
+    ~HashTable();
+    bool insert(const Key& key, void* value);                                            /* adds or replaces the value for key; returns false for an invalid value. */
+    void* find(const Key& key) const;                                                    /* returns the value for key or NULL. */
+    bool remove(const Key& key);                                                         /* returns true when key was found and removed. */
+    uint32_t removeValue(void* value);                                                   /* removes every entry with the given value, scans the whole table; returns the number of entries we removed. */
+    void clear();                                                                        /* removes everything and frees the slots. */
+    uint32_t size() const;                                                               /* the number of entries */
+    uint32_t capacity() const;                                                           /* the number of slots */
+
+  private:
+    HashTable(const HashTable&);
+    HashTable& operator=(const HashTable&);
+    void resize(uint32_t nslots);                                                        /* rehashes the table */
+    void removeSlot(uint32_t i);                                                         /* backward shift deletion */
+
+  private:
+    HashSlot<Key>* slots;                                                                /* open addressing hash, linear probing */
+    uint32_t mask;                                                                       /* number of slots - 1 */
+    uint32_t nused;                                                                      /* number of used slots */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  template<class Key>
+  HashTable<Key>::HashTable()
+    :slots(NULL)
+    ,mask(0)
+    ,nused(0)
+  {
+  }
+
+  template<class Key>
+  HashTable<Key>::~HashTable() {
+    clear();
+  }
+
+  template<class Key>
+  bool HashTable<Key>::insert(const Key& key, void* value) {
+
+    if (!value) {
+      return false;
+    }
+
+    if (!slots) {
+      resize(HASH_TABLE_INITIAL_SLOTS);
+    }
+    else if (nused + 1 > (mask + 1) / 2) {
+      resize((mask + 1) * 2);
+    }
+
+    uint32_t i = key.hash & mask;
+
+    while (NULL != slots[i].value) {
+      if (slots[i].key == key) {
+        slots[i].value = value;
+        return true;
+      }
+      i = (i + 1) & mask;
+    }
+
+    slots[i].key = key;
+    slots[i].value = value;
+    nused++;
+
+    return true;
+  }
+
+  template<class Key>
+  inline void* HashTable<Key>::find(const Key& key) const {
+
+    if (!slots) {
+      return NULL;
+    }
+
+    uint32_t i = key.hash & mask;
+
+    while (NULL != slots[i].value) {
+      if (slots[i].key == key) {
+        return slots[i].value;
+      }
+      i = (i + 1) & mask;
+    }
+
+    return NULL;
+  }
+
+  template<class Key>
+  bool HashTable<Key>::remove(const Key& key) {
+
+    if (!slots) {
+      return false;
+    }
+
+    uint32_t i = key.hash & mask;
+
+    while (NULL != slots[i].value) {
+      if (slots[i].key == key) {
+        removeSlot(i);
+        return true;
+      }
+      i = (i + 1) & mask;
+    }
+
+    return false;
+  }
+
+  template<class Key>
+  uint32_t HashTable<Key>::removeValue(void* value) {
+
+    uint32_t nremoved = 0;
+    uint32_t i = 0;
+
+    if (!slots || !value) {
+      return 0;
+    }
+
+    /* removing shifts entries backwards, so we check the same slot again after a removal. */
+    while (i <= mask && 0 != nused) {
+      if (slots[i].value == value) {
+        removeSlot(i);
+        nremoved++;
+        continue;
+      }
+      ++i;
+    }
+
+    return nremoved;
+  }
+
+  template<class Key>
+  void HashTable<Key>::clear() {
+
+    if (slots) {
+      delete[] slots;
+      slots = NULL;
+    }
+
+    mask = 0;
+    nused = 0;
+  }
+
+  template<class Key>
+  inline uint32_t HashTable<Key>::size() const {
+    return nused;
+  }
+
+  template<class Key>
+  inline uint32_t HashTable<Key>::capacity() const {
+    return (slots) ? (mask + 1) : 0;
+  }
+
+  template<class Key>
+  void HashTable<Key>::resize(uint32_t nslots) {
+
+    HashSlot<Key>* old_slots = slots;
+    uint32_t old_nslots = (old_slots) ? (mask + 1) : 0;
+
+    slots = new HashSlot<Key>[nslots];
+    for (uint32_t i = 0; i < nslots; ++i) {
+      slots[i].value = NULL;
+    }
+
+    mask = nslots - 1;
+    nused = 0;
+
+    for (uint32_t i = 0; i < old_nslots; ++i) {
+      if (NULL != old_slots[i].value) {
+        insert(old_slots[i].key, old_slots[i].value);
+      }
+    }
+
+    if (old_slots) {
+      delete[] old_slots;
+    }
+  }
+
+  template<class Key>
+  void HashTable<Key>::removeSlot(uint32_t i) {
+
+    uint32_t j = i;
+
+    slots[i].value = NULL;
+    nused--;
+
+    /* move up the entries after the hole that may not skip it, so lookups never stop early. */
+    while (true) {
+
+      j = (j + 1) & mask;
+      if (NULL == slots[j].value) {
+        break;
+      }
+
+      uint32_t home = slots[j].key.hash & mask;
+      bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+      if (stays) {
+        continue;
+      }
+
+      slots[i] = slots[j];
+      slots[j].value = NULL;
+      i = j;
+    }
+  }
+
+} /* namespace ice */
+
+#endif
@@ -0,0 +1,149 @@
+/*
+
+  PortMux
+  -------
+
+  Runs all streams (sessions) on one shared UDP socket instead of a socket
+  per local candidate. This keeps the number of sockets (and the work per
+  loop iteration) flat when we serve thousands of peers and means we only
+  need to open one port in the firewall.
+
+  Packets are routed to the stream they belong to:
+
+  - a packet from a remote endpoint we know is routed via the route table,
+    an ice::FlowTable on the remote endpoint (on a shared socket the local
+    side of the 5-tuple is always the same);
+  - a packet from an unknown endpoint must be a STUN binding request; we
+    route it on the local ufrag of its USERNAME ("local:remote"), which we
+    look up in an ice::HashTable on the ufrag. When the
+    request passes the integrity check of that stream we learn the route,
+    so the DTLS and SRTP traffic that follows finds the stream directly.
+    Anything else from an unknown endpoint is dropped. When no stream
+    uses the ufrag, the on_claim callback (when set) can add one after it
+    verified the request, or pass the datagram on to another mux, see
+    ice::WorkerPool.
+
+  A stream that uses a PortMux gets one local host candidate for the shared
+  ip and port; that's what ice::Agent::getSDP() advertises. The stream
+  credentials must be set before the agent is initialized because we
+  register the stream on its ufrag; when they change afterwards the stream
+  registers itself again (and loses its routes).
+
+  Adding and removing a stream costs O(1): a stream counts the routes we
+  have to it, and removeStream() removes them via its remote candidates.
+
+  <example>
+
+     ice::PortMux mux;
+     mux.init("192.168.0.193", 59976);
+
+     agent.setPortMux(&mux);
+     agent.addStream(stream);
+     agent.setCredentials(ufrag, pwd);
+     agent.init();
+
+     while (true) {
+       mux.update();
+       agent.update();
+     }
+
+  </example>
+
+ */
+#ifndef ICE_PORT_MUX_H
+#define ICE_PORT_MUX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <rtc/Connection.h>
+#include <rtc/Endpoint.h>
+#include <stun/MessageView.h>
+#include <ice/FlowTable.h>
+#include <ice/HashTable.h>
+
+namespace ice {
+
+  class Stream;
+  class PortMux;
+
+  typedef void(*port_mux_claim_callback)(PortMux* mux, const char* ufrag, uint32_t nbytes, stun::MessageView* request, rtc::Packet* pkt, void* user);  /* gets called for a binding request with an unknown ufrag; add the stream for it with addStream() to route the request. */
+
+  uint32_t port_mux_hash_ufrag(const char* ufrag, uint32_t nbytes);                      /* FNV-1a; the hash we use for the ufrag table. */
+
+  /* --------------------------------------------------------------------- */
+
+  class UfragKey {
+  public:
+    UfragKey();
+    UfragKey(const char* ufrag, uint32_t len);
+    bool operator==(const UfragKey& other) const;
+
+  public:
+    const char* data;                                                                    /* the ufrag; in the table it points at the ice_ufrag of the stream. */
+    uint32_t nbytes;
+    uint32_t hash;                                                                       /* port_mux_hash_ufrag() */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class PortMux {
+  public:
+    PortMux();
+    ~PortMux();
+    bool init(std::string ip, uint16_t port);                                            /* binds the shared socket. */
+    void update();                                                                       /* receives and routes data; call this often. */
+    int addStream(Stream* stream);                                                       /* registers the stream on its ice_ufrag; returns 0 on success. */
+    void removeStream(Stream* stream);                                                   /* removes the stream and all routes to it. */
+    Stream* findStream(const char* ufrag, uint32_t nbytes);                              /* returns the stream with the given ice_ufrag or NULL. */
+    Stream* findStream(const std::string& ufrag);                                        /* returns the stream with the given ice_ufrag or NULL. */
+    bool addRoute(const rtc::Endpoint& remote, Stream* stream);                          /* routes all data from remote to stream. */
+    void removeRoute(const rtc::Endpoint& remote);                                       /* removes the route for remote, e.g. when its candidate pair is removed. */
+    Stream* findRoute(const rtc::Endpoint& remote);                                      /* returns the stream for remote or NULL. */
+    void handleData(rtc::Packet* pkt);                                                   /* routes a datagram we received; is called by the connection. */
+
+  private:
+    Stream* routeRequest(rtc::Packet* pkt);                                              /* finds the stream for a binding request from an unknown endpoint and learns the route. */
+
+  public:
+    rtc::ConnectionUDP conn;                                                             /* the shared socket */
+    uint32_t nstreams;                                                                   /* the number of streams we route to */
+    port_mux_claim_callback on_claim;                                                    /* is called when we receive a request for an unknown ufrag */
+    void* claim_user;                                                                    /* passed into on_claim */
+
+    /* stats */
+    uint64_t nrouted;                                                                    /* datagrams we routed via the route table */
+    uint64_t nlearned;                                                                   /* routes we learned from binding requests */
+    uint64_t nunrouted;                                                                  /* datagrams we dropped because we don't know where they belong */
+
+  private:
+    FlowTable routes;                                                                    /* the streams on the remote endpoint, the local one is unset */
+    HashTable<UfragKey> ufrags;                                                          /* the streams on their local ufrag */
+    bool is_initialized;
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  inline UfragKey::UfragKey()
+    :data(NULL)
+    ,nbytes(0)
+    ,hash(0)
+  {
+  }
+
+  inline UfragKey::UfragKey(const char* ufrag, uint32_t len)
+    :data(ufrag)
+    ,nbytes(len)
+    ,hash(port_mux_hash_ufrag(ufrag, len))
+  {
+  }
+
+  inline bool UfragKey::operator==(const UfragKey& other) const {
+    return hash == other.hash
+      && nbytes == other.nbytes
+      && 0 == memcmp(data, other.data, nbytes);
+  }
+
+} /* namespace ice */
+
+#endif
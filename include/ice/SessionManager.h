@@ -0,0 +1,90 @@
+/*
+
+  SessionManager
+  --------------
+
+  Serves many independent peers from one process. Each session is an
+  ice::Agent with its own streams, credentials and lifecycle; the manager
+  runs all of them on one shared socket (an ice::PortMux) and gives them
+  one ice::AgentContext, so they share the certificate and SSL_CTX, the
+  timer wheel and the stun transactions. What's left per session is the
+  agent, its streams and their candidates and pairs, see getMemoryUsage().
+
+  The sessions are indexed by the local ufrag of their streams and by the
+  remote endpoints the mux learns from authenticated binding requests; on
+  the shared socket the local side of the 5-tuple is always the same. Both
+  indices are open addressing hashes, so adding and removing a session is
+  O(1) (besides creating its streams).
+
+  Set the credentials of each stream before you add the session; streams
+  that share a port need a unique ice-ufrag. The manager doesn't use
+  threads, use one per thread (or see ice::WorkerPool) when you need more.
+
+  <example>
+
+     ice::SessionManager manager;
+     manager.init("192.168.0.193", 59976);        // or pass a certificate and key file
+
+     ice::Agent* agent = new ice::Agent();
+     ice::Stream* stream = new ice::Stream(STREAM_FLAG_VP8 | STREAM_FLAG_RTCP_MUX);
+     agent->addStream(stream);
+     agent->setCredentials(ufrag, pwd);
+     manager.addSession(agent);                   // the manager owns the agent now
+     std::string sdp = agent->getSDP();
+
+     while (true) {
+       manager.update();
+     }
+
+     manager.removeSession(agent);                // when the peer leaves
+
+  </example>
+
+ */
+#ifndef ICE_SESSION_MANAGER_H
+#define ICE_SESSION_MANAGER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <ice/Agent.h>
+#include <ice/AgentContext.h>
+#include <ice/PortMux.h>
+#include <rtc/Runtime.h>
+
+#define SESSION_MANAGER_MAX_TRANSACTIONS 16384                                             /* the number of stun transactions (e.g. consent checks) all sessions together can have outstanding. */
+
+namespace ice {
+
+  class SessionManager {
+  public:
+    SessionManager();
+    ~SessionManager();                                                                     /* removes all sessions, see shutdown() */
+    bool init(std::string ip, uint16_t port);                                              /* binds the shared socket and generates a self signed certificate for all sessions. */
+    bool init(std::string ip, uint16_t port, std::string certfile, std::string keyfile);   /* binds the shared socket and loads the certificate and key for all sessions. */
+    void setRuntime(rtc::Runtime* runtime);                                                /* run the socket and timers on the runtime, so you don't call update(); call before init(), we don't take ownership. */
+    void update();                                                                         /* the polled API: receives and routes data and runs the timers; call this often. */
+    void shutdown();                                                                       /* removes all sessions and closes the socket; without a runtime we run the loop until it's closed, with a runtime call this on its loop thread (e.g. in on_stop). */
+    int addSession(Agent* agent);                                                          /* initializes the agent on our socket and context and takes ownership; returns 0 on success. On error the agent still belongs to the caller. */
+    int removeSession(Agent* agent);                                                       /* removes and deletes the session; returns 0 on success. */
+    Agent* findSession(const std::string& ufrag);                                          /* returns the session with a stream that uses this local ufrag, or NULL. */
+    Agent* findSession(const rtc::Endpoint& remote);                                       /* returns the session that receives the data from remote, or NULL. */
+    size_t getMemoryUsage();                                                               /* returns the number of bytes all sessions use; divide by sessions.size() for the cost per session. The shared context and socket aren't included. */
+
+  private:
+    bool initShared(std::string ip, uint16_t port);                                        /* creates the context and binds the socket, once the certificate is ready */
+
+  public:
+    AgentContext context;                                                                  /* shared by all sessions */
+    PortMux mux;                                                                           /* the shared socket and the ufrag and remote endpoint indices */
+    rtc::Runtime* runtime;                                                                 /* when set, the runtime runs our socket and timers, see setRuntime(). */
+    std::vector<Agent*> sessions;                                                          /* all sessions; Agent::session_index is the index in here */
+
+    /* stats */
+    uint64_t nadded;                                                                       /* sessions we added */
+    uint64_t nremoved;                                                                     /* sessions we removed */
+  };
+
+} /* namespace ice */
+
+#endif
@@ -3,8 +3,12 @@
 
 #include <vector>
 #include <ice/Candidate.h>
+#include <ice/FlowTable.h>
+#include <ice/PortMux.h>
 #include <dtls/Parser.h>
 #include <srtp/ParserSRTP.h>
+#include <stun/BindingResponder.h>
+#include <stun/IntegrityKey.h>
 
 /* flags, used to control the way the stream works */
 #define STREAM_FLAG_NONE         0x0000
@@ -18,43 +22,75 @@ namespace ice {
   class Stream;
 
   /* gets called when a stream received data, for which we haven't found a candidate pair yet. */
-  typedef void(*stream_data_callback)(Stream* stream, 
-                                      std::string rip, uint16_t rport, 
-                                      std::string lip, uint16_t lport,
-                                      uint8_t* data, uint32_t nbytes, void* user);
-                                      
-  /* gets called when we have MEDIA data from a valid candidate (RTP, DTLS, RTCP), e.g. similar to stream_data_callback, only we have a valid candidate pair now. */
-  typedef void(*stream_media_callback)(Stream* stream, CandidatePair* pair, 
-                                       uint8_t* data, uint32_t nbytes, void* user);
+  typedef void(*stream_data_callback)(Stream* stream, rtc::Packet* pkt, void* user);
+
+  /* gets called when we have MEDIA data from a valid candidate (RTP, DTLS, RTCP), e.g. similar to stream_data_callback, only we have a valid candidate pair now; pkt->data and pkt->nbytes are the unprotected data. */
+  typedef void(*stream_media_callback)(Stream* stream, CandidatePair* pair, rtc::Packet* pkt, void* user);
                                       
 
+  /* counters for the stun messages that we received on a stream. */
+  class StunStats {
+  public:
+    StunStats();
+
+  public:
+    uint64_t naccepted;                                                                         /* number of requests that passed verification. */
+    uint64_t nrejected_fingerprint;                                                             /* rejected because the FINGERPRINT was missing or invalid. */
+    uint64_t nrejected_username;                                                                /* rejected because the USERNAME doesn't start with our ice_ufrag. */
+    uint64_t nrejected_integrity;                                                               /* rejected because the MESSAGE-INTEGRITY was missing or invalid. */
+    uint64_t nmalformed;                                                                        /* messages that looked like stun but couldn't be parsed; dropped w/o logging. */
+  };
+
   class Stream {
   public:
     Stream(uint32_t flags = STREAM_FLAG_NONE);
     ~Stream();
     bool init();                                                                                /* initialize, must be called once after all local candidates have been added */
+    bool initShared(PortMux* mux);                                                              /* initialize on the shared socket of the mux instead; adds a local candidate for it, so don't add local candidates yourself. The credentials must be set. */
     void update();                                                                              /* must be called often, which flush any pending buffers */
     void addLocalCandidate(Candidate* c);                                                       /* add a candidate; we take ownership of the candidate and free it in the d'tor. */
-    void addRemoteCandidate(Candidate* c);                                                      /* add a remote candidate; is done whenever we recieve data from a ip:port for which no CandidatePair exists. */ 
+    void addRemoteCandidate(RemoteCandidate* c);                                                /* add a remote candidate; is done whenever we recieve data from a ip:port for which no CandidatePair exists. */ 
     void addCandidatePair(CandidatePair* p);                                                    /* add a candidate pair; local -> remote data flow */
     void setCredentials(std::string ufrag, std::string pwd);                                    /* set the credentials (ice-ufrag, ice-pwd) for all candidates. */
-    CandidatePair* createPair(std::string rip, uint16_t rport, std::string lip, uint16_t lport);/* creates a new candidate pair for the given IPs, ofc. when the local stream exists */ 
-    CandidatePair* findPair(std::string rip, uint16_t rport, std::string lip, uint16_t lport);  /* used internally to find a pair on which data flows */
-    Candidate* findLocalCandidate(std::string ip, uint16_t port);                               /* find a local candidate for the given local ip and port. */
-    Candidate* findRemoteCandidate(std::string ip, uint16_t port);                              /* find a remote candidate for the given remote ip and port. */
-    int sendRTP(uint8_t* data, uint32_t nbytes);                                                /* send unprotected RTP data; we will make sure it's protected. */
+    void setRemoteCredentials(std::string ufrag, std::string pwd);                              /* set the credentials (ice-ufrag, ice-pwd) of the other agent; needed to send our own requests (e.g. consent checks). */
+    CandidatePair* createPair(const rtc::Endpoint& remote, const rtc::Endpoint& local);         /* creates a new candidate pair for the given endpoints, ofc. when the local candidate exists */ 
+    CandidatePair* findPair(const rtc::Endpoint& remote, const rtc::Endpoint& local);           /* used internally to find a pair on which data flows; one hash lookup on the 5-tuple, the last found pair is checked first. */
+    Candidate* findLocalCandidate(const rtc::Endpoint& ep);                                     /* find a local candidate for the given local endpoint. */
+    RemoteCandidate* findRemoteCandidate(const rtc::Endpoint& ep);                              /* find a remote candidate for the given remote endpoint. */
+    bool removePair(CandidatePair* p);                                                          /* removes and frees the pair and its remote candidate when no other pair uses it; use Agent::removePair() when the agent runs its timers. */
+    void removeDtls();                                                                          /* frees the dtls transport (e.g. when the handshake failed) and clears the references of the pairs; the next dtls record starts a new one. */
+    int sendRTP(uint8_t* data, uint32_t nbytes);                                                /* send unprotected RTP data to the selected pair; we will make sure it's protected. */
+    size_t getMemoryUsage();                                                                    /* returns the number of bytes we use, including our candidates, pairs and indices; not the openssl/libsrtp state of a handshake. */
 
   public:
     std::vector<Candidate*> local_candidates;                                                   /* our local candidates */
-    std::vector<Candidate*> remote_candidates;                                                  /* our remote candidates */
+    std::vector<RemoteCandidate*> remote_candidates;                                            /* our remote candidates */
     std::vector<CandidatePair*> pairs;                                                          /* the candidate pairs */
+    CandidatePair* selected;                                                                    /* the nominated pair we send media on, or NULL; see Agent::selectPair(). */
+    DtlsTransport* dtls;                                                                        /* the dtls association and srtp keys of this stream (component), shared by its pairs; created with the first dtls record, so an idle stream only pays the pointer. */
     stream_data_callback on_data;                                                               /* the stream data callback; is called whenever one of the transports receives data; the Agent handles incoming data. */
     stream_media_callback on_rtp;                                                               /* is called whenever there is decoded rtp data; it's up to the user to call this at the right time, e.g. see Agent.cpp */
+    stream_media_callback on_rtcp;                                                              /* is called whenever there is decoded rtcp data (rtcp-mux); gets user_rtp. */
     void* user_data;                                                                            /* user data that is passed to the on_data handler. */
-    void* user_rtp;                                                                             /* user data that is passed to the on_rtp handler. */
+    void* user_rtp;                                                                             /* user data that is passed to the on_rtp and on_rtcp handlers. */
     std::string ice_ufrag;                                                                      /* the ice_ufrag from the sdp */
     std::string ice_pwd;                                                                        /* the ice-pwd value from the sdp, used when adding the message-integrity element to the responses. */ 
+    stun::IntegrityKey integrity_key;                                                           /* precomputed hmac-sha1 key schedule for ice_pwd; used to sign and verify stun messages. */
+    std::string remote_ice_ufrag;                                                               /* the ice-ufrag of the other agent */
+    std::string check_username;                                                                 /* "<remote_ice_ufrag>:<ice_ufrag>", the USERNAME of the requests we send; set with the credentials. */
+    stun::IntegrityKey remote_integrity_key;                                                    /* precomputed hmac-sha1 key schedule for the ice-pwd of the other agent; used for the requests we send. */
+    stun::BindingResponder responder;                                                           /* creates the binding responses for connectivity checks, uses integrity_key. */
+    StunStats stun_stats;                                                                       /* counts accepted and rejected stun requests */
     uint32_t flags;                                                                             /* bitflags, defines the featues of the stream; e.g. is it VP8, does it use RTCP-MUX, etc.. */
+    PortMux* mux;                                                                               /* the mux when the stream uses a shared socket, otherwise NULL. */
+    uint32_t nroutes;                                                                           /* the number of routes the mux has to this stream; maintained by the mux. */
+    uint64_t ndtls_errors;                                                                      /* dtls handshakes we gave up on, e.g. when the peer didn't negotiate use_srtp */
+
+  private:
+    FlowTable pair_index;                                                                       /* the pairs on their (remote, local) endpoints */
+    FlowTable local_index;                                                                      /* the local candidates on their endpoint */
+    FlowTable remote_index;                                                                     /* the remote candidates on their endpoint */
+    CandidatePair* last_pair;                                                                   /* the pair findPair() found last; most packets in a row belong to the same pair. */
   }; 
 
 } /* namespace ice */
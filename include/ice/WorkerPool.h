@@ -0,0 +1,171 @@
+/*
+
+  WorkerPool
+  ----------
+
+  Runs the agents (sessions) on N worker threads instead of a single thread
+  that pumps uv_default_loop(). Each worker runs its own rtc::Runtime (a loop
+  on a thread of its own) with its own ice::PortMux; all the muxes bind the
+  same media ip and port with
+  SO_REUSEPORT, so the kernel spreads the flows over the workers (optionally
+  with a CBPF program that steers on the flow hash of the 5-tuple, see
+  rtc::ConnectionUDP::steer_group).
+
+  Agents are added to the pool before they receive any traffic. An agent is
+  claimed by the worker that receives the first binding request for one of
+  its ufrags that passes the integrity check of that stream (so a forged
+  request can't pin the session to another worker): that worker
+  initializes the agent on its mux and from then on the agent is only used
+  on that worker thread; the runtime of the worker runs the agent's timers,
+  nobody calls Agent::update(). When the agent can't be initialized it
+  isn't claimed again; the pool keeps it until removeAgent() or stop().
+
+  The kernel only keeps a 5-tuple on the same socket: the checks from the
+  other candidates of the peer, a NAT that rebinds and the streams of a
+  session without BUNDLE may arrive on another worker. That worker finds
+  the ufrag in the claimed agents, verifies the request with a copy of the
+  key of the stream and forwards it to the owner (a copy of the datagram
+  on the task queue of the owner's runtime). It also remembers the remote
+  endpoint, so the DTLS and SRTP that follow are forwarded without taking
+  the lock. The owner never forwards a datagram it got from another worker.
+
+  The workers see every binding request for a ufrag their mux doesn't
+  know, including floods of made up ones. Before they take the lock that
+  protects claiming they check a counting filter on the hash of the
+  pending and claimed ufrags; requests that can't belong to an agent of the
+  pool are dropped without touching the lock.
+
+  The application must not call into an agent that is running on a worker.
+  Use post() instead: the task is pushed on the lock-free queue of the
+  owning worker (see rtc::Runtime::post()) and runs on its thread. Tasks for
+  an agent that isn't claimed yet wait in the pool and run on the worker
+  that claims it, after it initialized the agent.
+
+  <example>
+
+     static void set_remote_credentials(ice::Agent* agent, void* user) {
+       agent->setRemoteCredentials(...);
+     }
+
+     ice::WorkerPool pool;
+     pool.start("192.168.0.193", 59976, 4, true);
+
+     ice::Agent* agent = new ice::Agent();
+     agent->addStream(stream);
+     agent->setCredentials(ufrag, pwd);
+     pool.addAgent(agent);                    // the pool owns the agent now
+     std::string sdp = agent->getSDP();       // advertises the shared port
+
+     pool.post(agent, set_remote_credentials, NULL);
+
+  </example>
+
+ */
+#ifndef ICE_WORKER_POOL_H
+#define ICE_WORKER_POOL_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include <ice/Agent.h>
+#include <ice/FlowTable.h>
+#include <ice/PortMux.h>
+#include <rtc/Packet.h>
+#include <rtc/RecvPool.h>
+#include <rtc/Runtime.h>
+#include <stun/IntegrityKey.h>
+#include <stun/MessageView.h>
+
+#define WORKER_POOL_FILTER_SIZE 4096                                                     /* the number of counters in the filter of pending ufrags, must be a power of two. */
+
+namespace ice {
+
+  class WorkerPool;
+  class Worker;
+
+  typedef void(*agent_task_callback)(Agent* agent, void* user);                         /* runs on the thread that owns the agent. */
+
+  /* --------------------------------------------------------------------- */
+
+  /* a ufrag of an agent that runs on a worker; the other workers use it to forward the traffic of the session. */
+  class WorkerClaim {
+  public:
+    WorkerClaim();
+
+  public:
+    Worker* owner;                                                                       /* the worker that runs the agent */
+    Agent* agent;
+    std::string ufrag;                                                                   /* the ice-ufrag of the stream when it was claimed */
+    stun::IntegrityKey key;                                                              /* a copy of the key of the stream, so the other workers can verify without touching the agent. */
+    std::atomic<uint32_t> nrefs;                                                         /* the workers that still have to forget the claim after it was released */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class Worker {
+  public:
+    Worker(WorkerPool* pool, uint32_t id);
+    ~Worker();
+    void removeAgent(Agent* agent);                                                      /* removes and deletes an agent we own; only on the worker thread. */
+    void forward(Worker* owner, rtc::Packet* pkt);                                       /* passes a copy of the datagram to the worker that runs its session; only on our thread. */
+
+  public:
+    WorkerPool* pool;
+    uint32_t id;                                                                         /* index in the pool */
+    rtc::Runtime runtime;                                                                /* our loop and thread; runs the tasks posted by other threads, see runtime.ntasks */
+    PortMux mux;                                                                         /* our socket in the reuseport group; we receive its datagrams first to forward the ones of other workers */
+    std::vector<Agent*> agents;                                                          /* the agents we claimed */
+    std::map<Agent*, std::vector<WorkerClaim*> > claims;                                 /* the claims of our agents */
+    FlowTable forwards;                                                                  /* the WorkerClaim on the remote endpoint, for the sessions that run on another worker */
+    rtc::RecvPool* recv_pool;                                                            /* the shared pool of our loop; the datagrams other workers forward to us are copied into it */
+    bool is_forwarded;                                                                   /* true while our mux handles a datagram another worker forwarded */
+
+    /* stats */
+    uint64_t nclaimed;                                                                   /* agents we claimed */
+    uint64_t nfailed;                                                                    /* agents we claimed but couldn't initialize */
+    uint64_t nfiltered;                                                                  /* requests for an unknown ufrag we dropped without taking the lock */
+    uint64_t nrejected;                                                                  /* requests for a pending or claimed ufrag that failed the integrity check */
+    uint64_t nforwarded;                                                                 /* datagrams we passed on to the worker that runs their session */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class WorkerPool {
+  public:
+    WorkerPool();
+    ~WorkerPool();
+    int start(std::string ip, uint16_t port, uint32_t nworkers, bool steer);             /* starts nworkers threads which all bind ip:port; steer attaches the CBPF steering program. Returns 0 on success. */
+    void stop();                                                                         /* stops and joins the workers and deletes all agents. */
+    int addAgent(Agent* agent);                                                          /* adds an agent; its streams must have credentials. We take ownership. */
+    int removeAgent(Agent* agent);                                                       /* removes and deletes the agent on the thread that owns it. */
+    int post(Agent* agent, agent_task_callback cb, void* user);                          /* runs cb on the thread that owns the agent; returns 0 when posted. */
+    void claim(Worker* worker, const char* ufrag, uint32_t nbytes, stun::MessageView* request, rtc::Packet* pkt);  /* used by the workers; claims the agent for the ufrag (when not claimed yet and the request verifies) and initializes it on the worker, or forwards the request to the worker that claimed it. */
+    void releaseClaims(Worker* worker, Agent* agent);                                    /* used by the workers; forgets the claims of an agent we remove. */
+
+  public:
+    std::vector<Worker*> workers;
+    std::string ip;                                                                      /* the ip we advertise and bind */
+    uint16_t port;                                                                       /* the shared port */
+
+  private:
+    void addToFilter(const std::string& ufrag);                                          /* counts a pending ufrag; with the lock held. */
+    void removeFromFilter(const std::string& ufrag);                                     /* uncounts a pending ufrag; with the lock held. */
+
+  private:
+    uv_mutex_t mutex;                                                                    /* protects `pending`, `claimed`, `failed`, `tasks` and setting Agent::worker */
+    std::map<std::string, Agent*> pending;                                               /* agents that aren't claimed yet, by the ufrag of each of their streams. */
+    std::map<std::string, WorkerClaim*> claimed;                                         /* the agents that run on a worker, by the ufrag of each of their streams. */
+    std::vector<Agent*> failed;                                                          /* agents a worker couldn't initialize */
+    std::vector<rtc::Task*> tasks;                                                       /* the tasks posted for agents that aren't claimed yet, in order */
+    std::atomic<uint32_t> filter[WORKER_POOL_FILTER_SIZE];                               /* the number of pending and claimed ufrags per hash slot; written with the lock held, read by the workers without it. */
+  };
+
+} /* namespace ice */
+
+#endif
@@ -8,6 +8,67 @@
 
   At this moment there is a base Connection and an ConnectionUDP class.
 
+  ConnectionUDP has two I/O backends, selected with the `mode` member
+  before calling bind():
+
+  - CONNECTION_UDP_MODE_LIBUV:   one datagram per libuv callback and
+                                 one uv_udp_send() per packet.
+  - CONNECTION_UDP_MODE_BATCHED: (Linux) we poll the socket with libuv and
+                                 drain up to CONNECTION_UDP_BATCH_SIZE
+                                 datagrams per wakeup with recvmmsg();
+                                 sendTo() queues the packets which are
+                                 flushed with one sendmmsg() at the end of
+                                 each loop iteration (or when the queue
+                                 is full).
+  - CONNECTION_UDP_MODE_URING:   (Linux 6.0+) io_uring with a multishot
+                                 receive and provided buffers; the sends
+                                 of all connections on a loop are submitted
+                                 together, see Uring.h. When io_uring is
+                                 not available bind() falls back to the
+                                 batched backend.
+
+  The on_data callback is the same for all backends; it gets every
+  datagram as an rtc::Packet, see Packet.h.
+
+  When `offload` is set (the default) the batched backend uses the UDP
+  segmentation offloads of the kernel (Linux 4.18+ for GSO, 5.0+ for GRO):
+
+  - GSO: when we flush, consecutive packets to the same destination with
+         the same size (the last one may be smaller), e.g. the packets of
+         a keyframe, are sent as one "super datagram" with UDP_SEGMENT;
+         the kernel (or the NIC) splits it. That's one trip through the
+         stack instead of one per packet.
+  - GRO: the kernel may coalesce datagrams of the same flow in one read;
+         we split them again before calling on_data, so the callback
+         always gets single datagrams.
+
+  has_gso and has_gro tell what the kernel supports. The libuv backend
+  can't pass the control messages, so it never uses the offloads.
+
+  A connection uses the default uv loop unless you set `loop` before
+  calling bind(), e.g. when every worker thread runs its own loop. With
+  `reuse_port` set (Linux) several connections can bind the same ip and
+  port; the kernel spreads the incoming flows over them. Set
+  `steer_group` to the number of sockets in the group to attach a CBPF
+  program that picks the socket from the flow hash of the 5-tuple.
+
+  With `timestamps` set (the default, Linux) the kernel timestamps every
+  datagram it receives (SO_TIMESTAMPNS); you get it with the receive buffer,
+  see RecvBuffer::timestamp. The timestamp comes in a control message, so
+  only the batched and io_uring backends have it; the libuv backend leaves
+  it 0. We also ask the kernel for the number of
+  datagrams it dropped because the receive queue was full (SO_RXQ_OVFL),
+  which happens when the loop doesn't read the socket often enough. Set
+  `socket_recv_size` and `socket_send_size` to change the size of the
+  socket buffers. getStats() returns the counters of the connection together
+  with the drop count, the depth of the queues and the buffer sizes as
+  the kernel reports them.
+
+  Outgoing packets live in the rtc::SendSlots of the connection pool.
+  sendTo() only copies the data into a slot when it can't be sent
+  right away (or when it must be queued); callers that want to avoid
+  that copy write directly into a slot, see acquireSlot() and submit().
+
 */
 #ifndef RTC_CONNECTION_H
 #define RTC_CONNECTION_H
@@ -19,31 +80,126 @@ extern "C" {
 #include <stdlib.h>
 #include <stdint.h>
 #include <string>
+#include <rtc/Endpoint.h>
+#include <rtc/SendPool.h>
+#include <rtc/RecvPool.h>
+#include <rtc/Packet.h>
+
+#if !defined(CONNECTION_UDP_DEFAULT_MODE)
+#  define CONNECTION_UDP_DEFAULT_MODE rtc::CONNECTION_UDP_MODE_LIBUV       /* the backend that a new ConnectionUDP uses */
+#endif
+
+#define CONNECTION_UDP_BATCH_SIZE 64                                      /* the max number of datagrams we receive or send with one syscall */
+#define CONNECTION_UDP_GSO_MAX_BYTES 65000                                /* the max payload of one GSO send; the kernel limit is 64k minus the headers. */
+#define CONNECTION_UDP_GSO_MAX_SEGMENTS 64                                /* the max number of datagrams in one GSO send (UDP_MAX_SEGMENTS in the kernel) */
+#define CONNECTION_UDP_GRO_BATCH_SIZE 8                                   /* the number of (coalesced) reads per recvmmsg() when GRO is used */
+#define CONNECTION_UDP_GRO_BUFFER_SIZE 65536                              /* the size of the receive buffers when GRO is used; a coalesced read is at most 64k */
 
-typedef void(*connection_on_data_callback)(std::string rip, uint16_t rport,              /* local ip and port */
-                                           std::string lip, uint16_t lport,              /* remote ip and port */
-                                           uint8_t* data, uint32_t nbytes, void* user);  /* gets called when a connection receives some data. */
+typedef void(*connection_on_data_callback)(rtc::Packet* pkt, void* user);              /* gets called when a connection receives some data; the packet is only valid during the call, see Packet.h */
 
 namespace rtc {
 
   class Connnection {
   };
 
+  enum ConnectionUDPMode {
+    CONNECTION_UDP_MODE_LIBUV,
+    CONNECTION_UDP_MODE_BATCHED,
+    CONNECTION_UDP_MODE_URING
+  };
+
+  /* a snapshot of the counters and the socket state of a connection, see ConnectionUDP::getStats(). */
+  class ConnectionUDPStats {
+  public:
+    ConnectionUDPStats();
+
+  public:
+    uint64_t nrecv_calls;                                                 /* the counters of the connection, see ConnectionUDP */
+    uint64_t nrecv_packets;
+    uint64_t nrecv_gro;
+    uint64_t nrecv_truncated;
+    uint64_t nsend_calls;
+    uint64_t nsend_packets;
+    uint64_t nsend_dropped;
+    uint64_t nsend_gso;
+    uint64_t nrecv_overflow;                                              /* number of datagrams the kernel dropped because the receive queue was full */
+    uint32_t recv_queue_bytes;                                            /* bytes waiting in the receive queue, including the overhead of the kernel per datagram */
+    uint32_t send_queue_bytes;                                            /* bytes in the send queue of the kernel */
+    uint32_t recv_buffer_size;                                            /* SO_RCVBUF; the kernel doubles the value that was set for its overhead */
+    uint32_t send_buffer_size;                                            /* SO_SNDBUF */
+    bool has_timestamps;                                                  /* true when the datagrams are timestamped by the kernel */
+  };
+
+  class ConnectionUDPBatch;                                               /* the state of the batched backend, see Connection.cpp */
+  class UringSocket;                                                      /* the state of the io_uring backend, see Uring.h */
+
   class ConnectionUDP {
 
   public:
     ConnectionUDP();
+    ~ConnectionUDP();
     bool bind(std::string ip, uint16_t port);
+    void close();                                                         /* stops receiving and closes the socket; closing finishes on the next loop iteration, see is_closing. */
     void update();
     //    void send(uint8_t* data, uint32_t nbytes); /* @todo - deprecated, use sendTo */
-    void sendTo(std::string rip, uint16_t rport, uint8_t* data, uint32_t nbytes);
+    void sendTo(const Endpoint& dest, uint8_t* data, uint32_t nbytes);   /* sends a datagram; this is what the data path uses. */
+    void sendTo(std::string rip, uint16_t rport, uint8_t* data, uint32_t nbytes); /* parses the ip for each call; use the Endpoint version for anything that's sent often. */
+    void flush();                                                         /* batched and io_uring mode: sends all the queued packets; is called automatically at the end of each loop iteration. */
+    SendSlot* acquireSlot();                                              /* returns a free send slot, or NULL when the pool is exhausted; bind() must have been called. */
+    bool submit(SendSlot* slot, const Endpoint& dest);                    /* sends slot->nbytes of slot->data; the slot is released by the connection, also on error. */
+    void deliver(RecvBuffer* buf);                                        /* passes a received datagram to on_data and drops our reference; used by the backends. */
+    uint64_t readControl(struct msghdr* msg);                             /* reads the SO_RXQ_OVFL counter of the control messages and returns the SO_TIMESTAMPNS timestamp, or 0; used by the backends. */
+    int getStats(ConnectionUDPStats& result);                             /* fills result; returns 0 on success or < 0 when the socket state can't be read (the counters are filled anyway). */
+
+  private:
+    bool bindBatched();
+    bool bindUring();
+    int createSocket();                                                   /* creates, configures and binds a non-blocking socket; returns the fd or -1. */
+    void configureSocket(int fd);                                         /* sets the buffer sizes and enables the timestamps and drop counter. */
+    int getSocket();                                                      /* returns the fd of the backend or -1 when we're not bound. */
+    void sendToQueued(const Endpoint& dest, uint8_t* data, uint32_t nbytes); /* copies the datagram into a slot and queues it (batched and io_uring backends) */
+    bool submitSlot(SendSlot* slot);                                      /* sends a slot with its destination set. */
+    void destroyRecvPool();                                               /* drops the pending receive buffer and our reference to the shared pool; retained buffers stay valid. */
+
+  public:
+    ConnectionUDPMode mode;                                               /* the I/O backend, set before calling bind(), defaults to CONNECTION_UDP_DEFAULT_MODE */
+    ConnectionUDPBatch* batch;                                            /* the batched backend, NULL in the other modes */
+    UringSocket* uring;                                                   /* the io_uring backend, NULL in the other modes */
+    bool reuse_port;                                                      /* set SO_REUSEPORT so other connections can bind the same port; set before bind() */
+    uint32_t steer_group;                                                 /* when > 0 and reuse_port is set, steer the flows over this many sockets on their hash; set before bind() */
+    bool is_open;                                                         /* true when the libuv socket is bound and not closed yet */
+    bool is_closing;                                                      /* true from close() until the loop closed the libuv socket; we must outlive that. */
+    bool offload;                                                         /* batched mode: use UDP GSO/GRO when the kernel supports it; set before bind(), defaults to true */
+    bool has_gso;                                                         /* true when we send with UDP_SEGMENT, set in bind() */
+    bool has_gro;                                                         /* true when the kernel may coalesce the datagrams we receive, set in bind() */
+    bool timestamps;                                                      /* enable kernel receive timestamps (not in libuv mode) and the drop counter; set before bind(), defaults to true */
+    bool has_timestamps;                                                  /* true when the kernel timestamps the datagrams we receive, set in bind() */
+    uint32_t socket_recv_size;                                            /* SO_RCVBUF in bytes; 0 keeps the system default; set before bind() */
+    uint32_t socket_send_size;                                            /* SO_SNDBUF in bytes; 0 keeps the system default; set before bind() */
+    SendPool send_pool;                                                   /* the send slots, see SendPool.h for the stats */
+    RecvPool* recv_pool;                                                  /* the receive buffers of the libuv and batched backends, shared by the connections of our loop; io_uring uses the pool of its ring */
+    uint32_t recv_reserved;                                               /* the buffers we added to recv_pool for our reads */
+    RecvBuffer* recv_pending;                                             /* libuv mode: the buffer we handed to the next read */
+
+    /* stats */
+    uint64_t nrecv_calls;                                                 /* number of receive callbacks, recvmmsg() calls or io_uring completions */
+    uint64_t nrecv_packets;                                               /* number of datagrams we received */
+    uint64_t nsend_calls;                                                 /* number of send syscalls (uv_udp_try_send, uv_udp_send, sendmmsg); io_uring submits for all connections of a loop at once, see UringRing::nsubmit_calls */
+    uint64_t nsend_packets;                                               /* number of datagrams we sent */
+    uint64_t nsend_dropped;                                               /* number of datagrams we dropped because the send queue or pool was full, or the datagram didn't fit in a slot */
+    uint64_t nsend_gso;                                                   /* number of GSO sends, i.e. messages with more than one datagram */
+    uint64_t nrecv_gro;                                                   /* number of coalesced reads that we split into datagrams */
+    uint64_t nrecv_truncated;                                             /* number of datagrams we dropped because they didn't fit in a receive buffer */
+    uint64_t nrecv_overflow;                                              /* number of datagrams the kernel dropped because the receive queue was full (SO_RXQ_OVFL); updated when we receive, see getStats() */
+
   public:
     std::string ip;
     uint16_t port;
+    Endpoint endpoint;         /* the local endpoint, set in bind() and passed into on_data */
     struct sockaddr_in raddr;  /* receive */
     //    struct sockaddr* saddr; /* send (will not be necessary anymore! @todo remove when ice things are working) */
     uv_udp_t sock;
-    uv_loop_t* loop;
+    uv_loop_t* loop;           /* the loop we run on, defaults to uv_default_loop(); set before bind() */
 
     /* callbacks */
     connection_on_data_callback on_data;
@@ -0,0 +1,95 @@
+/*
+
+  Demux
+  -----
+
+  Tells STUN, DTLS, RTP and RTCP apart when they share one port, see
+  http://tools.ietf.org/html/rfc7983#section-7. The first byte of the
+  datagram decides:
+
+      0 -   3   STUN
+     20 -  63   DTLS
+    128 - 191   RTP or RTCP
+
+  and everything else (ZRTP, TURN channels, ...) is unknown to us. With
+  rtcp-mux the second byte separates RTCP from RTP: RTCP packet types are
+  192 - 223, which RTP payload types (with the marker bit) never use, see
+  http://tools.ietf.org/html/rfc5761#section-4.
+
+  classify_packet() is a table lookup on the first byte plus one compare
+  on the second, without branches on the class. It only looks at those two
+  bytes; the handler of the class validates the rest.
+
+  PacketCounters counts the packets and bytes per class, e.g. per
+  ice::CandidatePair.
+
+  <example>
+
+     switch (rtc::classify_packet(pkt->data, pkt->nbytes)) {
+       case rtc::PACKET_CLASS_STUN: { ... break; }
+       case rtc::PACKET_CLASS_DTLS: { ... break; }
+       case rtc::PACKET_CLASS_RTP:  { ... break; }
+       case rtc::PACKET_CLASS_RTCP: { ... break; }
+       default: { ... }                    // drop
+     }
+
+  </example>
+
+ */
+#ifndef RTC_DEMUX_H
+#define RTC_DEMUX_H
+
+#include <stdint.h>
+
+namespace rtc {
+
+  enum PacketClass {
+    PACKET_CLASS_UNKNOWN = 0,
+    PACKET_CLASS_STUN = 1,
+    PACKET_CLASS_DTLS = 2,
+    PACKET_CLASS_RTP = 3,
+    PACKET_CLASS_RTCP = 4,                                                /* must follow PACKET_CLASS_RTP, see classify_packet() */
+    PACKET_CLASS_COUNT = 5
+  };
+
+  extern const uint8_t packet_class_table[256];                           /* the PacketClass for each first byte; RTP and RTCP are both PACKET_CLASS_RTP here. */
+
+  int classify_packet(const uint8_t* data, uint32_t nbytes);              /* returns the PacketClass of a datagram. */
+  const char* packet_class_to_string(int cls);
+
+  /* --------------------------------------------------------------------- */
+
+  class PacketCounters {
+  public:
+    PacketCounters();
+    void add(int cls, uint32_t nbytes);                                   /* counts a packet of the given PacketClass */
+    void reset();
+
+  public:
+    uint64_t npackets[PACKET_CLASS_COUNT];                                /* number of packets per PacketClass */
+    uint64_t nbytes[PACKET_CLASS_COUNT];                                  /* number of bytes per PacketClass */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  inline int classify_packet(const uint8_t* data, uint32_t nbytes) {
+
+    /* the smallest thing we handle is a RTCP header; this also makes it safe to read the second byte. */
+    if (nbytes < 4) {
+      return PACKET_CLASS_UNKNOWN;
+    }
+
+    int cls = packet_class_table[data[0]];
+    cls += (PACKET_CLASS_RTP == cls) & ((uint8_t)(data[1] - 192) < 32);
+
+    return cls;
+  }
+
+  inline void PacketCounters::add(int cls, uint32_t n) {
+    npackets[cls]++;
+    nbytes[cls] += n;
+  }
+
+} /* namespace rtc */
+
+#endif
@@ -0,0 +1,100 @@
+/*
+
+  Endpoint
+  --------
+
+  An IPv4 address and port as we use them on the data path. The address is
+  stored as a `struct sockaddr_in` so we can pass it directly to the socket
+  functions, together with a hash which is computed once when the endpoint
+  is set. Endpoints are compared on the address and port, never on strings.
+
+  We only parse or format an IP string when we create an endpoint for a
+  candidate from the SDP or when we log something; ConnectionUDP hands out
+  endpoints that are filled directly from the address of the received
+  datagram.
+
+  <example>
+
+     rtc::Endpoint ep;
+     if (!ep.set("192.168.0.193", 59976)) {
+       // invalid ip
+     }
+
+     conn.sendTo(ep, data, nbytes);
+     printf("sent to %s:%u\n", ep.getIP().c_str(), ep.getPort());
+
+  </example>
+
+ */
+#ifndef RTC_ENDPOINT_H
+#define RTC_ENDPOINT_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <stdint.h>
+#include <string>
+
+namespace rtc {
+
+  class Endpoint {
+  public:
+    Endpoint();
+    bool set(const std::string& ip, uint16_t port);                       /* parses the ip; returns false when it's not a valid IPv4 address. */
+    void set(const struct sockaddr_in* addr);                             /* copies the address, e.g. of a datagram we received. */
+    std::string getIP() const;                                            /* formats the ip; only use this for logging and the SDP. */
+    uint16_t getPort() const;                                             /* returns the port in host byte order. */
+    uint32_t getAddress() const;                                          /* returns the ip in host byte order. */
+    bool isSet() const;                                                   /* returns true when an address was set. */
+    bool operator==(const Endpoint& other) const;
+    bool operator!=(const Endpoint& other) const;
+
+  private:
+    void updateHash();
+
+  public:
+    struct sockaddr_in addr;                                              /* the address, network byte order */
+    uint32_t hash;                                                        /* hash of the address and port */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  inline void Endpoint::set(const struct sockaddr_in* a) {
+    addr.sin_family = AF_INET;
+    addr.sin_port = a->sin_port;
+    addr.sin_addr.s_addr = a->sin_addr.s_addr;
+    updateHash();
+  }
+
+  inline uint16_t Endpoint::getPort() const {
+    return ntohs(addr.sin_port);
+  }
+
+  inline uint32_t Endpoint::getAddress() const {
+    return ntohl(addr.sin_addr.s_addr);
+  }
+
+  inline bool Endpoint::isSet() const {
+    return 0 != addr.sin_port;
+  }
+
+  inline bool Endpoint::operator==(const Endpoint& other) const {
+    return hash == other.hash
+      && addr.sin_port == other.addr.sin_port
+      && addr.sin_addr.s_addr == other.addr.sin_addr.s_addr;
+  }
+
+  inline bool Endpoint::operator!=(const Endpoint& other) const {
+    return !(*this == other);
+  }
+
+  inline void Endpoint::updateHash() {
+    uint32_t h = (uint32_t)addr.sin_addr.s_addr * 0x9E3779B1u;
+    h ^= (uint32_t)addr.sin_port * 0x85EBCA77u;
+    hash = h ^ (h >> 16);
+  }
+
+} /* namespace rtc */
+
+#endif
@@ -0,0 +1,75 @@
+/*
+
+  Packet
+  ------
+
+  The context of a datagram we received. rtc::ConnectionUDP fills one on
+  the stack for every datagram and passes it by pointer through the receive
+  chain: the connection callback, ice::PortMux, ice::Stream and ice::Agent,
+  up to Stream::on_rtp. A packet only points at things that already exist
+  (the endpoints, the connection and the receive buffer), so passing it on
+  doesn't copy or allocate anything.
+
+  A handler may process the data in place, e.g. the agent unprotects SRTP
+  into the same buffer and updates nbytes before it calls on_rtp. The packet
+  is only valid during the callback; retain() the buffer to keep the data.
+
+  <example>
+
+     static void on_data(rtc::Packet* pkt, void* user) {
+       MyApp* app = static_cast<MyApp*>(user);
+       if (app->jitter.wants(pkt->data, pkt->nbytes)) {
+         pkt->buffer->retain();                   // call release() when it's played out.
+         app->jitter.push(pkt->buffer, pkt->arrival);
+       }
+     }
+
+  </example>
+
+ */
+#ifndef RTC_PACKET_H
+#define RTC_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace rtc {
+
+  class Endpoint;
+  class ConnectionUDP;
+  class RecvBuffer;
+
+  /* --------------------------------------------------------------------- */
+
+  class Packet {
+  public:
+    Packet();
+
+  public:
+    const Endpoint* remote;                                               /* the endpoint that sent it */
+    const Endpoint* local;                                                /* the endpoint of the connection that received it */
+    uint8_t* data;                                                        /* the datagram; handlers may change it in place */
+    uint32_t nbytes;                                                      /* the size of data */
+    uint64_t arrival;                                                     /* when the datagram arrived, in nanoseconds (uv_hrtime()) */
+    uint64_t timestamp;                                                   /* when the kernel received it, in nanoseconds since the epoch; 0 when not available */
+    ConnectionUDP* socket;                                                /* the connection that received it */
+    RecvBuffer* buffer;                                                   /* the buffer that holds data; retain() it to keep the data after the callback */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  inline Packet::Packet()
+    :remote(NULL)
+    ,local(NULL)
+    ,data(NULL)
+    ,nbytes(0)
+    ,arrival(0)
+    ,timestamp(0)
+    ,socket(NULL)
+    ,buffer(NULL)
+  {
+  }
+
+} /* namespace rtc */
+
+#endif
@@ -0,0 +1,144 @@
+/*
+
+  RecvPool
+  --------
+
+  Reference counted receive buffers. rtc::ConnectionUDP receives every
+  datagram into a RecvBuffer from a pool, so a consumer (e.g. a jitter
+  buffer or a retransmission cache) can keep a packet without copying it:
+  retain() the buffer in the data callback and release() it when you're
+  done; the buffer goes back to the pool when the last reference is
+  released. A buffer also carries the metadata of the datagram: when it
+  arrived, the connection that received it and the endpoint that sent it.
+  When the connection enabled kernel timestamps it also carries the time the
+  kernel received it, which doesn't include the time the datagram waited in
+  the receive queue until we read it.
+
+  The pool buffers are RECV_BUFFER_SIZE bytes, enough for anything that's
+  sent with an ethernet MTU. Larger datagrams, and datagrams that arrive
+  when all pool buffers are retained, get a buffer that's allocated on
+  the heap (the jumbo fallback) and freed when it's released.
+
+  A pool belongs to one loop (worker) and its buffers must be retained and
+  released on the thread of that loop; the reference counts aren't atomic.
+  The owner of the pool calls destroy() instead of deleting it: the pool
+  stays alive until the last buffer is released.
+
+  The buffers are allocated RECV_POOL_CHUNK_SIZE at a time when the free
+  list is empty, up to the size of the pool, so a pool only costs the
+  memory of the buffers that were used at the same time. The libuv and
+  batched connections of a loop share one pool (acquireShared()); each
+  connection adds the buffers it keeps for its reads with reserve(), on
+  top of the RECV_POOL_DEFAULT_SIZE buffers the consumers can retain.
+
+  <example>
+
+     static void on_data(rtc::Packet* pkt, void* user) {
+       MyApp* app = static_cast<MyApp*>(user);
+       rtc::RecvBuffer* buf = pkt->buffer;
+       buf->retain();
+       app->jitter.push(buf);                 // call buf->release() when it's played out.
+     }
+
+  </example>
+
+ */
+#ifndef RTC_RECV_POOL_H
+#define RTC_RECV_POOL_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <stdint.h>
+#include <vector>
+#include <rtc/Endpoint.h>
+
+#if !defined(RECV_BUFFER_SIZE)
+#  define RECV_BUFFER_SIZE 2048                                           /* the size of a pool buffer; an MTU plus some room. Larger datagrams get a heap buffer. */
+#endif
+
+#if !defined(RECV_JUMBO_SIZE)
+#  define RECV_JUMBO_SIZE 9216                                            /* the largest datagram a connection receives; a jumbo frame. */
+#endif
+
+#define RECV_POOL_DEFAULT_SIZE 256                                        /* the number of buffers of a shared pool besides the ones its connections reserve */
+#define RECV_POOL_CHUNK_SIZE 16                                           /* the number of buffers we allocate at once */
+
+namespace rtc {
+
+  class ConnectionUDP;
+  class RecvBuffer;
+  class RecvPool;
+
+  typedef void(*recv_pool_release_callback)(RecvPool* pool, RecvBuffer* buf, void* user);  /* is called instead of returning a pool buffer to the free list, e.g. to give it back to the kernel. */
+
+  /* --------------------------------------------------------------------- */
+
+  class RecvBuffer {
+  public:
+    RecvBuffer();
+    void retain();                                                        /* adds a reference */
+    void release();                                                       /* drops a reference; the buffer returns to its pool with the last one. */
+
+  public:
+    uint8_t* base;                                                        /* the memory of the buffer */
+    uint32_t capacity;                                                    /* the size of base */
+    uint8_t* data;                                                        /* the datagram, points into base */
+    uint32_t nbytes;                                                      /* the size of the datagram */
+    uint64_t arrival;                                                     /* when the datagram arrived, in nanoseconds (uv_hrtime()) */
+    uint64_t timestamp;                                                   /* when the kernel received it, in nanoseconds since the epoch (SO_TIMESTAMPNS); 0 when not available */
+    ConnectionUDP* socket;                                                /* the connection that received it */
+    Endpoint remote;                                                      /* the endpoint that sent it */
+    int refcount;
+    uint32_t index;                                                       /* the index in the pool */
+    bool is_jumbo;                                                        /* true when allocated on the heap */
+    RecvPool* pool;
+    RecvBuffer* next;                                                     /* free list */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class RecvPool {
+  public:
+    RecvPool();
+    static RecvPool* acquireShared(uv_loop_t* loop);                      /* returns the pool the connections of the loop share (creating it); call releaseShared() when you're done with it. */
+    void releaseShared();                                                 /* drops a reference to the shared pool; the last one destroys it. */
+    int init(uint32_t count, uint32_t size);                              /* sets the number and size of the buffers, they're allocated when needed; returns 0 on success. */
+    void reserve(uint32_t count);                                         /* adds count buffers to the pool, e.g. for the reads a connection keeps in flight. */
+    void unreserve(uint32_t count);                                       /* removes count buffers again; the ones that were allocated stay until the pool is destroyed. */
+    RecvBuffer* acquire();                                                /* returns a pool buffer with one reference, or NULL when all of them are used. */
+    RecvBuffer* acquireJumbo(uint32_t nbytes);                            /* returns a heap buffer of at least nbytes with one reference; it's freed when released. */
+    RecvBuffer* at(uint32_t index);                                       /* returns the pool buffer with the given index, see on_release. */
+    void release(RecvBuffer* buf);                                        /* is called by RecvBuffer::release() for the last reference. */
+    void destroy();                                                       /* the owner is done with the pool; it's deleted when all buffers are released. */
+
+  public:
+    uint32_t size;                                                        /* the size of the pool buffers */
+    recv_pool_release_callback on_release;                                /* when set, released pool buffers are passed here instead of the free list */
+    void* release_user;                                                   /* passed into on_release */
+
+    /* stats */
+    uint32_t nbuffers;                                                    /* the number of pool buffers we allocated */
+    uint32_t max_buffers;                                                 /* the number of pool buffers we may allocate, rounded up to a whole chunk */
+    uint32_t nused;                                                       /* the number of buffers (pool and heap) with references */
+    uint32_t high_water;                                                  /* the max number of buffers that were used at the same time */
+    uint64_t nexhausted;                                                  /* the number of times acquire() failed because all buffers were used */
+    uint64_t njumbo;                                                      /* the number of heap buffers we allocated */
+
+  private:
+    ~RecvPool();                                                          /* use destroy() */
+    bool grow();                                                          /* allocates a chunk of buffers onto the free list; returns false when we're at max_buffers. */
+
+  private:
+    std::vector<RecvBuffer*> chunks;                                      /* RECV_POOL_CHUNK_SIZE buffers each; the base of the first one is the storage of the chunk. */
+    RecvBuffer* free_list;
+    uint32_t njumbo_used;                                                 /* heap buffers with references */
+    uv_loop_t* shared_loop;                                               /* the loop when we're shared, see acquireShared() */
+    int nshared;                                                          /* the references to the shared pool */
+    bool is_destroyed;
+  };
+
+} /* namespace rtc */
+
+#endif
@@ -0,0 +1,131 @@
+/*
+
+  Runtime
+  -------
+
+  Runs a uv loop the event driven way: run() blocks in the poll phase of the
+  loop until a socket is readable, a timer expires or another thread posts
+  some work, instead of the application calling update() in a busy loop
+  (which burns a core when idle and adds up to one spin interval of latency
+  when it isn't).
+
+  A runtime owns its loop (init()) or drives an existing one, e.g. the
+  default loop (init(uv_default_loop())). Run it on the calling thread with
+  run() or on a thread of its own with start(). Everything that uses the loop
+  (connections, agents) runs on that thread; other threads hand work to it
+  with post(), which pushes a task on a lock-free queue and wakes up the loop.
+
+  The periodic work (stun retransmissions, consent freshness, ...) lives on
+  rtc::TimerWheels. Add a wheel with addTimers() and the runtime advances it;
+  it only ticks while at least one of its wheels has an active timer, so an
+  idle runtime doesn't wake up at all. The runtime has a wheel of its own
+  (`timers`) which you can use for anything else.
+
+  stop() can be called from any thread. The runtime runs the tasks that were
+  posted before, calls on_stop on the loop thread (close your handles
+  there, e.g. the connections that use the loop) and makes run() return.
+
+  When the application still pumps the loop itself, poll() runs one
+  iteration without blocking; that's what the polled API (e.g.
+  ice::Agent::update()) comes down to.
+
+  <example>
+
+     static void on_stop(rtc::Runtime* runtime, void* user) {
+       MyApp* app = static_cast<MyApp*>(user);
+       delete app->agent;
+     }
+
+     static void set_remote_credentials(rtc::Runtime* runtime, void* user) {
+       ...
+     }
+
+     rtc::Runtime runtime;
+     runtime.init();
+     runtime.on_stop = on_stop;
+     runtime.user = &app;
+
+     app.agent->setRuntime(&runtime);         // before agent->init()
+     app.agent->init();
+
+     runtime.start();                         // or runtime.run() to block this thread
+
+     // from any thread
+     runtime.post(set_remote_credentials, &app);
+     runtime.stop();
+
+  </example>
+
+ */
+#ifndef RTC_RUNTIME_H
+#define RTC_RUNTIME_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <rtc/TaskQueue.h>
+#include <rtc/TimerWheel.h>
+
+namespace rtc {
+
+  class Runtime;
+
+  typedef void(*runtime_callback)(Runtime* runtime, void* user);         /* runs on the loop thread */
+
+  /* --------------------------------------------------------------------- */
+
+  class Runtime {
+  public:
+    Runtime();
+    ~Runtime();                                                           /* stops the runtime and closes the loop when we own it. */
+    int init();                                                           /* creates the loop we run; returns 0 on success. */
+    int init(uv_loop_t* loop);                                            /* runs the given loop, e.g. uv_default_loop(); we don't close it. Returns 0 on success. */
+    int run();                                                            /* runs the loop on the calling thread until stop(); returns 0 on success. */
+    int start();                                                          /* calls run() on a new thread; returns 0 on success. */
+    void stop();                                                          /* can be called from any thread; when we started a thread, we join it. */
+    void poll();                                                          /* the polled API: runs one iteration of the loop without blocking. */
+    void post(Task* task);                                                /* runs the task on the loop thread; can be called from any thread, the task callback owns the task. */
+    int post(runtime_callback cb, void* user);                            /* runs cb on the loop thread; can be called from any thread. Returns 0 when posted. */
+    void addTimers(TimerWheel* wheel);                                    /* the runtime advances the wheel; only on the loop thread. */
+    void removeTimers(TimerWheel* wheel);                                 /* only on the loop thread */
+    void processTasks();                                                  /* runs the posted tasks; only on the loop thread. */
+    void updateTimers();                                                  /* advances the wheels; only on the loop thread. */
+    void updateTicker();                                                  /* starts or stops the tick timer when the wheels (don't) have active timers. */
+    void shutdown();                                                      /* on the loop thread, see stop() */
+
+  public:
+    uv_loop_t* loop;                                                      /* the loop we run */
+    TimerWheel timers;                                                    /* a wheel for the users of the runtime, it's advanced like the added ones. */
+    std::vector<TimerWheel*> wheels;                                      /* the wheels we advance */
+    runtime_callback on_stop;                                             /* is called on the loop thread when we stop; close the handles that use our loop. */
+    void* user;                                                           /* passed into on_stop */
+    int nclosing;                                                         /* number of our handles that still need to be closed */
+    std::atomic<bool> is_stopping;                                        /* set by stop() */
+
+    /* stats */
+    uint64_t nwakeups;                                                    /* number of times another thread woke us up */
+    uint64_t ntasks;                                                      /* number of tasks we ran */
+    uint64_t nticks;                                                      /* number of times the tick timer fired */
+
+  private:
+    uv_loop_t own_loop;                                                   /* used when we create the loop */
+    uv_async_t wakeup;                                                    /* is signalled when a task was posted or when we need to stop */
+    uv_timer_t ticker;                                                    /* advances the wheels */
+    uv_prepare_t prepare;                                                 /* (re)starts the ticker before we block */
+    uv_thread_t thread;
+    TaskQueue tasks;                                                      /* posted by any thread */
+    bool is_initialized;
+    bool is_started;                                                      /* true when we run on our own thread */
+    bool is_running;                                                      /* true while run() is running */
+    bool is_ticking;                                                      /* true when the ticker is started */
+    bool is_shutdown;                                                     /* true when shutdown() ran */
+    bool owns_loop;
+  };
+
+} /* namespace rtc */
+
+#endif
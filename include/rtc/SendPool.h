@@ -0,0 +1,102 @@
+/*
+
+  SendPool
+  --------
+
+  A fixed size pool of send slots used by rtc::ConnectionUDP. A slot
+  holds everything that is needed to send one datagram: the libuv request,
+  the destination address and an MTU sized payload area. Instead of passing
+  a buffer to ConnectionUDP::sendTo() (which has to copy it when the send
+  can't complete immediately) you can acquire a slot, write the RTP, SRTP or
+  STUN packet directly into slot->data and submit it; the slot goes back to
+  the free list of the pool when the send completed.
+
+  The pool belongs to one connection and is only used from the thread that
+  runs the loop of that connection, so the free list is a plain intrusive
+  list; acquire() and release() don't lock. The slots are allocated
+  SEND_POOL_CHUNK_SIZE at a time when the free list is empty, so a
+  connection that never has more than a few sends in flight only pays for
+  a few slots; once allocated a slot is reused until the pool is destroyed.
+
+  <example>
+
+     rtc::SendSlot* slot = conn.acquireSlot();
+     if (slot) {
+       slot->nbytes = writer.finish(...);     // write into slot->data, at most sizeof(slot->data) bytes.
+       conn.submit(slot, endpoint);           // don't touch the slot after this.
+     }
+
+  </example>
+
+ */
+#ifndef RTC_SEND_POOL_H
+#define RTC_SEND_POOL_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <stdint.h>
+#include <vector>
+
+#if !defined(SEND_SLOT_SIZE)
+#  define SEND_SLOT_SIZE 1500                                            /* the max payload of a slot; an ethernet MTU */
+#endif
+
+#define SEND_POOL_DEFAULT_SIZE 256                                        /* the default number of slots per connection */
+#define SEND_POOL_CHUNK_SIZE 16                                           /* the number of slots we allocate at once */
+
+namespace rtc {
+
+  class SendPool;
+
+  /* --------------------------------------------------------------------- */
+
+  class SendSlot {
+  public:
+    SendSlot();
+
+  public:
+    uv_udp_send_t req;                                                    /* used for async sends; req.data points to the slot. */
+    struct sockaddr_in addr;                                              /* the destination */
+    uint8_t data[SEND_SLOT_SIZE];                                         /* write the packet into this buffer */
+    uint32_t nbytes;                                                      /* the number of bytes in data */
+    SendPool* pool;                                                       /* the pool that owns this slot */
+    SendSlot* next;                                                       /* free list */
+    bool is_used;                                                         /* true when handed out by acquire() */
+#if defined(__linux__)
+    struct msghdr msg;                                                    /* used by the io_uring backend, see Uring.h */
+    struct iovec iov;
+    void* owner;                                                          /* the rtc::UringSocket that's sending the slot */
+#endif
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class SendPool {
+  public:
+    SendPool();
+    ~SendPool();
+    int init(uint32_t count);                                             /* sets the number of slots, they're allocated when needed; returns 0 on success. */
+    SendSlot* acquire();                                                  /* returns a free slot or NULL when all slots are in use. */
+    void release(SendSlot* slot);                                         /* puts the slot back into the free list. */
+
+  public:
+    /* stats */
+    uint32_t nslots;                                                      /* the number of slots we allocated */
+    uint32_t max_slots;                                                   /* the number of slots we may allocate */
+    uint32_t nused;                                                       /* the number of slots that are in use */
+    uint32_t high_water;                                                  /* the max number of slots that were in use at the same time */
+    uint64_t nexhausted;                                                  /* the number of times acquire() failed because all slots were in use */
+
+  private:
+    bool grow();                                                          /* allocates a chunk of slots onto the free list; returns false when we're at max_slots. */
+
+  private:
+    std::vector<SendSlot*> chunks;                                        /* SEND_POOL_CHUNK_SIZE slots each */
+    SendSlot* free_list;
+  };
+
+} /* namespace rtc */
+
+#endif
@@ -0,0 +1,78 @@
+/*
+
+  TaskQueue
+  ---------
+
+  A lock-free multi producer, single consumer queue of tasks. Any thread can
+  push() a task, only the thread that owns the queue (e.g. the thread that
+  runs a worker loop) may pop() them. Tasks are intrusive: the Task is
+  allocated by the producer (often as part of a larger object) and handed
+  over to the consumer, so the queue itself never allocates.
+
+  This is the well known MPSC queue by Dmitry Vyukov: push() is one atomic
+  exchange; pop() may return NULL while a push() is in progress on another
+  thread, the task is returned by a later pop() then. When you push from
+  another thread, wake up the consumer afterwards (e.g. with uv_async_send()).
+
+  <example>
+
+     static void on_task(rtc::Task* task, void* user) {
+       ...
+       delete task;
+     }
+
+     rtc::Task* task = new rtc::Task();
+     task->run = on_task;
+     queue.push(task);
+
+     // on the consumer thread:
+     rtc::Task* task = NULL;
+     while (NULL != (task = queue.pop())) {
+       task->run(task, task->user);
+     }
+
+  </example>
+
+ */
+#ifndef RTC_TASK_QUEUE_H
+#define RTC_TASK_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+namespace rtc {
+
+  class Task;
+
+  typedef void(*task_callback)(Task* task, void* user);                  /* runs the task on the consumer thread; the callback owns the task. */
+
+  /* --------------------------------------------------------------------- */
+
+  class Task {
+  public:
+    Task();
+    virtual ~Task();
+
+  public:
+    task_callback run;                                                    /* is called on the consumer thread */
+    void* user;                                                           /* passed into run */
+    std::atomic<Task*> next;                                              /* used by the queue */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class TaskQueue {
+  public:
+    TaskQueue();
+    void push(Task* task);                                                /* adds a task; can be called from any thread. */
+    Task* pop();                                                          /* returns the oldest task or NULL; only call this from the consumer thread. */
+
+  private:
+    std::atomic<Task*> head;                                              /* the producers push here */
+    Task* tail;                                                           /* the consumer pops here */
+    Task stub;                                                            /* keeps the list non empty */
+  };
+
+} /* namespace rtc */
+
+#endif
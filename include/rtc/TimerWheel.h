@@ -0,0 +1,110 @@
+/*
+
+  TimerWheel
+  ----------
+
+  A hashed timer wheel that is shared by everything that needs a timeout
+  (stun retransmissions, consent freshness, ...). We don't want to create
+  a uv_timer_t for each of the (possibly) hundreds of thousands of timers
+  we run; starting, stopping and expiring a timer on the wheel is O(1) and
+  doesn't allocate because the rtc::Timer is embedded in the object that
+  owns it (intrusive).
+
+  The wheel has TIMER_WHEEL_SLOTS slots of `resolution` millis each. A timer
+  that expires after more than one revolution keeps a rounds counter which
+  is decremented each time the wheel passes its slot. Timers fire with a
+  precision of one slot (resolution millis).
+
+  The wheel doesn't have its own clock: call update() with the current time
+  in millis, e.g. from ice::Agent::update(). When a wheel isn't updated
+  while it has no timers (e.g. rtc::Runtime stops ticking when idle) call
+  resume() before you update it again, so the timers that were started in
+  the meantime don't fire early.
+
+  <example>
+
+     static void on_timeout(rtc::Timer* timer, void* user) {
+       ...
+     }
+
+     rtc::TimerWheel wheel;
+     rtc::Timer timer;
+
+     wheel.init(uv_hrtime() / 1000000ull);
+     timer.on_timeout = on_timeout;
+     timer.user = this;
+     wheel.start(&timer, 500);
+
+     // and often:
+     wheel.update(uv_hrtime() / 1000000ull);
+
+  </example>
+
+ */
+#ifndef RTC_TIMER_WHEEL_H
+#define RTC_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_SLOTS 512                                                  /* number of slots, must be a power of two. */
+#define TIMER_WHEEL_DEFAULT_RESOLUTION 10                                      /* default millis per slot. */
+
+namespace rtc {
+
+  class Timer;
+
+  typedef void(*timer_callback)(Timer* timer, void* user);                    /* gets called when the timer expires. */
+
+  /* --------------------------------------------------------------------- */
+
+  class Timer {
+  public:
+    Timer();
+    bool isActive();                                                           /* returns true when the timer is started and hasn't fired yet. */
+
+  public:
+    timer_callback on_timeout;                                                 /* called when the timer expires; you can (re)start the timer from the callback. */
+    void* user;                                                                /* passed into on_timeout */
+    uint32_t rounds;                                                           /* number of revolutions before the timer expires; used by the wheel. */
+    Timer* prev;                                                               /* intrusive list; used by the wheel. */
+    Timer* next;                                                               /* intrusive list; used by the wheel. */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class TimerWheel {
+  public:
+    TimerWheel(uint32_t resolution = TIMER_WHEEL_DEFAULT_RESOLUTION);
+    ~TimerWheel();
+    void init(uint64_t nowMillis);                                             /* sets the current time of the wheel, call before you start any timer. */
+    void start(Timer* timer, uint64_t delayMillis);                            /* (re)starts the timer; it fires after delayMillis, rounded up to the resolution. */
+    void stop(Timer* timer);                                                   /* stops the timer; it's safe to stop a timer that isn't active. */
+    void update(uint64_t nowMillis);                                           /* advances the wheel to nowMillis and fires all the timers that expired. */
+    void resume(uint64_t nowMillis);                                           /* moves the clock of a wheel that wasn't updated for a while to nowMillis without firing anything; the active timers keep the delay they were started with. */
+    uint64_t now();                                                            /* returns the time (in millis) the wheel advanced to. */
+
+  private:
+    void link(Timer* head, Timer* timer);
+    void unlink(Timer* timer);
+
+  public:
+    Timer slots[TIMER_WHEEL_SLOTS];                                            /* each slot is the sentinel of a circular list. */
+    uint32_t resolution;                                                       /* millis per slot */
+    uint64_t tick;                                                             /* the last tick we processed; the wheel is at slot (tick & (TIMER_WHEEL_SLOTS - 1)) */
+    uint64_t nactive;                                                          /* number of active timers */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  inline bool Timer::isActive() {
+    return NULL != next;
+  }
+
+  inline uint64_t TimerWheel::now() {
+    return tick * resolution;
+  }
+
+} /* namespace rtc */
+
+#endif
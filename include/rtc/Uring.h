@@ -0,0 +1,147 @@
+/*
+
+  Uring
+  -----
+
+  The io_uring backend of rtc::ConnectionUDP (CONNECTION_UDP_MODE_URING).
+  We talk to the kernel with the raw syscalls, so we don't depend on
+  liburing.
+
+  - There is one UringRing per uv loop, so per worker thread; all the
+    connections on that loop share it. The ring fd is polled by the loop,
+    completions are handled in the poll callback and the queued requests
+    are submitted with one io_uring_enter() before and after the poll
+    phase of each loop iteration.
+  - Each socket has one multishot recvmsg request armed. The kernel picks
+    a buffer from the provided buffer ring that all sockets of the ring
+    share, so we don't need a request or buffer per datagram; we give the
+    buffer back once on_data returned.
+  - Sends use the pooled rtc::SendSlots of the connection. They aren't
+    linked: sends on a shared socket go to different peers and must not
+    fail together.
+
+  The ring needs Linux 6.0 or newer (multishot recvmsg and provided buffer
+  rings). UringRing::acquire() returns NULL when the kernel or the headers
+  we're compiled with don't support that (or io_uring is disabled, e.g. by
+  a seccomp filter); the connection falls back to the batched backend then.
+
+  <example>
+
+     rtc::ConnectionUDP conn;
+     conn.mode = rtc::CONNECTION_UDP_MODE_URING;
+     conn.bind("192.168.0.193", 59976);           // falls back when io_uring isn't available
+     printf("using io_uring: %s\n", (conn.uring) ? "yes" : "no");
+
+  </example>
+
+ */
+#ifndef RTC_URING_H
+#define RTC_URING_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <stdint.h>
+#include <vector>
+
+#define URING_RING_ENTRIES 256                                            /* the size of the submission queue; the completion queue is 4 times larger */
+#define URING_BUFFER_COUNT 512                                            /* the number of receive buffers in the provided buffer ring, must be a power of two */
+#define URING_CONTROL_SIZE 64                                             /* room for the SO_TIMESTAMPNS and SO_RXQ_OVFL control messages */
+#define URING_BUFFER_SIZE 2176                                            /* the size of a receive buffer: a datagram of RECV_BUFFER_SIZE plus the recvmsg header, address and control messages; larger datagrams are dropped */
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace rtc {
+
+  class ConnectionUDP;
+  class SendSlot;
+  class RecvPool;
+  class UringRing;
+
+  /* --------------------------------------------------------------------- */
+
+  class UringSocket {
+  public:
+    UringSocket(UringRing* ring, ConnectionUDP* conn, int fd);
+    ~UringSocket();
+    bool arm();                                                           /* queues the multishot recvmsg */
+    bool send(SendSlot* slot);                                            /* queues a sendmsg for the slot (with its addr and nbytes set); the slot is released when the send completed. */
+    void close();                                                         /* waits for our sends, cancels the receive and deletes the socket when the kernel is done with it. */
+
+  public:
+    UringRing* ring;
+    ConnectionUDP* conn;                                                  /* NULL after close() */
+    int fd;
+    struct msghdr recv_msg;                                               /* template for the multishot recvmsg; only the name and control lengths are used. */
+    bool is_receiving;                                                    /* true while the multishot recvmsg is armed */
+    bool is_closing;                                                      /* true after close() */
+    uint32_t nsending;                                                    /* sends that didn't complete yet */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class UringRing {
+  public:
+    static UringRing* acquire(uv_loop_t* loop);                           /* returns the ring of the loop (creating it), or NULL when io_uring isn't supported. */
+    void release();                                                       /* releases a reference; the ring is destroyed with the last one. */
+    struct io_uring_sqe* getSqe();                                        /* returns a cleared sqe or NULL when the submission queue is full. */
+    void submit();                                                        /* submits the queued requests */
+    void reap();                                                          /* handles the completions */
+    void wait();                                                          /* submits and waits for at least one completion, then handles them */
+    void recycleBuffer(uint16_t bid);                                     /* gives a receive buffer back to the kernel */
+
+    UringRing(uv_loop_t* loop);                                           /* use acquire() */
+    ~UringRing();                                                         /* use release() */
+
+  private:
+    bool init();
+    void shutdown();                                                      /* closes the uv handles, the ring is deleted in the close callback */
+    void handleReceive(UringSocket* sock, struct io_uring_cqe* cqe);
+    void handleSend(SendSlot* slot, struct io_uring_cqe* cqe);
+
+  public:
+    uv_loop_t* loop;
+    int fd;
+    uv_poll_t poll;                                                       /* tells us when there are completions */
+    uv_prepare_t prepare;                                                 /* submits before we block in the poll phase */
+    uv_check_t check;                                                     /* submits what the callbacks queued in the poll phase */
+    int refcount;                                                         /* the number of sockets (and acquire() calls) that use the ring */
+    int nclosing;                                                         /* number of handles that still need to be closed */
+    std::vector<UringSocket*> rearm;                                      /* sockets whose multishot receive ended (e.g. no buffers) */
+
+    /* stats */
+    uint64_t nsubmit_calls;                                               /* number of io_uring_enter() calls */
+    uint64_t nsubmitted;                                                  /* number of requests we submitted */
+    uint64_t nnobufs;                                                     /* number of times the kernel ran out of receive buffers */
+    RecvPool* recv_pool;                                                  /* the URING_BUFFER_COUNT receive buffers of the provided buffer ring, shared by the sockets of the loop */
+
+  private:
+    /* the rings, mapped from the kernel */
+    uint8_t* sq_ptr;
+    uint8_t* cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t* sq_array;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t sq_local_tail;                                               /* sqes we queued; we publish the tail when we submit. */
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe* cqes;
+
+    /* the provided buffer ring */
+    uint8_t* buf_ring;                                                    /* struct io_uring_buf_ring */
+    size_t buf_ring_size;
+    uint16_t buf_tail;
+  };
+
+} /* namespace rtc */
+
+#endif
@@ -0,0 +1,64 @@
+/*
+
+  AttributeRegistry
+  -----------------
+
+  One table that describes all the STUN attributes we know: the type,
+  the allowed length of the value, a decoder that creates the matching
+  stun::Attribute (used by stun::Reader) and a name for logging. The
+  parsers use the table for dispatch and length validation:
+
+  - a known attribute must have a value length in [min_length, max_length].
+  - an unknown attribute in the comprehension-required range (< 0x8000)
+    makes the message invalid, see http://tools.ietf.org/html/rfc5389#section-7.3
+  - an unknown attribute in the comprehension-optional range (>= 0x8000)
+    is skipped.
+
+  The table is sorted on type; this is checked at compile time. Names are
+  only used for logging and never on the hot path.
+
+  <example>
+
+     const stun::AttributeInfo* info = stun::find_attribute_info(type);
+     if (NULL == info && stun::attribute_is_comprehension_required(type)) {
+       // reject
+     }
+
+  </example>
+
+ */
+#ifndef STUN_ATTRIBUTE_REGISTRY_H
+#define STUN_ATTRIBUTE_REGISTRY_H
+
+#include <stdint.h>
+#include <stun/Types.h>
+#include <stun/Attribute.h>
+
+namespace stun {
+
+  /* --------------------------------------------------------------------- */
+
+  typedef Attribute*(*attribute_decoder)(const uint8_t* value, uint16_t length);   /* creates an attribute from the value bytes; returns NULL when the value is invalid. */
+
+  struct AttributeInfo {
+    uint16_t type;                                                                 /* the attribute type */
+    uint16_t min_length;                                                           /* the minimum number of bytes of the value; when min_length == max_length the attribute has a fixed length. */
+    uint16_t max_length;                                                           /* the maximum number of bytes of the value */
+    attribute_decoder decode;                                                      /* NULL when we know the attribute but don't decode it (it's skipped). */
+    const char* name;                                                              /* name, used for logging */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  const AttributeInfo* find_attribute_info(uint16_t type);                         /* returns the descriptor for the given type or NULL when it's unknown. */
+  const char* attribute_type_name(uint16_t type);                                  /* returns the name of a known attribute or "unknown", doesn't allocate. */
+
+  inline bool attribute_is_comprehension_required(uint16_t type) {
+    return type < 0x8000;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+} /* namespace stun */
+
+#endif
@@ -0,0 +1,58 @@
+/*
+
+  BindingResponder
+  ----------------
+
+  Fast path to answer STUN Binding Requests. The general stun::Writer builds
+  a response from heap allocated attributes and grows a std::vector while
+  writing. Every response we send for a connectivity or consent check has the
+  same layout though, so the responder keeps a pre laid out template:
+
+      [ STUN HEADER ]                  - 20 bytes, type = Binding Success Response
+      [ XOR-MAPPED-ADDRESS ]           - 12 bytes, IPv4
+      [ MESSAGE-INTEGRITY ]            - 24 bytes
+      [ FINGERPRINT ]                  -  8 bytes
+
+  For each request we copy the template into the buffer you pass to write(),
+  patch the transaction ID and the XOR-MAPPED-ADDRESS and then compute the
+  HMAC-SHA1 and CRC32 in place. Nothing is allocated.
+
+  The message integrity is computed with the stun::IntegrityKey that you
+  pass into setKey(); ice::Stream owns both and sets them up.
+
+  <example>
+
+     uint8_t buf[STUN_BINDING_RESPONSE_SIZE];
+     int nbytes = stream->responder.write(&request, ip, port, buf);
+     if (nbytes > 0) {
+       conn.sendTo(rip, rport, buf, nbytes);
+     }
+
+  </example>
+
+ */
+#ifndef STUN_BINDING_RESPONDER_H
+#define STUN_BINDING_RESPONDER_H
+
+#include <stdint.h>
+#include <stun/MessageView.h>
+#include <stun/IntegrityKey.h>
+
+#define STUN_BINDING_RESPONSE_SIZE 64                                       /* number of bytes of a binding response that we create. */
+
+namespace stun {
+
+  class BindingResponder {
+  public:
+    BindingResponder();
+    void setKey(IntegrityKey* k);                                           /* set the key (for the local ice-pwd) that is used to compute the message integrity, we don't take ownership. */
+    int write(MessageView* request, uint32_t ip, uint16_t port, uint8_t* output); /* write a response for the given request; ip and port (host byte order) are the source of the request, output must be at least STUN_BINDING_RESPONSE_SIZE bytes. Returns the number of bytes written or < 0 on error. */
+
+  public:
+    uint8_t response[STUN_BINDING_RESPONSE_SIZE];                           /* the template */
+    IntegrityKey* key;                                                      /* used for the message integrity */
+  };
+
+} /* namespace stun */
+
+#endif
@@ -0,0 +1,70 @@
+/*
+
+  BufferWriter
+  ------------
+
+  Writes a STUN message into a fixed buffer that is owned by the caller,
+  e.g. a stack buffer or a slot of a send pool, instead of the std::vector
+  that stun::Writer grows one push_back at a time. Every write checks the
+  bounds of the buffer; when something doesn't fit, the writer stops writing
+  and finish() returns an error. The attributes are written in one pass and
+  finish() computes the MESSAGE-INTEGRITY and FINGERPRINT in place and
+  patches the Message-Length. Nothing is allocated.
+
+  <example>
+
+     uint8_t buf[512];
+     stun::BufferWriter writer(buf, sizeof(buf));
+
+     writer.begin(stun::STUN_BINDING_REQUEST, transaction);
+     writer.writeUsername(username.c_str(), username.size());
+     writer.writePriority(priority);
+     writer.writeIceControlling(tie_breaker);
+
+     int nbytes = writer.finish(&key, true);
+     if (nbytes > 0) {
+       conn.sendTo(rip, rport, buf, nbytes);
+     }
+
+  </example>
+
+ */
+#ifndef STUN_BUFFER_WRITER_H
+#define STUN_BUFFER_WRITER_H
+
+#include <stdint.h>
+#include <stun/Types.h>
+#include <stun/IntegrityKey.h>
+
+namespace stun {
+
+  class BufferWriter {
+  public:
+    BufferWriter(uint8_t* buffer, uint32_t capacity);
+    bool begin(uint16_t type, const uint32_t* transaction);                 /* writes the header; transaction must contain 3 values (like Message::transaction). */
+    bool writeUsername(const char* name, uint16_t nbytes);                  /* writes a USERNAME attribute */
+    bool writeSoftware(const char* name, uint16_t nbytes);                  /* writes a SOFTWARE attribute */
+    bool writePriority(uint32_t priority);                                  /* writes a PRIORITY attribute */
+    bool writeIceControlled(uint64_t tieBreaker);                           /* writes an ICE-CONTROLLED attribute */
+    bool writeIceControlling(uint64_t tieBreaker);                          /* writes an ICE-CONTROLLING attribute */
+    bool writeUseCandidate();                                               /* writes an (empty) USE-CANDIDATE attribute */
+    bool writeXorMappedAddress(uint32_t ip, uint16_t port);                 /* writes an IPv4 XOR-MAPPED-ADDRESS; ip and port in host byte order. */
+    int finish(IntegrityKey* key, bool fingerprint);                        /* appends the MESSAGE-INTEGRITY (when key is given) and FINGERPRINT (when fingerprint is true), patches the Message-Length and returns the size of the message or < 0 on error. */
+
+  private:
+    bool writeAttributeHeader(uint16_t type, uint16_t length);              /* checks if an attribute with the given value length fits, writes the header and zeros the padding. */
+    void writeU16(uint16_t v);
+    void writeU32(uint32_t v);
+    void writeU64(uint64_t v);
+    void setLength(uint16_t length);                                        /* sets the Message-Length header field */
+
+  public:
+    uint8_t* buffer;                                                        /* the buffer we write into, not owned */
+    uint32_t capacity;                                                      /* number of bytes we can write into buffer */
+    uint32_t nbytes;                                                        /* number of bytes written */
+    bool is_overflow;                                                       /* set when something didn't fit into buffer */
+  };
+
+} /* namespace stun */
+
+#endif
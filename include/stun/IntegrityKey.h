@@ -0,0 +1,65 @@
+/*
+
+  IntegrityKey
+  ------------
+
+  HMAC-SHA1 key schedule for the MESSAGE-INTEGRITY attribute. A HMAC is
+  computed as SHA1((K ^ opad) + SHA1((K ^ ipad) + message)). The first
+  block of both the inner and outer hash only depends on the key, so we
+  hash them once in setKey() and keep the resulting SHA1 states. Signing
+  or verifying a message then only costs the hash of the message itself
+  plus one block for the outer hash, instead of re-deriving the pads
+  for every message like HMAC_Init_ex() does.
+
+  ice::Stream owns one for its ice-pwd.
+
+  <example>
+
+     stun::IntegrityKey key;
+     key.setKey("Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC");
+
+     uint8_t sha1[20];
+     key.compute(data, nbytes, sha1);
+
+  </example>
+
+ */
+#ifndef STUN_INTEGRITY_KEY_H
+#define STUN_INTEGRITY_KEY_H
+
+#include <stdint.h>
+#include <string>
+#include <openssl/sha.h>
+
+namespace stun {
+
+  /* --------------------------------------------------------------------- */
+
+  class IntegrityJob {
+  public:
+    const uint8_t* data;                                                    /* the data over which we compute the hmac-sha1 */
+    uint32_t nbytes;                                                        /* number of bytes in data */
+    uint8_t* output;                                                        /* we write the 20 bytes sha1 into this buffer */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class IntegrityKey {
+  public:
+    IntegrityKey();
+    bool setKey(const std::string& key);                                    /* precomputes the inner and outer pad states for the given key. */
+    bool isSet();                                                           /* returns true when setKey() has been called successfully. */
+    bool compute(const uint8_t* data, uint32_t nbytes, uint8_t* output);    /* compute the hmac-sha1 over data and write the 20 bytes into output. */
+    bool computeBatch(IntegrityJob* jobs, uint32_t njobs);                  /* compute the hmac-sha1 of several messages in one call. */
+    bool computeMessage(const uint8_t* msg, uint32_t nbytes, uint16_t length, uint8_t* output); /* compute the hmac-sha1 over the first nbytes of a stun message, using `length` as Message-Length instead of the value in msg; msg isn't changed. */
+    bool verifyMessage(const uint8_t* msg, uint32_t nbytes, uint16_t length, const uint8_t* expected); /* computes the hmac-sha1 like computeMessage() and compares it in constant time with the 20 bytes in expected. */
+
+  public:
+    SHA_CTX inner;                                                          /* sha1 state after hashing K ^ ipad */
+    SHA_CTX outer;                                                          /* sha1 state after hashing K ^ opad */
+    bool is_set;
+  };
+
+} /* namespace stun */
+
+#endif
@@ -0,0 +1,80 @@
+/*
+
+  MessageView
+  -----------
+
+  Read-only view over a STUN message which is stored in a buffer that is
+  owned by the caller, e.g. the datagram we just received from the socket.
+  Contrary to stun::Reader, the view does not copy the data and does not
+  allocate an Attribute per attribute. parse() validates the header, the
+  magic cookie and the bounds of all attributes in place and stores the
+  offset/length of each attribute. Typed values are only decoded when you
+  call one of the find functions.
+
+  Because we only store offsets, the view is valid as long as the buffer
+  that was passed into parse() is valid and unchanged.
+
+  <example>
+
+     stun::MessageView view;
+     if (0 == view.parse(data, nbytes)) {
+       uint32_t prio = 0;
+       if (view.findPriority(&prio)) {
+         ...
+       }
+     }
+
+  </example>
+
+ */
+#ifndef STUN_MESSAGE_VIEW_H
+#define STUN_MESSAGE_VIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stun/Types.h>
+
+#define STUN_VIEW_MAX_ATTRIBUTES 16                                   /* the max number of attributes we keep track of; a binding request from a browser contains 6 or 7. */
+
+namespace stun {
+
+  /* --------------------------------------------------------------------- */
+
+  class AttributeSpan {
+  public:
+    uint16_t type;                                                    /* the attribute type */
+    uint16_t length;                                                  /* the number of bytes of the attribute value, w/o padding */
+    uint16_t offset;                                                  /* byte offset where the header of the attribute starts in the message; the value starts at offset + 4. */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class MessageView {
+  public:
+    MessageView();
+    int parse(const uint8_t* data, uint32_t nbytes);                  /* validates the given data in place; returns 0 when it contains a valid stun message, 1 when the data isn't stun (e.g. DTLS/RTP), -1 when it looks like stun but is malformed and -2 when it contains an unknown comprehension-required attribute (see unknown_attribute). */
+    bool hasAttribute(uint16_t atype);                                /* check if the message contains the given attribute type */
+    bool find(uint16_t atype, AttributeSpan** result);                /* find the span of the given attribute type */
+    bool findUsername(const uint8_t** value, uint16_t* nbytes);       /* points `value` to the username bytes (not nul terminated) */
+    bool findPriority(uint32_t* value);                               /* decodes the PRIORITY attribute */
+    bool findIceControlled(uint64_t* tieBreaker);                     /* decodes the ICE-CONTROLLED attribute */
+    bool findIceControlling(uint64_t* tieBreaker);                    /* decodes the ICE-CONTROLLING attribute */
+    bool findXorMappedAddress(uint8_t* family, uint16_t* port, uint32_t* ip); /* decodes an IPv4 XOR-MAPPED-ADDRESS; port and ip are in host byte order. */
+    bool findMessageIntegrity(const uint8_t** sha1);                  /* points `sha1` to the 20 bytes of the MESSAGE-INTEGRITY value. */
+    bool findFingerprint(uint32_t* crc);                              /* decodes the FINGERPRINT value. */
+    const uint8_t* value(AttributeSpan* span);                        /* returns a pointer to the value of the given attribute. */
+
+  public:
+    const uint8_t* data;                                              /* the buffer that was passed into parse(); we don't own it. */
+    uint32_t nbytes;                                                  /* number of bytes in data (header + attributes) */
+    uint16_t type;                                                    /* the message type */
+    uint16_t length;                                                  /* the Message-Length header field */
+    uint32_t transaction[3];                                          /* the transaction id, as read by stun::Reader so it can be used with Message::setTransactionID() */
+    AttributeSpan attributes[STUN_VIEW_MAX_ATTRIBUTES];               /* the spans of the attributes we found */
+    uint32_t nattributes;                                             /* number of valid spans in attributes */
+    uint16_t unknown_attribute;                                       /* when parse() returns -2, this is the unknown comprehension-required attribute type we found. */
+  };
+
+} /* namespace stun */
+
+#endif
@@ -33,7 +33,7 @@ namespace stun {
 
   public:
     Reader();
-    int process(uint8_t* data, uint32_t nbytes, Message* msg);  /* parses the incoming data and fills msg if the data contains a valid stun message, if so it returns 0, when other data is passed into this function it will return 1, on error it returns -1 */
+    int process(uint8_t* data, uint32_t nbytes, Message* msg);  /* parses the incoming data and fills msg if the data contains a valid stun message, if so it returns 0, when other data is passed into this function it will return 1, on error it returns -1. Attributes are validated using the AttributeRegistry; an unknown comprehension-required attribute is an error. */
 
   private:
     uint8_t readU8();                                           /* read one uint8_t from buffer and increment the index. */
@@ -41,10 +41,10 @@ namespace stun {
     uint32_t readU32();                                         /* read an uint32_t from the buffer, expecting the buffer to hold Big Endian data and moving the dx member. */
     uint64_t readU64();                                         /* read an uint64_t from the buffer, expecting the buffer to hold Big Endian data and moving the dx member. */
     StringValue readString(uint16_t len);                       /* read a StringValue from the current buffer */
-    XorMappedAddress* readXorMappedAddress();                   /* reads a XorMappedAddress */
     void skip(uint32_t nbytes);                                 /* skip the next nbytes. */    
     uint32_t bytesLeft();                                       /* returns the number of bytes that still need to be parsed, this is not the same as the size of the buffer! */
     uint8_t* ptr();                                             /* returns a pointer to the current read index of the buffer. */
+    int reset(int result);                                      /* clears the buffer and read index and returns result, used when we're ready with a message. */
     
   public:
     std::vector<uint8_t> buffer;
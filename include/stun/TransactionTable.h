@@ -0,0 +1,157 @@
+/*
+
+  TransactionTable
+  ----------------
+
+  Keeps track of the STUN requests we send (e.g. connectivity and consent
+  checks) and matches the responses we receive with them. A transaction
+  retransmits its request as described in http://tools.ietf.org/html/rfc5389#section-7.2.1:
+  the first retransmit is after RTO millis, the RTO doubles after each send,
+  we send Rc requests in total and after the last one we wait Rm * RTO
+  before the transaction times out. The retransmission timers run on a
+  shared rtc::TimerWheel.
+
+  All transactions are preallocated in init() and handed out from a free
+  list. They are indexed on their 96-bit transaction id in an open
+  addressing hash table (linear probing, backward shift deletion), so
+  creating, matching and finishing a transaction doesn't allocate and
+  takes constant time, also with hundreds of thousands of outstanding
+  transactions.
+
+  The request is written directly into the transaction (Transaction::request)
+  so we can retransmit it without keeping another copy.
+
+  <example>
+
+     static bool on_send(stun::Transaction* trans, const uint8_t* data, uint32_t nbytes, void* user) {
+       conn.sendTo(rip, rport, (uint8_t*)data, nbytes);
+       return true;
+     }
+
+     static void on_result(stun::Transaction* trans, int result, stun::MessageView* response, void* user) {
+       if (stun::STUN_TRANSACTION_SUCCESS == result) {
+         ...
+       }
+     }
+
+     stun::Transaction* trans = table.create();
+     stun::BufferWriter writer(trans->request, sizeof(trans->request));
+     writer.begin(stun::STUN_BINDING_REQUEST, trans->transaction);
+     ...
+     trans->key = &remote_key;
+     trans->on_send = on_send;
+     trans->on_result = on_result;
+     table.start(trans, writer.finish(&remote_key, true));
+
+     // and for each stun response we receive:
+     table.process(&view);
+
+  </example>
+
+ */
+#ifndef STUN_TRANSACTION_TABLE_H
+#define STUN_TRANSACTION_TABLE_H
+
+#include <stdint.h>
+#include <rtc/TimerWheel.h>
+#include <stun/MessageView.h>
+#include <stun/IntegrityKey.h>
+
+#define STUN_TRANSACTION_MAX_REQUEST_SIZE 192                                            /* the max size of a request we can (re)transmit; a binding request with all ICE attributes is ~120 bytes. */
+#define STUN_TRANSACTION_RTO 500                                                         /* initial retransmission timeout in millis, see http://tools.ietf.org/html/rfc5389#section-7.2.1 */
+#define STUN_TRANSACTION_RC 7                                                            /* max number of requests we send */
+#define STUN_TRANSACTION_RM 16                                                           /* after the last request we wait Rm * RTO for a response */
+#define STUN_TRANSACTION_RANDOM_POOL 384                                                 /* number of random bytes we fetch at once for new transaction ids. */
+
+namespace stun {
+
+  class Transaction;
+  class TransactionTable;
+
+  enum TransactionResult {
+    STUN_TRANSACTION_SUCCESS = 0,                                                        /* we received a success response */
+    STUN_TRANSACTION_ERROR = 1,                                                          /* we received an error response */
+    STUN_TRANSACTION_TIMEOUT = 2                                                         /* we didn't receive a response in time */
+  };
+
+  typedef bool(*transaction_send_callback)(Transaction* trans, const uint8_t* data, uint32_t nbytes, void* user);    /* sends the request; return false when it couldn't be sent. */
+  typedef void(*transaction_result_callback)(Transaction* trans, int result, MessageView* response, void* user);     /* gets called once with the TransactionResult; response is NULL on timeout. The transaction is released after this returns. */
+
+  /* --------------------------------------------------------------------- */
+
+  class Transaction {
+  public:
+    Transaction();
+
+  public:
+    uint32_t transaction[3];                                                             /* the random transaction id, in the same order as Message::transaction; pass it to BufferWriter::begin(). */
+    uint8_t request[STUN_TRANSACTION_MAX_REQUEST_SIZE];                                  /* write the request into this buffer */
+    uint32_t nbytes;                                                                     /* the size of the request */
+    IntegrityKey* key;                                                                   /* when set, a response must contain a valid MESSAGE-INTEGRITY for this key, others are ignored. */
+    transaction_send_callback on_send;                                                   /* used to (re)transmit the request */
+    transaction_result_callback on_result;                                               /* called with the result */
+    void* user;                                                                          /* passed into the callbacks */
+
+    /* used by the TransactionTable */
+    rtc::Timer timer;                                                                    /* retransmission timer */
+    uint32_t rto;                                                                        /* the current retransmission timeout */
+    uint32_t nsent;                                                                      /* how many times we sent the request */
+    uint32_t hash;                                                                       /* the hash of the transaction id */
+    uint32_t slot;                                                                       /* the slot in the hash table */
+    bool is_used;                                                                        /* true when the transaction was handed out by create() */
+    TransactionTable* table;                                                             /* the table that owns this transaction */
+    Transaction* next_free;                                                              /* free list */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  class TransactionTable {
+  public:
+    TransactionTable();
+    ~TransactionTable();
+    int init(rtc::TimerWheel* wheel, uint32_t capacity);                                 /* preallocates capacity transactions; returns 0 on success. */
+    Transaction* create();                                                               /* returns a transaction with a new random id, or NULL when all transactions are in use. */
+    int start(Transaction* trans, int nbytes);                                           /* sends the request (of nbytes in trans->request) and starts the retransmission timer; returns 0 on success, < 0 on error (the transaction is released then). */
+    void cancel(Transaction* trans);                                                     /* stops and releases the transaction w/o calling on_result. */
+    int process(MessageView* response);                                                  /* matches a response with a transaction and calls on_result; returns 0 when matched, 1 when it's not a response to one of our transactions and < 0 when the response is invalid. */
+    Transaction* find(const uint32_t* id);                                               /* find the active transaction for the given id */
+    void handleTimeout(Transaction* trans);                                              /* used internally; retransmits or times out the transaction. */
+
+  private:
+    void insert(Transaction* trans);                                                     /* add to the hash */
+    void remove(Transaction* trans);                                                     /* remove from the hash */
+    void release(Transaction* trans);                                                    /* stops the timer, removes it from the hash and puts it back into the free list. */
+    bool generateId(uint32_t* id);                                                       /* generates a random transaction id */
+    void shutdown();                                                                     /* frees everything */
+
+  public:
+    uint32_t rto;                                                                        /* initial retransmission timeout, defaults to STUN_TRANSACTION_RTO */
+    uint32_t rc;                                                                         /* max number of requests, defaults to STUN_TRANSACTION_RC */
+    uint32_t rm;                                                                         /* last wait multiplier, defaults to STUN_TRANSACTION_RM */
+
+    /* stats */
+    uint64_t nstarted;
+    uint64_t nsucceeded;
+    uint64_t nfailed;
+    uint64_t ntimedout;
+    uint64_t nretransmits;
+    uint64_t nunmatched;                                                                 /* responses for unknown transactions */
+    uint64_t nrejected;                                                                  /* responses with an invalid fingerprint or integrity */
+
+  private:
+    rtc::TimerWheel* wheel;
+    Transaction* pool;                                                                   /* all transactions */
+    Transaction* free_list;
+    Transaction** slots;                                                                 /* open addressing hash */
+    uint32_t capacity;                                                                   /* number of transactions in pool */
+    uint32_t mask;                                                                       /* number of slots - 1 */
+    uint32_t nactive;                                                                    /* number of transactions in use */
+    uint8_t random[STUN_TRANSACTION_RANDOM_POOL];                                        /* random bytes for the transaction ids */
+    uint32_t random_offset;                                                              /* read offset in random */
+  };
+
+  /* --------------------------------------------------------------------- */
+
+} /* namespace stun */
+
+#endif
@@ -58,6 +58,14 @@ namespace stun {
 
   /* --------------------------------------------------------------------- */
 
+  /* The class bits C1 (0x0100) and C0 (0x0010) of the message type, see http://tools.ietf.org/html/rfc5389#section-6 */
+  inline bool message_is_request(uint16_t t) { return 0x0000 == (t & 0x0110); }
+  inline bool message_is_indication(uint16_t t) { return 0x0010 == (t & 0x0110); }
+  inline bool message_is_success_response(uint16_t t) { return 0x0100 == (t & 0x0110); }
+  inline bool message_is_error_response(uint16_t t) { return 0x0110 == (t & 0x0110); }
+
+  /* --------------------------------------------------------------------- */
+
 } /* namespace stun */
 
 #endif
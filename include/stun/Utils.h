@@ -4,8 +4,19 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <stun/MessageView.h>
+#include <stun/IntegrityKey.h>
 
 namespace stun {
+
+  enum VerifyResult {
+    STUN_VERIFY_OK = 0,
+    STUN_VERIFY_NO_FINGERPRINT,                                            /* the message has no FINGERPRINT attribute */
+    STUN_VERIFY_INVALID_FINGERPRINT,                                       /* the crc doesn't match */
+    STUN_VERIFY_INVALID_USERNAME,                                          /* no USERNAME or it doesn't start with our ufrag */
+    STUN_VERIFY_NO_INTEGRITY,                                              /* the message has no MESSAGE-INTEGRITY attribute */
+    STUN_VERIFY_INVALID_INTEGRITY                                          /* the hmac-sha1 doesn't match */
+  };
   
   /* 
      Compute the hmac-sha1 over message.
@@ -14,8 +25,11 @@ namespace stun {
      uint32_t nbytes:   the number of bytse in message
      std::string key:   key to use for hmac 
      uint8_t* output:   we write the sha1 into this buffer.
+
+     This derives the HMAC key schedule for every call; when you sign or 
+     verify many messages with the same key use a stun::IntegrityKey.
    */
-  bool compute_hmac_sha1(uint8_t* message, uint32_t nbytes, std::string key, uint8_t* output);
+  bool compute_hmac_sha1(uint8_t* message, uint32_t nbytes, const std::string& key, uint8_t* output);
 
   /* 
      Compute the Message-Integrity of a stun message. 
@@ -25,7 +39,7 @@ namespace stun {
      std::string key:              key to use for hmac 
      uint8_t* output:              will be filled with the correct hmac-sha1 of that represents the integrity message value. 
   */
-  bool compute_message_integrity(std::vector<uint8_t>& buffer, std::string key, uint8_t* output);
+  bool compute_message_integrity(std::vector<uint8_t>& buffer, const std::string& key, uint8_t* output);
 
   /* 
      Compute the fingerprint value for the stun message.
@@ -36,6 +50,44 @@ namespace stun {
   */
   bool compute_fingerprint(std::vector<uint8_t>& buffer, uint32_t& result);
 
+  /*
+     CRC-32 (IEEE polynomial) as used by the FINGERPRINT attribute. This
+     returns the same value as zlib's crc32(crc, data, nbytes), so start
+     with crc = 0 and pass the result in again to continue a crc. When the
+     library is loaded we select a kernel that uses the PCLMULQDQ (x86-64)
+     or CRC32 (ARMv8) instructions when the cpu supports them, otherwise we 
+     fall back to crc32_ieee_table().
+  */
+  uint32_t crc32_ieee(uint32_t crc, const uint8_t* data, uint32_t nbytes);
+  uint32_t crc32_ieee_table(uint32_t crc, const uint8_t* data, uint32_t nbytes);  /* portable slicing-by-8 version */
+  const char* crc32_ieee_kernel_name();                                          /* name of the kernel that crc32_ieee() uses, e.g. "pclmulqdq", "armv8-crc32" or "table". */
+
+  /*
+     Verify the FINGERPRINT of a parsed message. Returns false when the 
+     message doesn't contain a fingerprint or when the crc is invalid.
+  */
+  bool verify_fingerprint(MessageView* msg);
+
+  /*
+     Verify that the USERNAME of a parsed request starts with `ufrag:`, 
+     see http://tools.ietf.org/html/rfc5245#section-7.2.1.3
+  */
+  bool verify_username(MessageView* msg, const std::string& ufrag);
+
+  /*
+     Verify the MESSAGE-INTEGRITY of a parsed message with the given key.
+     The hmac-sha1 values are compared in constant time.
+  */
+  bool verify_message_integrity(MessageView* msg, IntegrityKey* key);
+
+  /* 
+     Verify an incoming request that is sent to the agent with the given
+     ufrag and key. We do the cheap checks first (crc and username) and 
+     only compute the hmac-sha1 when they pass. Returns STUN_VERIFY_OK or 
+     one of the other VerifyResult values.
+  */
+  int verify_request(MessageView* msg, const std::string& ufrag, IntegrityKey* key);
+
 
 } /* namespace stun */
 
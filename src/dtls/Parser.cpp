@@ -7,22 +7,19 @@ namespace dtls {
   
   Parser::Parser()
     :ssl(NULL)
-    ,state(DTLS_STATE_NONE)
-    ,mode(DTLS_MODE_SERVER)
     ,in_bio(NULL)
     ,out_bio(NULL)
+    ,state(DTLS_STATE_NONE)
+    ,mode(DTLS_MODE_SERVER)
+    ,buffer(NULL)
+    ,owns_buffer(false)
     ,on_data(NULL)
     ,user(NULL)
-    ,local_key(NULL)
-    ,local_salt(NULL)
     ,remote_key(NULL)
     ,remote_salt(NULL)
+    ,local_key(NULL)
+    ,local_salt(NULL)
   {
-    buffer = new uint8_t[DTLS_BUFFER_SIZE];
-    if (!buffer) {
-      printf("Error: cannot allocate the out buffer in dtls::Parser. Out of mem?\n");
-      exit(1);
-    }
   }
 
   Parser::~Parser() {
@@ -33,11 +30,13 @@ namespace dtls {
       ssl = NULL;
     }
 
-    if (buffer) {
+    if (buffer && owns_buffer) {
       delete[] buffer;
-      buffer = NULL;
     }
 
+    buffer = NULL;
+    owns_buffer = false;
+
     /* @todo - free memory bios (in_bio and out_bio) */
 
     on_data = NULL;
@@ -51,6 +50,12 @@ namespace dtls {
       return false;
     }
 
+    /* without a shared buffer we use one of our own. */
+    if (!buffer) {
+      buffer = new uint8_t[DTLS_BUFFER_SIZE];
+      owns_buffer = true;
+    }
+
     /* in bio */
     {
       in_bio = BIO_new(BIO_s_mem());
@@ -151,7 +156,7 @@ namespace dtls {
   
     if (r != 1) {
       printf("dtls::Parser::extractKeyingMaterial() - error: cannot export the keying material.\n");
-      exit(1);
+      return false;
     }
 
     if (mode == DTLS_MODE_SERVER) {
@@ -177,11 +182,11 @@ namespace dtls {
     }
 
 #if 1
-    /* show some debug info (p->name probably = SRTP_AES128_CM_SHA1_80) */
+    /* show some debug info (p->name probably = SRTP_AES128_CM_SHA1_80); there is none when the peer didn't negotiate use_srtp. */
     SRTP_PROTECTION_PROFILE *p = SSL_get_selected_srtp_profile(ssl);
     if(!p) {
       printf("dtls::Parser::extractKeyingMaterial() - error: cannot extract the srtp_profile.\n");
-      exit(1);
+      return false;
     }
     printf("dtls::Parser::extractKeyingMaterial() - verbose: protection profile: %s\n", p->name);
 
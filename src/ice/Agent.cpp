@@ -1,8 +1,10 @@
 #include <stdlib.h>
-#include <time.h>
 #include <sstream>
 #include <uv.h>
+#include <openssl/rand.h>
 #include <ice/Agent.h>
+#include <stun/Utils.h>
+#include <stun/BufferWriter.h>
 
 namespace ice {
 
@@ -11,29 +13,75 @@ namespace ice {
   /* gets called whenever the dtls connection needs to send some data back to the other party. */  
   static void agent_on_dtls_data(uint8_t* data, uint32_t nbytes, void* user);                   
 
+  /* sets up the srtp contexts with the keys of a finished handshake; returns false when we can't. */
+  static bool agent_init_srtp(DtlsTransport* transport);
+
   /* gets called whenever a stream receives data for a candidate pair that needs to be processed. */
-  static void agent_stream_on_data(Stream* stream, 
-                                   std::string rip, uint16_t rport,
-                                   std::string lip, uint16_t lport,
-                                   uint8_t* data, uint32_t nbytes, void* user);
+  static void agent_stream_on_data(Stream* stream, rtc::Packet* pkt, void* user);
+
+  /* consent freshness, see http://tools.ietf.org/html/rfc7675 */
+  static void agent_on_consent_timer(rtc::Timer* timer, void* user);
+  static void agent_on_consent_expired(rtc::Timer* timer, void* user);
+  static bool agent_consent_on_send(stun::Transaction* trans, const uint8_t* data, uint32_t nbytes, void* user);
+  static void agent_consent_on_result(stun::Transaction* trans, int result, stun::MessageView* response, void* user);
+
+  /* candidate pair lifecycle */
+  static void agent_on_pair_idle(rtc::Timer* timer, void* user);
+  static uint64_t agent_pair_priority(uint64_t controlling, uint64_t controlled);
+  static uint64_t agent_pair_npackets(CandidatePair* pair);
 
   /* ------------------------------------------------------------------ */
 
   Agent::Agent() 
     :is_lite(true)
+    ,mux(NULL)
+    ,worker(NULL)
+    ,runtime(NULL)
+    ,context(NULL)
+    ,owns_context(false)
+    ,manager(NULL)
+    ,session_index(0)
   {
-    srand(time(NULL));
+    /* the tie breaker must differ per agent, also for the sessions we create in the same second. */
+    if (1 != RAND_bytes((unsigned char*)&tie_breaker, sizeof(tie_breaker))) {
+      printf("ice::Agent - error: cannot generate the tie breaker, using the clock.\n");
+      tie_breaker = uv_hrtime() ^ (uint64_t)(uintptr_t)this;
+    }
   }
 
   Agent::~Agent() {
 
+    if (runtime && owns_context) {
+      runtime->removeTimers(&context->timers);
+    }
+
+    /* the pairs are freed by the streams, make sure none of them is still used by the timers or transactions (which may be shared). */
+    if (context) {
+      for (size_t i = 0; i < streams.size(); ++i) {
+        for (size_t k = 0; k < streams[i]->pairs.size(); ++k) {
+          CandidatePair* pair = streams[i]->pairs[k];
+          context->timers.stop(&pair->consent_timer);
+          context->timers.stop(&pair->expire_timer);
+          context->timers.stop(&pair->idle_timer);
+          if (pair->consent_transaction) {
+            context->transactions.cancel(pair->consent_transaction);
+            pair->consent_transaction = NULL;
+          }
+        }
+      }
+    }
+
     std::vector<Stream*>::iterator it = streams.begin();
     while(it != streams.end()) {
       delete *it;
       streams.erase(it);
     }
 
-    /* @todo make sure the dtls::Parser is free'd (see stream data handler) */
+    if (owns_context) {
+      delete context;
+    }
+
+    context = NULL;
   }
 
   /* Add a new stream; we take ownership */
@@ -50,18 +98,68 @@ namespace ice {
     stream->user_data = this;
   }
 
+  void Agent::setPortMux(PortMux* m) {
+    mux = m;
+  }
+
+  void Agent::setRuntime(rtc::Runtime* rt) {
+    runtime = rt;
+  }
+
+  void Agent::setContext(AgentContext* ctx) {
+
+    if (owns_context) {
+      printf("ice::Agent - error: cannot set the context after init().\n");
+      return;
+    }
+
+    context = ctx;
+  }
+
   /* Initializes all the streams/candidates */
   bool Agent::init() {
 
-    /* @todo - we're initializing the dtls::Context in Agent now, but this must be controlled by the user */
-    if (!dtls_ctx.init("./server-cert.pem", "./server-key.pem")) {
-      printf("ice::Agent - error: cannot initialize the dtls context.\n");
-      return false;
+    /* without a shared context we create our own: the certificate, timers and stun transactions of a single session. */
+    if (!context) {
+
+      context = new AgentContext();
+      owns_context = true;
+
+      /* @todo - we're initializing the dtls::Context in Agent now, but this must be controlled by the user; share an AgentContext for that. */
+      if (!context->dtls_ctx.init("./server-cert.pem", "./server-key.pem")) {
+        printf("ice::Agent - error: cannot initialize the dtls context.\n");
+        return false;
+      }
+
+      if (0 != context->init(ICE_AGENT_MAX_TRANSACTIONS)) {
+        printf("ice::Agent - error: cannot initialize the agent context.\n");
+        return false;
+      }
+
+      if (runtime) {
+        runtime->addTimers(&context->timers);
+      }
+    }
+
+    /* the sockets of the candidates run on the loop of the runtime; a mux has its own loop. */
+    if (runtime) {
+      if (!mux) {
+        for (size_t i = 0; i < streams.size(); ++i) {
+          for (size_t k = 0; k < streams[i]->local_candidates.size(); ++k) {
+            streams[i]->local_candidates[k]->conn.loop = runtime->loop;
+          }
+        }
+      }
     }
 
     /* and initialize all streams. */
     for (size_t i = 0; i < streams.size(); ++i) {
-      if (!streams[i]->init()) {
+      if (mux) {
+        if (!streams[i]->initShared(mux)) {
+          return false;
+        }
+      }
+      else if (!streams[i]->init()) {
         return false;
       }
     }
@@ -71,9 +169,21 @@ namespace ice {
 
   /* Processes any incoming/outcoming data */
   void Agent::update() {
+
+    /* the runtime runs our sockets and timers, so one iteration of its loop does it all. */
+    if (runtime) {
+      runtime->poll();
+      return;
+    }
+
     for (size_t i = 0; i < streams.size(); ++i) {
       streams[i]->update();
     }
+
+    /* a shared context is updated by its owner. */
+    if (owns_context) {
+      context->timers.update(uv_hrtime() / 1000000ull);
+    }
   }
 
   /* Set the ice-ufrag and ice-pwd values to use in stun messages (e.g. MessageIntegrity). */
@@ -88,10 +198,16 @@ namespace ice {
     }
   }
 
-  void Agent::handleStunMessage(Stream* stream, stun::Message* msg, 
-                                std::string rip, uint16_t rport, 
-                                std::string lip, uint16_t lport) 
-  {
+  void Agent::setRemoteCredentials(std::string ufrag, std::string pwd) {
+    for (size_t i = 0; i < streams.size(); ++i) {
+      streams[i]->setRemoteCredentials(ufrag, pwd);
+    }
+  }
+
+  void Agent::handleStunMessage(Stream* stream, stun::MessageView* msg, rtc::Packet* pkt) {
+
+    const rtc::Endpoint& remote = *pkt->remote;
+    const rtc::Endpoint& local = *pkt->local;
 
     /* Make sure we receive valid input. */
     if (!stream) {
@@ -104,133 +220,354 @@ namespace ice {
       return;
     }
 
+    /* Responses to the requests we sent are matched with their transaction. */
+    if (stun::message_is_success_response(msg->type) || stun::message_is_error_response(msg->type)) {
+      CandidatePair* pair = stream->findPair(remote, local);
+      if (NULL != pair) {
+        pair->recv_counters.add(rtc::PACKET_CLASS_STUN, pkt->nbytes);
+      }
+      context->transactions.process(msg);
+      return;
+    }
+
     /* Handle the message */
     if (msg->type != stun::STUN_BINDING_REQUEST) {
       printf("ice::Agent::handleStunMesage() -  error: we only implement ice-controlled mode for now so we must receive a STUN_BINDING_REQUEST first.\n");
       return;
     }
 
-    /* Find the local candidate that we use to transfer data from. */
-    ice::Candidate* local_cand = stream->findLocalCandidate(lip, lport);
+    /* Verify the request before we spend any time on it; the cheap checks go first. */
+    int verified = stun::verify_request(msg, stream->ice_ufrag, &stream->integrity_key);
+    switch (verified) {
+      case stun::STUN_VERIFY_OK: {
+        stream->stun_stats.naccepted++;
+        break;
+      }
+      case stun::STUN_VERIFY_NO_FINGERPRINT:
+      case stun::STUN_VERIFY_INVALID_FINGERPRINT: {
+        stream->stun_stats.nrejected_fingerprint++;
+        return;
+      }
+      case stun::STUN_VERIFY_INVALID_USERNAME: {
+        stream->stun_stats.nrejected_username++;
+        return;
+      }
+      default: {
+        stream->stun_stats.nrejected_integrity++;
+        return;
+      }
+    }
+
+    /* Find the local candidate that we use to transfer data from; when we already have a pair that's the only lookup. */
+    CandidatePair* pair = stream->findPair(remote, local);
+    ice::Candidate* local_cand = (NULL != pair) ? pair->local : stream->findLocalCandidate(local);
     if (!local_cand) {
-      printf("ice::Agent::handleStunMessage() - error: cannot find the local candidate for %s:%u\n", lip.c_str(), lport);
+      printf("ice::Agent::handleStunMessage() - error: cannot find the local candidate for %s:%u\n", local.getIP().c_str(), local.getPort());
       return;
     }
 
-    /* Create the pair when the controlling agent tell us to use this candidate. */
-    if (msg->hasAttribute(stun::STUN_ATTR_USE_CANDIDATE)) {
-      CandidatePair* pair = stream->findPair(rip, rport, lip, lport);
-      if (NULL == pair) {
-        pair = stream->createPair(rip, rport, lip, lport);
+    /* Every authenticated check from a new address creates a pair; the controlling agent tells us with USE-CANDIDATE which ones to use. */
+    if (NULL == pair) {
+      pair = stream->createPair(remote, local);
+      if (NULL != pair) {
+        startConsent(pair);
       }
     }
-    
-    /* Construct our STUN Binding-Success-Response */
-    stun::Message response(stun::STUN_BINDING_RESPONSE);
-    response.copyTransactionID(msg);
-    response.addAttribute(new stun::XorMappedAddress(rip, rport));
-    response.addAttribute(new stun::MessageIntegrity());
-    response.addAttribute(new stun::Fingerprint());
-
-    /* Write + send the message. */
-    stun::Writer writer;
-    writer.writeMessage(&response, stream->ice_pwd);
-    local_cand->conn.sendTo(rip, rport, &writer.buffer[0], writer.buffer.size());
-  }
 
-  void Agent::handleStreamData(Stream* stream, 
-                               std::string rip, uint16_t rport, 
-                               std::string lip, uint16_t lport, 
-                               uint8_t* data, uint32_t nbytes)
-  {
+    /* An authenticated request from the other agent is consent to keep sending. */
+    if (NULL != pair) {
+
+      uint32_t priority = 0;
+
+      pair->recv_counters.add(rtc::PACKET_CLASS_STUN, pkt->nbytes);
+
+      if (msg->findPriority(&priority)) {
+        pair->priority = agent_pair_priority(priority, ICE_AGENT_PRIORITY);
+      }
+
+      if (msg->hasAttribute(stun::STUN_ATTR_USE_CANDIDATE)) {
+        pair->state = CANDIDATE_PAIR_STATE_NOMINATED;
+        if (pair != stream->selected
+            && (NULL == stream->selected || pair->priority >= stream->selected->priority))
+          {
+            selectPair(pair);
+          }
+      }
+      else if (CANDIDATE_PAIR_STATE_NOMINATED != pair->state) {
+        pair->state = CANDIDATE_PAIR_STATE_SUCCEEDED;
+      }
 
-#if !defined(NDEBUG)
-    if (NULL == on_rtp) {
-      printf("Agent::handleStreamData() - error: no on_rtp() callback set; makes no sense to do anything with the data.\n");
+      refreshConsent(pair);
+    }
+    
+    /* Construct our STUN Binding-Success-Response from the stream's template. */
+    uint8_t response[STUN_BINDING_RESPONSE_SIZE];
+    int nbytes = stream->responder.write(msg, remote.getAddress(), remote.getPort(), response);
+    if (nbytes < 0) {
+      printf("ice::Agent::handleStunMessage() - error: cannot write the binding response: %d\n", nbytes);
       return;
     }
-#endif
 
-    /* Find a candidate pair. */
-    CandidatePair* pair = stream->findPair(rip, rport, lip, lport);
+    local_cand->transport->sendTo(remote, response, nbytes);
+  }
+
+  void Agent::handleDtlsData(Stream* stream, rtc::Packet* pkt) {
+
+    /* only a pair that passed an authenticated check takes part in the handshake; the stream has one, so anyone else could take it over. */
+    CandidatePair* pair = stream->findPair(*pkt->remote, *pkt->local);
     if (NULL == pair) {
-      pair = stream->createPair(rip, rport, lip, lport);
-      if (NULL == pair) {
-        printf("Agent::handleStreamData() - error: cannot allocate a candidate pair!\n");
-        return;
-      }
+      return;
     }
 
-    Candidate* lcand = pair->local;
+    pair->recv_counters.add(rtc::PACKET_CLASS_DTLS, pkt->nbytes);
 
     /* INITIALIZE DTLS */
     /* --------------- */
-    if (NULL == lcand->dtls.ssl) {
-      lcand->dtls.on_data = agent_on_dtls_data;
-      lcand->dtls.user = pair;
+    if (NULL == stream->dtls) {
+
+      DtlsTransport* transport = new DtlsTransport();
+      transport->parser.on_data = agent_on_dtls_data;
+      transport->parser.user = transport;
+      transport->parser.buffer = context->getDtlsBuffer();
 
       /* Allocate our SSL* object. */
-      lcand->dtls.ssl = dtls_ctx.createSSL();
-      if (!lcand->dtls.ssl) {
-          printf("agent_stream_on_data - error: cannot allocate a new SSL object.\n");
-          exit(1);
+      transport->parser.ssl = context->dtls_ctx.createSSL();
+      if (!transport->parser.ssl || !transport->parser.init()) {
+        printf("Agent::handleDtlsData() - error: cannot initialize the dtls parser, removing the pair.\n");
+        delete transport;
+        stream->ndtls_errors++;
+        removePair(pair);
+        return;
       }
-      if (!lcand->dtls.init()) {
-        printf("agent_stream_on_data - error: cannot initialize the dtls parser.\n");
-        exit(1);
+
+      /* the pairs we create from now on get it in Stream::createPair(). */
+      stream->dtls = transport;
+      for (size_t i = 0; i < stream->pairs.size(); ++i) {
+        stream->pairs[i]->dtls = transport;
       }
     }
 
-    dtls::Parser& dtls = lcand->dtls;
+    /* we answer on the (validated) path the record arrived on. */
+    stream->dtls->pair = pair;
+
+    dtls::Parser& dtls = stream->dtls->parser;
+
+    /* @todo - records after the handshake (e.g. a close_notify alert) are ignored for now. */
+    if (true == dtls.isHandshakeFinished()) {
+      return;
+    }
+
+    /* Handle data. */
+    dtls.process(pkt->data, pkt->nbytes);
 
     /* SETUP SRTP WHEN DTLS HANDSHAKE IS FINISHED */
     /* ------------------------------------------ */
-    if (false == lcand->dtls.isHandshakeFinished()) {
+    /* e.g. a peer that didn't negotiate use_srtp; without keys the pair is useless, a new handshake starts over. */
+    if (true == dtls.isHandshakeFinished() && false == agent_init_srtp(stream->dtls)) {
+      stream->ndtls_errors++;
+      stream->removeDtls();
+      removePair(pair);
+    }
+  }
 
-      /* Handle data. */
-      dtls.process(data, nbytes);
+  void Agent::handleRtpData(Stream* stream, rtc::Packet* pkt) {
 
-      /* When DTLS handshake is finished we can setup the SRTP flow */
-      if (true == dtls.isHandshakeFinished()) {
-        if (false == dtls.extractKeyingMaterial()) {
-          printf("Agent::handleStreamData() - error: cannot extract keying material.\n");
-          exit(1);
-        }
+    /* media without a pair (and so without a handshake) can't be unprotected. */
+    CandidatePair* pair = stream->findPair(*pkt->remote, *pkt->local);
+    if (NULL == pair) {
+      return;
+    }
 
-        const char* cipher = dtls.getCipherSuite();
-        if (NULL == cipher) {
-          printf("Agent::handleStreamData() - error: cannot get cipher suite.\n");
-          exit(1);
-        }
+    pair->recv_counters.add(rtc::PACKET_CLASS_RTP, pkt->nbytes);
 
-        if (0 != lcand->srtp_in.init(cipher, true, dtls.remote_key, dtls.remote_salt)) {
-          printf("Agent::handleStreamData() - erorr: cannot initialize srtp_in.\n");
-          exit(1);
-        }
+    if (NULL == pair->dtls || false == pair->dtls->srtp_in.is_init) {
+      pair->nsrtp_errors++;
+      return;
+    }
 
-        if (0 != lcand->srtp_out.init(cipher, false, dtls.local_key, dtls.local_salt)) {
-          printf("Agent::handleStreamData() - erorr: cannot initialize srtp_out.\n");
-          exit(1);
-        }
+    int len = pair->dtls->srtp_in.unprotectRTP(pkt->data, pkt->nbytes);
+    if (len <= 0) {
+      pair->nsrtp_errors++;
+      return;
+    }
+
+    pkt->nbytes = len;
+
+    if (stream->on_rtp) {
+      stream->on_rtp(stream, pair, pkt, stream->user_rtp);
+    }
+  }
+
+  void Agent::handleRtcpData(Stream* stream, rtc::Packet* pkt) {
+
+    CandidatePair* pair = stream->findPair(*pkt->remote, *pkt->local);
+    if (NULL == pair) {
+      return;
+    }
+
+    pair->recv_counters.add(rtc::PACKET_CLASS_RTCP, pkt->nbytes);
+
+    if (NULL == pair->dtls || false == pair->dtls->srtp_in.is_init) {
+      pair->nsrtp_errors++;
+      return;
+    }
+
+    int len = pair->dtls->srtp_in.unprotectRTCP(pkt->data, pkt->nbytes);
+    if (len <= 0) {
+      pair->nsrtp_errors++;
+      return;
+    }
+
+    pkt->nbytes = len;
+
+    if (stream->on_rtcp) {
+      stream->on_rtcp(stream, pair, pkt, stream->user_rtp);
+    }
+  }
+
+  void Agent::startConsent(CandidatePair* pair) {
+
+    if (!pair) {
+      return;
+    }
+
+    pair->consent_timer.on_timeout = agent_on_consent_timer;
+    pair->consent_timer.user = pair;
+    pair->expire_timer.on_timeout = agent_on_consent_expired;
+    pair->expire_timer.user = pair;
+    pair->idle_timer.on_timeout = agent_on_pair_idle;
+    pair->idle_timer.user = pair;
+    pair->idle_npackets = agent_pair_npackets(pair);
+
+    /* spread the checks, so we don't send them in bursts: 0.8 - 1.2 times the interval. */
+    context->timers.start(&pair->consent_timer, (ICE_CONSENT_INTERVAL * 8) / 10 + (rand() % ((ICE_CONSENT_INTERVAL * 4) / 10)));
+    context->timers.start(&pair->idle_timer, ICE_PAIR_IDLE_TIMEOUT);
+    refreshConsent(pair);
+  }
+
+  void Agent::refreshConsent(CandidatePair* pair) {
+    pair->consent_time = context->timers.now();
+    context->timers.start(&pair->expire_timer, ICE_CONSENT_TIMEOUT);
+  }
+
+  void Agent::sendConsentCheck(CandidatePair* pair) {
+
+    Stream* stream = pair->stream;
+
+    /* consent is for the nominated pairs; the others are removed when they're idle. */
+    if (!stream || CANDIDATE_PAIR_STATE_NOMINATED != pair->state) {
+      return;
+    }
+
+    /* we can only send our own checks when we know the credentials of the other agent; without them we rely on the checks the other agent sends. */
+    if (false == stream->remote_integrity_key.isSet()) {
+      return;
+    }
+
+    /* a check that is still outstanding is replaced by the new one. */
+    if (pair->consent_transaction) {
+      context->transactions.cancel(pair->consent_transaction);
+      pair->consent_transaction = NULL;
+    }
+
+    stun::Transaction* trans = context->transactions.create();
+    if (!trans) {
+      printf("ice::Agent::sendConsentCheck() - warning: no free stun transactions.\n");
+      return;
+    }
+
+    stun::BufferWriter writer(trans->request, sizeof(trans->request));
+    writer.begin(stun::STUN_BINDING_REQUEST, trans->transaction);
+    writer.writeUsername(stream->check_username.data(), stream->check_username.size());
+    writer.writePriority(ICE_AGENT_PRIORITY);
+    writer.writeIceControlled(tie_breaker);
+
+    trans->key = &stream->remote_integrity_key;
+    trans->on_send = agent_consent_on_send;
+    trans->on_result = agent_consent_on_result;
+    trans->user = pair;
+
+    pair->consent_transaction = trans;
+
+    if (0 != context->transactions.start(trans, writer.finish(&stream->remote_integrity_key, true))) {
+      pair->consent_transaction = NULL;
+    }
+  }
+
+  void Agent::selectPair(CandidatePair* pair) {
+
+    if (!pair || !pair->stream) {
+      return;
+    }
+
+    Stream* stream = pair->stream;
+
+    stream->selected = pair;
+
+    /* the pairs that weren't nominated lost; removePair() only erases the pair itself from the list, so we walk backwards. */
+    for (size_t i = stream->pairs.size(); i > 0; --i) {
+      CandidatePair* other = stream->pairs[i - 1];
+      if (other != pair && CANDIDATE_PAIR_STATE_NOMINATED != other->state) {
+        removePair(other);
       }
     }
+  }
+
+  void Agent::removePair(CandidatePair* pair) {
+
+    if (!pair || !pair->stream) {
+      return;
+    }
+
+    Stream* stream = pair->stream;
+
+    context->timers.stop(&pair->consent_timer);
+    context->timers.stop(&pair->expire_timer);
+    context->timers.stop(&pair->idle_timer);
+
+    if (pair->consent_transaction) {
+      context->transactions.cancel(pair->consent_transaction);
+      pair->consent_transaction = NULL;
+    }
+
+    /* keep sending on the best nominated pair that's left. */
+    CandidatePair* next = NULL;
 
-    /* HANDLE MEDIA DATA */
-    /* ----------------- */
+    if (stream->selected == pair) {
 
-    /* Ok, ready to decode some data with libsrtp. */
-    /* @todo - distinguish between rtp/rtcp */
-    int len = lcand->srtp_in.unprotectRTP(data, nbytes);
-    if (len > 0) {
-      if (stream->on_rtp) {
-        stream->on_rtp(stream, pair, data, len, stream->user_rtp);
+      for (size_t i = 0; i < stream->pairs.size(); ++i) {
+        CandidatePair* other = stream->pairs[i];
+        if (other != pair
+            && CANDIDATE_PAIR_STATE_NOMINATED == other->state
+            && (NULL == next || other->priority > next->priority))
+          {
+            next = other;
+          }
       }
-    } 
-    else {
-      /* @todo we need to handle the srtp decoding error! */
+    }
+
+    if (stream->mux) {
+      stream->mux->removeRoute(pair->remote_endpoint);
+    }
+
+    stream->removePair(pair);
+
+    /* select it once the pair is gone, so it isn't seen as one of the losers. */
+    if (NULL != next) {
+      selectPair(next);
     }
   }
 
+  size_t Agent::getMemoryUsage() {
+
+    size_t nbytes = sizeof(Agent) + streams.capacity() * sizeof(Stream*);
+
+    for (size_t i = 0; i < streams.size(); ++i) {
+      nbytes += streams[i]->getMemoryUsage();
+    }
+
+    return nbytes;
+  }
 
   /* Experimantal API: returns the SDP */
   std::string Agent::getSDP() {
@@ -244,7 +581,7 @@ namespace ice {
       return sdp;
     }
 
-    if (false == dtls_ctx.getFingerprint(fingerprint)) {
+    if (NULL == context || false == context->dtls_ctx.getFingerprint(fingerprint)) {
       printf("ice::Agent - error:cannot create the SDP, the DTLS context hasn't been initialized yet. Did you call init()?\n");
       return sdp;
     }
@@ -296,39 +633,179 @@ namespace ice {
   }
 
   /* ------------------------------------------------------------------ */
-  static void agent_stream_on_data(Stream* stream, 
-                                   std::string rip, uint16_t rport,
-                                   std::string lip, uint16_t lport,
-                                   uint8_t* data, uint32_t nbytes, void* user) 
-  {
-    int r;
-    stun::Message msg;
+  /* 
+     This is called for every packet, so it must not allocate; that's also why we don't log the packets here.
+     The first byte tells what it is (see rtc/Demux.h), each class goes straight to its handler.
+  */
+  static void agent_stream_on_data(Stream* stream, rtc::Packet* pkt, void* user) {
+
     ice::Agent* agent = static_cast<Agent*>(user);
-    
-    printf("agent_stream_on_data: verbose - received %u bytes from %s:%u on %s:%u\n", nbytes, rip.c_str(), rport, lip.c_str(), lport);
 
-    /* process the incoming message, check if it's STUN, DTLS or RTP data */
-    r = agent->stun.process(data, nbytes, &msg);
-    if (r == 0) {
-      /* STUN */
-      agent->handleStunMessage(stream, &msg, rip, rport, lip, lport);
+    switch (rtc::classify_packet(pkt->data, pkt->nbytes)) {
+
+      case rtc::PACKET_CLASS_RTP: {
+        agent->handleRtpData(stream, pkt);
+        break;
+      }
+
+      case rtc::PACKET_CLASS_RTCP: {
+        agent->handleRtcpData(stream, pkt);
+        break;
+      }
+
+      case rtc::PACKET_CLASS_STUN: {
+        /* the view parses the stun message in place, w/o copying. */
+        stun::MessageView msg;
+        if (0 == msg.parse(pkt->data, pkt->nbytes)) {
+          agent->handleStunMessage(stream, &msg, pkt);
+        }
+        else {
+          stream->stun_stats.nmalformed++;
+        }
+        break;
+      }
+
+      case rtc::PACKET_CLASS_DTLS: {
+        agent->handleDtlsData(stream, pkt);
+        break;
+      }
+
+      default: {
+        /* count what we drop when it comes from a pair we know. */
+        CandidatePair* pair = stream->findPair(*pkt->remote, *pkt->local);
+        if (pair) {
+          pair->recv_counters.add(rtc::PACKET_CLASS_UNKNOWN, pkt->nbytes);
+        }
+        break;
+      }
     }
-    else if (r == 1) {
-      /* RTP, RTCP or DTLS */
-      agent->handleStreamData(stream, rip, rport, lip, lport, data, nbytes);
+  }
+
+  static void agent_on_consent_timer(rtc::Timer* timer, void* user) {
+
+    ice::CandidatePair* pair = static_cast<ice::CandidatePair*>(user);
+    ice::Agent* agent = static_cast<ice::Agent*>(pair->stream->user_data);
+
+    agent->sendConsentCheck(pair);
+    agent->context->timers.start(timer, (ICE_CONSENT_INTERVAL * 8) / 10 + (rand() % ((ICE_CONSENT_INTERVAL * 4) / 10)));
+  }
+
+  static void agent_on_consent_expired(rtc::Timer*, void* user) {
+
+    ice::CandidatePair* pair = static_cast<ice::CandidatePair*>(user);
+    ice::Agent* agent = static_cast<ice::Agent*>(pair->stream->user_data);
+
+    printf("ice::Agent - verbose: consent expired for %s:%u <-> %s:%u, removing the pair.\n", 
+           pair->local->ip.c_str(), pair->local->port, 
+           pair->remote_endpoint.getIP().c_str(), pair->remote_endpoint.getPort());
+
+    pair->state = CANDIDATE_PAIR_STATE_EXPIRED;
+    agent->removePair(pair);
+  }
+
+  /* data is the request buffer of the transaction, which we can pass on as is. */
+  static bool agent_consent_on_send(stun::Transaction* trans, const uint8_t*, uint32_t nbytes, void* user) {
+    ice::CandidatePair* pair = static_cast<ice::CandidatePair*>(user);
+    pair->local->transport->sendTo(pair->remote_endpoint, trans->request, nbytes);
+    return true;
+  }
+
+  static void agent_consent_on_result(stun::Transaction*, int result, stun::MessageView*, void* user) {
+
+    ice::CandidatePair* pair = static_cast<ice::CandidatePair*>(user);
+    ice::Agent* agent = static_cast<ice::Agent*>(pair->stream->user_data);
+
+    pair->consent_transaction = NULL;
+
+    /* errors and timeouts don't remove the pair directly; consent expires when we don't get a success response in time. */
+    if (stun::STUN_TRANSACTION_SUCCESS == result) {
+      agent->refreshConsent(pair);
     }
   }
 
-  static void agent_on_dtls_data(uint8_t* data, uint32_t nbytes, void* user) {
+  static void agent_on_pair_idle(rtc::Timer* timer, void* user) {
 
     ice::CandidatePair* pair = static_cast<ice::CandidatePair*>(user);
+    ice::Agent* agent = static_cast<ice::Agent*>(pair->stream->user_data);
+    uint64_t npackets = agent_pair_npackets(pair);
+
+    /* we only look at the counters here, so receiving doesn't touch the timer; the selected pair stays as long as we have consent. */
+    if (pair == pair->stream->selected || npackets != pair->idle_npackets) {
+      pair->idle_npackets = npackets;
+      agent->context->timers.start(timer, ICE_PAIR_IDLE_TIMEOUT);
+      return;
+    }
+
+    printf("ice::Agent - verbose: the %s pair %s:%u <-> %s:%u is idle, removing the pair.\n", 
+           candidate_pair_state_to_string(pair->state),
+           pair->local->ip.c_str(), pair->local->port, 
+           pair->remote_endpoint.getIP().c_str(), pair->remote_endpoint.getPort());
+
+    pair->state = CANDIDATE_PAIR_STATE_EXPIRED;
+    agent->removePair(pair);
+  }
+
+  /* the pair priority of RFC 8445, section 6.1.2.3; G is the priority of the controlling agent, D ours. */
+  static uint64_t agent_pair_priority(uint64_t controlling, uint64_t controlled) {
+    uint64_t lo = (controlling < controlled) ? controlling : controlled;
+    uint64_t hi = (controlling < controlled) ? controlled : controlling;
+    return (lo << 32) + (hi << 1) + ((controlling > controlled) ? 1 : 0);
+  }
+
+  static uint64_t agent_pair_npackets(CandidatePair* pair) {
+
+    uint64_t npackets = 0;
+
+    for (int i = 0; i < rtc::PACKET_CLASS_COUNT; ++i) {
+      npackets += pair->recv_counters.npackets[i];
+    }
+
+    return npackets;
+  }
+
+  static bool agent_init_srtp(DtlsTransport* transport) {
+
+    dtls::Parser& dtls = transport->parser;
+
+    if (false == dtls.extractKeyingMaterial()) {
+      printf("Agent::handleDtlsData() - error: cannot extract keying material.\n");
+      return false;
+    }
+
+    const char* cipher = dtls.getCipherSuite();
+    if (NULL == cipher) {
+      printf("Agent::handleDtlsData() - error: cannot get cipher suite.\n");
+      return false;
+    }
+
+    if (0 != transport->srtp_in.init(cipher, true, dtls.remote_key, dtls.remote_salt)) {
+      printf("Agent::handleDtlsData() - error: cannot initialize srtp_in.\n");
+      return false;
+    }
+
+    if (0 != transport->srtp_out.init(cipher, false, dtls.local_key, dtls.local_salt)) {
+      printf("Agent::handleDtlsData() - error: cannot initialize srtp_out.\n");
+      return false;
+    }
+
+    return true;
+  }
+
+  static void agent_on_dtls_data(uint8_t* data, uint32_t nbytes, void* user) {
+
+    ice::DtlsTransport* transport = static_cast<ice::DtlsTransport*>(user);
+    ice::CandidatePair* pair = transport->pair;
+
+    if (NULL == pair) {
+      return;
+    }
 
     if (NULL == pair->local) {
       printf("agent_on_dtls_data: error - the pair doesn't have a local candidate which isn't supposed to happen!\n");
       return;
     }
 
-    pair->local->conn.sendTo(pair->remote->ip, pair->remote->port, data, nbytes);
+    pair->local->transport->sendTo(pair->remote_endpoint, data, nbytes);
   }                   
 
 } /* namespace ice */
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <uv.h>
+#include <ice/AgentContext.h>
+
+namespace ice {
+
+  AgentContext::AgentContext()
+    :dtls_buffer(NULL)
+    ,is_initialized(false)
+  {
+  }
+
+  AgentContext::~AgentContext() {
+
+    if (dtls_buffer) {
+      delete[] dtls_buffer;
+      dtls_buffer = NULL;
+    }
+
+    is_initialized = false;
+  }
+
+  int AgentContext::init(uint32_t maxTransactions) {
+
+    if (is_initialized) {
+      printf("ice::AgentContext - error: already initialized.\n");
+      return -1;
+    }
+
+    timers.init(uv_hrtime() / 1000000ull);
+
+    if (0 != transactions.init(&timers, maxTransactions)) {
+      printf("ice::AgentContext - error: cannot initialize the stun transactions.\n");
+      return -2;
+    }
+
+    is_initialized = true;
+
+    return 0;
+  }
+
+  uint8_t* AgentContext::getDtlsBuffer() {
+
+    if (!dtls_buffer) {
+      dtls_buffer = new uint8_t[DTLS_BUFFER_SIZE];
+    }
+
+    return dtls_buffer;
+  }
+
+} /* namespace ice */
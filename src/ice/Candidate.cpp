@@ -5,9 +5,32 @@
 
 namespace ice {
 
+  const char* candidate_pair_state_to_string(int state) {
+    switch (state) {
+      case CANDIDATE_PAIR_STATE_SUCCEEDED: { return "succeeded"; }
+      case CANDIDATE_PAIR_STATE_NOMINATED: { return "nominated"; }
+      case CANDIDATE_PAIR_STATE_EXPIRED:   { return "expired";   }
+      default: { return "unknown"; }
+    }
+  }
+
+  /* ------------------------------------------------------------- */
+
   Candidate::Candidate(std::string ip, uint16_t port)
     :ip(ip)
     ,port(port)
+    ,transport(&conn)
+    ,on_data(NULL)
+    ,user(NULL)
+  {
+    endpoint.set(ip, port);
+  }
+
+  Candidate::Candidate(const rtc::Endpoint& ep)
+    :ip(ep.getIP())
+    ,port(ep.getPort())
+    ,endpoint(ep)
+    ,transport(&conn)
     ,on_data(NULL)
     ,user(NULL)
   {
@@ -35,8 +58,41 @@ namespace ice {
     return true;
   }
 
+  bool Candidate::initShared(rtc::ConnectionUDP* shared) {
+
+    if (!shared) {
+      printf("ice::Candidate - error: invalid shared connection.\n");
+      return false;
+    }
+
+    ip = shared->ip;
+    port = shared->port;
+    endpoint = shared->endpoint;
+    transport = shared;
+
+    return true;
+  }
+
   void Candidate::update() {
-    conn.update();
+
+    /* the owner of a shared socket updates it. */
+    if (transport == &conn) {
+      conn.update();
+    }
+  }
+
+  /* ------------------------------------------------------------- */
+
+  RemoteCandidate::RemoteCandidate(const rtc::Endpoint& ep)
+    :endpoint(ep)
+  {
+  }
+
+  /* ------------------------------------------------------------- */
+
+  DtlsTransport::DtlsTransport()
+    :pair(NULL)
+  {
   }
 
   /* ------------------------------------------------------------- */
@@ -44,16 +100,36 @@ namespace ice {
   CandidatePair::CandidatePair()
     :local(NULL)
     ,remote(NULL)
+    ,stream(NULL)
+    ,state(CANDIDATE_PAIR_STATE_SUCCEEDED)
+    ,priority(0)
+    ,dtls(NULL)
+    ,consent_transaction(NULL)
+    ,consent_time(0)
+    ,idle_npackets(0)
+    ,nsrtp_errors(0)
   {
   }
 
-  CandidatePair::CandidatePair(Candidate* local, Candidate* remote)
+  CandidatePair::CandidatePair(Candidate* local, RemoteCandidate* remote)
     :local(local)
     ,remote(remote)
+    ,stream(NULL)
+    ,state(CANDIDATE_PAIR_STATE_SUCCEEDED)
+    ,priority(0)
+    ,dtls(NULL)
+    ,consent_transaction(NULL)
+    ,consent_time(0)
+    ,idle_npackets(0)
+    ,nsrtp_errors(0)
   {
+    if (remote) {
+      remote_endpoint = remote->endpoint;
+    }
   }
 
   CandidatePair::~CandidatePair() {
+    dtls = NULL;
     local = NULL;
     remote = NULL;
   }
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <string.h>
+#include <ice/PortMux.h>
+#include <ice/Stream.h>
+#include <stun/MessageView.h>
+#include <stun/Utils.h>
+
+namespace ice {
+
+  /* --------------------------------------------------------------------- */
+
+  static void port_mux_on_data(rtc::Packet* pkt, void* user);
+
+  /* the routes are keyed on the remote endpoint, the local side of their key is unset. */
+  static const rtc::Endpoint port_mux_any_endpoint;
+
+  /* --------------------------------------------------------------------- */
+
+  PortMux::PortMux()
+    :nstreams(0)
+    ,on_claim(NULL)
+    ,claim_user(NULL)
+    ,nrouted(0)
+    ,nlearned(0)
+    ,nunrouted(0)
+    ,is_initialized(false)
+  {
+  }
+
+  PortMux::~PortMux() {
+    routes.clear();
+    ufrags.clear();
+    nstreams = 0;
+  }
+
+  bool PortMux::init(std::string ip, uint16_t port) {
+
+    if (is_initialized) {
+      printf("ice::PortMux - error: already initialized.\n");
+      return false;
+    }
+
+    if (!conn.bind(ip, port)) {
+      printf("ice::PortMux - error: cannot bind the shared socket on %s:%u\n", ip.c_str(), port);
+      return false;
+    }
+
+    conn.on_data = port_mux_on_data;
+    conn.user = this;
+
+    is_initialized = true;
+
+    return true;
+  }
+
+  void PortMux::update() {
+    conn.update();
+  }
+
+  int PortMux::addStream(Stream* stream) {
+
+    if (!stream) {
+      printf("ice::PortMux - error: cannot add an invalid stream.\n");
+      return -1;
+    }
+
+    if (0 == stream->ice_ufrag.size()) {
+      printf("ice::PortMux - error: the stream has no ice-ufrag; set the credentials before adding it.\n");
+      return -2;
+    }
+
+    Stream* other = findStream(stream->ice_ufrag);
+    if (other == stream) {
+      return 0;
+    }
+
+    if (NULL != other) {
+      printf("ice::PortMux - error: another stream already uses the ice-ufrag: %s\n", stream->ice_ufrag.c_str());
+      return -3;
+    }
+
+    ufrags.insert(UfragKey(stream->ice_ufrag.data(), stream->ice_ufrag.size()), stream);
+    nstreams++;
+
+    return 0;
+  }
+
+  void PortMux::removeStream(Stream* stream) {
+
+    if (!stream) {
+      return;
+    }
+
+    /* the stream registers itself again when its credentials change, so its ufrag is the key. */
+    UfragKey key(stream->ice_ufrag.data(), stream->ice_ufrag.size());
+    if (ufrags.find(key) == stream) {
+      ufrags.remove(key);
+      nstreams--;
+    }
+
+    /* we only learn routes for authenticated requests, which create a pair and so a remote candidate. */
+    for (size_t i = 0; i < stream->remote_candidates.size() && 0 != stream->nroutes; ++i) {
+      const rtc::Endpoint& remote = stream->remote_candidates[i]->endpoint;
+      if (findRoute(remote) == stream) {
+        removeRoute(remote);
+      }
+    }
+
+    /* a route without a remote candidate, e.g. the agent didn't create the pair. */
+    if (0 != stream->nroutes) {
+      routes.removeValue(stream);
+      stream->nroutes = 0;
+    }
+  }
+
+  Stream* PortMux::findStream(const char* ufrag, uint32_t nbytes) {
+    return static_cast<Stream*>(ufrags.find(UfragKey(ufrag, nbytes)));
+  }
+
+  Stream* PortMux::findStream(const std::string& ufrag) {
+    return findStream(ufrag.data(), ufrag.size());
+  }
+
+  bool PortMux::addRoute(const rtc::Endpoint& remote, Stream* stream) {
+
+    if (!is_initialized || !stream) {
+      return false;
+    }
+
+    FlowKey key(remote, port_mux_any_endpoint);
+
+    Stream* other = static_cast<Stream*>(routes.find(key));
+    if (other == stream) {
+      return true;
+    }
+
+    if (other) {
+      other->nroutes--;
+    }
+
+    routes.insert(key, stream);
+    stream->nroutes++;
+
+    return true;
+  }
+
+  void PortMux::removeRoute(const rtc::Endpoint& remote) {
+
+    FlowKey key(remote, port_mux_any_endpoint);
+
+    Stream* stream = static_cast<Stream*>(routes.find(key));
+    if (stream) {
+      routes.remove(key);
+      stream->nroutes--;
+    }
+  }
+
+  Stream* PortMux::findRoute(const rtc::Endpoint& remote) {
+    return static_cast<Stream*>(routes.find(FlowKey(remote, port_mux_any_endpoint)));
+  }
+
+  void PortMux::handleData(rtc::Packet* pkt) {
+
+    Stream* stream = findRoute(*pkt->remote);
+    if (stream) {
+      nrouted++;
+    }
+    else {
+      stream = routeRequest(pkt);
+      if (!stream) {
+        nunrouted++;
+        return;
+      }
+    }
+
+    if (stream->on_data) {
+      stream->on_data(stream, pkt, stream->user_data);
+    }
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  Stream* PortMux::routeRequest(rtc::Packet* pkt) {
+
+    stun::MessageView msg;
+    const uint8_t* username = NULL;
+    uint16_t username_len = 0;
+    uint16_t ufrag_len = 0;
+
+    if (0 != msg.parse(pkt->data, pkt->nbytes)) {
+      return NULL;
+    }
+
+    if (stun::STUN_BINDING_REQUEST != msg.type) {
+      return NULL;
+    }
+
+    if (!msg.findUsername(&username, &username_len)) {
+      return NULL;
+    }
+
+    /* the USERNAME is "<our ufrag>:<their ufrag>" */
+    while (ufrag_len < username_len && ':' != username[ufrag_len]) {
+      ufrag_len++;
+    }
+
+    Stream* stream = findStream((const char*)username, ufrag_len);
+    if (NULL == stream) {
+      if (!on_claim) {
+        return NULL;
+      }
+      on_claim(this, (const char*)username, ufrag_len, &msg, pkt, claim_user);
+      stream = findStream((const char*)username, ufrag_len);
+      if (NULL == stream) {
+        return NULL;
+      }
+    }
+
+    /*
+       Only learn the route when the request is authenticated, otherwise anyone
+       who knows the ufrag could redirect the traffic of a session. We still pass
+       the request on so the agent handles (and counts) it.
+    */
+    if (stun::STUN_VERIFY_OK == stun::verify_request(&msg, stream->ice_ufrag, &stream->integrity_key)) {
+      if (addRoute(*pkt->remote, stream)) {
+        nlearned++;
+      }
+    }
+
+    return stream;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  static void port_mux_on_data(rtc::Packet* pkt, void* user) {
+    PortMux* mux = static_cast<PortMux*>(user);
+    mux->handleData(pkt);
+  }
+
+  /* FNV-1a */
+  uint32_t port_mux_hash_ufrag(const char* ufrag, uint32_t nbytes) {
+
+    uint32_t h = 2166136261u;
+
+    for (uint32_t i = 0; i < nbytes; ++i) {
+      h ^= (uint8_t)ufrag[i];
+      h *= 16777619u;
+    }
+
+    return h;
+  }
+
+} /* namespace ice */
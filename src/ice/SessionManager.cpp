@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <uv.h>
+#include <ice/SessionManager.h>
+
+namespace ice {
+
+  SessionManager::SessionManager()
+    :runtime(NULL)
+    ,nadded(0)
+    ,nremoved(0)
+  {
+  }
+
+  SessionManager::~SessionManager() {
+    shutdown();
+    runtime = NULL;
+  }
+
+  bool SessionManager::init(std::string ip, uint16_t port) {
+
+    if (context.is_initialized) {
+      printf("ice::SessionManager - error: already initialized.\n");
+      return false;
+    }
+
+    if (!context.dtls_ctx.init()) {
+      printf("ice::SessionManager - error: cannot create the certificate.\n");
+      return false;
+    }
+
+    return initShared(ip, port);
+  }
+
+  bool SessionManager::init(std::string ip, uint16_t port, std::string certfile, std::string keyfile) {
+
+    if (context.is_initialized) {
+      printf("ice::SessionManager - error: already initialized.\n");
+      return false;
+    }
+
+    if (!context.dtls_ctx.init(certfile, keyfile)) {
+      printf("ice::SessionManager - error: cannot load the certificate %s and key %s\n", certfile.c_str(), keyfile.c_str());
+      return false;
+    }
+
+    return initShared(ip, port);
+  }
+
+  void SessionManager::setRuntime(rtc::Runtime* rt) {
+    runtime = rt;
+  }
+
+  void SessionManager::update() {
+
+    /* the runtime runs our socket and timers, so one iteration of its loop does it all. */
+    if (runtime) {
+      runtime->poll();
+      return;
+    }
+
+    mux.update();
+    context.timers.update(uv_hrtime() / 1000000ull);
+  }
+
+  void SessionManager::shutdown() {
+
+    /* the sessions stop their timers and transactions, so they go before the context. */
+    for (size_t i = 0; i < sessions.size(); ++i) {
+      delete sessions[i];
+    }
+
+    nremoved += sessions.size();
+    sessions.clear();
+
+    if (!context.is_initialized) {
+      return;
+    }
+
+    if (runtime) {
+      runtime->removeTimers(&context.timers);
+    }
+
+    mux.conn.close();
+
+    /* the socket is part of the mux, so the loop must close it before we're destroyed; a runtime does that after on_stop, otherwise we run the loop ourself. */
+    if (!runtime) {
+      while (mux.conn.is_closing) {
+        uv_run(mux.conn.loop, UV_RUN_NOWAIT);
+      }
+    }
+  }
+
+  int SessionManager::addSession(Agent* agent) {
+
+    if (!agent) {
+      printf("ice::SessionManager - error: cannot add an invalid session.\n");
+      return -1;
+    }
+
+    if (!context.is_initialized) {
+      printf("ice::SessionManager - error: cannot add a session because we're not initialized.\n");
+      return -2;
+    }
+
+    if (NULL != agent->manager || NULL != agent->context) {
+      printf("ice::SessionManager - error: the agent is already used.\n");
+      return -3;
+    }
+
+    if (0 == agent->streams.size()) {
+      printf("ice::SessionManager - error: the session has no streams; add them before adding the session.\n");
+      return -4;
+    }
+
+    agent->setContext(&context);
+    agent->setPortMux(&mux);
+    agent->setRuntime(runtime);
+
+    /* registers the streams on their ufrag; fails when another session uses it. */
+    if (!agent->init()) {
+      printf("ice::SessionManager - error: cannot initialize the session.\n");
+      for (size_t i = 0; i < agent->streams.size(); ++i) {
+        mux.removeStream(agent->streams[i]);
+      }
+      agent->setContext(NULL);
+      agent->setPortMux(NULL);
+      agent->setRuntime(NULL);
+      return -5;
+    }
+
+    agent->manager = this;
+    agent->session_index = sessions.size();
+    sessions.push_back(agent);
+    nadded++;
+
+    return 0;
+  }
+
+  int SessionManager::removeSession(Agent* agent) {
+
+    if (!agent) {
+      return -1;
+    }
+
+    if (agent->manager != this
+        || agent->session_index >= sessions.size()
+        || sessions[agent->session_index] != agent)
+      {
+        printf("ice::SessionManager - error: cannot remove a session we don't own.\n");
+        return -2;
+      }
+
+    /* move the last session into the hole. */
+    Agent* last = sessions.back();
+    sessions[agent->session_index] = last;
+    last->session_index = agent->session_index;
+    sessions.pop_back();
+
+    /* the streams remove themselves and their routes from the mux. */
+    delete agent;
+    nremoved++;
+
+    return 0;
+  }
+
+  Agent* SessionManager::findSession(const std::string& ufrag) {
+
+    Stream* stream = mux.findStream(ufrag);
+    if (!stream) {
+      return NULL;
+    }
+
+    return static_cast<Agent*>(stream->user_data);
+  }
+
+  Agent* SessionManager::findSession(const rtc::Endpoint& remote) {
+
+    Stream* stream = mux.findRoute(remote);
+    if (!stream) {
+      return NULL;
+    }
+
+    return static_cast<Agent*>(stream->user_data);
+  }
+
+  size_t SessionManager::getMemoryUsage() {
+
+    size_t nbytes = 0;
+
+    for (size_t i = 0; i < sessions.size(); ++i) {
+      nbytes += sessions[i]->getMemoryUsage();
+    }
+
+    return nbytes;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  bool SessionManager::initShared(std::string ip, uint16_t port) {
+
+    if (0 != context.init(SESSION_MANAGER_MAX_TRANSACTIONS)) {
+      printf("ice::SessionManager - error: cannot initialize the shared context.\n");
+      return false;
+    }
+
+    if (runtime) {
+      mux.conn.loop = runtime->loop;
+    }
+
+    if (!mux.init(ip, port)) {
+      printf("ice::SessionManager - error: cannot bind %s:%u\n", ip.c_str(), port);
+      return false;
+    }
+
+    if (runtime) {
+      runtime->addTimers(&context.timers);
+    }
+
+    return true;
+  }
+
+} /* namespace ice */
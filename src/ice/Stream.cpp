@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ice/Stream.h>
 
 namespace ice {
@@ -5,22 +6,49 @@ namespace ice {
   /* ------------------------------------------------------------------ */
 
   /* gets called when a candidate receives data. */
-  static void stream_on_data(std::string rip, uint16_t rport, std::string lip, uint16_t lport, uint8_t* data, uint32_t nbytes, void* user);  
+  static void stream_on_data(rtc::Packet* pkt, void* user);
+
+  /* the candidates are indexed on one endpoint, the other side of their key is unset. */
+  static const rtc::Endpoint stream_any_endpoint;
+
+  /* ------------------------------------------------------------------ */
+
+  StunStats::StunStats()
+    :naccepted(0)
+    ,nrejected_fingerprint(0)
+    ,nrejected_username(0)
+    ,nrejected_integrity(0)
+    ,nmalformed(0)
+  {
+  }
 
   /* ------------------------------------------------------------------ */
 
   Stream::Stream(uint32_t flags) 
-    :on_data(NULL)
-    ,user_data(NULL)
+    :selected(NULL)
+    ,dtls(NULL)
+    ,on_data(NULL)
     ,on_rtp(NULL)
+    ,on_rtcp(NULL)
+    ,user_data(NULL)
     ,user_rtp(NULL)
     ,flags(flags)
+    ,mux(NULL)
+    ,nroutes(0)
+    ,ndtls_errors(0)
+    ,last_pair(NULL)
   {
-
+    responder.setKey(&integrity_key);
   }
 
   Stream::~Stream() {
 
+    /* the mux may outlive us; make sure it doesn't route to this stream anymore. */
+    if (mux) {
+      mux->removeStream(this);
+      mux = NULL;
+    }
+
     {
       /* local candidates */
       std::vector<Candidate*>::iterator it = local_candidates.begin();
@@ -32,7 +60,7 @@ namespace ice {
 
     {
       /* remote candidates */
-      std::vector<Candidate*>::iterator it = remote_candidates.begin();
+      std::vector<RemoteCandidate*>::iterator it = remote_candidates.begin();
       while (it != remote_candidates.end()) {
         delete *it;
         it = remote_candidates.erase(it);
@@ -47,6 +75,15 @@ namespace ice {
         it = pairs.erase(it);
       }
     }
+
+    /* after the pairs, which reference it */
+    if (dtls) {
+      delete dtls;
+      dtls = NULL;
+    }
+
+    last_pair = NULL;
+    selected = NULL;
   }
 
   bool Stream::init() {
@@ -60,6 +97,35 @@ namespace ice {
     return true;
   }
 
+  bool Stream::initShared(PortMux* m) {
+
+    if (!m) {
+      printf("ice::Stream - error: invalid mux given.\n");
+      return false;
+    }
+
+    if (0 != local_candidates.size()) {
+      printf("ice::Stream - error: a stream on a shared socket cannot have its own local candidates.\n");
+      return false;
+    }
+
+    Candidate* cand = new Candidate(m->conn.ip, m->conn.port);
+    if (!cand->initShared(&m->conn)) {
+      delete cand;
+      return false;
+    }
+
+    addLocalCandidate(cand);
+
+    if (0 != m->addStream(this)) {
+      return false;
+    }
+
+    mux = m;
+
+    return true;
+  }
+
   void Stream::update() {
     for (size_t i = 0; i < local_candidates.size(); ++i) {
       local_candidates[i]->update();
@@ -68,73 +134,85 @@ namespace ice {
 
   void Stream::addLocalCandidate(Candidate* c) {
     local_candidates.push_back(c);
+    local_index.insert(FlowKey(stream_any_endpoint, c->endpoint), c);
   }
 
-  void Stream::addRemoteCandidate(Candidate* c) {
+  void Stream::addRemoteCandidate(RemoteCandidate* c) {
     remote_candidates.push_back(c);
+    remote_index.insert(FlowKey(c->endpoint, stream_any_endpoint), c);
   }
 
   void Stream::addCandidatePair(CandidatePair* p) {
     pairs.push_back(p);
+    pair_index.insert(FlowKey(p->remote_endpoint, p->local->endpoint), p);
   }
 
   void Stream::setCredentials(std::string ufrag, std::string pwd) {
+
+    /* the mux indexes us on the ufrag (it points at ice_ufrag), so register again; the routes belong to the old credentials. */
+    if (mux) {
+      mux->removeStream(this);
+    }
+
     ice_ufrag = ufrag;
     ice_pwd = pwd;
+    integrity_key.setKey(pwd);
+    check_username = remote_ice_ufrag + ":" + ice_ufrag;
+
+    if (mux && 0 != mux->addStream(this)) {
+      printf("ice::Stream - error: cannot register the new ice-ufrag on the mux: %s\n", ice_ufrag.c_str());
+    }
   }
 
-  CandidatePair* Stream::findPair(std::string rip, uint16_t rport, std::string lip, uint16_t lport) {
+  void Stream::setRemoteCredentials(std::string ufrag, std::string pwd) {
+    remote_ice_ufrag = ufrag;
+    remote_integrity_key.setKey(pwd);
+    check_username = remote_ice_ufrag + ":" + ice_ufrag;
+  }
 
-    if (pairs.size() == 0) {
-      return NULL;
+  CandidatePair* Stream::findPair(const rtc::Endpoint& remote, const rtc::Endpoint& local) {
+
+    if (last_pair
+        && last_pair->remote_endpoint == remote
+        && last_pair->local->endpoint == local) {
+      return last_pair;
     }
 
-    for (size_t i = 0; i < pairs.size(); ++i) {
-      CandidatePair* p = pairs[i];
-      if (p->local->port != lport) {
-        continue;
-      }
-      if (p->remote->port != rport) {
-        continue;
-      }
-      if (p->local->ip != lip) {
-        continue;
-      }
-      if (p->remote->ip != rip) {
-        continue;
-      }
-      return p;
+    CandidatePair* p = static_cast<CandidatePair*>(pair_index.find(FlowKey(remote, local)));
+    if (p) {
+      last_pair = p;
     }
 
-    return NULL;
+    return p;
   }
 
-  CandidatePair* Stream::createPair(std::string rip, uint16_t rport, std::string lip, uint16_t lport) {
-    ice::Candidate* remote_cand = NULL;
+  CandidatePair* Stream::createPair(const rtc::Endpoint& remote, const rtc::Endpoint& local) {
+    ice::RemoteCandidate* remote_cand = NULL;
     ice::Candidate* local_cand = NULL;
     ice::CandidatePair* pair = NULL;
 
     /* We shouldn't find this pair */
-    pair = findPair(rip, rport, lip, lport);
+    pair = findPair(remote, local);
     if (NULL != pair) {
-      printf("ice::Stream::createPair() - pair already exists. %s:%u <-> %s:%u\n", lip.c_str(), lport, rip.c_str(), rport);
+      printf("ice::Stream::createPair() - pair already exists. %s:%u <-> %s:%u\n", local.getIP().c_str(), local.getPort(), remote.getIP().c_str(), remote.getPort());
       return pair;
     }
 
-    local_cand = findLocalCandidate(lip, lport);
+    local_cand = findLocalCandidate(local);
     if (NULL == local_cand) {
       printf("ice::Stream::createPair() - error: cannot find a local candidate; we can only create candidate when the local one has been added alread. (e.g. by the calling app.).\n");
       return NULL;
     }
 
     /* Create a new remote candidate or use the one that already exists. */
-    remote_cand = findRemoteCandidate(rip, rport);
+    remote_cand = findRemoteCandidate(remote);
     if (NULL == remote_cand) {
-      remote_cand = new Candidate(rip, rport);
+      remote_cand = new RemoteCandidate(remote);
       if (NULL == remote_cand) {
-        printf("ice::Stream::createPair() - error: cannot allocate an ice::Candidate. \n");
+        printf("ice::Stream::createPair() - error: cannot allocate an ice::RemoteCandidate. \n");
         return NULL;
       }
+      addRemoteCandidate(remote_cand);
     }
 
     /* Create a new pair of these local and remote candidates. */
@@ -144,39 +222,82 @@ namespace ice {
       return NULL;
     }
       
+    pair->stream = this;
+    pair->dtls = dtls;
+
     /* Make sure the stream keeps track of the allocate candidate/pairs. These will be freed by the stream. */
-    addRemoteCandidate(remote_cand);
     addCandidatePair(pair);
 
     return pair;
   }
 
-  Candidate* Stream::findLocalCandidate(std::string ip, uint16_t port) {
+  Candidate* Stream::findLocalCandidate(const rtc::Endpoint& ep) {
+    return static_cast<Candidate*>(local_index.find(FlowKey(stream_any_endpoint, ep)));
+  }
+
+  RemoteCandidate* Stream::findRemoteCandidate(const rtc::Endpoint& ep) {
+    return static_cast<RemoteCandidate*>(remote_index.find(FlowKey(ep, stream_any_endpoint)));
+  }
+
+  bool Stream::removePair(CandidatePair* p) {
+
+    std::vector<CandidatePair*>::iterator it = std::find(pairs.begin(), pairs.end(), p);
+    if (it == pairs.end()) {
+      printf("ice::Stream::removePair() - error: the pair is not part of this stream.\n");
+      return false;
+    }
+
+    pairs.erase(it);
+    pair_index.remove(FlowKey(p->remote_endpoint, p->local->endpoint));
+
+    if (last_pair == p) {
+      last_pair = NULL;
+    }
+
+    if (selected == p) {
+      selected = NULL;
+    }
+
+    if (dtls && dtls->pair == p) {
+      dtls->pair = NULL;
+    }
+
+    /* free the remote candidate when it's not used anymore; another pair can only use it with another local candidate. */
+    bool remote_used = false;
     for (size_t i = 0; i < local_candidates.size(); ++i) {
-      Candidate* c = local_candidates[i];
-      if (c->port != port) {
-        continue;
+      CandidatePair* other = static_cast<CandidatePair*>(pair_index.find(FlowKey(p->remote_endpoint, local_candidates[i]->endpoint)));
+      if (NULL != other && other->remote == p->remote) {
+        remote_used = true;
+        break;
       }
-      if (c->ip != ip) {
-        continue;
+    }
+
+    if (false == remote_used) {
+      std::vector<RemoteCandidate*>::iterator rit = std::find(remote_candidates.begin(), remote_candidates.end(), p->remote);
+      if (rit != remote_candidates.end()) {
+        remote_candidates.erase(rit);
       }
-      return c;
+      remote_index.remove(FlowKey(p->remote->endpoint, stream_any_endpoint));
+      delete p->remote;
     }
-    return NULL;
+
+    delete p;
+
+    return true;
   }
 
-  Candidate* Stream::findRemoteCandidate(std::string ip, uint16_t port) {
-    for (size_t i = 0; i < remote_candidates.size(); ++i) {
-      Candidate* c = remote_candidates[i];
-      if (c->port != port) {
-        continue;
-      }
-      if (c->ip != ip) {
-        continue;
-      }
-      return c;
+  void Stream::removeDtls() {
+
+    if (NULL == dtls) {
+      return;
+    }
+
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      pairs[i]->dtls = NULL;
     }
-    return NULL;
+
+    delete dtls;
+    dtls = NULL;
   }
 
   int Stream::sendRTP(uint8_t* data, uint32_t nbytes) {
@@ -184,47 +305,59 @@ namespace ice {
     /* validate  */
     if (!data) { return -1; }
     if (!nbytes) { return -2; } 
-    if (0 == pairs.size()) {
-      printf("ice::Stream::sendRTP() - error: cannot send because we have not pairs yet.\n");
+    if (NULL == selected) {
+      printf("ice::Stream::sendRTP() - error: cannot send because no pair has been selected yet.\n");
       return -3;
     }
     
-    CandidatePair* pair = pairs[0];
-    int len = pair->local->srtp_out.protectRTP(data, nbytes);
+    int len = (NULL == dtls) ? -1 : dtls->srtp_out.protectRTP(data, nbytes);
     if (len < 0) {
       printf("ice::Stream::sendRTP() - verbose: cannot protect the RTP data. Probably the srtp parser is not yet initialized.\n");
       return -4;
     }
 
-    for (size_t i = 0; i < pairs.size(); ++i) {
-      pair = pairs[i];
-      pair->local->conn.sendTo(pair->remote->ip, pair->remote->port, data, len);
-    }
+    selected->local->transport->sendTo(selected->remote_endpoint, data, len);
 
     return 0;
   }
 
+  size_t Stream::getMemoryUsage() {
+
+    size_t nbytes = sizeof(Stream);
+
+    nbytes += ice_ufrag.capacity() + ice_pwd.capacity() + remote_ice_ufrag.capacity() + check_username.capacity();
+    nbytes += local_candidates.capacity() * sizeof(Candidate*);
+    nbytes += remote_candidates.capacity() * sizeof(RemoteCandidate*) + remote_candidates.size() * sizeof(RemoteCandidate);
+    nbytes += pairs.capacity() * sizeof(CandidatePair*);
+    nbytes += (pair_index.capacity() + local_index.capacity() + remote_index.capacity()) * sizeof(FlowSlot);
+
+    for (size_t i = 0; i < local_candidates.size(); ++i) {
+      nbytes += sizeof(Candidate) + local_candidates[i]->ip.capacity();
+    }
+
+    nbytes += pairs.size() * sizeof(CandidatePair);
+
+    if (dtls) {
+      nbytes += sizeof(DtlsTransport);
+    }
+
+    return nbytes;
+  }
+
   /* ------------------------------------------------------------------ */
 
   /* 
      This is called whenever a candidate receives data. Each stream (e.g. video, audio, or muxed),
-     will check if there is an existing candidate pair for the transport. If it doesn't exist
-     it will create a new one. 
-
-     It may happen that a candidate pair is created but never used because another pair is selected.
-     At this moment the candidate pair is not free'd and simply ignored.
-
-     @todo - stream_on_data, implement candidate/candidate-pair states, so we can free unused pairs.
+     passes it to the agent, which finds the candidate pair for the transport or creates a new one.
 
+     A pair that is created but not selected is freed by the agent: right away when another pair
+     is selected, or when it's idle or loses consent, see Agent.h.
    */
-  static void stream_on_data(std::string rip, uint16_t rport, 
-                             std::string lip, uint16_t lport, 
-                             uint8_t* data, uint32_t nbytes, void* user) 
-  {
+  static void stream_on_data(rtc::Packet* pkt, void* user) {
 
     Stream* stream = static_cast<Stream*>(user);
     if (stream->on_data) {
-      stream->on_data(stream, rip, rport, lip, lport, data, nbytes, stream->user_data);
+      stream->on_data(stream, pkt, stream->user_data);
     }
   }
 
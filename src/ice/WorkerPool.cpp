@@ -0,0 +1,688 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <ice/WorkerPool.h>
+#include <stun/Utils.h>
+
+namespace ice {
+
+  /* --------------------------------------------------------------------- */
+
+  class AgentTask : public rtc::Task {
+  public:
+    Agent* agent;
+    agent_task_callback cb;
+    void* cb_user;
+  };
+
+  /* a datagram for the session of another worker; we can't use our receive buffer on its thread. */
+  class ForwardTask : public rtc::Task {
+  public:
+    ForwardTask(uint32_t nbytes);
+    ~ForwardTask();
+
+  public:
+    rtc::Endpoint remote;
+    uint8_t* data;
+    uint32_t nbytes;
+    uint64_t arrival;
+    uint64_t timestamp;
+  };
+
+  /* tells a worker to forget a released claim; the last worker that does frees it, also when the task never ran. */
+  class ForgetTask : public rtc::Task {
+  public:
+    ~ForgetTask();
+
+  public:
+    WorkerClaim* claim;
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  static void worker_on_stop(rtc::Runtime* runtime, void* user);
+  static void worker_on_data(rtc::Packet* pkt, void* user);
+  static void worker_on_claim(PortMux* mux, const char* ufrag, uint32_t nbytes, stun::MessageView* request, rtc::Packet* pkt, void* user);
+  static void worker_run_agent_task(rtc::Task* task, void* user);
+  static void worker_run_forward_task(rtc::Task* task, void* user);
+  static void worker_run_forget_task(rtc::Task* task, void* user);
+  static void worker_remove_agent(Agent* agent, void* user);
+
+  /* the forwards are keyed on the remote endpoint, like the routes of a PortMux. */
+  static const rtc::Endpoint worker_any_endpoint;
+
+  /* --------------------------------------------------------------------- */
+
+  WorkerClaim::WorkerClaim()
+    :owner(NULL)
+    ,agent(NULL)
+    ,nrefs(0)
+  {
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  Worker::Worker(WorkerPool* pool, uint32_t id)
+    :pool(pool)
+    ,id(id)
+    ,recv_pool(NULL)
+    ,is_forwarded(false)
+    ,nclaimed(0)
+    ,nfailed(0)
+    ,nfiltered(0)
+    ,nrejected(0)
+    ,nforwarded(0)
+  {
+  }
+
+  Worker::~Worker() {
+
+    /* the runtime closes the mux in on_stop, so stop it before the mux is destroyed. */
+    runtime.stop();
+
+    if (recv_pool) {
+      recv_pool->releaseShared();
+      recv_pool = NULL;
+    }
+
+    pool = NULL;
+  }
+
+  void Worker::removeAgent(Agent* agent) {
+
+    std::vector<Agent*>::iterator it = std::find(agents.begin(), agents.end(), agent);
+    if (it == agents.end()) {
+      printf("ice::Worker - error: cannot remove an agent we don't own.\n");
+      return;
+    }
+
+    pool->releaseClaims(this, agent);
+
+    agents.erase(it);
+    delete agent;
+  }
+
+  void Worker::forward(Worker* owner, rtc::Packet* pkt) {
+
+    ForwardTask* task = new ForwardTask(pkt->nbytes);
+    task->run = worker_run_forward_task;
+    task->user = owner;
+    task->remote = *pkt->remote;
+    task->arrival = pkt->arrival;
+    task->timestamp = pkt->timestamp;
+    memcpy(task->data, pkt->data, pkt->nbytes);
+
+    owner->runtime.post(task);
+    nforwarded++;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  ForwardTask::ForwardTask(uint32_t n)
+    :data(NULL)
+    ,nbytes(n)
+    ,arrival(0)
+    ,timestamp(0)
+  {
+    data = new uint8_t[n];
+  }
+
+  ForwardTask::~ForwardTask() {
+    delete[] data;
+    data = NULL;
+  }
+
+  ForgetTask::~ForgetTask() {
+    if (1 == claim->nrefs.fetch_sub(1)) {
+      delete claim;
+    }
+    claim = NULL;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  WorkerPool::WorkerPool()
+    :port(0)
+  {
+    uv_mutex_init(&mutex);
+
+    for (uint32_t i = 0; i < WORKER_POOL_FILTER_SIZE; ++i) {
+      filter[i].store(0);
+    }
+  }
+
+  WorkerPool::~WorkerPool() {
+    stop();
+    uv_mutex_destroy(&mutex);
+  }
+
+  int WorkerPool::start(std::string bindIP, uint16_t bindPort, uint32_t nworkers, bool steer) {
+
+    if (0 != workers.size()) {
+      printf("ice::WorkerPool - error: already started.\n");
+      return -1;
+    }
+
+    if (0 == nworkers) {
+      printf("ice::WorkerPool - error: we need at least one worker.\n");
+      return -2;
+    }
+
+    ip = bindIP;
+    port = bindPort;
+
+    for (uint32_t i = 0; i < nworkers; ++i) {
+
+      Worker* worker = new Worker(this, i);
+      workers.push_back(worker);
+
+      if (0 != worker->runtime.init()) {
+        printf("ice::WorkerPool - error: cannot initialize the runtime for worker %u\n", i);
+        workers.pop_back();
+        delete worker;
+        stop();
+        return -3;
+      }
+
+      worker->runtime.on_stop = worker_on_stop;
+      worker->runtime.user = worker;
+
+      worker->mux.conn.loop = worker->runtime.loop;
+      worker->mux.conn.reuse_port = true;
+      worker->mux.conn.steer_group = (steer) ? nworkers : 0;
+      worker->mux.on_claim = worker_on_claim;
+      worker->mux.claim_user = worker;
+
+      if (!worker->mux.init(ip, port)) {
+        printf("ice::WorkerPool - error: cannot bind worker %u on %s:%u\n", i, ip.c_str(), port);
+        workers.pop_back();
+        delete worker;
+        stop();
+        return -4;
+      }
+
+      /* we look at the datagrams before the mux, for the sessions of the other workers. */
+      worker->mux.conn.on_data = worker_on_data;
+      worker->mux.conn.user = worker;
+      worker->recv_pool = rtc::RecvPool::acquireShared(worker->runtime.loop);
+    }
+
+    /* the workers forward to each other, so they all exist before any of them runs. */
+    for (uint32_t i = 0; i < nworkers; ++i) {
+      if (0 != workers[i]->runtime.start()) {
+        printf("ice::WorkerPool - error: cannot start worker %u\n", i);
+        stop();
+        return -5;
+      }
+    }
+
+    return 0;
+  }
+
+  void WorkerPool::stop() {
+
+    /* a running worker may still post to the others, so we delete them when all have stopped. */
+    for (size_t i = 0; i < workers.size(); ++i) {
+
+      /* the worker deletes its agents and closes its mux in on_stop; when the thread never ran, stop() does that here. */
+      workers[i]->runtime.stop();
+    }
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+      delete workers[i];
+    }
+
+    workers.clear();
+
+    uv_mutex_lock(&mutex);
+    {
+      /* the agents nobody claimed */
+      std::vector<Agent*> agents;
+      std::map<std::string, Agent*>::iterator it = pending.begin();
+      while (it != pending.end()) {
+        if (std::find(agents.begin(), agents.end(), it->second) == agents.end()) {
+          agents.push_back(it->second);
+        }
+        removeFromFilter(it->first);
+        ++it;
+      }
+      pending.clear();
+
+      for (size_t i = 0; i < agents.size(); ++i) {
+        delete agents[i];
+      }
+
+      for (size_t i = 0; i < failed.size(); ++i) {
+        delete failed[i];
+      }
+      failed.clear();
+
+      /* the workers deleted the agents of these claims when they stopped. */
+      std::map<std::string, WorkerClaim*>::iterator cit = claimed.begin();
+      while (cit != claimed.end()) {
+        removeFromFilter(cit->first);
+        delete cit->second;
+        ++cit;
+      }
+      claimed.clear();
+
+      for (size_t i = 0; i < tasks.size(); ++i) {
+        delete tasks[i];
+      }
+      tasks.clear();
+    }
+    uv_mutex_unlock(&mutex);
+  }
+
+  int WorkerPool::addAgent(Agent* agent) {
+
+    if (!agent) {
+      printf("ice::WorkerPool - error: cannot add an invalid agent.\n");
+      return -1;
+    }
+
+    if (0 == agent->streams.size()) {
+      printf("ice::WorkerPool - error: the agent has no streams; add them before adding the agent.\n");
+      return -2;
+    }
+
+    uv_mutex_lock(&mutex);
+
+    for (size_t i = 0; i < agent->streams.size(); ++i) {
+
+      std::string& ufrag = agent->streams[i]->ice_ufrag;
+
+      if (0 == ufrag.size()) {
+        printf("ice::WorkerPool - error: the stream has no ice-ufrag; set the credentials before adding the agent.\n");
+        uv_mutex_unlock(&mutex);
+        return -3;
+      }
+
+      std::map<std::string, Agent*>::iterator it = pending.find(ufrag);
+      if ((it != pending.end() && it->second != agent) || claimed.find(ufrag) != claimed.end()) {
+        printf("ice::WorkerPool - error: another agent already uses the ice-ufrag: %s\n", ufrag.c_str());
+        uv_mutex_unlock(&mutex);
+        return -4;
+      }
+    }
+
+    for (size_t i = 0; i < agent->streams.size(); ++i) {
+      std::string& ufrag = agent->streams[i]->ice_ufrag;
+      if (pending.insert(std::pair<std::string, Agent*>(ufrag, agent)).second) {
+        addToFilter(ufrag);
+      }
+    }
+
+    uv_mutex_unlock(&mutex);
+
+    return 0;
+  }
+
+  int WorkerPool::removeAgent(Agent* agent) {
+
+    if (!agent) {
+      return -1;
+    }
+
+    uv_mutex_lock(&mutex);
+
+    if (NULL == agent->worker.load()) {
+
+      std::map<std::string, Agent*>::iterator it = pending.begin();
+      while (it != pending.end()) {
+        if (it->second == agent) {
+          removeFromFilter(it->first);
+          pending.erase(it++);
+        }
+        else {
+          ++it;
+        }
+      }
+
+      std::vector<Agent*>::iterator fit = std::find(failed.begin(), failed.end(), agent);
+      if (fit != failed.end()) {
+        failed.erase(fit);
+      }
+
+      std::vector<rtc::Task*>::iterator tit = tasks.begin();
+      while (tit != tasks.end()) {
+        if (static_cast<AgentTask*>(*tit)->agent == agent) {
+          delete *tit;
+          tit = tasks.erase(tit);
+        }
+        else {
+          ++tit;
+        }
+      }
+
+      uv_mutex_unlock(&mutex);
+      delete agent;
+      return 0;
+    }
+
+    uv_mutex_unlock(&mutex);
+
+    return post(agent, worker_remove_agent, NULL);
+  }
+
+  int WorkerPool::post(Agent* agent, agent_task_callback cb, void* user) {
+
+    if (!agent || !cb) {
+      printf("ice::WorkerPool - error: cannot post a task without an agent or callback.\n");
+      return -1;
+    }
+
+    AgentTask* task = new AgentTask();
+    task->run = worker_run_agent_task;
+    task->agent = agent;
+    task->cb = cb;
+    task->cb_user = user;
+
+    /* the worker is set once, so only an agent that isn't claimed yet needs the lock. */
+    Worker* worker = agent->worker.load(std::memory_order_acquire);
+    if (NULL == worker) {
+
+      uv_mutex_lock(&mutex);
+
+      worker = agent->worker.load(std::memory_order_acquire);
+      if (NULL == worker) {
+        tasks.push_back(task);
+        uv_mutex_unlock(&mutex);
+        return 0;
+      }
+
+      uv_mutex_unlock(&mutex);
+    }
+
+    task->user = worker;
+    worker->runtime.post(task);
+
+    return 0;
+  }
+
+  void WorkerPool::claim(Worker* worker, const char* ufrag, uint32_t nbytes, stun::MessageView* request, rtc::Packet* pkt) {
+
+    Agent* agent = NULL;
+    Stream* stream = NULL;
+
+    /* another worker forwarded it because it's ours; when our mux doesn't know it anymore, nobody does. */
+    if (worker->is_forwarded) {
+      return;
+    }
+
+    /* most of these ufrags aren't pending (stale sessions, scans, floods); don't serialize the workers on them. */
+    uint32_t slot = port_mux_hash_ufrag(ufrag, nbytes) & (WORKER_POOL_FILTER_SIZE - 1);
+    if (0 == filter[slot].load(std::memory_order_relaxed)) {
+      worker->nfiltered++;
+      return;
+    }
+
+    std::string key(ufrag, nbytes);
+
+    uv_mutex_lock(&mutex);
+
+    std::map<std::string, Agent*>::iterator it = pending.find(key);
+    if (it == pending.end()) {
+
+      std::map<std::string, WorkerClaim*>::iterator cit = claimed.find(key);
+      if (cit == claimed.end() || cit->second->owner == worker) {
+        uv_mutex_unlock(&mutex);
+        worker->nfiltered++;
+        return;
+      }
+
+      /* the claim is freed after every worker ran its ForgetTask, so it stays valid on our thread. */
+      WorkerClaim* claim = cit->second;
+
+      uv_mutex_unlock(&mutex);
+
+      /* only learn the forward for the peer that knows the ice-pwd, like PortMux::routeRequest(). */
+      if (stun::STUN_VERIFY_OK != stun::verify_request(request, claim->ufrag, &claim->key)) {
+        worker->nrejected++;
+        return;
+      }
+
+      worker->forwards.insert(FlowKey(*pkt->remote, worker_any_endpoint), claim);
+      worker->forward(claim->owner, pkt);
+      return;
+    }
+
+    agent = it->second;
+
+    for (size_t i = 0; i < agent->streams.size(); ++i) {
+      if (agent->streams[i]->ice_ufrag == key) {
+        stream = agent->streams[i];
+        break;
+      }
+    }
+
+    /* only the peer that knows the ice-pwd may decide on which worker the session runs. */
+    if (NULL == stream || stun::STUN_VERIFY_OK != stun::verify_request(request, stream->ice_ufrag, &stream->integrity_key)) {
+      uv_mutex_unlock(&mutex);
+      worker->nrejected++;
+      return;
+    }
+
+    /* the other streams of the agent run on this worker too. */
+    std::vector<std::string> ufrags;
+    it = pending.begin();
+    while (it != pending.end()) {
+      if (it->second == agent) {
+        ufrags.push_back(it->first);
+        pending.erase(it++);
+      }
+      else {
+        ++it;
+      }
+    }
+
+    /*
+       We initialize the agent with the lock held, so nobody removes it or posts
+       to it meanwhile; init() only touches the agent and our mux. When it fails
+       the pool keeps the agent until it's removed, we don't claim it again.
+    */
+    agent->setPortMux(&worker->mux);
+    agent->setRuntime(&worker->runtime);
+
+    if (!agent->init()) {
+
+      for (size_t i = 0; i < agent->streams.size(); ++i) {
+        worker->mux.removeStream(agent->streams[i]);
+        agent->streams[i]->mux = NULL;
+      }
+
+      if (agent->owns_context) {
+        worker->runtime.removeTimers(&agent->context->timers);
+      }
+
+      agent->setPortMux(NULL);
+      agent->setRuntime(NULL);
+
+      for (size_t i = 0; i < ufrags.size(); ++i) {
+        removeFromFilter(ufrags[i]);
+      }
+
+      failed.push_back(agent);
+
+      uv_mutex_unlock(&mutex);
+
+      printf("ice::WorkerPool - error: cannot initialize the agent for ufrag %s on worker %u\n", key.c_str(), worker->id);
+      worker->nfailed++;
+      return;
+    }
+
+    /* the ufrags stay in the filter, the other workers forward their traffic to us. */
+    std::vector<WorkerClaim*>& claims = worker->claims[agent];
+    for (size_t i = 0; i < ufrags.size(); ++i) {
+      for (size_t k = 0; k < agent->streams.size(); ++k) {
+        if (agent->streams[k]->ice_ufrag == ufrags[i]) {
+          WorkerClaim* claim = new WorkerClaim();
+          claim->owner = worker;
+          claim->agent = agent;
+          claim->ufrag = ufrags[i];
+          claim->key = agent->streams[k]->integrity_key;
+          claimed[claim->ufrag] = claim;
+          claims.push_back(claim);
+          break;
+        }
+      }
+    }
+
+    /* the tasks that were posted before run after the ones we queue now; that's why we set the worker last. */
+    std::vector<rtc::Task*>::iterator tit = tasks.begin();
+    while (tit != tasks.end()) {
+      if (static_cast<AgentTask*>(*tit)->agent == agent) {
+        (*tit)->user = worker;
+        worker->runtime.post(*tit);
+        tit = tasks.erase(tit);
+      }
+      else {
+        ++tit;
+      }
+    }
+
+    agent->worker.store(worker, std::memory_order_release);
+
+    uv_mutex_unlock(&mutex);
+
+    worker->agents.push_back(agent);
+    worker->nclaimed++;
+  }
+
+  void WorkerPool::releaseClaims(Worker* worker, Agent* agent) {
+
+    std::map<Agent*, std::vector<WorkerClaim*> >::iterator it = worker->claims.find(agent);
+    if (it == worker->claims.end()) {
+      return;
+    }
+
+    std::vector<WorkerClaim*>& claims = it->second;
+
+    uv_mutex_lock(&mutex);
+    for (size_t i = 0; i < claims.size(); ++i) {
+      claimed.erase(claims[i]->ufrag);
+      removeFromFilter(claims[i]->ufrag);
+      claims[i]->nrefs.store(workers.size());
+    }
+    uv_mutex_unlock(&mutex);
+
+    /* the other workers may have forwards to the claims; they're freed when every worker forgot them. */
+    for (size_t i = 0; i < claims.size(); ++i) {
+      for (size_t k = 0; k < workers.size(); ++k) {
+        ForgetTask* task = new ForgetTask();
+        task->run = worker_run_forget_task;
+        task->user = workers[k];
+        task->claim = claims[i];
+        workers[k]->runtime.post(task);
+      }
+    }
+
+    worker->claims.erase(it);
+  }
+
+  void WorkerPool::addToFilter(const std::string& ufrag) {
+    uint32_t slot = port_mux_hash_ufrag(ufrag.data(), ufrag.size()) & (WORKER_POOL_FILTER_SIZE - 1);
+    filter[slot].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void WorkerPool::removeFromFilter(const std::string& ufrag) {
+    uint32_t slot = port_mux_hash_ufrag(ufrag.data(), ufrag.size()) & (WORKER_POOL_FILTER_SIZE - 1);
+    filter[slot].fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  static void worker_on_stop(rtc::Runtime*, void* user) {
+
+    Worker* worker = static_cast<Worker*>(user);
+
+    for (size_t i = 0; i < worker->agents.size(); ++i) {
+      delete worker->agents[i];
+    }
+    worker->agents.clear();
+    worker->claims.clear();
+    worker->forwards.clear();
+
+    /* once its handles are closed the loop ends. */
+    worker->mux.conn.close();
+  }
+
+  /* the mux routes what it knows itself; only the rest can belong to a session of another worker. */
+  static void worker_on_data(rtc::Packet* pkt, void* user) {
+
+    Worker* worker = static_cast<Worker*>(user);
+
+    if (0 != worker->forwards.size() && NULL == worker->mux.findRoute(*pkt->remote)) {
+      WorkerClaim* claim = static_cast<WorkerClaim*>(worker->forwards.find(FlowKey(*pkt->remote, worker_any_endpoint)));
+      if (claim) {
+        worker->forward(claim->owner, pkt);
+        return;
+      }
+    }
+
+    worker->mux.handleData(pkt);
+  }
+
+  static void worker_on_claim(PortMux*, const char* ufrag, uint32_t nbytes, stun::MessageView* request, rtc::Packet* pkt, void* user) {
+    Worker* worker = static_cast<Worker*>(user);
+    worker->pool->claim(worker, ufrag, nbytes, request, pkt);
+  }
+
+  static void worker_run_agent_task(rtc::Task* task, void*) {
+    AgentTask* agent_task = static_cast<AgentTask*>(task);
+    agent_task->cb(agent_task->agent, agent_task->cb_user);
+    delete agent_task;
+  }
+
+  /* we copy the datagram into a buffer of our own loop, so the handlers can retain it like any other. */
+  static void worker_run_forward_task(rtc::Task* task, void* user) {
+
+    Worker* worker = static_cast<Worker*>(user);
+    ForwardTask* fwd = static_cast<ForwardTask*>(task);
+    rtc::RecvBuffer* buf = NULL;
+
+    if (fwd->nbytes <= worker->recv_pool->size) {
+      buf = worker->recv_pool->acquire();
+    }
+
+    if (NULL == buf) {
+      buf = worker->recv_pool->acquireJumbo(fwd->nbytes);
+    }
+
+    memcpy(buf->data, fwd->data, fwd->nbytes);
+    buf->nbytes = fwd->nbytes;
+    buf->arrival = fwd->arrival;
+    buf->timestamp = fwd->timestamp;
+    buf->socket = &worker->mux.conn;
+    buf->remote = fwd->remote;
+
+    rtc::Packet pkt;
+    pkt.remote = &buf->remote;
+    pkt.local = &worker->mux.conn.endpoint;
+    pkt.data = buf->data;
+    pkt.nbytes = buf->nbytes;
+    pkt.arrival = buf->arrival;
+    pkt.timestamp = buf->timestamp;
+    pkt.socket = &worker->mux.conn;
+    pkt.buffer = buf;
+
+    worker->is_forwarded = true;
+    worker->mux.handleData(&pkt);
+    worker->is_forwarded = false;
+
+    buf->release();
+    delete fwd;
+  }
+
+  static void worker_run_forget_task(rtc::Task* task, void* user) {
+    Worker* worker = static_cast<Worker*>(user);
+    ForgetTask* forget = static_cast<ForgetTask*>(task);
+    worker->forwards.removeValue(forget->claim);
+    delete forget;
+  }
+
+  static void worker_remove_agent(Agent* agent, void*) {
+    agent->worker.load()->removeAgent(agent);
+  }
+
+} /* namespace ice */
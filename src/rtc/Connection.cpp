@@ -1,22 +1,456 @@
 #include <rtc/Connection.h>
+#include <rtc/Uring.h>
 #include <string.h>
 
+#if defined(__linux__)
+#  include <errno.h>
+#  include <unistd.h>
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <netinet/udp.h>
+#  include <linux/filter.h>
+#  include <linux/sock_diag.h>
+#  define CONNECTION_UDP_HAVE_MMSG 1
+#  define CONNECTION_UDP_CONTROL_SIZE 128                         /* room for the UDP_GRO, SO_TIMESTAMPNS and SO_RXQ_OVFL messages */
+#  if !defined(SOL_UDP)
+#    define SOL_UDP 17
+#  endif
+#  if !defined(UDP_SEGMENT)
+#    define UDP_SEGMENT 103                                       /* older headers; the kernel decides if it's supported. */
+#  endif
+#  if !defined(UDP_GRO)
+#    define UDP_GRO 104
+#  endif
+#endif
+
 /* ----------------------------------------------------------------- */
 
 static void rtc_connection_udp_alloc_cb(uv_handle_t* handle, size_t nsize, uv_buf_t* buf);
 static void rtc_connection_udp_recv_cb(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned int flags);
 static void rtc_connection_udp_send_cb(uv_udp_send_t* req, int status);
+static void rtc_connection_udp_close_cb(uv_handle_t* handle);
+
+#if CONNECTION_UDP_HAVE_MMSG
+static void rtc_connection_udp_poll_cb(uv_poll_t* handle, int status, int events);
+static void rtc_connection_udp_check_cb(uv_check_t* handle);
+static void rtc_connection_udp_batch_close_cb(uv_handle_t* handle);
+#endif
 
 /* ----------------------------------------------------------------- */
 
 namespace rtc {
+
+#if CONNECTION_UDP_HAVE_MMSG
+
+  /* 
+     State of the batched backend. The uv handles are part of this object
+     and must stay valid until their close callbacks were called, that's
+     why it's allocated separately from the ConnectionUDP.
+  */
+  class ConnectionUDPBatch {
+  public:
+    ConnectionUDPBatch(ConnectionUDP* conn);
+    ~ConnectionUDPBatch();
+    bool init(bool gro);                                                    /* allocates the overflow buffers; with gro they're large enough for coalesced reads. */
+    void receive();                                                         /* drains the socket with recvmmsg() */
+    void dispatch(uint32_t dx);                                             /* passes the datagram(s) of receive message dx to on_data */
+    void releaseBuffers();                                                  /* releases the pool buffers we're holding for the next recvmmsg() */
+    uint32_t prepareSend();                                                 /* fills send_msgs for the queued slots, coalescing them when gso is set; returns the number of messages. */
+    void setWritable(bool watch);                                           /* start/stop watching for UV_WRITABLE */
+    void closeHandles(bool withCheck);                                      /* closes the poll (and check) handle; the last close callback closes the socket and deletes the batch. */
+
+  public:
+    ConnectionUDP* conn;
+    int fd;
+    uv_poll_t poll;
+    uv_check_t check;
+    int events;                                                             /* the events we're polling for */
+    int nclosing;                                                           /* number of handles that still need to be closed */
+    bool gso;                                                               /* coalesce the send queue with UDP_SEGMENT */
+    bool gro;                                                               /* the kernel may coalesce the datagrams we receive */
+
+    /* 
+       Receive. Without gro each message reads into a buffer of the pool of
+       the connection, which we hand to on_data without copying; a datagram
+       that's larger continues in the overflow buffer of the message and is
+       copied into a heap (jumbo) buffer. With gro we read into the large
+       overflow buffers and copy the datagrams out.
+    */
+    struct mmsghdr recv_msgs[CONNECTION_UDP_BATCH_SIZE];
+    struct iovec recv_iovs[CONNECTION_UDP_BATCH_SIZE][2];
+    struct sockaddr_in recv_addrs[CONNECTION_UDP_BATCH_SIZE];
+    uint8_t recv_controls[CONNECTION_UDP_BATCH_SIZE][CONNECTION_UDP_CONTROL_SIZE]; /* ancillary data: the UDP_GRO segment size, timestamp and drop counter */
+    RecvBuffer* recv_bufs[CONNECTION_UDP_BATCH_SIZE];                       /* the pool buffers the messages read into (without gro) */
+    uint8_t* recv_buffer;                                                   /* recv_count overflow buffers of recv_buffer_size bytes */
+    uint32_t recv_buffer_size;
+    uint32_t recv_count;                                                    /* the number of messages per recvmmsg() */
+    uint64_t recv_time;                                                     /* when the last recvmmsg() returned */
+
+    /* 
+       Send queue; slots [send_head, send_tail) still need to be sent. The
+       iovecs point into the slots and are contiguous, so a message can
+       cover a range of them; send_nslots tells how many slots a message of
+       the last prepareSend() covers.
+    */
+    struct mmsghdr send_msgs[CONNECTION_UDP_BATCH_SIZE];
+    struct iovec send_iovs[CONNECTION_UDP_BATCH_SIZE];
+    uint8_t send_controls[CONNECTION_UDP_BATCH_SIZE][CMSG_SPACE(sizeof(uint16_t))];
+    uint32_t send_nslots[CONNECTION_UDP_BATCH_SIZE];
+    SendSlot* send_slots[CONNECTION_UDP_BATCH_SIZE];
+    uint32_t send_head;
+    uint32_t send_tail;
+  };
+
+  ConnectionUDPBatch::ConnectionUDPBatch(ConnectionUDP* conn)
+    :conn(conn)
+    ,fd(-1)
+    ,events(0)
+    ,nclosing(0)
+    ,gso(false)
+    ,gro(false)
+    ,recv_buffer(NULL)
+    ,recv_buffer_size(0)
+    ,recv_count(0)
+    ,recv_time(0)
+    ,send_head(0)
+    ,send_tail(0)
+  {
+    memset(recv_msgs, 0x00, sizeof(recv_msgs));
+    memset(send_msgs, 0x00, sizeof(send_msgs));
+
+    for (int i = 0; i < CONNECTION_UDP_BATCH_SIZE; ++i) {
+      recv_msgs[i].msg_hdr.msg_iov = recv_iovs[i];
+      recv_msgs[i].msg_hdr.msg_iovlen = 1;
+      recv_msgs[i].msg_hdr.msg_name = &recv_addrs[i];
+      recv_bufs[i] = NULL;
+
+      send_slots[i] = NULL;
+      send_nslots[i] = 0;
+      send_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+  }
+
+  ConnectionUDPBatch::~ConnectionUDPBatch() {
+
+    if (recv_buffer) {
+      delete[] recv_buffer;
+      recv_buffer = NULL;
+    }
+  }
+
+  bool ConnectionUDPBatch::init(bool withGRO) {
+
+    gro = withGRO;
+
+    /* with gro one read can hold up to 64k, so we use fewer but larger buffers. */
+    recv_count = (gro) ? CONNECTION_UDP_GRO_BATCH_SIZE : CONNECTION_UDP_BATCH_SIZE;
+    recv_buffer_size = (gro) ? CONNECTION_UDP_GRO_BUFFER_SIZE : (RECV_JUMBO_SIZE - RECV_BUFFER_SIZE);
+
+    recv_buffer = new uint8_t[recv_count * recv_buffer_size];
+    if (!recv_buffer) {
+      printf("rtc::ConnectionUDP - error: cannot allocate the receive buffers.\n");
+      return false;
+    }
+
+    for (uint32_t i = 0; i < recv_count; ++i) {
+      uint32_t dx = (gro) ? 0 : 1;
+      recv_iovs[i][dx].iov_base = recv_buffer + (i * recv_buffer_size);
+      recv_iovs[i][dx].iov_len = recv_buffer_size;
+      recv_msgs[i].msg_hdr.msg_iovlen = dx + 1;
+    }
+
+    return true;
+  }
+
+  void ConnectionUDPBatch::closeHandles(bool withCheck) {
+
+    conn = NULL;
+    nclosing = (withCheck) ? 2 : 1;
+
+    uv_poll_stop(&poll);
+    uv_close((uv_handle_t*)&poll, rtc_connection_udp_batch_close_cb);
+
+    if (withCheck) {
+      uv_check_stop(&check);
+      uv_close((uv_handle_t*)&check, rtc_connection_udp_batch_close_cb);
+    }
+  }
+
+  void ConnectionUDPBatch::releaseBuffers() {
+    for (uint32_t i = 0; i < CONNECTION_UDP_BATCH_SIZE; ++i) {
+      if (recv_bufs[i]) {
+        recv_bufs[i]->release();
+        recv_bufs[i] = NULL;
+      }
+    }
+  }
+
+  void ConnectionUDPBatch::receive() {
+
+    /* we limit the number of batches per wakeup so one busy socket can't starve the others. */
+    for (int round = 0; round < 4; ++round) {
+
+      for (uint32_t i = 0; i < recv_count; ++i) {
+
+        recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        recv_msgs[i].msg_hdr.msg_flags = 0;
+        recv_msgs[i].msg_hdr.msg_control = (gro || conn->has_timestamps) ? recv_controls[i] : NULL;
+        recv_msgs[i].msg_hdr.msg_controllen = (gro || conn->has_timestamps) ? sizeof(recv_controls[i]) : 0;
+
+        /* the buffers of the previous round were handed to on_data; when all pool buffers are retained we use heap buffers. */
+        if (!gro && !recv_bufs[i]) {
+          RecvBuffer* buf = conn->recv_pool->acquire();
+          if (!buf) {
+            buf = conn->recv_pool->acquireJumbo(RECV_BUFFER_SIZE);
+          }
+          recv_bufs[i] = buf;
+          recv_iovs[i][0].iov_base = buf->base;
+          recv_iovs[i][0].iov_len = buf->capacity;
+        }
+      }
+
+      int n = recvmmsg(fd, recv_msgs, recv_count, MSG_DONTWAIT, NULL);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          printf("rtc::ConnectionUDP - error: recvmmsg() failed: %s\n", strerror(errno));
+        }
+        return;
+      }
+
+      conn->nrecv_calls++;
+      recv_time = uv_hrtime();
+
+      for (int i = 0; i < n; ++i) {
+
+        if (recv_msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+          printf("rtc::ConnectionUDP - warning: dropping a truncated datagram.\n");
+          conn->nrecv_truncated++;
+          continue;
+        }
+
+        if (AF_INET != recv_addrs[i].sin_family) {
+          continue;
+        }
+
+        dispatch(i);
+
+        /* on_data may close the connection. */
+        if (!conn) {
+          return;
+        }
+      }
+
+      if ((uint32_t)n < recv_count) {
+        return;
+      }
+    }
+  }
+
+  void ConnectionUDPBatch::dispatch(uint32_t dx) {
+
+    RecvBuffer* buf = NULL;
+    uint32_t nbytes = recv_msgs[dx].msg_len;
+    uint64_t timestamp = (conn->has_timestamps) ? conn->readControl(&recv_msgs[dx].msg_hdr) : 0;
+
+    if (!gro) {
+
+      uint32_t first = recv_iovs[dx][0].iov_len;
+
+      if (nbytes <= first) {
+        /* the common case; the buffer goes to on_data as is. */
+        buf = recv_bufs[dx];
+        recv_bufs[dx] = NULL;
+      }
+      else {
+        /* a jumbo datagram; we keep the pool buffer for the next read. */
+        buf = conn->recv_pool->acquireJumbo(nbytes);
+        memcpy(buf->base, recv_iovs[dx][0].iov_base, first);
+        memcpy(buf->base + first, recv_iovs[dx][1].iov_base, nbytes - first);
+      }
+
+      buf->data = buf->base;
+      buf->nbytes = nbytes;
+      buf->arrival = recv_time;
+      buf->timestamp = timestamp;
+      buf->socket = conn;
+      buf->remote.set(&recv_addrs[dx]);
+
+      conn->deliver(buf);
+      return;
+    }
+
+    uint8_t* data = (uint8_t*)recv_iovs[dx][0].iov_base;
+    uint32_t segment_size = nbytes;
+
+    /* a coalesced read has the size of its datagrams (all but the last one) in a UDP_GRO message. */
+    if (gro) {
+      struct msghdr* hdr = &recv_msgs[dx].msg_hdr;
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); NULL != cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (SOL_UDP == cmsg->cmsg_level && UDP_GRO == cmsg->cmsg_type) {
+          int size = 0;
+          memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+          if (size > 0 && (uint32_t)size < nbytes) {
+            segment_size = size;
+            conn->nrecv_gro++;
+          }
+        }
+      }
+    }
+
+    /* the datagrams share the large read buffer, so each gets its own copy. */
+    while (nbytes > 0 && conn) {
+
+      uint32_t len = (nbytes < segment_size) ? nbytes : segment_size;
+
+      buf = (len <= conn->recv_pool->size) ? conn->recv_pool->acquire() : NULL;
+      if (!buf) {
+        buf = conn->recv_pool->acquireJumbo(len);
+      }
+
+      memcpy(buf->base, data, len);
+      buf->data = buf->base;
+      buf->nbytes = len;
+      buf->arrival = recv_time;
+      buf->timestamp = timestamp;
+      buf->socket = conn;
+      buf->remote.set(&recv_addrs[dx]);
+
+      conn->deliver(buf);
+
+      data += len;
+      nbytes -= len;
+    }
+  }
+
+  uint32_t ConnectionUDPBatch::prepareSend() {
+
+    uint32_t nmsgs = 0;
+    uint32_t i = send_head;
+
+    while (i < send_tail) {
+
+      uint32_t first = i;
+      uint32_t segment_size = send_iovs[i].iov_len;
+      uint32_t nbytes = segment_size;
+      const struct sockaddr_in& dest = send_slots[first]->addr;
+
+      i++;
+
+      /* 
+         GSO splits the payload in segments of segment_size bytes, so we can
+         only coalesce packets to the same destination with the same size;
+         the last one may be smaller.
+      */
+      if (gso) {
+        while (i < send_tail
+               && (i - first) < CONNECTION_UDP_GSO_MAX_SEGMENTS
+               && send_iovs[i].iov_len <= segment_size
+               && nbytes + send_iovs[i].iov_len <= CONNECTION_UDP_GSO_MAX_BYTES
+               && send_slots[i]->addr.sin_addr.s_addr == dest.sin_addr.s_addr
+               && send_slots[i]->addr.sin_port == dest.sin_port)
+          {
+            bool is_last = send_iovs[i].iov_len < segment_size;
+            nbytes += send_iovs[i].iov_len;
+            i++;
+            if (is_last) {
+              break;
+            }
+          }
+      }
+
+      struct msghdr* hdr = &send_msgs[nmsgs].msg_hdr;
+      hdr->msg_name = (void*)&dest;
+      hdr->msg_namelen = sizeof(struct sockaddr_in);
+      hdr->msg_iov = &send_iovs[first];
+      hdr->msg_iovlen = i - first;
+      hdr->msg_control = NULL;
+      hdr->msg_controllen = 0;
+
+      if (hdr->msg_iovlen > 1) {
+        uint16_t size = segment_size;
+        hdr->msg_control = send_controls[nmsgs];
+        hdr->msg_controllen = sizeof(send_controls[nmsgs]);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+      }
+
+      send_nslots[nmsgs] = i - first;
+      nmsgs++;
+    }
+
+    return nmsgs;
+  }
+
+  void ConnectionUDPBatch::setWritable(bool watch) {
+
+    int wanted = (watch) ? (UV_READABLE | UV_WRITABLE) : UV_READABLE;
+    if (wanted == events) {
+      return;
+    }
+
+    events = wanted;
+    uv_poll_start(&poll, events, rtc_connection_udp_poll_cb);
+  }
+
+#endif /* CONNECTION_UDP_HAVE_MMSG */
+
+  /* ----------------------------------------------------------------- */
   
+  ConnectionUDPStats::ConnectionUDPStats()
+    :nrecv_calls(0)
+    ,nrecv_packets(0)
+    ,nrecv_gro(0)
+    ,nrecv_truncated(0)
+    ,nsend_calls(0)
+    ,nsend_packets(0)
+    ,nsend_dropped(0)
+    ,nsend_gso(0)
+    ,nrecv_overflow(0)
+    ,recv_queue_bytes(0)
+    ,send_queue_bytes(0)
+    ,recv_buffer_size(0)
+    ,send_buffer_size(0)
+    ,has_timestamps(false)
+  {
+  }
+
+  /* --------------------------------------------------------------------- */
+
   ConnectionUDP::ConnectionUDP() 
-    :loop(NULL)
+    :mode(CONNECTION_UDP_DEFAULT_MODE)
+    ,batch(NULL)
+    ,uring(NULL)
+    ,reuse_port(false)
+    ,steer_group(0)
+    ,is_open(false)
+    ,is_closing(false)
+    ,offload(true)
+    ,has_gso(false)
+    ,has_gro(false)
+    ,timestamps(true)
+    ,has_timestamps(false)
+    ,socket_recv_size(0)
+    ,socket_send_size(0)
+    ,recv_pool(NULL)
+    ,recv_reserved(0)
+    ,recv_pending(NULL)
+    ,nrecv_calls(0)
+    ,nrecv_packets(0)
+    ,nsend_calls(0)
+    ,nsend_packets(0)
+    ,nsend_dropped(0)
+    ,nsend_gso(0)
+    ,nrecv_gro(0)
+    ,nrecv_truncated(0)
+    ,nrecv_overflow(0)
+    ,port(0)
+    ,loop(NULL)
      //    ,saddr(NULL)
-    ,user(NULL)
     ,on_data(NULL)
-    ,port(0)
+    ,user(NULL)
   {
 
     loop = uv_default_loop();
@@ -27,6 +461,95 @@ namespace rtc {
 
   }
 
+  /* 
+     The handles of the batched and io_uring backends don't reference us after
+     close(). The libuv socket is part of this object, so it must be closed with
+     close() and the loop must have run the close callback (is_closing is false
+     again) before the connection is destroyed.
+  */
+  ConnectionUDP::~ConnectionUDP() {
+
+    if (batch || uring) {
+      close();
+    }
+
+    if (is_closing) {
+      printf("rtc::ConnectionUDP - error: destroyed before the loop closed the socket; run the loop after close().\n");
+    }
+
+    destroyRecvPool();
+  }
+
+  void ConnectionUDP::close() {
+
+    if (is_open) {
+      uv_udp_recv_stop(&sock);
+      uv_close((uv_handle_t*)&sock, rtc_connection_udp_close_cb);
+      is_open = false;
+      is_closing = true;
+    }
+
+    /* waits for the sends that use our slots; the socket is closed when the kernel cancelled the receive. */
+    if (uring) {
+      uring->close();
+      uring = NULL;
+    }
+
+#if CONNECTION_UDP_HAVE_MMSG
+    if (batch) {
+      flush();
+      /* the slots we couldn't send belong to our pool, which is destroyed with us. */
+      for (uint32_t i = batch->send_head; i < batch->send_tail; ++i) {
+        send_pool.release(batch->send_slots[i]);
+        nsend_dropped++;
+      }
+      batch->send_head = 0;
+      batch->send_tail = 0;
+      batch->releaseBuffers();
+      batch->closeHandles(true);
+      batch = NULL;
+    }
+#endif
+
+    destroyRecvPool();
+  }
+
+  void ConnectionUDP::destroyRecvPool() {
+
+    if (recv_pending) {
+      recv_pending->release();
+      recv_pending = NULL;
+    }
+
+    /* buffers that are retained by consumers keep the pool alive. */
+    if (recv_pool) {
+      recv_pool->unreserve(recv_reserved);
+      recv_pool->releaseShared();
+      recv_pool = NULL;
+      recv_reserved = 0;
+    }
+  }
+
+  void ConnectionUDP::deliver(RecvBuffer* buf) {
+
+    nrecv_packets++;
+
+    if (on_data) {
+      Packet pkt;
+      pkt.remote = &buf->remote;
+      pkt.local = &endpoint;
+      pkt.data = buf->data;
+      pkt.nbytes = buf->nbytes;
+      pkt.arrival = buf->arrival;
+      pkt.timestamp = buf->timestamp;
+      pkt.socket = this;
+      pkt.buffer = buf;
+      on_data(&pkt, user);
+    }
+
+    buf->release();
+  }
+
   bool ConnectionUDP::bind(std::string sip, uint16_t sport) {
 
     int r;
@@ -40,6 +563,45 @@ namespace rtc {
       return false;
     }
 
+    endpoint.set(&raddr);
+
+    if (0 == send_pool.max_slots) {
+      if (0 != send_pool.init(SEND_POOL_DEFAULT_SIZE)) {
+        return false;
+      }
+    }
+
+    if (CONNECTION_UDP_MODE_URING == mode) {
+      if (bindUring()) {
+        return true;
+      }
+      printf("rtc::ConnectionUDP - warning: io_uring is not available, using the batched backend.\n");
+      mode = CONNECTION_UDP_MODE_BATCHED;
+    }
+
+#if !CONNECTION_UDP_HAVE_MMSG
+    if (CONNECTION_UDP_MODE_BATCHED == mode) {
+      printf("rtc::ConnectionUDP - warning: the batched backend is not supported on this platform, using libuv.\n");
+      mode = CONNECTION_UDP_MODE_LIBUV;
+    }
+#endif
+
+    /* the io_uring ring has its own buffers; the other backends share the pool of the loop and add the buffers they keep for their reads. */
+    if (!recv_pool) {
+      recv_pool = RecvPool::acquireShared(loop);
+      if (!recv_pool) {
+        return false;
+      }
+      recv_reserved = (CONNECTION_UDP_MODE_BATCHED == mode) ? CONNECTION_UDP_BATCH_SIZE : 1;
+      recv_pool->reserve(recv_reserved);
+    }
+
+#if CONNECTION_UDP_HAVE_MMSG
+    if (CONNECTION_UDP_MODE_BATCHED == mode) {
+      return bindBatched();
+    }
+#endif
+
     /* initialize the socket */
     r = uv_udp_init(loop, &sock);
     if (r != 0) {
@@ -47,11 +609,33 @@ namespace rtc {
       return false;
     }
 
-    /* bind */
-    r  = uv_udp_bind(&sock, (const struct sockaddr*)&raddr, 0);
-    if (r != 0) {
-      printf("rtc::ConnectionUDP - error: cannot bind the UDP socket in ConnectionUDP: %s\n", uv_strerror(r));
+    is_open = true;
+
+    /* bind; libuv can't set SO_REUSEPORT so we create the socket ourself in that case. */
+    if (reuse_port) {
+#if CONNECTION_UDP_HAVE_MMSG
+      int fd = createSocket();
+      if (fd < 0) {
+        return false;
+      }
+      r = uv_udp_open(&sock, fd);
+      if (r != 0) {
+        printf("rtc::ConnectionUDP - error: cannot open the UDP socket in ConnectionUDP: %s\n", uv_strerror(r));
+        ::close(fd);
+        return false;
+      }
+#else
+      printf("rtc::ConnectionUDP - error: reuse_port is not supported on this platform.\n");
       return false;
+#endif
+    }
+    else {
+      r  = uv_udp_bind(&sock, (const struct sockaddr*)&raddr, 0);
+      if (r != 0) {
+        printf("rtc::ConnectionUDP - error: cannot bind the UDP socket in ConnectionUDP: %s\n", uv_strerror(r));
+        return false;
+      }
+      configureSocket(getSocket());
     }
 
     sock.data = (void*) this;
@@ -130,62 +714,614 @@ namespace rtc {
   }
 #endif
 
-  void ConnectionUDP::sendTo(std::string rip, uint16_t rport, uint8_t* data, uint32_t nbytes) {
-    uv_udp_send_t* req = (uv_udp_send_t*)malloc(sizeof(uv_udp_send_t));
-    if (!req) {
-      printf("rtc::ConnectionUDP - error: cannot allocate a send request in ConnectionUDP.\n");
+  int ConnectionUDP::createSocket() {
+
+#if CONNECTION_UDP_HAVE_MMSG
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      printf("rtc::ConnectionUDP - error: cannot create the UDP socket: %s\n", strerror(errno));
+      return -1;
+    }
+
+    configureSocket(fd);
+
+    if (reuse_port) {
+      int enable = 1;
+      if (0 != setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable))) {
+        printf("rtc::ConnectionUDP - error: cannot set SO_REUSEPORT: %s\n", strerror(errno));
+        ::close(fd);
+        return -1;
+      }
+    }
+
+    if (0 != ::bind(fd, (const struct sockaddr*)&raddr, sizeof(raddr))) {
+      printf("rtc::ConnectionUDP - error: cannot bind the UDP socket on %s:%u: %s\n", ip.c_str(), port, strerror(errno));
+      ::close(fd);
+      return -1;
+    }
+
+    /* 
+       The program returns the index of the socket in the reuseport group; we
+       use the flow hash so all datagrams of a 5-tuple end up on the same socket.
+       The program is shared by the group, so it doesn't matter which socket
+       attaches it last. Without it the kernel uses its own hash of the 4-tuple.
+    */
+    if (reuse_port && steer_group > 0) {
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+      struct sock_filter code[] = {
+        { BPF_LD  | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_RXHASH) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, steer_group },
+        { BPF_RET | BPF_A, 0, 0, 0 }
+      };
+      struct sock_fprog prog;
+      prog.len = sizeof(code) / sizeof(code[0]);
+      prog.filter = code;
+      if (0 != setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog))) {
+        printf("rtc::ConnectionUDP - warning: cannot attach the steering program, using the default distribution: %s\n", strerror(errno));
+      }
+#else
+      printf("rtc::ConnectionUDP - warning: SO_ATTACH_REUSEPORT_CBPF is not supported, using the default distribution.\n");
+#endif
+    }
+
+    return fd;
+#else
+    return -1;
+#endif
+  }
+
+  void ConnectionUDP::configureSocket(int fd) {
+
+    has_timestamps = false;
+
+    if (fd < 0) {
       return;
     }
 
+#if CONNECTION_UDP_HAVE_MMSG
+    int value;
 
-    printf("rtc::ConnectionUDP - verbose: sending the following data (%u bytes) form %s:%u to %s:%u.\n", nbytes, ip.c_str(), port, rip.c_str(), rport);
+    /* the kernel limits SO_RCVBUF to net.core.rmem_max; the FORCE variants ignore that limit but need CAP_NET_ADMIN. */
+    if (socket_recv_size > 0) {
+      value = socket_recv_size;
+      if (0 != setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &value, sizeof(value))
+          && 0 != setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value)))
+        {
+          printf("rtc::ConnectionUDP - warning: cannot set the receive buffer size to %u: %s\n", socket_recv_size, strerror(errno));
+        }
+    }
 
-#if 0
-    printf("-----------------------------------");
+    if (socket_send_size > 0) {
+      value = socket_send_size;
+      if (0 != setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &value, sizeof(value))
+          && 0 != setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value)))
+        {
+          printf("rtc::ConnectionUDP - warning: cannot set the send buffer size to %u: %s\n", socket_send_size, strerror(errno));
+        }
+    }
 
-    int c = 0;
-    for(uint32_t i = 0; i < nbytes; ++i) {
-      if (i == 0 || i % 16 == 0) {
-        printf("\n\t");
-        c++;
+    /* 
+       With SO_TIMESTAMPNS the timestamp is passed as a control message, which
+       libuv doesn't give us; asking the socket for it with an ioctl costs a
+       syscall per datagram, so only the batched and io_uring backends
+       timestamp. The drop counter doesn't need the control messages.
+    */
+    if (timestamps) {
+      value = 1;
+      if (CONNECTION_UDP_MODE_LIBUV != mode) {
+        if (0 != setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &value, sizeof(value))) {
+          printf("rtc::ConnectionUDP - warning: cannot enable the receive timestamps: %s\n", strerror(errno));
+        }
+        else {
+          has_timestamps = true;
+        }
+      }
+      if (0 != setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &value, sizeof(value))) {
+        printf("rtc::ConnectionUDP - warning: cannot enable the drop counter: %s\n", strerror(errno));
+      }
+    }
+#else
+    if (socket_recv_size > 0 || socket_send_size > 0) {
+      uv_handle_t* handle = (uv_handle_t*)&sock;
+      int value = socket_recv_size;
+      if (value > 0 && 0 != uv_recv_buffer_size(handle, &value)) {
+        printf("rtc::ConnectionUDP - warning: cannot set the receive buffer size to %u.\n", socket_recv_size);
+      }
+      value = socket_send_size;
+      if (value > 0 && 0 != uv_send_buffer_size(handle, &value)) {
+        printf("rtc::ConnectionUDP - warning: cannot set the send buffer size to %u.\n", socket_send_size);
+      }
+    }
+#endif
+  }
+
+  int ConnectionUDP::getSocket() {
+
+#if CONNECTION_UDP_HAVE_MMSG
+    if (batch) {
+      return batch->fd;
+    }
+#endif
 
+    if (uring) {
+      return uring->fd;
+    }
+
+    if (is_open) {
+      uv_os_fd_t fd;
+      if (0 == uv_fileno((uv_handle_t*)&sock, &fd)) {
+        return (int)fd;
+      }
+    }
+
+    return -1;
+  }
+
+  uint64_t ConnectionUDP::readControl(struct msghdr* msg) {
+
+    uint64_t timestamp = 0;
+
+#if CONNECTION_UDP_HAVE_MMSG
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); NULL != cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+
+      if (SOL_SOCKET != cmsg->cmsg_level) {
+        continue;
+      }
+
+      if (SO_TIMESTAMPNS == cmsg->cmsg_type) {
+        struct timespec ts;
+        memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        timestamp = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+      }
+      else if (SO_RXQ_OVFL == cmsg->cmsg_type) {
+        /* the number of datagrams the kernel dropped on this socket so far. */
+        uint32_t ndropped = 0;
+        memcpy(&ndropped, CMSG_DATA(cmsg), sizeof(ndropped));
+        nrecv_overflow = ndropped;
       }
-      printf("%02X ", data[i]);
     }
-    printf("\n-----------------------------------\n");
 #endif
 
-    /* @todo check nbytes size in ConnectionUDP::send */
-    /* @todo we def. don't want to allocate everytime when we need to sentin ConnectionUDP. */
+    return timestamp;
+  }
 
-    char* buffer_copy = new char[nbytes];
-    if (!buffer_copy) {
-      printf("rtc::ConnectionUDP - error: cannot allocate a copy for the send buffer in ConnectionUDP.\n");
-      free(req);
-      req = NULL;
+  int ConnectionUDP::getStats(ConnectionUDPStats& result) {
+
+    result.nrecv_calls = nrecv_calls;
+    result.nrecv_packets = nrecv_packets;
+    result.nrecv_gro = nrecv_gro;
+    result.nrecv_truncated = nrecv_truncated;
+    result.nsend_calls = nsend_calls;
+    result.nsend_packets = nsend_packets;
+    result.nsend_dropped = nsend_dropped;
+    result.nsend_gso = nsend_gso;
+    result.nrecv_overflow = nrecv_overflow;
+    result.recv_queue_bytes = 0;
+    result.send_queue_bytes = 0;
+    result.recv_buffer_size = 0;
+    result.send_buffer_size = 0;
+    result.has_timestamps = has_timestamps;
+
+    int fd = getSocket();
+    if (fd < 0) {
+      return -1;
+    }
+
+#if CONNECTION_UDP_HAVE_MMSG && defined(SO_MEMINFO)
+    /* SO_RXQ_OVFL only tells us about drops when we receive something, the meminfo is current. */
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+
+    memset(meminfo, 0x00, sizeof(meminfo));
+
+    if (0 != getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len)) {
+      printf("rtc::ConnectionUDP - error: cannot read the socket state: %s\n", strerror(errno));
+      return -2;
+    }
+
+    result.recv_queue_bytes = meminfo[SK_MEMINFO_RMEM_ALLOC];
+    result.send_queue_bytes = meminfo[SK_MEMINFO_WMEM_ALLOC];
+    result.recv_buffer_size = meminfo[SK_MEMINFO_RCVBUF];
+    result.send_buffer_size = meminfo[SK_MEMINFO_SNDBUF];
+
+    if (len > (socklen_t)(SK_MEMINFO_DROPS * sizeof(uint32_t))) {
+      nrecv_overflow = meminfo[SK_MEMINFO_DROPS];
+      result.nrecv_overflow = nrecv_overflow;
+    }
+
+    return 0;
+#else
+    uv_handle_t* handle = (uv_handle_t*)&sock;
+    int value = 0;
+
+    if (!is_open) {
+      return -2;
+    }
+
+    if (0 == uv_recv_buffer_size(handle, &value)) {
+      result.recv_buffer_size = value;
+    }
+
+    value = 0;
+    if (0 == uv_send_buffer_size(handle, &value)) {
+      result.send_buffer_size = value;
+    }
+
+    return 0;
+#endif
+  }
+
+  bool ConnectionUDP::bindBatched() {
+
+#if CONNECTION_UDP_HAVE_MMSG
+    int r;
+    int fd = createSocket();
+    if (fd < 0) {
+      return false;
+    }
+
+    /* the kernel only knows the options when it supports the offloads. */
+    has_gso = false;
+    has_gro = false;
+
+    if (offload) {
+      int value = 0;
+      if (0 == setsockopt(fd, SOL_UDP, UDP_SEGMENT, &value, sizeof(value))) {
+        has_gso = true;
+      }
+      value = 1;
+      if (0 == setsockopt(fd, SOL_UDP, UDP_GRO, &value, sizeof(value))) {
+        has_gro = true;
+      }
+    }
+
+    batch = new ConnectionUDPBatch(this);
+    batch->fd = fd;
+    batch->gso = has_gso;
+
+    if (!batch->init(has_gro)) {
+      ::close(fd);
+      delete batch;
+      batch = NULL;
+      return false;
+    }
+
+    r = uv_poll_init_socket(loop, &batch->poll, fd);
+    if (r != 0) {
+      printf("rtc::ConnectionUDP - error: cannot initialize the poll handle: %s\n", uv_strerror(r));
+      ::close(fd);
+      delete batch;
+      batch = NULL;
+      return false;
+    }
+
+    /* from here on the loop owns the handles; the close callback closes the socket and deletes the batch. */
+    batch->poll.data = batch;
+
+    r = uv_check_init(loop, &batch->check);
+    if (r != 0) {
+      printf("rtc::ConnectionUDP - error: cannot initialize the check handle: %s\n", uv_strerror(r));
+      batch->closeHandles(false);
+      batch = NULL;
+      return false;
+    }
+
+    batch->check.data = batch;
+    batch->events = UV_READABLE;
+
+    r = uv_poll_start(&batch->poll, batch->events, rtc_connection_udp_poll_cb);
+    if (r != 0) {
+      printf("rtc::ConnectionUDP - error: cannot start polling: %s\n", uv_strerror(r));
+      batch->closeHandles(true);
+      batch = NULL;
+      return false;
+    }
+
+    /* the check handle runs after the poll phase of every loop iteration; that's where we flush the send queue. */
+    r = uv_check_start(&batch->check, rtc_connection_udp_check_cb);
+    if (r != 0) {
+      printf("rtc::ConnectionUDP - error: cannot start the check handle: %s\n", uv_strerror(r));
+      batch->closeHandles(true);
+      batch = NULL;
+      return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  bool ConnectionUDP::bindUring() {
+
+    UringRing* ring = UringRing::acquire(loop);
+    if (!ring) {
+      return false;
+    }
+
+    int fd = createSocket();
+    if (fd < 0) {
+      ring->release();
+      return false;
+    }
+
+    /* the socket owns our reference to the ring. */
+    uring = new UringSocket(ring, this, fd);
+
+    if (!uring->arm()) {
+      uring->close();
+      uring = NULL;
+      return false;
+    }
+
+    return true;
+  }
+
+  void ConnectionUDP::flush() {
+
+    if (uring) {
+      uring->ring->submit();
       return;
     }
 
-    memcpy(buffer_copy, data, nbytes);
-    uv_buf_t buf = uv_buf_init(buffer_copy, nbytes);
-    
-    req->data = buffer_copy;
+#if CONNECTION_UDP_HAVE_MMSG
+    if (!batch) {
+      return;
+    }
 
-    struct sockaddr_in send_addr;
-    uv_ip4_addr(rip.c_str(), rport, &send_addr);
-    int r = uv_udp_send(req, 
-                        &sock, 
-                        &buf, 
-                        1, 
-                        (const struct sockaddr*)&send_addr, 
-                        rtc_connection_udp_send_cb);
+    while (batch->send_head < batch->send_tail) {
+
+      uint32_t nmsgs = batch->prepareSend();
+      int r = sendmmsg(batch->fd, batch->send_msgs, nmsgs, MSG_DONTWAIT);
+
+      nsend_calls++;
+
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          /* we continue when the socket is writable again. */
+          batch->setWritable(true);
+          return;
+        }
+        /* e.g. a device without checksum offload returns EIO for GSO; we send the packets one by one from now on. */
+        if (batch->send_nslots[0] > 1 && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)) {
+          printf("rtc::ConnectionUDP - warning: GSO send failed, disabling it: %s\n", strerror(errno));
+          batch->gso = false;
+          has_gso = false;
+          continue;
+        }
+        /* e.g. an unreachable destination for the first message; skip it and continue with the others. */
+        printf("rtc::ConnectionUDP - error: sendmmsg() failed: %s\n", strerror(errno));
+        for (uint32_t i = 0; i < batch->send_nslots[0]; ++i) {
+          send_pool.release(batch->send_slots[batch->send_head + i]);
+        }
+        batch->send_head += batch->send_nslots[0];
+        nsend_dropped += batch->send_nslots[0];
+        continue;
+      }
+
+      for (int i = 0; i < r; ++i) {
+        uint32_t nslots = batch->send_nslots[i];
+        for (uint32_t k = 0; k < nslots; ++k) {
+          send_pool.release(batch->send_slots[batch->send_head + k]);
+        }
+        batch->send_head += nslots;
+        nsend_packets += nslots;
+        if (nslots > 1) {
+          nsend_gso++;
+        }
+      }
+    }
+
+    batch->send_head = 0;
+    batch->send_tail = 0;
+    batch->setWritable(false);
+#endif
+  }
+
+  void ConnectionUDP::sendToQueued(const Endpoint& dest, uint8_t* data, uint32_t nbytes) {
+
+#if CONNECTION_UDP_HAVE_MMSG
+    /* datagrams that don't fit in a slot are sent directly, after the queue so we keep the order. */
+    if (nbytes > SEND_SLOT_SIZE) {
+      int fd = (batch) ? batch->fd : uring->fd;
+      if (uring) {
+        /* we can't wait for the submitted sends, so the order isn't guaranteed here. */
+        uring->ring->submit();
+      }
+      else {
+        flush();
+      }
+      nsend_calls++;
+      if (sendto(fd, data, nbytes, MSG_DONTWAIT, (const struct sockaddr*)&dest.addr, sizeof(dest.addr)) < 0) {
+        printf("rtc::ConnectionUDP - error: sendto() failed: %s\n", strerror(errno));
+        nsend_dropped++;
+        return;
+      }
+      nsend_packets++;
+      return;
+    }
+
+    SendSlot* slot = send_pool.acquire();
+    if (!slot) {
+      /* all slots are queued; try to send them. */
+      flush();
+      slot = send_pool.acquire();
+      if (!slot) {
+        nsend_dropped++;
+        return;
+      }
+    }
+
+    memcpy(slot->data, data, nbytes);
+    slot->nbytes = nbytes;
+    slot->addr = dest.addr;
+
+    submitSlot(slot);
+#endif
+  }
+
+  SendSlot* ConnectionUDP::acquireSlot() {
+    return send_pool.acquire();
+  }
+
+  bool ConnectionUDP::submit(SendSlot* slot, const Endpoint& dest) {
+
+    if (!slot || slot->pool != &send_pool || !slot->is_used) {
+      printf("rtc::ConnectionUDP - error: cannot submit an invalid slot.\n");
+      return false;
+    }
+
+    if (0 == slot->nbytes || slot->nbytes > SEND_SLOT_SIZE) {
+      printf("rtc::ConnectionUDP - error: cannot submit a slot with %u bytes.\n", slot->nbytes);
+      send_pool.release(slot);
+      nsend_dropped++;
+      return false;
+    }
+
+    slot->addr = dest.addr;
+
+    return submitSlot(slot);
+  }
+
+  bool ConnectionUDP::submitSlot(SendSlot* slot) {
+
+    if (uring) {
+      if (!uring->send(slot)) {
+        send_pool.release(slot);
+        nsend_dropped++;
+        return false;
+      }
+      return true;
+    }
+
+#if CONNECTION_UDP_HAVE_MMSG
+    if (batch) {
+
+      if (batch->send_tail >= CONNECTION_UDP_BATCH_SIZE) {
+        flush();
+        if (batch->send_tail >= CONNECTION_UDP_BATCH_SIZE) {
+          send_pool.release(slot);
+          nsend_dropped++;
+          return false;
+        }
+      }
+
+      uint32_t dx = batch->send_tail;
+      batch->send_slots[dx] = slot;
+      batch->send_iovs[dx].iov_base = slot->data;
+      batch->send_iovs[dx].iov_len = slot->nbytes;
+      batch->send_tail++;
+
+      if (batch->send_tail >= CONNECTION_UDP_BATCH_SIZE) {
+        flush();
+      }
+
+      return true;
+    }
+#endif
+
+    uv_buf_t buf = uv_buf_init((char*)slot->data, slot->nbytes);
+
+    /* try to send immediately; the slot can be reused right away then. */
+    int r = uv_udp_try_send(&sock, &buf, 1, (const struct sockaddr*)&slot->addr);
+    nsend_calls++;
+    if (r >= 0) {
+      nsend_packets++;
+      send_pool.release(slot);
+      return true;
+    }
+
+    if (r == UV_EAGAIN || r == UV_ENOSYS) {
+      r = uv_udp_send(&slot->req,
+                      &sock,
+                      &buf,
+                      1,
+                      (const struct sockaddr*)&slot->addr,
+                      rtc_connection_udp_send_cb);
+      nsend_calls++;
+      if (r == 0) {
+        return true;
+      }
+    }
+
+    printf("rtc:::ConnectionUDP - error: cannot send udp data in ConnectionUDP: %s.\n", uv_strerror(r));
+    send_pool.release(slot);
+    nsend_dropped++;
+
+    return false;
+  }
+
+  void ConnectionUDP::sendTo(std::string rip, uint16_t rport, uint8_t* data, uint32_t nbytes) {
+
+    Endpoint dest;
+    if (!dest.set(rip, rport)) {
+      printf("rtc::ConnectionUDP - error: invalid destination: %s:%u\n", rip.c_str(), rport);
+      return;
+    }
+
+    sendTo(dest, data, nbytes);
+  }
+
+  void ConnectionUDP::sendTo(const Endpoint& dest, uint8_t* data, uint32_t nbytes) {
+
+    if (batch || uring) {
+      sendToQueued(dest, data, nbytes);
+      return;
+    }
+
+    /* 
+       First try to send directly from the given buffer; when the socket is writable
+       (which is almost always the case for UDP) the kernel copies the data and we don't
+       need a send slot. Only when the send would block (or the queue is not empty) we
+       fall back to an async send which needs its own copy.
+    */
+    uv_buf_t direct_buf = uv_buf_init((char*)data, nbytes);
+    int r = uv_udp_try_send(&sock, &direct_buf, 1, (const struct sockaddr*)&dest.addr);
+    nsend_calls++;
+    if (r >= 0) {
+      nsend_packets++;
+      return;
+    }
+    if (r != UV_EAGAIN && r != UV_ENOSYS) {
+      printf("rtc:::ConnectionUDP - error: cannot send udp data in ConnectionUDP: %s.\n", uv_strerror(r));
+      return;
+    }
+
+    /* the send would block; copy the data into a slot which is released when the send completes. */
+    if (nbytes > SEND_SLOT_SIZE) {
+      printf("rtc::ConnectionUDP - error: cannot queue a datagram of %u bytes, the max is %d.\n", nbytes, SEND_SLOT_SIZE);
+      nsend_dropped++;
+      return;
+    }
+
+    SendSlot* slot = send_pool.acquire();
+    if (!slot) {
+      nsend_dropped++;
+      return;
+    }
+
+    memcpy(slot->data, data, nbytes);
+    slot->nbytes = nbytes;
+    slot->addr = dest.addr;
+
+    uv_buf_t buf = uv_buf_init((char*)slot->data, slot->nbytes);
+
+    r = uv_udp_send(&slot->req, 
+                    &sock, 
+                    &buf, 
+                    1, 
+                    (const struct sockaddr*)&slot->addr, 
+                    rtc_connection_udp_send_cb);
+
+    nsend_calls++;
 
     if (r != 0) {
       printf("rtc:::ConnectionUDP - error: cannot send udp data in ConnectionUDP: %s.\n", uv_strerror(r));
-      free(req);
-      free(buffer_copy);
-      req = NULL;
-      buffer_copy = NULL;
+      send_pool.release(slot);
+      nsend_dropped++;
     }
   }
 
@@ -197,58 +1333,129 @@ namespace rtc {
 
 /* ----------------------------------------------------------------- */
 
-static void rtc_connection_udp_recv_cb(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned int flags) {
+static void rtc_connection_udp_recv_cb(uv_udp_t* handle, ssize_t nread, const uv_buf_t*, const struct sockaddr* addr, unsigned int flags) {
 
-  /* do nothing when we receive 0 as nread. */
+  /* do nothing when we receive 0 as nread; the pending buffer is used for the next read. */
   if (nread == 0) {
     printf("rtc::ConnectionUDP - verbose: received 0 bytes, flags: %d.\n", flags);
     return;
   }
 
   rtc::ConnectionUDP* udp = static_cast<rtc::ConnectionUDP*>(handle->data);
-  /*
-  if (!udp->saddr) {
-    udp->saddr = (struct sockaddr*)malloc(sizeof(struct sockaddr));
-    if (!udp->saddr) {
-      printf("rtc::ConnectionUDP - error: cannot allocate the `struct sockaddr*` in ConnectionUDP. Out of mem?\n");
-      exit(1);
-    }
-    memcpy(udp->saddr, addr, sizeof(struct sockaddr));
+  udp->nrecv_calls++;
+
+  if (nread < 0) {
+    printf("rtc::ConnectionUDP - error: failed to receive: %s\n", uv_strerror(nread));
+    return;
   }
-  */
 
-  if (addr) {
-    char src_ip[20];
-    uint16_t port;
-    const struct sockaddr_in* src_addr = (const struct sockaddr_in*)addr;
-    uv_ip4_name(src_addr, src_ip, sizeof(src_ip));
-    port = ntohs(src_addr->sin_port);
-    printf("rtc::ConnectionUDP - verbose: received from: %s:%d, number of bytes: %ld\n", src_ip, port, nread);
-    if (udp->on_data) {
-      udp->on_data(src_ip, port, udp->ip, udp->port, (uint8_t*)buf->base, nread, udp->user);
-    }
+  /* libuv reads into one buffer, so we can't use the jumbo fallback; see the batched backend. */
+  if (flags & UV_UDP_PARTIAL) {
+    printf("rtc::ConnectionUDP - warning: dropping a truncated datagram.\n");
+    udp->nrecv_truncated++;
+    return;
   }
+
+  if (!addr || AF_INET != addr->sa_family || !udp->recv_pending) {
+    return;
+  }
+
+  rtc::RecvBuffer* recv_buf = udp->recv_pending;
+  udp->recv_pending = NULL;
+
+  recv_buf->data = recv_buf->base;
+  recv_buf->nbytes = nread;
+  recv_buf->arrival = uv_hrtime();
+  recv_buf->socket = udp;
+  recv_buf->remote.set((const struct sockaddr_in*)addr);
+
+  udp->deliver(recv_buf);
 }
 
-static void rtc_connection_udp_alloc_cb(uv_handle_t* handle, size_t nsize,  uv_buf_t* buf) {
-  static char slab[65536];
- 
-  if (nsize > sizeof(slab)) {
-    printf("rtc::ConnectionUDP - error: requested receiver size to large. @todo - this is just a quick implementation.\n");
-    exit(1);
+/* every read gets a buffer of the pool (or a heap buffer when they're all retained), so on_data can keep it. */
+static void rtc_connection_udp_alloc_cb(uv_handle_t* handle, size_t, uv_buf_t* buf) {
+
+  rtc::ConnectionUDP* udp = static_cast<rtc::ConnectionUDP*>(handle->data);
+
+  if (!udp->recv_pending) {
+    udp->recv_pending = udp->recv_pool->acquire();
+    if (!udp->recv_pending) {
+      udp->recv_pending = udp->recv_pool->acquireJumbo(RECV_BUFFER_SIZE);
+    }
   }
-  
-  buf->base = slab;
-  buf->len = sizeof(slab);
+
+  buf->base = (char*)udp->recv_pending->base;
+  buf->len = udp->recv_pending->capacity;
 }
 
 static void rtc_connection_udp_send_cb(uv_udp_send_t* req, int status) {
-  printf("rtc::ConnectionUDP - ready sending some data, status: %d\n", status);
-
-  /* @todo rtc_connection_udp_send_cb needs to handle the status value.*/
-  char* ptr = (char*)req->data;
-  delete[] ptr;
-  delete req;
-  req = NULL;
-  ptr = NULL;
+
+  rtc::SendSlot* slot = static_cast<rtc::SendSlot*>(req->data);
+  rtc::ConnectionUDP* udp = static_cast<rtc::ConnectionUDP*>(req->handle->data);
+
+  if (status < 0) {
+    printf("rtc::ConnectionUDP - error: failed to send a datagram: %s\n", uv_strerror(status));
+    udp->nsend_dropped++;
+  }
+  else {
+    udp->nsend_packets++;
+  }
+
+  slot->pool->release(slot);
 }
+
+static void rtc_connection_udp_close_cb(uv_handle_t* handle) {
+  rtc::ConnectionUDP* udp = static_cast<rtc::ConnectionUDP*>(handle->data);
+  udp->is_closing = false;
+}
+
+#if CONNECTION_UDP_HAVE_MMSG
+
+static void rtc_connection_udp_poll_cb(uv_poll_t* handle, int status, int events) {
+
+  rtc::ConnectionUDPBatch* batch = static_cast<rtc::ConnectionUDPBatch*>(handle->data);
+  if (!batch->conn) {
+    return;
+  }
+
+  if (status < 0) {
+    printf("rtc::ConnectionUDP - error: poll error: %s\n", uv_strerror(status));
+    return;
+  }
+
+  if (events & UV_WRITABLE) {
+    batch->conn->flush();
+  }
+
+  if (events & UV_READABLE) {
+    batch->receive();
+  }
+}
+
+static void rtc_connection_udp_check_cb(uv_check_t* handle) {
+
+  rtc::ConnectionUDPBatch* batch = static_cast<rtc::ConnectionUDPBatch*>(handle->data);
+
+  if (batch->conn && batch->send_tail > batch->send_head) {
+    batch->conn->flush();
+  }
+}
+
+static void rtc_connection_udp_batch_close_cb(uv_handle_t* handle) {
+
+  rtc::ConnectionUDPBatch* batch = static_cast<rtc::ConnectionUDPBatch*>(handle->data);
+
+  batch->nclosing--;
+  if (batch->nclosing > 0) {
+    return;
+  }
+
+  if (batch->fd >= 0) {
+    ::close(batch->fd);
+    batch->fd = -1;
+  }
+
+  delete batch;
+}
+
+#endif
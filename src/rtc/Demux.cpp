@@ -0,0 +1,57 @@
+#include <string.h>
+#include <rtc/Demux.h>
+
+#define U rtc::PACKET_CLASS_UNKNOWN
+#define S rtc::PACKET_CLASS_STUN
+#define D rtc::PACKET_CLASS_DTLS
+#define R rtc::PACKET_CLASS_RTP
+
+namespace rtc {
+
+  /* see http://tools.ietf.org/html/rfc7983#section-7 */
+  const uint8_t packet_class_table[256] = {
+    S, S, S, S, U, U, U, U, U, U, U, U, U, U, U, U, /*   0 -  15 */
+    U, U, U, U, D, D, D, D, D, D, D, D, D, D, D, D, /*  16 -  31 */
+    D, D, D, D, D, D, D, D, D, D, D, D, D, D, D, D, /*  32 -  47 */
+    D, D, D, D, D, D, D, D, D, D, D, D, D, D, D, D, /*  48 -  63 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /*  64 -  79 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /*  80 -  95 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /*  96 - 111 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 112 - 127 */
+    R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, /* 128 - 143 */
+    R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, /* 144 - 159 */
+    R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, /* 160 - 175 */
+    R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, R, /* 176 - 191 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 192 - 207 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 208 - 223 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 224 - 239 */
+    U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U  /* 240 - 255 */
+  };
+
+  const char* packet_class_to_string(int cls) {
+    switch (cls) {
+      case PACKET_CLASS_STUN: { return "STUN"; }
+      case PACKET_CLASS_DTLS: { return "DTLS"; }
+      case PACKET_CLASS_RTP:  { return "RTP";  }
+      case PACKET_CLASS_RTCP: { return "RTCP"; }
+      default: { return "UNKNOWN"; }
+    }
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  PacketCounters::PacketCounters() {
+    reset();
+  }
+
+  void PacketCounters::reset() {
+    memset(npackets, 0x00, sizeof(npackets));
+    memset(nbytes, 0x00, sizeof(nbytes));
+  }
+
+} /* namespace rtc */
+
+#undef U
+#undef S
+#undef D
+#undef R
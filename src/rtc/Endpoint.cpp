@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <string.h>
+#include <rtc/Endpoint.h>
+
+namespace rtc {
+
+  Endpoint::Endpoint()
+    :hash(0)
+  {
+    memset(&addr, 0x00, sizeof(addr));
+    addr.sin_family = AF_INET;
+  }
+
+  bool Endpoint::set(const std::string& ip, uint16_t port) {
+
+    struct sockaddr_in parsed;
+
+    if (0 != uv_ip4_addr(ip.c_str(), port, &parsed)) {
+      printf("rtc::Endpoint - error: invalid ip: %s\n", ip.c_str());
+      return false;
+    }
+
+    set(&parsed);
+
+    return true;
+  }
+
+  std::string Endpoint::getIP() const {
+    char ip[20];
+    if (0 != uv_ip4_name(&addr, ip, sizeof(ip))) {
+      return "";
+    }
+    return ip;
+  }
+
+} /* namespace rtc */
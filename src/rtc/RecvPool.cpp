@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <rtc/RecvPool.h>
+
+namespace rtc {
+
+  static uv_once_t shared_pools_once = UV_ONCE_INIT;
+  static uv_mutex_t shared_pools_mutex;
+  static std::map<uv_loop_t*, RecvPool*> shared_pools;                /* the shared pool of each loop */
+
+  static void rtc_recv_pool_init_shared() {
+    uv_mutex_init(&shared_pools_mutex);
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  RecvBuffer::RecvBuffer()
+    :base(NULL)
+    ,capacity(0)
+    ,data(NULL)
+    ,nbytes(0)
+    ,arrival(0)
+    ,timestamp(0)
+    ,socket(NULL)
+    ,refcount(0)
+    ,index(0)
+    ,is_jumbo(false)
+    ,pool(NULL)
+    ,next(NULL)
+  {
+  }
+
+  void RecvBuffer::retain() {
+    refcount++;
+  }
+
+  void RecvBuffer::release() {
+
+    if (refcount <= 0) {
+      printf("rtc::RecvBuffer - error: releasing a buffer without references.\n");
+      return;
+    }
+
+    refcount--;
+    if (0 == refcount) {
+      pool->release(this);
+    }
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  RecvPool::RecvPool()
+    :size(0)
+    ,on_release(NULL)
+    ,release_user(NULL)
+    ,nbuffers(0)
+    ,max_buffers(0)
+    ,nused(0)
+    ,high_water(0)
+    ,nexhausted(0)
+    ,njumbo(0)
+    ,free_list(NULL)
+    ,njumbo_used(0)
+    ,shared_loop(NULL)
+    ,nshared(0)
+    ,is_destroyed(false)
+  {
+  }
+
+  RecvPool::~RecvPool() {
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      delete[] chunks[i][0].base;
+      delete[] chunks[i];
+    }
+
+    chunks.clear();
+    free_list = NULL;
+    nbuffers = 0;
+  }
+
+  RecvPool* RecvPool::acquireShared(uv_loop_t* loop) {
+
+    RecvPool* pool = NULL;
+
+    if (!loop) {
+      printf("rtc::RecvPool - error: cannot share a pool without a loop.\n");
+      return NULL;
+    }
+
+    uv_once(&shared_pools_once, rtc_recv_pool_init_shared);
+    uv_mutex_lock(&shared_pools_mutex);
+    {
+      std::map<uv_loop_t*, RecvPool*>::iterator it = shared_pools.find(loop);
+      if (it != shared_pools.end()) {
+        pool = it->second;
+      }
+      else {
+        pool = new RecvPool();
+        pool->init(RECV_POOL_DEFAULT_SIZE, RECV_BUFFER_SIZE);
+        pool->shared_loop = loop;
+        shared_pools[loop] = pool;
+      }
+
+      pool->nshared++;
+    }
+    uv_mutex_unlock(&shared_pools_mutex);
+
+    return pool;
+  }
+
+  void RecvPool::releaseShared() {
+
+    bool is_last = false;
+
+    if (!shared_loop) {
+      printf("rtc::RecvPool - error: releasing a pool that isn't shared.\n");
+      return;
+    }
+
+    uv_mutex_lock(&shared_pools_mutex);
+    {
+      nshared--;
+      if (0 == nshared) {
+        shared_pools.erase(shared_loop);
+        is_last = true;
+      }
+    }
+    uv_mutex_unlock(&shared_pools_mutex);
+
+    if (is_last) {
+      destroy();
+    }
+  }
+
+  int RecvPool::init(uint32_t count, uint32_t bufferSize) {
+
+    if (0 != max_buffers) {
+      printf("rtc::RecvPool - error: already initialized.\n");
+      return -1;
+    }
+
+    if (0 == count || 0 == bufferSize) {
+      printf("rtc::RecvPool - error: invalid number or size of buffers.\n");
+      return -2;
+    }
+
+    max_buffers = count;
+    size = bufferSize;
+
+    return 0;
+  }
+
+  void RecvPool::reserve(uint32_t count) {
+    max_buffers += count;
+  }
+
+  void RecvPool::unreserve(uint32_t count) {
+    max_buffers = (count < max_buffers) ? (max_buffers - count) : 0;
+  }
+
+  RecvBuffer* RecvPool::acquire() {
+
+    RecvBuffer* buf = free_list;
+    if (!buf) {
+      if (!grow()) {
+        nexhausted++;
+        return NULL;
+      }
+      buf = free_list;
+    }
+
+    free_list = buf->next;
+    buf->next = NULL;
+    buf->data = buf->base;
+    buf->nbytes = 0;
+    buf->timestamp = 0;
+    buf->socket = NULL;
+    buf->refcount = 1;
+
+    nused++;
+    if (nused > high_water) {
+      high_water = nused;
+    }
+
+    return buf;
+  }
+
+  RecvBuffer* RecvPool::acquireJumbo(uint32_t nbytes) {
+
+    RecvBuffer* buf = new RecvBuffer();
+    buf->base = new uint8_t[nbytes];
+    buf->capacity = nbytes;
+    buf->data = buf->base;
+    buf->is_jumbo = true;
+    buf->pool = this;
+    buf->refcount = 1;
+
+    njumbo++;
+    njumbo_used++;
+    nused++;
+    if (nused > high_water) {
+      high_water = nused;
+    }
+
+    return buf;
+  }
+
+  RecvBuffer* RecvPool::at(uint32_t index) {
+
+    if (index >= nbuffers) {
+      return NULL;
+    }
+
+    return &chunks[index / RECV_POOL_CHUNK_SIZE][index % RECV_POOL_CHUNK_SIZE];
+  }
+
+  void RecvPool::release(RecvBuffer* buf) {
+
+    if (!buf || buf->pool != this) {
+      printf("rtc::RecvPool - error: trying to release an invalid buffer.\n");
+      return;
+    }
+
+    buf->socket = NULL;
+
+    if (buf->is_jumbo) {
+      delete[] buf->base;
+      delete buf;
+      njumbo_used--;
+      nused--;
+    }
+    else if (on_release) {
+      /* the owner decides what happens with the buffer; it stays used. */
+      on_release(this, buf, release_user);
+      return;
+    }
+    else {
+      buf->next = free_list;
+      free_list = buf;
+      nused--;
+    }
+
+    if (is_destroyed && 0 == nused) {
+      delete this;
+    }
+  }
+
+  void RecvPool::destroy() {
+
+    is_destroyed = true;
+    on_release = NULL;
+
+    /* buffers that were handed to the owner (see on_release) aren't used by anyone anymore. */
+    nused = njumbo_used;
+    for (uint32_t i = 0; i < nbuffers; ++i) {
+      if (at(i)->refcount > 0) {
+        nused++;
+      }
+    }
+
+    if (0 == nused) {
+      delete this;
+    }
+  }
+
+  bool RecvPool::grow() {
+
+    if (nbuffers >= max_buffers) {
+      return false;
+    }
+
+    RecvBuffer* chunk = new RecvBuffer[RECV_POOL_CHUNK_SIZE];
+    uint8_t* storage = new uint8_t[RECV_POOL_CHUNK_SIZE * size];
+
+    chunks.push_back(chunk);
+
+    for (uint32_t i = RECV_POOL_CHUNK_SIZE; i > 0; --i) {
+      RecvBuffer* buf = &chunk[i - 1];
+      buf->base = storage + ((i - 1) * size);
+      buf->capacity = size;
+      buf->index = nbuffers + (i - 1);
+      buf->pool = this;
+      buf->next = free_list;
+      free_list = buf;
+    }
+
+    nbuffers += RECV_POOL_CHUNK_SIZE;
+
+    return true;
+  }
+
+} /* namespace rtc */
@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <algorithm>
+#include <rtc/Runtime.h>
+
+/* ----------------------------------------------------------------- */
+
+static void rtc_runtime_thread(void* user);
+static void rtc_runtime_wakeup_cb(uv_async_t* handle);
+static void rtc_runtime_ticker_cb(uv_timer_t* handle);
+static void rtc_runtime_prepare_cb(uv_prepare_t* handle);
+static void rtc_runtime_close_cb(uv_handle_t* handle);
+static void rtc_runtime_run_task(rtc::Task* task, void* user);
+
+/* ----------------------------------------------------------------- */
+
+namespace rtc {
+
+  class RuntimeTask : public Task {
+  public:
+    Runtime* runtime;
+    runtime_callback cb;
+    void* cb_user;
+  };
+
+  /* --------------------------------------------------------------------- */
+
+  Runtime::Runtime()
+    :loop(NULL)
+    ,on_stop(NULL)
+    ,user(NULL)
+    ,nclosing(0)
+    ,is_stopping(false)
+    ,nwakeups(0)
+    ,ntasks(0)
+    ,nticks(0)
+    ,is_initialized(false)
+    ,is_started(false)
+    ,is_running(false)
+    ,is_ticking(false)
+    ,is_shutdown(false)
+    ,owns_loop(false)
+  {
+  }
+
+  Runtime::~Runtime() {
+
+    stop();
+
+    /* tasks that were posted after we stopped never ran. */
+    Task* task = NULL;
+    while (NULL != (task = tasks.pop())) {
+      delete task;
+    }
+
+    if (owns_loop) {
+      int r = uv_loop_close(&own_loop);
+      if (0 != r) {
+        printf("rtc::Runtime - error: cannot close the loop, not all handles are closed: %s\n", uv_strerror(r));
+      }
+      owns_loop = false;
+    }
+
+    loop = NULL;
+  }
+
+  int Runtime::init() {
+
+    if (is_initialized) {
+      printf("rtc::Runtime - error: already initialized.\n");
+      return -1;
+    }
+
+    int r = uv_loop_init(&own_loop);
+    if (0 != r) {
+      printf("rtc::Runtime - error: cannot initialize the loop: %s\n", uv_strerror(r));
+      return -2;
+    }
+
+    owns_loop = true;
+
+    r = init(&own_loop);
+    if (0 != r) {
+      uv_loop_close(&own_loop);
+      owns_loop = false;
+      return r;
+    }
+
+    return 0;
+  }
+
+  int Runtime::init(uv_loop_t* l) {
+
+    int r = 0;
+
+    if (is_initialized) {
+      printf("rtc::Runtime - error: already initialized.\n");
+      return -1;
+    }
+
+    if (!l) {
+      printf("rtc::Runtime - error: cannot initialize without a loop.\n");
+      return -2;
+    }
+
+    loop = l;
+
+    r = uv_async_init(loop, &wakeup, rtc_runtime_wakeup_cb);
+    if (0 != r) {
+      printf("rtc::Runtime - error: cannot initialize the wakeup handle: %s\n", uv_strerror(r));
+      return -3;
+    }
+
+    uv_timer_init(loop, &ticker);
+    uv_prepare_init(loop, &prepare);
+
+    wakeup.data = this;
+    ticker.data = this;
+    prepare.data = this;
+
+    /* the wakeup handle keeps the loop alive until we stop, the prepare handle shouldn't. */
+    uv_prepare_start(&prepare, rtc_runtime_prepare_cb);
+    uv_unref((uv_handle_t*)&prepare);
+
+    timers.init(uv_hrtime() / 1000000ull);
+    wheels.push_back(&timers);
+
+    is_initialized = true;
+
+    return 0;
+  }
+
+  int Runtime::run() {
+
+    if (!is_initialized) {
+      printf("rtc::Runtime - error: cannot run, not initialized.\n");
+      return -1;
+    }
+
+    if (is_running) {
+      printf("rtc::Runtime - error: already running.\n");
+      return -2;
+    }
+
+    is_running = true;
+
+    /* blocks until shutdown() stops the loop */
+    uv_run(loop, UV_RUN_DEFAULT);
+
+    /* finish closing our handles, and the ones that were closed in on_stop when the loop is ours. */
+    if (owns_loop) {
+      uv_run(loop, UV_RUN_DEFAULT);
+    }
+    else {
+      while (nclosing > 0) {
+        uv_run(loop, UV_RUN_NOWAIT);
+      }
+    }
+
+    is_running = false;
+
+    return 0;
+  }
+
+  int Runtime::start() {
+
+    if (!is_initialized) {
+      printf("rtc::Runtime - error: cannot start, not initialized.\n");
+      return -1;
+    }
+
+    if (is_started || is_running) {
+      printf("rtc::Runtime - error: already running.\n");
+      return -2;
+    }
+
+    int r = uv_thread_create(&thread, rtc_runtime_thread, this);
+    if (0 != r) {
+      printf("rtc::Runtime - error: cannot create the thread: %s\n", uv_strerror(r));
+      return -3;
+    }
+
+    is_started = true;
+
+    return 0;
+  }
+
+  void Runtime::stop() {
+
+    if (!is_initialized || is_shutdown) {
+      return;
+    }
+
+    is_stopping.store(true);
+    uv_async_send(&wakeup);
+
+    if (is_started) {
+      uv_thread_join(&thread);
+      is_started = false;
+      return;
+    }
+
+    /* run() returns on its own thread. */
+    if (is_running) {
+      return;
+    }
+
+    /* nobody runs the loop, so we run it until we're shut down. */
+    run();
+  }
+
+  void Runtime::poll() {
+    uv_run(loop, UV_RUN_NOWAIT);
+  }
+
+  void Runtime::post(Task* task) {
+
+    if (!task) {
+      printf("rtc::Runtime - error: cannot post an invalid task.\n");
+      return;
+    }
+
+    tasks.push(task);
+
+    if (false == is_stopping.load()) {
+      uv_async_send(&wakeup);
+    }
+  }
+
+  int Runtime::post(runtime_callback cb, void* cbUser) {
+
+    if (!cb) {
+      printf("rtc::Runtime - error: cannot post a task without a callback.\n");
+      return -1;
+    }
+
+    RuntimeTask* task = new RuntimeTask();
+    task->run = rtc_runtime_run_task;
+    task->user = this;
+    task->runtime = this;
+    task->cb = cb;
+    task->cb_user = cbUser;
+
+    post(task);
+
+    return 0;
+  }
+
+  void Runtime::addTimers(TimerWheel* wheel) {
+
+    if (!wheel) {
+      printf("rtc::Runtime - error: cannot add an invalid timer wheel.\n");
+      return;
+    }
+
+    if (std::find(wheels.begin(), wheels.end(), wheel) == wheels.end()) {
+      wheels.push_back(wheel);
+    }
+  }
+
+  void Runtime::removeTimers(TimerWheel* wheel) {
+
+    std::vector<TimerWheel*>::iterator it = std::find(wheels.begin(), wheels.end(), wheel);
+    if (it != wheels.end()) {
+      wheels.erase(it);
+    }
+  }
+
+  void Runtime::processTasks() {
+
+    Task* task = NULL;
+
+    while (NULL != (task = tasks.pop())) {
+      ntasks++;
+      task->run(task, task->user);
+    }
+  }
+
+  void Runtime::updateTimers() {
+
+    uint64_t now = uv_hrtime() / 1000000ull;
+
+    /* a timer callback may remove a wheel. */
+    for (size_t i = 0; i < wheels.size(); ++i) {
+      wheels[i]->update(now);
+    }
+  }
+
+  void Runtime::updateTicker() {
+
+    uint32_t interval = 0;
+
+    for (size_t i = 0; i < wheels.size(); ++i) {
+      if (wheels[i]->nactive > 0 && (0 == interval || wheels[i]->resolution < interval)) {
+        interval = wheels[i]->resolution;
+      }
+    }
+
+    if (interval > 0 && !is_ticking) {
+
+      /* nobody advanced the wheels while we were idle, so the timers that were just started are relative to an old time. */
+      uint64_t now = uv_hrtime() / 1000000ull;
+      for (size_t i = 0; i < wheels.size(); ++i) {
+        wheels[i]->resume(now);
+      }
+
+      uv_timer_start(&ticker, rtc_runtime_ticker_cb, interval, interval);
+      is_ticking = true;
+    }
+    else if (0 == interval && is_ticking) {
+      uv_timer_stop(&ticker);
+      is_ticking = false;
+    }
+  }
+
+  void Runtime::shutdown() {
+
+    if (is_shutdown) {
+      return;
+    }
+
+    is_shutdown = true;
+
+    processTasks();
+
+    if (on_stop) {
+      on_stop(this, user);
+    }
+
+    uv_timer_stop(&ticker);
+    uv_prepare_stop(&prepare);
+    is_ticking = false;
+
+    nclosing = 3;
+    uv_close((uv_handle_t*)&wakeup, rtc_runtime_close_cb);
+    uv_close((uv_handle_t*)&ticker, rtc_runtime_close_cb);
+    uv_close((uv_handle_t*)&prepare, rtc_runtime_close_cb);
+
+    /* run() finishes closing the handles */
+    uv_stop(loop);
+  }
+
+} /* namespace rtc */
+
+/* ----------------------------------------------------------------- */
+
+static void rtc_runtime_thread(void* user) {
+  rtc::Runtime* runtime = static_cast<rtc::Runtime*>(user);
+  runtime->run();
+}
+
+static void rtc_runtime_wakeup_cb(uv_async_t* handle) {
+
+  rtc::Runtime* runtime = static_cast<rtc::Runtime*>(handle->data);
+
+  runtime->nwakeups++;
+  runtime->processTasks();
+
+  if (runtime->is_stopping.load()) {
+    runtime->shutdown();
+  }
+}
+
+static void rtc_runtime_ticker_cb(uv_timer_t* handle) {
+  rtc::Runtime* runtime = static_cast<rtc::Runtime*>(handle->data);
+  runtime->nticks++;
+  runtime->updateTimers();
+}
+
+/* the callbacks of the previous iteration may have started or stopped timers; this runs right before we block. */
+static void rtc_runtime_prepare_cb(uv_prepare_t* handle) {
+  rtc::Runtime* runtime = static_cast<rtc::Runtime*>(handle->data);
+  runtime->updateTicker();
+}
+
+static void rtc_runtime_close_cb(uv_handle_t* handle) {
+  rtc::Runtime* runtime = static_cast<rtc::Runtime*>(handle->data);
+  runtime->nclosing--;
+}
+
+static void rtc_runtime_run_task(rtc::Task* task, void*) {
+  rtc::RuntimeTask* runtime_task = static_cast<rtc::RuntimeTask*>(task);
+  runtime_task->cb(runtime_task->runtime, runtime_task->cb_user);
+  delete runtime_task;
+}
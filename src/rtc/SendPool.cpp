@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+#include <rtc/SendPool.h>
+
+namespace rtc {
+
+  /* --------------------------------------------------------------------- */
+
+  SendSlot::SendSlot()
+    :nbytes(0)
+    ,pool(NULL)
+    ,next(NULL)
+    ,is_used(false)
+  {
+    memset(&addr, 0x00, sizeof(addr));
+    req.data = this;
+#if defined(__linux__)
+    memset(&msg, 0x00, sizeof(msg));
+    memset(&iov, 0x00, sizeof(iov));
+    owner = NULL;
+#endif
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  SendPool::SendPool()
+    :nslots(0)
+    ,max_slots(0)
+    ,nused(0)
+    ,high_water(0)
+    ,nexhausted(0)
+    ,free_list(NULL)
+  {
+  }
+
+  SendPool::~SendPool() {
+
+    if (nused > 0) {
+      printf("rtc::SendPool - warning: destroying the pool while %u slots are in use.\n", nused);
+    }
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      delete[] chunks[i];
+    }
+
+    chunks.clear();
+    free_list = NULL;
+    nslots = 0;
+    nused = 0;
+  }
+
+  int SendPool::init(uint32_t count) {
+
+    if (0 != max_slots) {
+      printf("rtc::SendPool - error: already initialized.\n");
+      return -1;
+    }
+
+    if (0 == count) {
+      printf("rtc::SendPool - error: invalid number of slots.\n");
+      return -2;
+    }
+
+    max_slots = count;
+
+    return 0;
+  }
+
+  SendSlot* SendPool::acquire() {
+
+    SendSlot* slot = free_list;
+    if (!slot) {
+      if (!grow()) {
+        nexhausted++;
+        return NULL;
+      }
+      slot = free_list;
+    }
+
+    free_list = slot->next;
+    slot->next = NULL;
+    slot->nbytes = 0;
+    slot->is_used = true;
+
+    nused++;
+    if (nused > high_water) {
+      high_water = nused;
+    }
+
+    return slot;
+  }
+
+  void SendPool::release(SendSlot* slot) {
+
+    if (!slot || slot->pool != this || !slot->is_used) {
+      printf("rtc::SendPool - error: trying to release an invalid slot.\n");
+      return;
+    }
+
+    slot->is_used = false;
+    slot->next = free_list;
+    free_list = slot;
+
+    nused--;
+  }
+
+  bool SendPool::grow() {
+
+    if (nslots >= max_slots) {
+      return false;
+    }
+
+    uint32_t count = max_slots - nslots;
+    if (count > SEND_POOL_CHUNK_SIZE) {
+      count = SEND_POOL_CHUNK_SIZE;
+    }
+
+    SendSlot* chunk = new SendSlot[count];
+    chunks.push_back(chunk);
+
+    for (uint32_t i = count; i > 0; --i) {
+      SendSlot* slot = &chunk[i - 1];
+      slot->pool = this;
+      slot->next = free_list;
+      free_list = slot;
+    }
+
+    nslots += count;
+
+    return true;
+  }
+
+} /* namespace rtc */
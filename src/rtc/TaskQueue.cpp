@@ -0,0 +1,68 @@
+#include <rtc/TaskQueue.h>
+
+namespace rtc {
+
+  /* --------------------------------------------------------------------- */
+
+  Task::Task()
+    :run(NULL)
+    ,user(NULL)
+    ,next(NULL)
+  {
+  }
+
+  Task::~Task() {
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  TaskQueue::TaskQueue()
+    :head(&stub)
+    ,tail(&stub)
+  {
+  }
+
+  void TaskQueue::push(Task* task) {
+    task->next.store(NULL, std::memory_order_relaxed);
+    Task* prev = head.exchange(task, std::memory_order_acq_rel);
+    prev->next.store(task, std::memory_order_release);
+  }
+
+  Task* TaskQueue::pop() {
+
+    Task* task = tail;
+    Task* next = task->next.load(std::memory_order_acquire);
+
+    /* skip the stub */
+    if (task == &stub) {
+      if (NULL == next) {
+        return NULL;
+      }
+      tail = next;
+      task = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (NULL != next) {
+      tail = next;
+      return task;
+    }
+
+    /* a producer swapped the head but didn't link its task yet; we get it on the next pop(). */
+    if (task != head.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+
+    /* task is the last one; push the stub behind it so we can take it out. */
+    push(&stub);
+
+    next = task->next.load(std::memory_order_acquire);
+    if (NULL != next) {
+      tail = next;
+      return task;
+    }
+
+    return NULL;
+  }
+
+} /* namespace rtc */
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <rtc/TimerWheel.h>
+
+namespace rtc {
+
+  /* --------------------------------------------------------------------- */
+
+  Timer::Timer()
+    :on_timeout(NULL)
+    ,user(NULL)
+    ,rounds(0)
+    ,prev(NULL)
+    ,next(NULL)
+  {
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  TimerWheel::TimerWheel(uint32_t resolution)
+    :resolution(resolution)
+    ,tick(0)
+    ,nactive(0)
+  {
+    if (0 == resolution) {
+      printf("rtc::TimerWheel - warning: invalid resolution, using %d millis.\n", TIMER_WHEEL_DEFAULT_RESOLUTION);
+      this->resolution = TIMER_WHEEL_DEFAULT_RESOLUTION;
+    }
+
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+      slots[i].prev = &slots[i];
+      slots[i].next = &slots[i];
+    }
+  }
+
+  TimerWheel::~TimerWheel() {
+
+    /* detach all timers so they don't point into the wheel anymore. */
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+      while (slots[i].next != &slots[i]) {
+        unlink(slots[i].next);
+      }
+    }
+
+    nactive = 0;
+  }
+
+  void TimerWheel::init(uint64_t nowMillis) {
+    tick = nowMillis / resolution;
+  }
+
+  void TimerWheel::start(Timer* timer, uint64_t delayMillis) {
+
+    if (!timer) {
+      printf("rtc::TimerWheel - error: cannot start an invalid timer.\n");
+      return;
+    }
+
+    if (timer->isActive()) {
+      stop(timer);
+    }
+
+    /* we always wait at least one tick, so a timer that is restarted from its callback doesn't fire in the same update(). */
+    uint64_t ticks = (delayMillis + resolution - 1) / resolution;
+    if (0 == ticks) {
+      ticks = 1;
+    }
+
+    timer->rounds = (uint32_t)((ticks - 1) / TIMER_WHEEL_SLOTS);
+    link(&slots[(tick + ticks) & (TIMER_WHEEL_SLOTS - 1)], timer);
+
+    nactive++;
+  }
+
+  void TimerWheel::stop(Timer* timer) {
+
+    if (!timer || !timer->isActive()) {
+      return;
+    }
+
+    unlink(timer);
+    nactive--;
+  }
+
+  void TimerWheel::update(uint64_t nowMillis) {
+
+    uint64_t target = nowMillis / resolution;
+    Timer pending;
+
+    /* nothing can fire; don't walk the slots of a wheel that was idle for a long time. */
+    if (0 == nactive) {
+      if (target > tick) {
+        tick = target;
+      }
+      return;
+    }
+
+    while (tick < target) {
+
+      tick++;
+
+      Timer* head = &slots[tick & (TIMER_WHEEL_SLOTS - 1)];
+      if (head->next == head) {
+        continue;
+      }
+
+      /*
+         Move the slot into a local list first; callbacks may start or stop
+         any timer, including the ones in this slot, while we're iterating.
+      */
+      pending.prev = head->prev;
+      pending.next = head->next;
+      pending.prev->next = &pending;
+      pending.next->prev = &pending;
+      head->prev = head;
+      head->next = head;
+
+      while (pending.next != &pending) {
+
+        Timer* timer = pending.next;
+        unlink(timer);
+
+        if (timer->rounds > 0) {
+          timer->rounds--;
+          link(head, timer);
+          continue;
+        }
+
+        nactive--;
+
+        if (timer->on_timeout) {
+          timer->on_timeout(timer, timer->user);
+        }
+      }
+    }
+  }
+
+  /*
+     The timers were started relative to the old tick; we take them all off the
+     wheel, move the clock and link them again with the number of ticks they
+     still had to wait.
+  */
+  void TimerWheel::resume(uint64_t nowMillis) {
+
+    uint64_t target = nowMillis / resolution;
+    Timer pending;
+
+    if (target <= tick) {
+      return;
+    }
+
+    if (0 == nactive) {
+      tick = target;
+      return;
+    }
+
+    pending.prev = &pending;
+    pending.next = &pending;
+
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; ++i) {
+
+      Timer* head = &slots[i];
+      uint64_t ticks = (i - tick) & (TIMER_WHEEL_SLOTS - 1);
+      if (0 == ticks) {
+        ticks = TIMER_WHEEL_SLOTS;
+      }
+
+      while (head->next != head) {
+        Timer* timer = head->next;
+        unlink(timer);
+        timer->rounds = (uint32_t)(ticks + ((uint64_t)timer->rounds * TIMER_WHEEL_SLOTS));  /* remaining ticks, for now */
+        link(&pending, timer);
+      }
+    }
+
+    tick = target;
+
+    while (pending.next != &pending) {
+      Timer* timer = pending.next;
+      uint64_t ticks = timer->rounds;
+      unlink(timer);
+      timer->rounds = (uint32_t)((ticks - 1) / TIMER_WHEEL_SLOTS);
+      link(&slots[(tick + ticks) & (TIMER_WHEEL_SLOTS - 1)], timer);
+    }
+  }
+
+  void TimerWheel::link(Timer* head, Timer* timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+  }
+
+  void TimerWheel::unlink(Timer* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = NULL;
+    timer->next = NULL;
+  }
+
+} /* namespace rtc */
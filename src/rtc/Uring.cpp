@@ -0,0 +1,785 @@
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <rtc/Uring.h>
+#include <rtc/Connection.h>
+
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#  endif
+#endif
+
+/* multishot recvmsg and provided buffer rings came with Linux 6.0 */
+#if defined(IORING_RECV_MULTISHOT)
+#  define URING_SUPPORTED 1
+#  include <errno.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/socket.h>
+#  include <sys/syscall.h>
+#  include <sys/utsname.h>
+#  if !defined(__NR_io_uring_setup)
+#    define __NR_io_uring_setup 425
+#  endif
+#  if !defined(__NR_io_uring_enter)
+#    define __NR_io_uring_enter 426
+#  endif
+#  if !defined(__NR_io_uring_register)
+#    define __NR_io_uring_register 427
+#  endif
+#  define URING_BUFFER_GROUP 0                                      /* the id of the provided buffer ring */
+#  define URING_TAG_RECV 1                                          /* the low bits of the user_data tell what completed */
+#  define URING_TAG_SEND 2
+#  define URING_TAG_MASK 3
+#endif
+
+/* ----------------------------------------------------------------- */
+
+#if URING_SUPPORTED
+static void rtc_uring_poll_cb(uv_poll_t* handle, int status, int events);
+static void rtc_uring_prepare_cb(uv_prepare_t* handle);
+static void rtc_uring_check_cb(uv_check_t* handle);
+static void rtc_uring_close_cb(uv_handle_t* handle);
+static bool rtc_uring_kernel_supported();
+static void rtc_uring_recv_release_cb(rtc::RecvPool* pool, rtc::RecvBuffer* buf, void* user);
+#endif
+
+/* ----------------------------------------------------------------- */
+
+namespace rtc {
+
+#if URING_SUPPORTED
+
+  static uv_once_t rings_once = UV_ONCE_INIT;
+  static uv_mutex_t rings_mutex;
+  static std::map<uv_loop_t*, UringRing*> rings;                    /* the ring of each loop */
+
+  static void rtc_uring_init_rings() {
+    uv_mutex_init(&rings_mutex);
+  }
+
+#endif
+
+  /* ----------------------------------------------------------------- */
+
+  UringSocket::UringSocket(UringRing* ring, ConnectionUDP* conn, int fd)
+    :ring(ring)
+    ,conn(conn)
+    ,fd(fd)
+    ,is_receiving(false)
+    ,is_closing(false)
+    ,nsending(0)
+  {
+    memset(&recv_msg, 0x00, sizeof(recv_msg));
+    recv_msg.msg_namelen = sizeof(struct sockaddr_in);
+    recv_msg.msg_controllen = (conn && conn->has_timestamps) ? URING_CONTROL_SIZE : 0;
+  }
+
+  UringSocket::~UringSocket() {
+
+#if URING_SUPPORTED
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+#endif
+
+    if (ring) {
+      ring->release();
+      ring = NULL;
+    }
+  }
+
+  bool UringSocket::arm() {
+
+#if URING_SUPPORTED
+    struct io_uring_sqe* sqe = ring->getSqe();
+    if (!sqe) {
+      ring->submit();
+      sqe = ring->getSqe();
+      if (!sqe) {
+        printf("rtc::UringSocket - error: the submission queue is full, cannot arm the receive.\n");
+        return false;
+      }
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&recv_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)this | URING_TAG_RECV;
+
+    is_receiving = true;
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  bool UringSocket::send(SendSlot* slot) {
+
+#if URING_SUPPORTED
+    struct io_uring_sqe* sqe = ring->getSqe();
+
+    if (!sqe) {
+      ring->submit();
+      sqe = ring->getSqe();
+      if (!sqe) {
+        return false;
+      }
+    }
+
+    slot->iov.iov_base = slot->data;
+    slot->iov.iov_len = slot->nbytes;
+    memset(&slot->msg, 0x00, sizeof(slot->msg));
+    slot->msg.msg_name = &slot->addr;
+    slot->msg.msg_namelen = sizeof(slot->addr);
+    slot->msg.msg_iov = &slot->iov;
+    slot->msg.msg_iovlen = 1;
+    slot->owner = this;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&slot->msg;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)(uintptr_t)slot | URING_TAG_SEND;
+
+    /*
+       We don't link the sends (IOSQE_IO_LINK): on a PortMux socket they go to
+       different peers and one failed sendmsg would cancel the rest of the
+       chain. The kernel issues the sqes in order; a udp sendmsg on a
+       non-blocking socket completes inline, so they still leave in order.
+    */
+    nsending++;
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void UringSocket::close() {
+
+#if URING_SUPPORTED
+    /* the sends use the slots of the connection, so they must be done before it's destroyed. */
+    while (nsending > 0) {
+      ring->wait();
+    }
+
+    conn = NULL;
+    is_closing = true;
+
+    for (size_t i = 0; i < ring->rearm.size(); ++i) {
+      if (ring->rearm[i] == this) {
+        ring->rearm.erase(ring->rearm.begin() + i);
+        break;
+      }
+    }
+
+    if (!is_receiving) {
+      delete this;
+      return;
+    }
+
+    struct io_uring_sqe* sqe = ring->getSqe();
+    if (!sqe) {
+      ring->submit();
+      sqe = ring->getSqe();
+    }
+
+    if (sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->addr = (uint64_t)(uintptr_t)this | URING_TAG_RECV;
+      sqe->user_data = 0;
+      ring->submit();
+    }
+    else {
+      printf("rtc::UringSocket - error: cannot cancel the receive, the submission queue is full.\n");
+    }
+#else
+    delete this;
+#endif
+  }
+
+  /* ----------------------------------------------------------------- */
+
+  UringRing::UringRing(uv_loop_t* loop)
+    :loop(loop)
+    ,fd(-1)
+    ,refcount(0)
+    ,nclosing(0)
+    ,nsubmit_calls(0)
+    ,nsubmitted(0)
+    ,nnobufs(0)
+    ,recv_pool(NULL)
+    ,sq_ptr(NULL)
+    ,cq_ptr(NULL)
+    ,sq_size(0)
+    ,cq_size(0)
+    ,sqes(NULL)
+    ,sqes_size(0)
+    ,sq_head(NULL)
+    ,sq_tail(NULL)
+    ,sq_array(NULL)
+    ,sq_mask(0)
+    ,sq_entries(0)
+    ,sq_local_tail(0)
+    ,cq_head(NULL)
+    ,cq_tail(NULL)
+    ,cq_mask(0)
+    ,cqes(NULL)
+    ,buf_ring(NULL)
+    ,buf_ring_size(0)
+    ,buf_tail(0)
+  {
+  }
+
+  UringRing::~UringRing() {
+
+#if URING_SUPPORTED
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+
+    if (sqes) {
+      munmap(sqes, sqes_size);
+      sqes = NULL;
+    }
+
+    if (cq_ptr && cq_ptr != sq_ptr) {
+      munmap(cq_ptr, cq_size);
+    }
+    cq_ptr = NULL;
+
+    if (sq_ptr) {
+      munmap(sq_ptr, sq_size);
+      sq_ptr = NULL;
+    }
+
+    if (buf_ring) {
+      munmap(buf_ring, buf_ring_size);
+      buf_ring = NULL;
+    }
+#endif
+
+    /* buffers that are still retained by consumers keep the pool alive. */
+    if (recv_pool) {
+      recv_pool->destroy();
+      recv_pool = NULL;
+    }
+  }
+
+  UringRing* UringRing::acquire(uv_loop_t* loop) {
+
+#if URING_SUPPORTED
+    UringRing* ring = NULL;
+
+    if (!loop) {
+      return NULL;
+    }
+
+    if (!rtc_uring_kernel_supported()) {
+      return NULL;
+    }
+
+    uv_once(&rings_once, rtc_uring_init_rings);
+    uv_mutex_lock(&rings_mutex);
+    {
+      std::map<uv_loop_t*, UringRing*>::iterator it = rings.find(loop);
+      if (it != rings.end()) {
+        ring = it->second;
+      }
+      else {
+        ring = new UringRing(loop);
+        if (!ring->init()) {
+          delete ring;
+          ring = NULL;
+        }
+        else {
+          rings[loop] = ring;
+        }
+      }
+
+      if (ring) {
+        ring->refcount++;
+      }
+    }
+    uv_mutex_unlock(&rings_mutex);
+
+    return ring;
+#else
+    return NULL;
+#endif
+  }
+
+  void UringRing::release() {
+
+#if URING_SUPPORTED
+    bool is_last = false;
+
+    uv_mutex_lock(&rings_mutex);
+    {
+      refcount--;
+      if (0 == refcount) {
+        rings.erase(loop);
+        is_last = true;
+      }
+    }
+    uv_mutex_unlock(&rings_mutex);
+
+    if (is_last) {
+      shutdown();
+    }
+#endif
+  }
+
+  bool UringRing::init() {
+
+#if URING_SUPPORTED
+    struct io_uring_params params;
+    memset(&params, 0x00, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_RING_ENTRIES * 4;
+
+    fd = syscall(__NR_io_uring_setup, URING_RING_ENTRIES, &params);
+    if (fd < 0) {
+      printf("rtc::UringRing - warning: cannot create the ring: %s\n", strerror(errno));
+      return false;
+    }
+
+    if (0 == (params.features & IORING_FEAT_NODROP)) {
+      printf("rtc::UringRing - warning: the kernel doesn't support IORING_FEAT_NODROP.\n");
+      return false;
+    }
+
+    /* map the rings */
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_size = (cq_size > sq_size) ? cq_size : sq_size;
+      cq_size = sq_size;
+    }
+
+    sq_ptr = (uint8_t*)mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == sq_ptr) {
+      printf("rtc::UringRing - error: cannot map the submission queue: %s\n", strerror(errno));
+      sq_ptr = NULL;
+      return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      cq_ptr = sq_ptr;
+    }
+    else {
+      cq_ptr = (uint8_t*)mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (MAP_FAILED == cq_ptr) {
+        printf("rtc::UringRing - error: cannot map the completion queue: %s\n", strerror(errno));
+        cq_ptr = NULL;
+        return false;
+      }
+    }
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe*)mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (MAP_FAILED == (void*)sqes) {
+      printf("rtc::UringRing - error: cannot map the submission queue entries: %s\n", strerror(errno));
+      sqes = NULL;
+      return false;
+    }
+
+    sq_head = (uint32_t*)(sq_ptr + params.sq_off.head);
+    sq_tail = (uint32_t*)(sq_ptr + params.sq_off.tail);
+    sq_array = (uint32_t*)(sq_ptr + params.sq_off.array);
+    sq_mask = *(uint32_t*)(sq_ptr + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_local_tail = *sq_tail;
+
+    cq_head = (uint32_t*)(cq_ptr + params.cq_off.head);
+    cq_tail = (uint32_t*)(cq_ptr + params.cq_off.tail);
+    cq_mask = *(uint32_t*)(cq_ptr + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe*)(cq_ptr + params.cq_off.cqes);
+
+    /* the provided buffer ring; it must be page aligned so we map it. */
+    buf_ring_size = URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    buf_ring = (uint8_t*)mmap(NULL, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == buf_ring) {
+      printf("rtc::UringRing - error: cannot allocate the buffer ring: %s\n", strerror(errno));
+      buf_ring = NULL;
+      return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0x00, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)buf_ring;
+    reg.ring_entries = URING_BUFFER_COUNT;
+    reg.bgid = URING_BUFFER_GROUP;
+
+    if (0 != syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+      printf("rtc::UringRing - warning: cannot register the buffer ring: %s\n", strerror(errno));
+      return false;
+    }
+
+    /* all pool buffers belong to the kernel until we hand them to on_data; a released buffer goes back to the kernel. */
+    recv_pool = new RecvPool();
+    if (0 != recv_pool->init(URING_BUFFER_COUNT, URING_BUFFER_SIZE)) {
+      return false;
+    }
+
+    recv_pool->on_release = rtc_uring_recv_release_cb;
+    recv_pool->release_user = this;
+
+    buf_tail = 0;
+    for (uint16_t i = 0; i < URING_BUFFER_COUNT; ++i) {
+      RecvBuffer* buf = recv_pool->acquire();
+      buf->refcount = 0;
+      recycleBuffer(buf->index);
+    }
+
+    /* the loop tells us when there are completions; we submit around the poll phase. */
+    uv_poll_init(loop, &poll, fd);
+    uv_prepare_init(loop, &prepare);
+    uv_check_init(loop, &check);
+
+    poll.data = this;
+    prepare.data = this;
+    check.data = this;
+
+    uv_poll_start(&poll, UV_READABLE, rtc_uring_poll_cb);
+    uv_prepare_start(&prepare, rtc_uring_prepare_cb);
+    uv_check_start(&check, rtc_uring_check_cb);
+
+    /* the handles shouldn't keep the loop alive on their own; the sockets do that. */
+    uv_unref((uv_handle_t*)&prepare);
+    uv_unref((uv_handle_t*)&check);
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void UringRing::shutdown() {
+
+#if URING_SUPPORTED
+    submit();
+
+    uv_poll_stop(&poll);
+    uv_prepare_stop(&prepare);
+    uv_check_stop(&check);
+
+    nclosing = 3;
+    uv_close((uv_handle_t*)&poll, rtc_uring_close_cb);
+    uv_close((uv_handle_t*)&prepare, rtc_uring_close_cb);
+    uv_close((uv_handle_t*)&check, rtc_uring_close_cb);
+#endif
+  }
+
+  struct io_uring_sqe* UringRing::getSqe() {
+
+#if URING_SUPPORTED
+    uint32_t head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sq_local_tail - head >= sq_entries) {
+      return NULL;
+    }
+
+    uint32_t dx = sq_local_tail & sq_mask;
+    struct io_uring_sqe* sqe = &sqes[dx];
+
+    memset(sqe, 0x00, sizeof(*sqe));
+    sq_array[dx] = dx;
+    sq_local_tail++;
+
+    return sqe;
+#else
+    return NULL;
+#endif
+  }
+
+  void UringRing::submit() {
+
+#if URING_SUPPORTED
+    uint32_t tail = *sq_tail;
+    uint32_t count = sq_local_tail - tail;
+
+    if (0 == count) {
+      return;
+    }
+
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+    while (count > 0) {
+
+      int r = syscall(__NR_io_uring_enter, fd, count, 0, 0, NULL, 0);
+      nsubmit_calls++;
+
+      if (r < 0) {
+        if (EINTR == errno) {
+          continue;
+        }
+        /* the completion queue is full; make room and try again. */
+        if (EBUSY == errno || EAGAIN == errno) {
+          reap();
+          continue;
+        }
+        printf("rtc::UringRing - error: io_uring_enter() failed: %s\n", strerror(errno));
+        return;
+      }
+
+      nsubmitted += r;
+      count -= r;
+
+      if (0 == r) {
+        return;
+      }
+    }
+#endif
+  }
+
+  void UringRing::wait() {
+
+#if URING_SUPPORTED
+    submit();
+
+    int r = syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    nsubmit_calls++;
+    if (r < 0 && EINTR != errno) {
+      printf("rtc::UringRing - error: waiting for completions failed: %s\n", strerror(errno));
+    }
+
+    reap();
+#endif
+  }
+
+  void UringRing::reap() {
+
+#if URING_SUPPORTED
+    while (true) {
+
+      uint32_t head = *cq_head;
+      uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+      if (head == tail) {
+        break;
+      }
+
+      /* we copy the cqe and advance the head first so the callbacks can reap too (e.g. when they close a connection). */
+      struct io_uring_cqe cqe = cqes[head & cq_mask];
+      __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+
+      uint64_t tag = cqe.user_data & URING_TAG_MASK;
+      void* ptr = (void*)(uintptr_t)(cqe.user_data & ~(uint64_t)URING_TAG_MASK);
+
+      if (URING_TAG_RECV == tag) {
+        handleReceive(static_cast<UringSocket*>(ptr), &cqe);
+      }
+      else if (URING_TAG_SEND == tag) {
+        handleSend(static_cast<SendSlot*>(ptr), &cqe);
+      }
+    }
+
+    /* rearm the sockets that stopped receiving, e.g. because we ran out of buffers which we have returned by now. */
+    if (rearm.size()) {
+      std::vector<UringSocket*> sockets;
+      sockets.swap(rearm);
+      for (size_t i = 0; i < sockets.size(); ++i) {
+        if (!sockets[i]->is_closing) {
+          sockets[i]->arm();
+        }
+      }
+    }
+#endif
+  }
+
+  void UringRing::handleReceive(UringSocket* sock, struct io_uring_cqe* cqe) {
+
+#if URING_SUPPORTED
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+
+      uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      RecvBuffer* recv_buf = recv_pool->at(bid);
+      uint8_t* buf = recv_buf->base;
+      bool is_delivered = false;
+
+      if (cqe->res > 0 && sock->conn) {
+
+        /* the buffer starts with a io_uring_recvmsg_out, followed by the name (of the size we asked for) and the payload. */
+        struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*)buf;
+        struct sockaddr_in* addr = (struct sockaddr_in*)(buf + sizeof(*out));
+        uint8_t* payload = buf + sizeof(*out) + sock->recv_msg.msg_namelen + sock->recv_msg.msg_controllen;
+        ConnectionUDP* conn = sock->conn;
+
+        conn->nrecv_calls++;
+
+        if (out->flags & MSG_TRUNC) {
+          printf("rtc::ConnectionUDP - warning: dropping a truncated datagram.\n");
+          conn->nrecv_truncated++;
+        }
+        else if (out->namelen >= sizeof(struct sockaddr_in) && AF_INET == addr->sin_family) {
+          /* the payload stays where the kernel wrote it; the buffer returns to the kernel when it's released. */
+          recv_buf->refcount = 1;
+          recv_buf->data = payload;
+          recv_buf->nbytes = out->payloadlen;
+          recv_buf->arrival = uv_hrtime();
+          recv_buf->timestamp = 0;
+          recv_buf->socket = conn;
+          recv_buf->remote.set(addr);
+          is_delivered = true;
+
+          /* the control messages follow the name. */
+          if (out->controllen > 0) {
+            struct msghdr control;
+            memset(&control, 0x00, sizeof(control));
+            control.msg_control = buf + sizeof(*out) + sock->recv_msg.msg_namelen;
+            control.msg_controllen = out->controllen;
+            recv_buf->timestamp = conn->readControl(&control);
+          }
+
+          conn->deliver(recv_buf);
+        }
+      }
+
+      if (!is_delivered) {
+        recycleBuffer(bid);
+      }
+    }
+
+    if (cqe->flags & IORING_CQE_F_MORE) {
+      return;
+    }
+
+    /* the multishot receive ended */
+    sock->is_receiving = false;
+
+    if (sock->is_closing) {
+      if (0 == sock->nsending) {
+        delete sock;
+      }
+      return;
+    }
+
+    if (-ENOBUFS == cqe->res) {
+      nnobufs++;
+    }
+    else if (cqe->res < 0) {
+      printf("rtc::UringRing - error: the receive stopped: %s\n", strerror(-cqe->res));
+    }
+
+    rearm.push_back(sock);
+#endif
+  }
+
+  void UringRing::handleSend(SendSlot* slot, struct io_uring_cqe* cqe) {
+
+#if URING_SUPPORTED
+    UringSocket* sock = static_cast<UringSocket*>(slot->owner);
+    ConnectionUDP* conn = sock->conn;
+
+    sock->nsending--;
+    slot->owner = NULL;
+
+    if (conn) {
+      if (cqe->res < 0) {
+        printf("rtc::ConnectionUDP - error: failed to send a datagram: %s\n", strerror(-cqe->res));
+        conn->nsend_dropped++;
+      }
+      else {
+        conn->nsend_packets++;
+      }
+    }
+
+    slot->pool->release(slot);
+
+    if (sock->is_closing && !sock->is_receiving && 0 == sock->nsending) {
+      delete sock;
+    }
+#endif
+  }
+
+  void UringRing::recycleBuffer(uint16_t bid) {
+
+#if URING_SUPPORTED
+    /* not br->bufs; in C++ the flex array of the kernel header may not start at offset 0. */
+    struct io_uring_buf_ring* br = (struct io_uring_buf_ring*)buf_ring;
+    struct io_uring_buf* buf = (struct io_uring_buf*)buf_ring + (buf_tail & (URING_BUFFER_COUNT - 1));
+
+    buf->addr = (uint64_t)(uintptr_t)recv_pool->at(bid)->base;
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = bid;
+
+    buf_tail++;
+    __atomic_store_n(&br->tail, buf_tail, __ATOMIC_RELEASE);
+#endif
+  }
+
+} /* namespace rtc */
+
+/* ----------------------------------------------------------------- */
+
+#if URING_SUPPORTED
+
+static void rtc_uring_poll_cb(uv_poll_t* handle, int status, int) {
+
+  rtc::UringRing* ring = static_cast<rtc::UringRing*>(handle->data);
+
+  if (status < 0) {
+    printf("rtc::UringRing - error: poll error: %s\n", uv_strerror(status));
+    return;
+  }
+
+  ring->reap();
+}
+
+static void rtc_uring_prepare_cb(uv_prepare_t* handle) {
+  rtc::UringRing* ring = static_cast<rtc::UringRing*>(handle->data);
+  ring->submit();
+}
+
+static void rtc_uring_check_cb(uv_check_t* handle) {
+  rtc::UringRing* ring = static_cast<rtc::UringRing*>(handle->data);
+  ring->submit();
+}
+
+static void rtc_uring_close_cb(uv_handle_t* handle) {
+
+  rtc::UringRing* ring = static_cast<rtc::UringRing*>(handle->data);
+
+  ring->nclosing--;
+  if (ring->nclosing > 0) {
+    return;
+  }
+
+  delete ring;
+}
+
+/* a consumer released the last reference of a receive buffer; give it back to the kernel. */
+static void rtc_uring_recv_release_cb(rtc::RecvPool*, rtc::RecvBuffer* buf, void* user) {
+  rtc::UringRing* ring = static_cast<rtc::UringRing*>(user);
+  ring->recycleBuffer(buf->index);
+}
+
+/* multishot recvmsg needs 6.0; older kernels accept the request but fail it. */
+static bool rtc_uring_kernel_supported() {
+
+  struct utsname name;
+  int major = 0;
+  int minor = 0;
+
+  if (0 != uname(&name)) {
+    return false;
+  }
+
+  if (2 != sscanf(name.release, "%d.%d", &major, &minor)) {
+    return false;
+  }
+
+  return major >= 6;
+}
+
+#endif
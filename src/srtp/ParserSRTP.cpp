@@ -10,6 +10,7 @@ namespace srtp {
   ParserSRTP::ParserSRTP()
     :is_init(false)
   {
+    policy.key = NULL;
 
     /* Initialize the srtp library. */
     if (false == is_lib_init) {
@@ -24,15 +25,16 @@ namespace srtp {
 
   ParserSRTP::~ParserSRTP() {
 
+    if (is_init) {
+      srtp_dealloc(session);
+    }
+
     if (policy.key) {
+      memset(policy.key, 0x00, SRTP_PARSER_MASTER_LEN);
       delete[] policy.key;
       policy.key = NULL;
     }
 
-    if (is_init) {
-      srtp_dealloc(session);
-    }
-
     is_init = false;
   }
 
@@ -136,8 +138,25 @@ namespace srtp {
   }
 
   int ParserSRTP::unprotectRTCP(void* in, uint32_t nbytes) {
-    /* @todo implement */
-    return 0;
+    err_status_t err;
+    int len = nbytes;
+
+    /* validate. */
+    if (!in) { return -1; } 
+    if (!nbytes) { return -2; } 
+
+    if (false == is_init) {
+      printf("srtp::ParserSRTP::unprotectRTCP() - error: trying to unprotect data, but we're not initialized.\n");
+      return -3;
+    }
+
+    err = srtp_unprotect_rtcp(session, in, &len);
+    if (err != err_status_ok) {
+      printf("srtp::ParserSRTP::unprotectRTCP() - error: cannot unprotect the given SRTCP packet: %d\n", err);
+      return -4;
+    }
+
+    return len;
   }
   
 } /* namespace srtp */
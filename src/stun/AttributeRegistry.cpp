@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <stun/AttributeRegistry.h>
+
+namespace stun {
+
+  /* --------------------------------------------------------------------- */
+
+  static uint16_t registry_read_u16(const uint8_t* ptr);
+  static uint32_t registry_read_u32(const uint8_t* ptr);
+  static uint64_t registry_read_u64(const uint8_t* ptr);
+
+  static Attribute* decode_use_candidate(const uint8_t* value, uint16_t length);
+  static Attribute* decode_username(const uint8_t* value, uint16_t length);
+  static Attribute* decode_software(const uint8_t* value, uint16_t length);
+  static Attribute* decode_xor_mapped_address(const uint8_t* value, uint16_t length);
+  static Attribute* decode_priority(const uint8_t* value, uint16_t length);
+  static Attribute* decode_message_integrity(const uint8_t* value, uint16_t length);
+  static Attribute* decode_fingerprint(const uint8_t* value, uint16_t length);
+  static Attribute* decode_ice_controlled(const uint8_t* value, uint16_t length);
+  static Attribute* decode_ice_controlling(const uint8_t* value, uint16_t length);
+
+  /* --------------------------------------------------------------------- */
+
+  /*
+     Sorted on type. The length limits come from http://tools.ietf.org/html/rfc5389#section-15
+     and http://tools.ietf.org/html/rfc5245#section-19.1. Attributes with a NULL decoder
+     are known, validated and skipped by stun::Reader.
+  */
+  static constexpr AttributeInfo attribute_registry[] = {
+    { STUN_ATTR_MAPPED_ADDR,          8,  20,     NULL,                       "STUN_ATTR_MAPPED_ADDR"          },
+    { STUN_ATTR_USERNAME,             0,  513,    decode_username,            "STUN_ATTR_USERNAME"             },
+    { STUN_ATTR_MESSAGE_INTEGRITY,    20, 20,     decode_message_integrity,   "STUN_ATTR_MESSAGE_INTEGRITY"    },
+    { STUN_ATTR_ERR_CODE,             4,  767,    NULL,                       "STUN_ATTR_ERR_CODE"             },
+    { STUN_ATTR_UNKNOWN_ATTRIBUTES,   0,  0xFFFF, NULL,                       "STUN_ATTR_UNKNOWN_ATTRIBUTES"   },
+    { STUN_ATTR_REALM,                0,  763,    NULL,                       "STUN_ATTR_REALM"                },
+    { STUN_ATTR_NONCE,                0,  763,    NULL,                       "STUN_ATTR_NONCE"                },
+    { STUN_ATTR_XOR_MAPPED_ADDRESS,   8,  20,     decode_xor_mapped_address,  "STUN_ATTR_XOR_MAPPED_ADDRESS"   },
+    { STUN_ATTR_PRIORITY,             4,  4,      decode_priority,            "STUN_ATTR_PRIORITY"             },
+    { STUN_ATTR_USE_CANDIDATE,        0,  0,      decode_use_candidate,       "STUN_ATTR_USE_CANDIDATE"        },
+    { STUN_ATTR_SOFTWARE,             0,  763,    decode_software,            "STUN_ATTR_SOFTWARE"             },
+    { STUN_ATTR_ALTERNATE_SERVER,     8,  20,     NULL,                       "STUN_ATTR_ALTERNATE_SERVER"     },
+    { STUN_ATTR_FINGERPRINT,          4,  4,      decode_fingerprint,         "STUN_ATTR_FINGERPRINT"          },
+    { STUN_ATTR_ICE_CONTROLLED,       8,  8,      decode_ice_controlled,      "STUN_ATTR_ICE_CONTROLLED"       },
+    { STUN_ATTR_ICE_CONTROLLING,      8,  8,      decode_ice_controlling,     "STUN_ATTR_ICE_CONTROLLING"      },
+  };
+
+  static constexpr uint32_t attribute_registry_size = sizeof(attribute_registry) / sizeof(attribute_registry[0]);
+
+  static constexpr bool attribute_registry_is_sorted(uint32_t i) {
+    return (i + 1 >= attribute_registry_size)
+      ? true
+      : (attribute_registry[i].type < attribute_registry[i + 1].type
+         && attribute_registry[i].min_length <= attribute_registry[i].max_length
+         && attribute_registry_is_sorted(i + 1));
+  }
+
+  static_assert(attribute_registry_is_sorted(0), "stun::attribute_registry must be sorted on type and min_length <= max_length.");
+
+  /* --------------------------------------------------------------------- */
+
+  const AttributeInfo* find_attribute_info(uint16_t type) {
+
+    uint32_t lo = 0;
+    uint32_t hi = attribute_registry_size;
+
+    while (lo < hi) {
+      uint32_t mid = (lo + hi) >> 1;
+      if (attribute_registry[mid].type < type) {
+        lo = mid + 1;
+      }
+      else {
+        hi = mid;
+      }
+    }
+
+    if (lo < attribute_registry_size && attribute_registry[lo].type == type) {
+      return &attribute_registry[lo];
+    }
+
+    return NULL;
+  }
+
+  const char* attribute_type_name(uint16_t type) {
+    const AttributeInfo* info = find_attribute_info(type);
+    return (NULL == info) ? "unknown" : info->name;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  static Attribute* decode_use_candidate(const uint8_t*, uint16_t) {
+    return new Attribute(STUN_ATTR_USE_CANDIDATE);
+  }
+
+  static Attribute* decode_username(const uint8_t* value, uint16_t length) {
+    Username* username = new Username();
+    std::copy(value, value + length, std::back_inserter(username->value.buffer));
+    return username;
+  }
+
+  static Attribute* decode_software(const uint8_t* value, uint16_t length) {
+    Software* software = new Software();
+    std::copy(value, value + length, std::back_inserter(software->value.buffer));
+    return software;
+  }
+
+  /* See http://tools.ietf.org/html/rfc5389#section-15.2 */
+  static Attribute* decode_xor_mapped_address(const uint8_t* value, uint16_t length) {
+
+    char ip_addr[16];
+
+    if (STUN_IP6 == value[1]) {
+      /* @todo decode_xor_mapped_address() - implement IPv6. */
+      printf("stun::AttributeRegistry - warning: we have to implement the IPv6 XOR-MAPPED-ADDRESS.\n");
+      return NULL;
+    }
+
+    if (STUN_IP4 != value[1] || 8 != length) {
+      printf("stun::AttributeRegistry - error: invalid family or length for the xor mapped address.\n");
+      return NULL;
+    }
+
+    uint16_t port = registry_read_u16(value + 2) ^ 0x2112;
+    uint32_t ip = registry_read_u32(value + 4) ^ 0x2112A442;
+
+    sprintf(ip_addr, "%u.%u.%u.%u", (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+
+    return new XorMappedAddress(ip_addr, port, STUN_IP4);
+  }
+
+  /* priority: http://tools.ietf.org/html/rfc5245#section-4.1.2.1 */
+  static Attribute* decode_priority(const uint8_t* value, uint16_t) {
+    Priority* prio = new Priority();
+    prio->value = registry_read_u32(value);
+    return prio;
+  }
+
+  static Attribute* decode_message_integrity(const uint8_t* value, uint16_t) {
+    MessageIntegrity* integ = new MessageIntegrity();
+    memcpy(integ->sha1, value, 20);
+    return integ;
+  }
+
+  /* CRC32-bit, see http://tools.ietf.org/html/rfc5389#section-15.5 */
+  static Attribute* decode_fingerprint(const uint8_t* value, uint16_t) {
+    Fingerprint* fp = new Fingerprint();
+    fp->crc = registry_read_u32(value);
+    return fp;
+  }
+
+  static Attribute* decode_ice_controlled(const uint8_t* value, uint16_t) {
+    IceControlled* ic = new IceControlled();
+    ic->tie_breaker = registry_read_u64(value);
+    return ic;
+  }
+
+  static Attribute* decode_ice_controlling(const uint8_t* value, uint16_t) {
+    IceControlling* ic = new IceControlling();
+    ic->tie_breaker = registry_read_u64(value);
+    return ic;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  static uint16_t registry_read_u16(const uint8_t* ptr) {
+    return ((uint16_t)ptr[0] << 8) | (uint16_t)ptr[1];
+  }
+
+  static uint32_t registry_read_u32(const uint8_t* ptr) {
+    return ((uint32_t)ptr[0] << 24)
+      | ((uint32_t)ptr[1] << 16)
+      | ((uint32_t)ptr[2] << 8)
+      | (uint32_t)ptr[3];
+  }
+
+  static uint64_t registry_read_u64(const uint8_t* ptr) {
+    return ((uint64_t)registry_read_u32(ptr) << 32) | (uint64_t)registry_read_u32(ptr + 4);
+  }
+
+} /* namespace stun */
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+#include <stun/BindingResponder.h>
+#include <stun/Utils.h>
+
+/* Offsets into the response template. */
+#define RESPONDER_LENGTH_OFFSET        2
+#define RESPONDER_TRANSACTION_OFFSET   8
+#define RESPONDER_PORT_OFFSET         26
+#define RESPONDER_IP_OFFSET           28
+#define RESPONDER_INTEGRITY_OFFSET    32
+#define RESPONDER_FINGERPRINT_OFFSET  56
+
+namespace stun {
+
+  BindingResponder::BindingResponder() 
+    :key(NULL)
+  {
+
+    static const uint8_t templ[STUN_BINDING_RESPONSE_SIZE] = {
+      0x01, 0x01, 0x00, 0x2C,                                   /* Binding Success Response, Message-Length = 44 */
+      0x21, 0x12, 0xA4, 0x42,                                   /* cookie */
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00,                       /* transaction id */
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x20, 0x00, 0x08,                                   /* XOR-MAPPED-ADDRESS */
+      0x00, STUN_IP4, 0x00, 0x00,                               /* family, x-port */
+      0x00, 0x00, 0x00, 0x00,                                   /* x-address */
+      0x00, 0x08, 0x00, 0x14,                                   /* MESSAGE-INTEGRITY */
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x80, 0x28, 0x00, 0x04,                                   /* FINGERPRINT */
+      0x00, 0x00, 0x00, 0x00
+    };
+
+    memcpy(response, templ, sizeof(response));
+  }
+
+  void BindingResponder::setKey(IntegrityKey* k) {
+    key = k;
+  }
+
+  int BindingResponder::write(MessageView* request, uint32_t ip, uint16_t port, uint8_t* output) {
+
+    uint16_t xport = port ^ 0x2112;
+    uint32_t xip = ip ^ 0x2112A442;
+    uint32_t crc = 0;
+
+    if (!request || !request->data) { return -1; }
+    if (!output) { return -2; }
+    if (!key || !key->isSet()) {
+      printf("stun::BindingResponder - error: cannot write a response, no key set.\n");
+      return -3;
+    }
+
+    memcpy(output, response, STUN_BINDING_RESPONSE_SIZE);
+    memcpy(output + RESPONDER_TRANSACTION_OFFSET, request->data + RESPONDER_TRANSACTION_OFFSET, 12);
+
+    output[RESPONDER_PORT_OFFSET + 0] = (xport >> 8) & 0xFF;
+    output[RESPONDER_PORT_OFFSET + 1] = xport & 0xFF;
+    output[RESPONDER_IP_OFFSET + 0] = (xip >> 24) & 0xFF;
+    output[RESPONDER_IP_OFFSET + 1] = (xip >> 16) & 0xFF;
+    output[RESPONDER_IP_OFFSET + 2] = (xip >> 8) & 0xFF;
+    output[RESPONDER_IP_OFFSET + 3] = xip & 0xFF;
+
+    /* The HMAC is computed with a Message-Length up to and including the MESSAGE-INTEGRITY attribute (36 bytes). */
+    output[RESPONDER_LENGTH_OFFSET + 1] = 0x24;
+    if (!key->compute(output, RESPONDER_INTEGRITY_OFFSET, output + RESPONDER_INTEGRITY_OFFSET + 4)) {
+      printf("stun::BindingResponder - error: cannot compute the message integrity.\n");
+      return -4;
+    }
+
+    /* The CRC is computed with the final Message-Length (44 bytes). */
+    output[RESPONDER_LENGTH_OFFSET + 1] = 0x2C;
+    crc = crc32_ieee(0, output, RESPONDER_FINGERPRINT_OFFSET) ^ 0x5354554e;
+    output[RESPONDER_FINGERPRINT_OFFSET + 4] = (crc >> 24) & 0xFF;
+    output[RESPONDER_FINGERPRINT_OFFSET + 5] = (crc >> 16) & 0xFF;
+    output[RESPONDER_FINGERPRINT_OFFSET + 6] = (crc >> 8) & 0xFF;
+    output[RESPONDER_FINGERPRINT_OFFSET + 7] = crc & 0xFF;
+
+    return STUN_BINDING_RESPONSE_SIZE;
+  }
+
+} /* namespace stun */
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include <stun/BufferWriter.h>
+#include <stun/Utils.h>
+
+namespace stun {
+
+  BufferWriter::BufferWriter(uint8_t* buffer, uint32_t capacity)
+    :buffer(buffer)
+    ,capacity(capacity)
+    ,nbytes(0)
+    ,is_overflow(false)
+  {
+  }
+
+  bool BufferWriter::begin(uint16_t type, const uint32_t* transaction) {
+
+    nbytes = 0;
+    is_overflow = false;
+
+    if (!buffer || capacity < 20 || !transaction) {
+      is_overflow = true;
+      return false;
+    }
+
+    writeU16(type);
+    writeU16(0);                  /* length, set in finish() */
+    writeU32(0x2112A442);         /* cookie */
+    writeU32(transaction[0]);
+    writeU32(transaction[1]);
+    writeU32(transaction[2]);
+
+    return true;
+  }
+
+  bool BufferWriter::writeUsername(const char* name, uint16_t len) {
+    if (!name || !writeAttributeHeader(STUN_ATTR_USERNAME, len)) {
+      return false;
+    }
+    memcpy(buffer + nbytes, name, len);
+    nbytes += (len + 3) & ~0x03;
+    return true;
+  }
+
+  bool BufferWriter::writeSoftware(const char* name, uint16_t len) {
+    if (!name || !writeAttributeHeader(STUN_ATTR_SOFTWARE, len)) {
+      return false;
+    }
+    memcpy(buffer + nbytes, name, len);
+    nbytes += (len + 3) & ~0x03;
+    return true;
+  }
+
+  bool BufferWriter::writePriority(uint32_t priority) {
+    if (!writeAttributeHeader(STUN_ATTR_PRIORITY, 4)) {
+      return false;
+    }
+    writeU32(priority);
+    return true;
+  }
+
+  bool BufferWriter::writeIceControlled(uint64_t tieBreaker) {
+    if (!writeAttributeHeader(STUN_ATTR_ICE_CONTROLLED, 8)) {
+      return false;
+    }
+    writeU64(tieBreaker);
+    return true;
+  }
+
+  bool BufferWriter::writeIceControlling(uint64_t tieBreaker) {
+    if (!writeAttributeHeader(STUN_ATTR_ICE_CONTROLLING, 8)) {
+      return false;
+    }
+    writeU64(tieBreaker);
+    return true;
+  }
+
+  bool BufferWriter::writeUseCandidate() {
+    return writeAttributeHeader(STUN_ATTR_USE_CANDIDATE, 0);
+  }
+
+  /* See http://tools.ietf.org/html/rfc5389#section-15.2 */
+  bool BufferWriter::writeXorMappedAddress(uint32_t ip, uint16_t port) {
+    if (!writeAttributeHeader(STUN_ATTR_XOR_MAPPED_ADDRESS, 8)) {
+      return false;
+    }
+    writeU16(STUN_IP4);
+    writeU16(port ^ 0x2112);
+    writeU32(ip ^ 0x2112A442);
+    return true;
+  }
+
+  int BufferWriter::finish(IntegrityKey* key, bool fingerprint) {
+
+    uint32_t needed = nbytes;
+
+    if (is_overflow || nbytes < 20) {
+      return -1;
+    }
+
+    if (key) {
+      needed += 24;
+    }
+    if (fingerprint) {
+      needed += 8;
+    }
+    if (needed > capacity || needed - 20 > 0xFFFF) {
+      printf("stun::BufferWriter - error: the message doesn't fit into the buffer (%u > %u).\n", needed, capacity);
+      is_overflow = true;
+      return -2;
+    }
+
+    /* The hmac-sha1 is computed with a Message-Length that includes the MESSAGE-INTEGRITY attribute. */
+    if (key) {
+      setLength(nbytes + 24 - 20);
+      if (!key->compute(buffer, nbytes, buffer + nbytes + 4)) {
+        printf("stun::BufferWriter - error: cannot compute the message integrity.\n");
+        return -3;
+      }
+      writeU16(STUN_ATTR_MESSAGE_INTEGRITY);
+      writeU16(20);
+      nbytes += 20;
+    }
+
+    /* The crc is computed with a Message-Length that includes the FINGERPRINT attribute. */
+    if (fingerprint) {
+      setLength(nbytes + 8 - 20);
+      uint32_t crc = crc32_ieee(0, buffer, nbytes) ^ 0x5354554e;
+      writeU16(STUN_ATTR_FINGERPRINT);
+      writeU16(4);
+      writeU32(crc);
+    }
+
+    setLength(nbytes - 20);
+
+    return nbytes;
+  }
+
+  bool BufferWriter::writeAttributeHeader(uint16_t type, uint16_t length) {
+
+    uint32_t padded = (length + 3) & ~0x03;
+
+    if (is_overflow) {
+      return false;
+    }
+
+    if (nbytes < 20 || nbytes + 4 + padded > capacity) {
+      printf("stun::BufferWriter - error: attribute of %u bytes doesn't fit into the buffer.\n", length);
+      is_overflow = true;
+      return false;
+    }
+
+    writeU16(type);
+    writeU16(length);
+
+    /* Padding: http://tools.ietf.org/html/rfc5389#section-15, must be 32bit aligned */
+    if (padded != length) {
+      memset(buffer + nbytes + length, 0x00, padded - length);
+    }
+
+    return true;
+  }
+
+  void BufferWriter::writeU16(uint16_t v) {
+    buffer[nbytes + 0] = (v >> 8) & 0xFF;
+    buffer[nbytes + 1] = v & 0xFF;
+    nbytes += 2;
+  }
+
+  void BufferWriter::writeU32(uint32_t v) {
+    buffer[nbytes + 0] = (v >> 24) & 0xFF;
+    buffer[nbytes + 1] = (v >> 16) & 0xFF;
+    buffer[nbytes + 2] = (v >> 8) & 0xFF;
+    buffer[nbytes + 3] = v & 0xFF;
+    nbytes += 4;
+  }
+
+  void BufferWriter::writeU64(uint64_t v) {
+    writeU32((v >> 32) & 0xFFFFFFFF);
+    writeU32(v & 0xFFFFFFFF);
+  }
+
+  void BufferWriter::setLength(uint16_t length) {
+    buffer[2] = (length >> 8) & 0xFF;
+    buffer[3] = length & 0xFF;
+  }
+
+} /* namespace stun */
@@ -0,0 +1,321 @@
+/*
+
+  CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) kernels that are used
+  for the STUN FINGERPRINT attribute. We select the fastest kernel that the
+  cpu supports the first time the library is loaded:
+
+  - x86-64: carry-less multiplication folding with PCLMULQDQ, based on the
+    Intel paper "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+    Instruction" and the implementation in Chromium's zlib (crc32_simd.c).
+  - ARMv8:  the CRC32 instructions.
+  - others: slicing-by-8 table lookups.
+
+  All kernels return the same value as zlib's crc32(crc, data, nbytes).
+
+ */
+#include <string.h>
+#include <stun/Utils.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define CRC32_USE_PCLMUL 1
+#  include <cpuid.h>
+#  include <emmintrin.h>
+#  include <smmintrin.h>
+#  include <wmmintrin.h>
+#elif defined(__aarch64__)
+#  define CRC32_USE_ARMV8 1
+#  include <arm_acle.h>
+#  if defined(__linux__)
+#    include <sys/auxv.h>
+#    if !defined(HWCAP_CRC32)
+#      define HWCAP_CRC32 (1 << 7)
+#    endif
+#  endif
+#  if defined(__clang__)
+#    define CRC32_ARMV8_TARGET __attribute__((target("crc")))
+#  else
+#    define CRC32_ARMV8_TARGET __attribute__((target("+crc")))
+#  endif
+#endif
+
+namespace stun {
+
+  /* --------------------------------------------------------------------- */
+
+  typedef uint32_t(*crc32_kernel)(uint32_t crc, const uint8_t* data, uint32_t nbytes);
+
+  struct Crc32Kernel {
+    crc32_kernel func;
+    const char* name;
+  };
+
+  static Crc32Kernel crc32_select_kernel();
+
+#if CRC32_USE_PCLMUL
+  static uint32_t crc32_ieee_pclmul(uint32_t crc, const uint8_t* data, uint32_t nbytes);
+#endif
+
+#if CRC32_USE_ARMV8
+  static uint32_t crc32_ieee_armv8(uint32_t crc, const uint8_t* data, uint32_t nbytes);
+#endif
+
+  /* --------------------------------------------------------------------- */
+
+  /* Slicing-by-8 lookup tables, generated once when the library is loaded. */
+  class Crc32Tables {
+  public:
+    Crc32Tables() {
+      for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+          c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        }
+        table[0][i] = c;
+      }
+      for (uint32_t i = 0; i < 256; ++i) {
+        for (int k = 1; k < 8; ++k) {
+          table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+      }
+    }
+
+  public:
+    uint32_t table[8][256];
+  };
+
+  static const Crc32Tables crc32_tables;
+  static const Crc32Kernel crc32_kernel_selected = crc32_select_kernel();
+
+  /* --------------------------------------------------------------------- */
+
+  uint32_t crc32_ieee(uint32_t crc, const uint8_t* data, uint32_t nbytes) {
+    return crc32_kernel_selected.func(crc, data, nbytes);
+  }
+
+  const char* crc32_ieee_kernel_name() {
+    return crc32_kernel_selected.name;
+  }
+
+  uint32_t crc32_ieee_table(uint32_t crc, const uint8_t* data, uint32_t nbytes) {
+
+    const uint32_t (*t)[256] = crc32_tables.table;
+
+    if (!data) {
+      return crc;
+    }
+
+    crc = ~crc;
+
+    while (nbytes >= 8) {
+      uint32_t one = ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24)) ^ crc;
+      uint32_t two = ((uint32_t)data[4] | ((uint32_t)data[5] << 8) | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24));
+      crc = t[7][one & 0xFF]
+        ^ t[6][(one >> 8) & 0xFF]
+        ^ t[5][(one >> 16) & 0xFF]
+        ^ t[4][one >> 24]
+        ^ t[3][two & 0xFF]
+        ^ t[2][(two >> 8) & 0xFF]
+        ^ t[1][(two >> 16) & 0xFF]
+        ^ t[0][two >> 24];
+      data += 8;
+      nbytes -= 8;
+    }
+
+    while (nbytes) {
+      crc = t[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+      data++;
+      nbytes--;
+    }
+
+    return ~crc;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+#if CRC32_USE_PCLMUL
+
+  /*
+     Folds blocks of 64 bytes using the constants from the Intel paper. The given
+     crc must be inverted and we return the inverted crc. nbytes must be >= 64 and
+     a multiple of 16.
+  */
+  __attribute__((target("pclmul,sse4.1")))
+  static uint32_t crc32_pclmul_fold(const uint8_t* buf, uint32_t len, uint32_t crc) {
+
+    static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    /* fold 4 x 128 bits in parallel. */
+    while (len >= 64) {
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+      y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+      y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+      y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+      y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+      buf += 64;
+      len -= 64;
+    }
+
+    /* fold into 128 bits. */
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* fold the remaining blocks of 16 bytes. */
+    while (len >= 16) {
+      x2 = _mm_loadu_si128((const __m128i*)buf);
+
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+      buf += 16;
+      len -= 16;
+    }
+
+    /* fold 128 bits into 64 bits. */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* barrett reduce to 32 bits. */
+    x0 = _mm_load_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return _mm_extract_epi32(x1, 1);
+  }
+
+  static uint32_t crc32_ieee_pclmul(uint32_t crc, const uint8_t* data, uint32_t nbytes) {
+
+    if (data && nbytes >= 64) {
+      uint32_t chunk = nbytes & ~15u;
+      crc = ~crc32_pclmul_fold(data, chunk, ~crc);
+      data += chunk;
+      nbytes -= chunk;
+    }
+
+    return crc32_ieee_table(crc, data, nbytes);
+  }
+
+#endif /* CRC32_USE_PCLMUL */
+
+  /* --------------------------------------------------------------------- */
+
+#if CRC32_USE_ARMV8
+
+  CRC32_ARMV8_TARGET
+  static uint32_t crc32_ieee_armv8(uint32_t crc, const uint8_t* data, uint32_t nbytes) {
+
+    uint64_t v;
+
+    if (!data) {
+      return crc;
+    }
+
+    crc = ~crc;
+
+    while (nbytes >= 8) {
+      memcpy(&v, data, 8);
+      crc = __crc32d(crc, v);
+      data += 8;
+      nbytes -= 8;
+    }
+
+    while (nbytes) {
+      crc = __crc32b(crc, *data);
+      data++;
+      nbytes--;
+    }
+
+    return ~crc;
+  }
+
+#endif /* CRC32_USE_ARMV8 */
+
+  /* --------------------------------------------------------------------- */
+
+  static Crc32Kernel crc32_select_kernel() {
+
+    Crc32Kernel kernel;
+    kernel.func = crc32_ieee_table;
+    kernel.name = "table";
+
+#if CRC32_USE_PCLMUL
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+      if ((ecx & bit_PCLMUL) && (ecx & bit_SSE4_1)) {
+        kernel.func = crc32_ieee_pclmul;
+        kernel.name = "pclmulqdq";
+      }
+    }
+#endif
+
+#if CRC32_USE_ARMV8
+#  if defined(__APPLE__)
+    kernel.func = crc32_ieee_armv8;
+    kernel.name = "armv8-crc32";
+#  elif defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+      kernel.func = crc32_ieee_armv8;
+      kernel.name = "armv8-crc32";
+    }
+#  endif
+#endif
+
+    return kernel;
+  }
+
+} /* namespace stun */
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <openssl/crypto.h>
+#include <stun/IntegrityKey.h>
+
+namespace stun {
+
+  IntegrityKey::IntegrityKey()
+    :is_set(false)
+  {
+  }
+
+  /* See http://tools.ietf.org/html/rfc2104#section-2 */
+  bool IntegrityKey::setKey(const std::string& key) {
+
+    uint8_t block[SHA_CBLOCK];
+    uint8_t pad[SHA_CBLOCK];
+
+    is_set = false;
+
+    if (0 == key.size()) {
+      printf("stun::IntegrityKey - error: cannot set an empty key.\n");
+      return false;
+    }
+
+    /* keys longer than the block size are hashed first. */
+    memset(block, 0x00, sizeof(block));
+    if (key.size() > SHA_CBLOCK) {
+      SHA1((const unsigned char*)key.c_str(), key.size(), block);
+    }
+    else {
+      memcpy(block, key.c_str(), key.size());
+    }
+
+    for (int i = 0; i < SHA_CBLOCK; ++i) {
+      pad[i] = block[i] ^ 0x36;
+    }
+    SHA1_Init(&inner);
+    SHA1_Update(&inner, pad, SHA_CBLOCK);
+
+    for (int i = 0; i < SHA_CBLOCK; ++i) {
+      pad[i] = block[i] ^ 0x5c;
+    }
+    SHA1_Init(&outer);
+    SHA1_Update(&outer, pad, SHA_CBLOCK);
+
+    memset(block, 0x00, sizeof(block));
+    memset(pad, 0x00, sizeof(pad));
+
+    is_set = true;
+
+    return true;
+  }
+
+  bool IntegrityKey::isSet() {
+    return is_set;
+  }
+
+  bool IntegrityKey::compute(const uint8_t* data, uint32_t nbytes, uint8_t* output) {
+
+    SHA_CTX ctx;
+    uint8_t digest[SHA_DIGEST_LENGTH];
+
+    if (!is_set) { return false; }
+    if (!data) { return false; }
+    if (!output) { return false; }
+
+    ctx = inner;
+    SHA1_Update(&ctx, data, nbytes);
+    SHA1_Final(digest, &ctx);
+
+    ctx = outer;
+    SHA1_Update(&ctx, digest, SHA_DIGEST_LENGTH);
+    SHA1_Final(output, &ctx);
+
+    return true;
+  }
+
+  bool IntegrityKey::computeBatch(IntegrityJob* jobs, uint32_t njobs) {
+
+    SHA_CTX ctx;
+    uint8_t digest[SHA_DIGEST_LENGTH];
+
+    if (!is_set) { return false; }
+    if (!jobs) { return false; }
+
+    /* First all inner hashes, then all outer hashes so the key states stay hot. */
+    for (uint32_t i = 0; i < njobs; ++i) {
+      if (!jobs[i].data || !jobs[i].output) {
+        return false;
+      }
+      ctx = inner;
+      SHA1_Update(&ctx, jobs[i].data, jobs[i].nbytes);
+      SHA1_Final(jobs[i].output, &ctx);
+    }
+
+    for (uint32_t i = 0; i < njobs; ++i) {
+      memcpy(digest, jobs[i].output, SHA_DIGEST_LENGTH);
+      ctx = outer;
+      SHA1_Update(&ctx, digest, SHA_DIGEST_LENGTH);
+      SHA1_Final(jobs[i].output, &ctx);
+    }
+
+    return true;
+  }
+
+  bool IntegrityKey::computeMessage(const uint8_t* msg, uint32_t nbytes, uint16_t length, uint8_t* output) {
+
+    SHA_CTX ctx;
+    uint8_t header[4];
+    uint8_t digest[SHA_DIGEST_LENGTH];
+
+    if (!is_set) { return false; }
+    if (!msg) { return false; }
+    if (!output) { return false; }
+    if (nbytes < 20) { return false; }
+
+    header[0] = msg[0];
+    header[1] = msg[1];
+    header[2] = (length >> 8) & 0xFF;
+    header[3] = length & 0xFF;
+
+    ctx = inner;
+    SHA1_Update(&ctx, header, 4);
+    SHA1_Update(&ctx, msg + 4, nbytes - 4);
+    SHA1_Final(digest, &ctx);
+
+    ctx = outer;
+    SHA1_Update(&ctx, digest, SHA_DIGEST_LENGTH);
+    SHA1_Final(output, &ctx);
+
+    return true;
+  }
+
+  bool IntegrityKey::verifyMessage(const uint8_t* msg, uint32_t nbytes, uint16_t length, const uint8_t* expected) {
+
+    uint8_t sha1[SHA_DIGEST_LENGTH];
+
+    if (!expected) { return false; } 
+
+    if (!computeMessage(msg, nbytes, length, sha1)) {
+      return false;
+    }
+
+    return 0 == CRYPTO_memcmp(sha1, expected, SHA_DIGEST_LENGTH);
+  }
+
+} /* namespace stun */
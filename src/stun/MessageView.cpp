@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <string.h>
+#include <stun/MessageView.h>
+#include <stun/AttributeRegistry.h>
+
+namespace stun {
+
+  /* --------------------------------------------------------------------- */
+
+  static uint16_t view_read_u16(const uint8_t* ptr);
+  static uint32_t view_read_u32(const uint8_t* ptr);
+  static uint64_t view_read_u64(const uint8_t* ptr);
+
+  /* --------------------------------------------------------------------- */
+
+  MessageView::MessageView()
+    :data(NULL)
+    ,nbytes(0)
+    ,type(STUN_MSG_TYPE_NONE)
+    ,length(0)
+    ,nattributes(0)
+    ,unknown_attribute(0)
+  {
+    transaction[0] = 0;
+    transaction[1] = 0;
+    transaction[2] = 0;
+  }
+
+  /*
+     Validates the header and attribute bounds as described in
+     http://tools.ietf.org/html/rfc5389#section-6 and section-15.
+     Attributes that follow a MESSAGE-INTEGRITY (other than FINGERPRINT)
+     and attributes that follow a FINGERPRINT are ignored, see
+     http://tools.ietf.org/html/rfc5389#section-15.4
+
+     The lengths of the attributes we know are validated with the
+     AttributeRegistry; unknown comprehension-optional attributes are
+     skipped and unknown comprehension-required attributes make the
+     message invalid (http://tools.ietf.org/html/rfc5389#section-7.3).
+  */
+  int MessageView::parse(const uint8_t* buf, uint32_t len) {
+
+    data = NULL;
+    nbytes = 0;
+    nattributes = 0;
+    unknown_attribute = 0;
+
+    if (!buf) {
+      printf("stun::MessageView - error: received invalid data in MessageView::parse().\n");
+      return -1;
+    }
+
+    /* A stun message must at least contain 20 bytes and the first byte must be in [0, 3], otherwise it's e.g. DTLS or RTP, see http://tools.ietf.org/html/rfc7983#section-7 */
+    if (len < 20 || buf[0] > 3) {
+      return 1;
+    }
+
+    /* magic cookie: 0x2112A442 */
+    if (buf[4] != 0x21 || buf[5] != 0x12 || buf[6] != 0xA4 || buf[7] != 0x42) {
+      return 1;
+    }
+
+    type = view_read_u16(buf);
+    length = view_read_u16(buf + 2);
+
+    /* The Message-Length must be a multiple of 4 and must match the size of the datagram. */
+    if ((length & 0x03) != 0 || (uint32_t)length + 20 != len) {
+      return -1;
+    }
+
+    transaction[0] = view_read_u32(buf + 8);
+    transaction[1] = view_read_u32(buf + 12);
+    transaction[2] = view_read_u32(buf + 16);
+
+    uint32_t dx = 20;
+    bool got_integrity = false;
+
+    while (dx < len) {
+
+      if (len - dx < 4) {
+        return -1;
+      }
+
+      uint16_t attr_type = view_read_u16(buf + dx);
+      uint16_t attr_length = view_read_u16(buf + dx + 2);
+      uint32_t attr_nbytes = 4 + ((attr_length + 3) & ~0x03);
+
+      if (attr_nbytes > len - dx) {
+        return -1;
+      }
+
+      if (false == got_integrity || STUN_ATTR_FINGERPRINT == attr_type) {
+
+        const AttributeInfo* info = find_attribute_info(attr_type);
+        if (NULL == info) {
+          if (attribute_is_comprehension_required(attr_type)) {
+            unknown_attribute = attr_type;
+            return -2;
+          }
+          dx += attr_nbytes;
+          continue;
+        }
+
+        if (attr_length < info->min_length || attr_length > info->max_length) {
+          return -1;
+        }
+
+        if (nattributes >= STUN_VIEW_MAX_ATTRIBUTES) {
+          printf("stun::MessageView - error: message contains more than %d attributes.\n", STUN_VIEW_MAX_ATTRIBUTES);
+          return -1;
+        }
+
+        AttributeSpan& span = attributes[nattributes];
+        span.type = attr_type;
+        span.length = attr_length;
+        span.offset = dx;
+        nattributes++;
+      }
+
+      dx += attr_nbytes;
+
+      if (STUN_ATTR_MESSAGE_INTEGRITY == attr_type) {
+        got_integrity = true;
+      }
+      else if (STUN_ATTR_FINGERPRINT == attr_type) {
+        break;
+      }
+    }
+
+    data = buf;
+    nbytes = len;
+
+    return 0;
+  }
+
+  bool MessageView::hasAttribute(uint16_t atype) {
+    for (uint32_t i = 0; i < nattributes; ++i) {
+      if (attributes[i].type == atype) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool MessageView::find(uint16_t atype, AttributeSpan** result) {
+    for (uint32_t i = 0; i < nattributes; ++i) {
+      if (attributes[i].type == atype) {
+        *result = &attributes[i];
+        return true;
+      }
+    }
+    *result = NULL;
+    return false;
+  }
+
+  const uint8_t* MessageView::value(AttributeSpan* span) {
+    return data + span->offset + 4;
+  }
+
+  bool MessageView::findUsername(const uint8_t** result, uint16_t* len) {
+    AttributeSpan* span = NULL;
+    if (!find(STUN_ATTR_USERNAME, &span)) {
+      return false;
+    }
+    *result = value(span);
+    *len = span->length;
+    return true;
+  }
+
+  bool MessageView::findPriority(uint32_t* result) {
+    AttributeSpan* span = NULL;
+    if (!find(STUN_ATTR_PRIORITY, &span) || span->length != 4) {
+      return false;
+    }
+    *result = view_read_u32(value(span));
+    return true;
+  }
+
+  bool MessageView::findIceControlled(uint64_t* tieBreaker) {
+    AttributeSpan* span = NULL;
+    if (!find(STUN_ATTR_ICE_CONTROLLED, &span) || span->length != 8) {
+      return false;
+    }
+    *tieBreaker = view_read_u64(value(span));
+    return true;
+  }
+
+  bool MessageView::findIceControlling(uint64_t* tieBreaker) {
+    AttributeSpan* span = NULL;
+    if (!find(STUN_ATTR_ICE_CONTROLLING, &span) || span->length != 8) {
+      return false;
+    }
+    *tieBreaker = view_read_u64(value(span));
+    return true;
+  }
+
+  /* See http://tools.ietf.org/html/rfc5389#section-15.2 */
+  bool MessageView::findXorMappedAddress(uint8_t* family, uint16_t* port, uint32_t* ip) {
+    AttributeSpan* span = NULL;
+    if (!find(STUN_ATTR_XOR_MAPPED_ADDRESS, &span) || span->length < 8) {
+      return false;
+    }
+
+    const uint8_t* ptr = value(span);
+    if (ptr[1] != STUN_IP4) {
+      /* @todo MessageView::findXorMappedAddress() - implement IPv6. */
+      return false;
+    }
+
+    *family = ptr[1];
+    *port = view_read_u16(ptr + 2) ^ 0x2112;
+    *ip = view_read_u32(ptr + 4) ^ 0x2112A442;
+    return true;
+  }
+
+  bool MessageView::findMessageIntegrity(const uint8_t** sha1) {
+    AttributeSpan* span = NULL;
+    if (!find(STUN_ATTR_MESSAGE_INTEGRITY, &span) || span->length != 20) {
+      return false;
+    }
+    *sha1 = value(span);
+    return true;
+  }
+
+  bool MessageView::findFingerprint(uint32_t* crc) {
+    AttributeSpan* span = NULL;
+    if (!find(STUN_ATTR_FINGERPRINT, &span) || span->length != 4) {
+      return false;
+    }
+    *crc = view_read_u32(value(span));
+    return true;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  static uint16_t view_read_u16(const uint8_t* ptr) {
+    return ((uint16_t)ptr[0] << 8) | (uint16_t)ptr[1];
+  }
+
+  static uint32_t view_read_u32(const uint8_t* ptr) {
+    return ((uint32_t)ptr[0] << 24)
+      | ((uint32_t)ptr[1] << 16)
+      | ((uint32_t)ptr[2] << 8)
+      | (uint32_t)ptr[3];
+  }
+
+  static uint64_t view_read_u64(const uint8_t* ptr) {
+    return ((uint64_t)view_read_u32(ptr) << 32) | (uint64_t)view_read_u32(ptr + 4);
+  }
+
+} /* namespace stun */
@@ -1,5 +1,7 @@
 #include <string.h>
+#include <algorithm>
 #include <stun/Reader.h>
+#include <stun/AttributeRegistry.h>
 #include <openssl/engine.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
@@ -18,7 +20,6 @@ namespace stun {
   }
 
   /* @todo Reader::process - we can optimize this part by not copying but setting pointers to the  members of the Message. */
-  /* @todo Reader::process - we need to implement the rules as described here: http://tools.ietf.org/html/rfc5389#section-7.3 */
   int Reader::process(uint8_t* data, uint32_t nbytes, Message* msg) {
 
     if (!data) {
@@ -46,7 +47,9 @@ namespace stun {
       return 1;
     }
 
+#if !defined(NDEBUG)
     printf("stun::Reader - verbose: data to process: %u bytes, %lu.\n", nbytes, buffer.size());
+#endif
     
     /* create the base message */
     msg->type = readU16();
@@ -68,136 +71,75 @@ namespace stun {
     /* copy the data into the message, @todo - is this used anywhere; and do we need it? */
     std::copy(data, data + nbytes, std::back_inserter(msg->buffer));
 
-    /* parse the rest of the message */
-    int c = 0;
+    /* parse the rest of the message, attributes are dispatched and validated using the AttributeRegistry */
     uint16_t attr_type;
     uint16_t attr_length;
     uint32_t attr_offset;
-    uint32_t prev_dx;
+    uint32_t attr_padded;
+    const AttributeInfo* info;
     
     while (bytesLeft() >= 4) {
       
       Attribute* attr = NULL;
-      prev_dx = dx;
       attr_offset = dx; 
       attr_type = readU16();
       attr_length = readU16();
+      attr_padded = (attr_length + 3) & ~0x03;
 
+#if !defined(NDEBUG)
       printf("stun::Reader - received message type: %s, Type: %s, Length: %d, bytes left: %u, current index: %ld\n", 
              message_type_to_string(msg->type).c_str(),
-             attribute_type_to_string(attr_type).c_str(), 
+             attribute_type_name(attr_type),
              attr_length, 
              bytesLeft(), 
              dx);
+#endif
 
-      switch (attr_type) {
-
-
-        /* no parsing needed for these */
-        case STUN_ATTR_USE_CANDIDATE: {
-          attr = new Attribute();
-          break;
-        }
-
-        case STUN_ATTR_USERNAME: { 
-          Username* username = new Username();
-          username->value = readString(attr_length);
-          attr = (Attribute*) username;
-          break;
-        }
-
-        case STUN_ATTR_SOFTWARE: { 
-          Software* software = new Software();
-          software->value = readString(attr_length);
-          attr = (Attribute*) software;
-          break;
-        }
-
-        case STUN_ATTR_XOR_MAPPED_ADDRESS: {
-          XorMappedAddress* address = readXorMappedAddress();
-          if (address) {
-            attr = (Attribute*) address;
-          }
-          break;
-        }
-
-        case STUN_ATTR_PRIORITY: {
-          /* priority: http://tools.ietf.org/html/rfc5245#section-4.1.2.1 */
-          Priority* prio = new Priority();
-          prio->value = readU32();
-          attr = (Attribute*) prio;
-          printf("stun::Reader - verbose: priority: %u\n", prio->value);
-          break;
-        } 
-
-        case STUN_ATTR_MESSAGE_INTEGRITY: {     
-          MessageIntegrity* integ = new MessageIntegrity();
-          memcpy(integ->sha1, &buffer[dx], 20);
-          printf("stun::Reader - received Message-Integrity: ");
-          for (int k = 0; k < 20; ++k) {
-            printf("%02X ", integ->sha1[k]);
-          }
-          printf("\n");
-          attr = (Attribute*) integ;
-          skip(20);
-          break;
-        }
-
-        case STUN_ATTR_FINGERPRINT: {
-          /* CRC32-bit, see http://tools.ietf.org/html/rfc5389#section-15.5 */
-          Fingerprint* fp = new Fingerprint();
-          fp->crc = readU32();
-          attr = (Attribute*) fp;
-          break;
-        }
+      if (attr_length > bytesLeft()) {
+        printf("stun::Reader - error: attribute 0x%04X has a length of %u but we only have %u bytes left.\n", attr_type, attr_length, bytesLeft());
+        return reset(-1);
+      }
 
-        case STUN_ATTR_ICE_CONTROLLED: {
-          IceControlled* ic = new IceControlled();
-          ic->tie_breaker = readU64();
-          attr = (Attribute*) ic;
-          break;
+      info = find_attribute_info(attr_type);
+      if (NULL == info) {
+        if (attribute_is_comprehension_required(attr_type)) {
+          /* See http://tools.ietf.org/html/rfc5389#section-7.3 */
+          printf("stun::Reader - error: unknown comprehension-required attribute 0x%04X.\n", attr_type);
+          return reset(-1);
         }
+        skip(std::min<uint32_t>(attr_padded, bytesLeft()));
+        continue;
+      }
 
-        case STUN_ATTR_ICE_CONTROLLING: {
-          IceControlling* ic = new IceControlling();
-          ic->tie_breaker = readU64();
-          attr = (Attribute*) ic;
-          break;
-        }
+      if (attr_length < info->min_length || attr_length > info->max_length) {
+        printf("stun::Reader - error: invalid length %u for %s.\n", attr_length, info->name);
+        return reset(-1);
+      }
 
-        default: {
-          printf("stun::Reader - error: unhandled STUN attribute %s of length: %u, this will result in incorrect message integrity\n", attribute_type_to_string(attr_type).c_str(), attr_length);
-          break;
-        }
+      if (info->decode) {
+        attr = info->decode(ptr(), attr_length);
       }
 
       /* Padding: http://tools.ietf.org/html/rfc5389#section-15, must be 32bit aligned */
-      while ( (dx & 0x03) != 0 && bytesLeft() > 0) {
-        dx++;
-      }
+      skip(std::min<uint32_t>(attr_padded, bytesLeft()));
 
       /* when we parsed an attribute, we set the members and append it to the message */
       if (attr) {
         attr->length = attr_length;
         attr->type = attr_type;
         attr->offset = attr_offset;
-        attr->nbytes = dx - prev_dx;
+        attr->nbytes = dx - attr_offset;
         msg->addAttribute(attr);
       }
-
-      /* reset vars used while parsing */
-      attr = NULL;
-      attr_length = 0;
-      prev_dx = dx;
     }
 
-    /* and erase any read data. */
-    /* @todo - we could use buffer.clear() here ... */
-    buffer.erase(buffer.begin(), buffer.begin() + dx);
-    
-    dx = 0;
+    return reset(0);
+  }
 
-    return 0;
+  int Reader::reset(int result) {
+    buffer.clear();
+    dx = 0;
+    return result;
   }
 
   uint32_t Reader::bytesLeft() {
@@ -298,66 +240,6 @@ namespace stun {
     return v;
   }
 
-  /* See http://tools.ietf.org/html/rfc5389#section-15.2 */
-  XorMappedAddress* Reader::readXorMappedAddress() {
-
-    if (bytesLeft() < 8) {
-      printf("Error: cannot read a XorMappedAddress as the buffer is too small in stun::Reader.\n");
-      return NULL;
-    }
-    
-    XorMappedAddress* addr = new XorMappedAddress();
-    uint32_t ip = 0;
-    uint8_t cookie[] = { 0x42, 0xA4, 0x12, 0x21 }; 
-    uint8_t* port_ptr = (uint8_t*) &addr->port;
-    uint8_t* ip_ptr = (uint8_t*) &ip;
-    unsigned char ip_addr[16];
-
-    /* skip the first byte */
-    skip(1); 
-
-    /* read family: 0x01 = IP4, 0x02 = IP6 */
-    addr->family = readU8();
-    if (addr->family != STUN_IP4 && addr->family != STUN_IP6) {
-      printf("Error: invalid family for the xor mapped address in stun::Reader.\n");
-      delete addr;
-      return NULL;
-    }
-
-    /* read the port. */
-    addr->port = readU16();
-    port_ptr[0] = port_ptr[0] ^ cookie[2];
-    port_ptr[1] = port_ptr[1] ^ cookie[3];
-
-    /* read the address part. */
-    if (addr->family == STUN_IP4) {
-
-      ip = readU32();
-
-      ip_ptr[0] = ip_ptr[0] ^ cookie[0];
-      ip_ptr[1] = ip_ptr[1] ^ cookie[1];
-      ip_ptr[2] = ip_ptr[2] ^ cookie[2];
-      ip_ptr[3] = ip_ptr[3] ^ cookie[3];
-
-      sprintf((char*)ip_addr, "%u.%u.%u.%u", ip_ptr[3], ip_ptr[2], ip_ptr[1], ip_ptr[0]);
-
-      std::copy(ip_addr, ip_addr + 16, std::back_inserter(addr->address));
-    }
-    else if (addr->family == STUN_IP6) {
-      /* @todo read the address for ipv6 in stun::Reader::readXorMappedAddress(). */
-      printf("Warning: we have to implement the IPv6 address in stun::Reader.\n");
-      delete addr;
-      return NULL;
-    }
-    else {
-      printf("Warning: we shouldn't arrive here in stun::Reader.\n");
-      delete addr;
-      return NULL;
-    }
-
-    return addr;
-  }
-
   uint8_t* Reader::ptr() {
     return &buffer[dx];
   }
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <string.h>
+#include <openssl/rand.h>
+#include <stun/TransactionTable.h>
+#include <stun/Utils.h>
+
+namespace stun {
+
+  /* --------------------------------------------------------------------- */
+
+  static void transaction_on_timer(rtc::Timer* timer, void* user);
+  static uint32_t transaction_hash(const uint32_t* id);
+
+  /* --------------------------------------------------------------------- */
+
+  Transaction::Transaction()
+    :nbytes(0)
+    ,key(NULL)
+    ,on_send(NULL)
+    ,on_result(NULL)
+    ,user(NULL)
+    ,rto(0)
+    ,nsent(0)
+    ,hash(0)
+    ,slot(0)
+    ,is_used(false)
+    ,table(NULL)
+    ,next_free(NULL)
+  {
+    transaction[0] = 0;
+    transaction[1] = 0;
+    transaction[2] = 0;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  TransactionTable::TransactionTable()
+    :rto(STUN_TRANSACTION_RTO)
+    ,rc(STUN_TRANSACTION_RC)
+    ,rm(STUN_TRANSACTION_RM)
+    ,nstarted(0)
+    ,nsucceeded(0)
+    ,nfailed(0)
+    ,ntimedout(0)
+    ,nretransmits(0)
+    ,nunmatched(0)
+    ,nrejected(0)
+    ,wheel(NULL)
+    ,pool(NULL)
+    ,free_list(NULL)
+    ,slots(NULL)
+    ,capacity(0)
+    ,mask(0)
+    ,nactive(0)
+    ,random_offset(STUN_TRANSACTION_RANDOM_POOL)
+  {
+  }
+
+  TransactionTable::~TransactionTable() {
+    shutdown();
+  }
+
+  int TransactionTable::init(rtc::TimerWheel* w, uint32_t cap) {
+
+    if (!w) {
+      printf("stun::TransactionTable - error: invalid timer wheel given.\n");
+      return -1;
+    }
+
+    if (0 == cap || cap > (1u << 30)) {
+      printf("stun::TransactionTable - error: invalid capacity: %u\n", cap);
+      return -2;
+    }
+
+    if (pool) {
+      printf("stun::TransactionTable - error: already initialized.\n");
+      return -3;
+    }
+
+    /* at least twice the capacity so the probe sequences stay short. */
+    uint32_t nslots = 2;
+    while (nslots < cap * 2) {
+      nslots <<= 1;
+    }
+
+    pool = new Transaction[cap];
+    slots = new Transaction*[nslots];
+    memset(slots, 0x00, sizeof(Transaction*) * nslots);
+
+    wheel = w;
+    capacity = cap;
+    mask = nslots - 1;
+    nactive = 0;
+    free_list = NULL;
+
+    for (uint32_t i = cap; i > 0; --i) {
+      Transaction* trans = &pool[i - 1];
+      trans->table = this;
+      trans->timer.on_timeout = transaction_on_timer;
+      trans->timer.user = trans;
+      trans->next_free = free_list;
+      free_list = trans;
+    }
+
+    return 0;
+  }
+
+  Transaction* TransactionTable::create() {
+
+    if (!free_list) {
+      if (!pool) {
+        printf("stun::TransactionTable - error: not initialized.\n");
+      }
+      return NULL;
+    }
+
+    Transaction* trans = free_list;
+
+    /* a collision of 96 random bits is very unlikely, but we must never have two active transactions with the same id. */
+    do {
+      if (!generateId(trans->transaction)) {
+        return NULL;
+      }
+    } while (NULL != find(trans->transaction));
+
+    free_list = trans->next_free;
+    trans->next_free = NULL;
+    trans->nbytes = 0;
+    trans->key = NULL;
+    trans->on_send = NULL;
+    trans->on_result = NULL;
+    trans->user = NULL;
+    trans->rto = rto;
+    trans->nsent = 0;
+    trans->is_used = true;
+
+    insert(trans);
+    nactive++;
+
+    return trans;
+  }
+
+  int TransactionTable::start(Transaction* trans, int nbytes) {
+
+    if (!trans || trans->table != this || !trans->is_used) {
+      printf("stun::TransactionTable - error: invalid transaction given to start().\n");
+      return -1;
+    }
+
+    if (nbytes < 20 || nbytes > STUN_TRANSACTION_MAX_REQUEST_SIZE) {
+      printf("stun::TransactionTable - error: invalid request size: %d\n", nbytes);
+      release(trans);
+      return -2;
+    }
+
+    if (!trans->on_send || !trans->on_result) {
+      printf("stun::TransactionTable - error: the on_send and on_result callbacks must be set.\n");
+      release(trans);
+      return -3;
+    }
+
+    trans->nbytes = nbytes;
+    trans->nsent = 1;
+    trans->rto = rto;
+
+    if (!trans->on_send(trans, trans->request, trans->nbytes, trans->user)) {
+      release(trans);
+      return -4;
+    }
+
+    nstarted++;
+
+    wheel->start(&trans->timer, (rc > 1) ? trans->rto : (uint64_t)rm * rto);
+
+    return 0;
+  }
+
+  void TransactionTable::cancel(Transaction* trans) {
+
+    if (!trans || trans->table != this || !trans->is_used) {
+      return;
+    }
+
+    release(trans);
+  }
+
+  int TransactionTable::process(MessageView* response) {
+
+    int result;
+
+    if (!response || !response->data) {
+      return -1;
+    }
+
+    if (message_is_success_response(response->type)) {
+      result = STUN_TRANSACTION_SUCCESS;
+    }
+    else if (message_is_error_response(response->type)) {
+      result = STUN_TRANSACTION_ERROR;
+    }
+    else {
+      return 1;
+    }
+
+    Transaction* trans = find(response->transaction);
+    if (!trans) {
+      nunmatched++;
+      return 1;
+    }
+
+    /*
+       Responses that fail the checks are ignored and the transaction keeps running,
+       see http://tools.ietf.org/html/rfc5389#section-10.1.3
+    */
+    if (response->hasAttribute(STUN_ATTR_FINGERPRINT) && !verify_fingerprint(response)) {
+      nrejected++;
+      return -2;
+    }
+
+    if (trans->key && !verify_message_integrity(response, trans->key)) {
+      nrejected++;
+      return -3;
+    }
+
+    if (STUN_TRANSACTION_SUCCESS == result) {
+      nsucceeded++;
+    }
+    else {
+      nfailed++;
+    }
+
+    wheel->stop(&trans->timer);
+    trans->on_result(trans, result, response, trans->user);
+    release(trans);
+
+    return 0;
+  }
+
+  Transaction* TransactionTable::find(const uint32_t* id) {
+
+    if (!slots) {
+      return NULL;
+    }
+
+    uint32_t i = transaction_hash(id) & mask;
+
+    while (NULL != slots[i]) {
+      Transaction* trans = slots[i];
+      if (trans->transaction[0] == id[0]
+          && trans->transaction[1] == id[1]
+          && trans->transaction[2] == id[2])
+      {
+        return trans;
+      }
+      i = (i + 1) & mask;
+    }
+
+    return NULL;
+  }
+
+  void TransactionTable::handleTimeout(Transaction* trans) {
+
+    if (trans->nsent >= rc) {
+      ntimedout++;
+      trans->on_result(trans, STUN_TRANSACTION_TIMEOUT, NULL, trans->user);
+      release(trans);
+      return;
+    }
+
+    trans->on_send(trans, trans->request, trans->nbytes, trans->user);
+    trans->nsent++;
+    nretransmits++;
+
+    if (trans->nsent >= rc) {
+      wheel->start(&trans->timer, (uint64_t)rm * rto);
+    }
+    else {
+      trans->rto *= 2;
+      wheel->start(&trans->timer, trans->rto);
+    }
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  void TransactionTable::insert(Transaction* trans) {
+
+    uint32_t i;
+
+    trans->hash = transaction_hash(trans->transaction);
+    i = trans->hash & mask;
+
+    while (NULL != slots[i]) {
+      i = (i + 1) & mask;
+    }
+
+    slots[i] = trans;
+    trans->slot = i;
+  }
+
+  /* Backward shift deletion, so we don't need tombstones and lookups stay short. */
+  void TransactionTable::remove(Transaction* trans) {
+
+    uint32_t i = trans->slot;
+    uint32_t j = i;
+
+    slots[i] = NULL;
+
+    while (true) {
+
+      j = (j + 1) & mask;
+      if (NULL == slots[j]) {
+        break;
+      }
+
+      /* the entry at j can move into the hole at i when its home slot is not cyclically in (i, j]. */
+      uint32_t home = slots[j]->hash & mask;
+      bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+      if (stays) {
+        continue;
+      }
+
+      slots[i] = slots[j];
+      slots[i]->slot = i;
+      slots[j] = NULL;
+      i = j;
+    }
+  }
+
+  void TransactionTable::release(Transaction* trans) {
+
+    if (!trans->is_used) {
+      return;
+    }
+
+    wheel->stop(&trans->timer);
+    remove(trans);
+
+    trans->is_used = false;
+    trans->on_send = NULL;
+    trans->on_result = NULL;
+    trans->user = NULL;
+    trans->key = NULL;
+    trans->next_free = free_list;
+    free_list = trans;
+
+    nactive--;
+  }
+
+  /* The transaction id must be cryptographically random, see http://tools.ietf.org/html/rfc5389#section-6 */
+  bool TransactionTable::generateId(uint32_t* id) {
+
+    if (random_offset + 12 > STUN_TRANSACTION_RANDOM_POOL) {
+      if (1 != RAND_bytes(random, STUN_TRANSACTION_RANDOM_POOL)) {
+        printf("stun::TransactionTable - error: cannot generate random bytes.\n");
+        return false;
+      }
+      random_offset = 0;
+    }
+
+    memcpy(id, random + random_offset, 12);
+    random_offset += 12;
+
+    return true;
+  }
+
+  void TransactionTable::shutdown() {
+
+    if (pool) {
+      for (uint32_t i = 0; i < capacity; ++i) {
+        wheel->stop(&pool[i].timer);
+      }
+      delete[] pool;
+      pool = NULL;
+    }
+
+    if (slots) {
+      delete[] slots;
+      slots = NULL;
+    }
+
+    free_list = NULL;
+    capacity = 0;
+    mask = 0;
+    nactive = 0;
+  }
+
+  /* --------------------------------------------------------------------- */
+
+  static void transaction_on_timer(rtc::Timer*, void* user) {
+    Transaction* trans = static_cast<Transaction*>(user);
+    trans->table->handleTimeout(trans);
+  }
+
+  static uint32_t transaction_hash(const uint32_t* id) {
+    uint32_t h = id[0] * 0x9E3779B1u;
+    h ^= id[1] * 0x85EBCA77u;
+    h ^= id[2] * 0xC2B2AE3Du;
+    return h ^ (h >> 16);
+  }
+
+} /* namespace stun */
@@ -1,15 +1,15 @@
 #include <stdio.h>
+#include <string.h>
 #include <openssl/engine.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
-#include <zlib.h>  /* for crc */
 
 #include <stun/Types.h>
 #include <stun/Utils.h>
 
 namespace stun {
 
-  bool compute_hmac_sha1(uint8_t* message, uint32_t nbytes, std::string key, uint8_t* output) {
+  bool compute_hmac_sha1(uint8_t* message, uint32_t nbytes, const std::string& key, uint8_t* output) {
 
     if (!message) { 
       printf("Error: can't compute hmac_sha1 as the input message is empty in compute_hmac_sha1().\n");
@@ -42,7 +42,7 @@ namespace stun {
     HMAC_Update(&ctx, (const unsigned char*)message, nbytes);
     HMAC_Final(&ctx, output, &len);
 
-#if 1
+#if 0
     printf("stun::compute_hmac_sha1 - verbose: computing hash over %u bytes, using key `%s`:\n", nbytes, key.c_str());
     printf("-----------------------------------\n\t0: ");
     int nl = 0, lines = 0;
@@ -58,7 +58,7 @@ namespace stun {
     printf("\n-----------------------------------\n");
 #endif
 
-#if 1
+#if 0
     printf("stun::compute_hmac_sha1 - verbose: computed hash: ");
     for(unsigned int i = 0; i < len; ++i) {
       printf("%02X ", output[i]);
@@ -70,7 +70,7 @@ namespace stun {
     
   }
 
-  bool compute_message_integrity(std::vector<uint8_t>& buffer, std::string key, uint8_t* output) {
+  bool compute_message_integrity(std::vector<uint8_t>& buffer, const std::string& key, uint8_t* output) {
 
     uint16_t dx = 20;
     uint16_t offset = 0;
@@ -188,7 +188,7 @@ namespace stun {
     buffer[2] = (offset >> 8) & 0xFF;
     buffer[3] = offset & 0xFF;
 
-    result = crc32(0L, &buffer[0], offset + 12) ^ 0x5354554e;
+    result = crc32_ieee(0, &buffer[0], offset + 12) ^ 0x5354554e;
     
     /* and reset the size */
     buffer[2] = curr_size[0];
@@ -198,4 +198,94 @@ namespace stun {
     return true;
   }
 
+  bool verify_fingerprint(MessageView* msg) {
+
+    AttributeSpan* span = NULL;
+    uint32_t expected = 0;
+    uint32_t crc = 0;
+    uint16_t length = 0;
+    uint8_t header[4];
+
+    if (!msg || !msg->data) {
+      return false;
+    }
+
+    if (!msg->find(STUN_ATTR_FINGERPRINT, &span) || !msg->findFingerprint(&expected)) {
+      return false;
+    }
+
+    /* The crc is computed over the message up to the FINGERPRINT, with a Message-Length that includes the FINGERPRINT. */
+    length = span->offset + 8 - 20;
+    header[0] = msg->data[0];
+    header[1] = msg->data[1];
+    header[2] = (length >> 8) & 0xFF;
+    header[3] = length & 0xFF;
+
+    crc = crc32_ieee(0, header, 4);
+    crc = crc32_ieee(crc, msg->data + 4, span->offset - 4);
+
+    return (crc ^ 0x5354554e) == expected;
+  }
+
+  bool verify_username(MessageView* msg, const std::string& ufrag) {
+
+    const uint8_t* username = NULL;
+    uint16_t nbytes = 0;
+
+    if (!msg || 0 == ufrag.size()) {
+      return false;
+    }
+
+    if (!msg->findUsername(&username, &nbytes)) {
+      return false;
+    }
+
+    if (nbytes <= ufrag.size() || ':' != username[ufrag.size()]) {
+      return false;
+    }
+
+    return 0 == memcmp(username, ufrag.c_str(), ufrag.size());
+  }
+
+  bool verify_message_integrity(MessageView* msg, IntegrityKey* key) {
+
+    AttributeSpan* span = NULL;
+
+    if (!msg || !msg->data || !key) {
+      return false;
+    }
+
+    if (!msg->find(STUN_ATTR_MESSAGE_INTEGRITY, &span) || 20 != span->length) {
+      return false;
+    }
+
+    /* The hmac is computed over the message up to the MESSAGE-INTEGRITY, with a Message-Length that includes the MESSAGE-INTEGRITY. */
+    return key->verifyMessage(msg->data, span->offset, span->offset + 24 - 20, msg->value(span));
+  }
+
+  int verify_request(MessageView* msg, const std::string& ufrag, IntegrityKey* key) {
+
+    if (!msg->hasAttribute(STUN_ATTR_FINGERPRINT)) {
+      return STUN_VERIFY_NO_FINGERPRINT;
+    }
+
+    if (!verify_fingerprint(msg)) {
+      return STUN_VERIFY_INVALID_FINGERPRINT;
+    }
+
+    if (!verify_username(msg, ufrag)) {
+      return STUN_VERIFY_INVALID_USERNAME;
+    }
+
+    if (!msg->hasAttribute(STUN_ATTR_MESSAGE_INTEGRITY)) {
+      return STUN_VERIFY_NO_INTEGRITY;
+    }
+
+    if (!verify_message_integrity(msg, key)) {
+      return STUN_VERIFY_INVALID_INTEGRITY;
+    }
+
+    return STUN_VERIFY_OK;
+  }
+
 } /* namespace stun */
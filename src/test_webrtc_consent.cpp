@@ -0,0 +1,144 @@
+/*
+
+  test_webrtc_consent
+  -------------------
+
+  Consent freshness of the selected pair (RFC 7675). While the other
+  agent answers our consent checks the selected pair stays past
+  ICE_CONSENT_TIMEOUT, even when it doesn't send any checks itself. When
+  it stops answering, the pair expires: it's removed and the stream has
+  nothing selected anymore. We run the shared timer wheel of the context
+  ourself, so the timeouts don't take real time. Every agent uses its own
+  random ICE-CONTROLLED tie breaker.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ice/Agent.h>
+#include <stun/BufferWriter.h>
+#include <stun/MessageView.h>
+#include <test_webrtc_utils.h>
+
+#define PORT 45510
+#define UFRAG "5PN2qmWqBl"
+#define PWD "Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC"
+#define REMOTE_UFRAG "remote"
+#define REMOTE_PWD "2lYQsc6pTIZc9IdXUzmGcBLy2sa6Ga8p"
+
+struct Client {
+  rtc::ConnectionUDP conn;
+  uint32_t nchecks;                                            /* the consent checks we received */
+  bool answer;                                                 /* answer the checks of the agent */
+};
+
+static Client client;
+static rtc::Endpoint dest;
+static stun::IntegrityKey remote_key;
+
+static void pump(ice::Stream* stream, int num);
+static void advance(ice::AgentContext& context, ice::Stream* stream, uint64_t millis);
+static void client_on_data(rtc::Packet* pkt, void* user);
+
+int main() {
+
+  printf("\n\ntest_webrtc_consent\n\n");
+
+  ice::AgentContext context;
+  ice::Agent agent;
+  ice::Agent other_agent;
+  ice::Stream* stream = new ice::Stream(STREAM_FLAG_RTCP_MUX);
+
+  /* no certificate: there is no handshake. */
+  check(0 == context.init(64), "init the agent context");
+  check(agent.tie_breaker != other_agent.tie_breaker, "each agent has its own tie breaker");
+
+  stream->addLocalCandidate(new ice::Candidate("127.0.0.1", PORT));
+  agent.setContext(&context);
+  agent.addStream(stream);
+  agent.setCredentials(UFRAG, PWD);
+  agent.setRemoteCredentials(REMOTE_UFRAG, REMOTE_PWD);
+  check(stream->init(), "init the stream");
+  check(dest.set("127.0.0.1", PORT), "create the destination endpoint");
+  check(remote_key.setKey(REMOTE_PWD), "create the key of the client");
+  check(client.conn.bind("127.0.0.1", PORT + 1), "bind the client");
+
+  client.conn.on_data = client_on_data;
+  client.conn.user = &client;
+  client.nchecks = 0;
+  client.answer = true;
+
+  /* the nomination selects the pair */
+  send_request(client.conn, dest, UFRAG ":" REMOTE_UFRAG, &stream->integrity_key, true);
+  pump(stream, 50);
+
+  ice::CandidatePair* pair = stream->selected;
+  check(NULL != pair && 1 == stream->pairs.size() && ice::CANDIDATE_PAIR_STATE_NOMINATED == pair->state, "the nomination selects the pair");
+
+  /* the answers to our checks are consent, the client doesn't send any checks */
+  {
+    advance(context, stream, ICE_CONSENT_TIMEOUT + ICE_CONSENT_INTERVAL);
+
+    check(0 < client.nchecks, "we send consent checks on the selected pair");
+    check(pair == stream->selected && 1 == stream->pairs.size(), "the answered checks keep the pair");
+    check(context.timers.now() - pair->consent_time < ICE_CONSENT_TIMEOUT, "the answers refresh the consent");
+  }
+
+  /* without answers consent expires */
+  {
+    uint32_t nchecks = client.nchecks;
+    client.answer = false;
+
+    advance(context, stream, ICE_CONSENT_TIMEOUT + ICE_CONSENT_INTERVAL);
+
+    check(nchecks < client.nchecks, "we keep sending consent checks");
+    check(0 == stream->pairs.size() && 0 == stream->remote_candidates.size(), "the pair without consent is removed");
+    check(NULL == stream->selected, "nothing is selected anymore");
+  }
+
+  client.conn.close();
+  stream->local_candidates[0]->conn.close();
+  uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void pump(ice::Stream* stream, int num) {
+  for (int i = 0; i < num; ++i) {
+    client.conn.update();
+    stream->update();
+  }
+}
+
+/* moves the clock of the wheel forward one tick at a time, so the timers fire in order. */
+static void advance(ice::AgentContext& context, ice::Stream* stream, uint64_t millis) {
+  uint64_t end = context.timers.now() + millis;
+  while (context.timers.now() < end) {
+    context.timers.update(context.timers.now() + TIMER_WHEEL_DEFAULT_RESOLUTION);
+    pump(stream, 2);
+  }
+}
+
+static void client_on_data(rtc::Packet* pkt, void* user) {
+
+  Client* c = static_cast<Client*>(user);
+
+  stun::MessageView msg;
+  if (0 != msg.parse(pkt->data, pkt->nbytes) || stun::STUN_BINDING_REQUEST != msg.type) {
+    return;
+  }
+
+  c->nchecks++;
+
+  if (false == c->answer) {
+    return;
+  }
+
+  /* answer with a success response for the same transaction. */
+  uint8_t buffer[256];
+  stun::BufferWriter writer(buffer, sizeof(buffer));
+  writer.begin(stun::STUN_BINDING_RESPONSE, msg.transaction);
+  c->conn.sendTo(dest, buffer, writer.finish(&remote_key, true));
+}
@@ -0,0 +1,162 @@
+/*
+
+  test_webrtc_demux
+  -----------------
+
+  Checks the RFC 7983 classifier for every first byte, the RFC 5761 split
+  of RTP and RTCP, and that an ice::Agent counts each class on the pair
+  the packets arrive on. There is no DTLS handshake in this test, so the
+  media can't be unprotected and is counted as a SRTP error.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rtc/Demux.h>
+#include <ice/Agent.h>
+#include <test_webrtc_utils.h>
+
+#define PORT 45470
+#define UFRAG "5PN2qmWqBl"
+#define PWD "Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC"
+#define NUM_RTP 20
+#define NUM_RTCP 5
+#define NUM_UNKNOWN 3
+#define RTP_SIZE 172
+#define RTCP_SIZE 52
+#define UNKNOWN_SIZE 30
+
+static int expected_class(uint8_t first, uint8_t second);
+static void pump(rtc::ConnectionUDP& client, ice::Stream* stream);
+static void send_packet(rtc::ConnectionUDP& client, rtc::Endpoint& dest, uint8_t first, uint8_t second, uint32_t nbytes);
+
+int main() {
+
+  printf("\n\ntest_webrtc_demux\n\n");
+
+  /* the classifier */
+  {
+    uint8_t pkt[12];
+    uint32_t nwrong = 0;
+
+    memset(pkt, 0x00, sizeof(pkt));
+
+    for (uint32_t first = 0; first < 256; ++first) {
+      for (uint32_t second = 0; second < 256; ++second) {
+        pkt[0] = first;
+        pkt[1] = second;
+        if (expected_class(first, second) != rtc::classify_packet(pkt, sizeof(pkt))) {
+          nwrong++;
+        }
+      }
+    }
+
+    check(0 == nwrong, "all first and second bytes are classified as in RFC 7983 and RFC 5761");
+
+    pkt[0] = 0x80;
+    pkt[1] = 0xC8;
+    check(rtc::PACKET_CLASS_RTCP == rtc::classify_packet(pkt, 8), "a sender report is RTCP");
+
+    pkt[1] = 0x80 | 96;
+    check(rtc::PACKET_CLASS_RTP == rtc::classify_packet(pkt, 12), "payload type 96 with the marker bit is RTP");
+
+    check(rtc::PACKET_CLASS_UNKNOWN == rtc::classify_packet(pkt, 3), "a packet that's too small is unknown");
+    check(rtc::PACKET_CLASS_UNKNOWN == rtc::classify_packet(NULL, 0), "an empty packet is unknown");
+  }
+
+  /* the counters of an agent */
+  {
+    ice::AgentContext context;
+    ice::Agent agent;
+    ice::Stream* stream = new ice::Stream(STREAM_FLAG_RTCP_MUX);
+    rtc::ConnectionUDP client;
+    rtc::Endpoint dest;
+
+    /* the agent needs certificates for dtls in init(); without a handshake we don't need them, so we give it a context without one. */
+    check(0 == context.init(64), "init the agent context");
+    stream->addLocalCandidate(new ice::Candidate("127.0.0.1", PORT));
+    agent.setContext(&context);
+    agent.addStream(stream);
+    agent.setCredentials(UFRAG, PWD);
+    check(stream->init(), "init the stream");
+
+    check(client.bind("127.0.0.1", PORT + 1), "bind the client");
+    check(dest.set("127.0.0.1", PORT), "create the destination endpoint");
+
+    /* media before there's a pair is dropped */
+    send_packet(client, dest, 0x80, 96, RTP_SIZE);
+    pump(client, stream);
+    check(0 == stream->pairs.size(), "media doesn't create a pair");
+
+    send_request(client, dest, UFRAG ":remote", &stream->integrity_key, true);
+    pump(client, stream);
+    check(1 == stream->pairs.size(), "the binding request created a pair");
+
+    for (uint32_t i = 0; i < NUM_RTP; ++i) {
+      send_packet(client, dest, 0x80, 0x80 | 96, RTP_SIZE);
+    }
+    for (uint32_t i = 0; i < NUM_RTCP; ++i) {
+      send_packet(client, dest, 0x80, 0xC9, RTCP_SIZE);
+    }
+    for (uint32_t i = 0; i < NUM_UNKNOWN; ++i) {
+      send_packet(client, dest, 0x50, 0x00, UNKNOWN_SIZE);
+    }
+    send_packet(client, dest, 0x00, 0x01, UNKNOWN_SIZE);
+    pump(client, stream);
+
+    ice::CandidatePair* pair = stream->pairs[0];
+    rtc::PacketCounters& counters = pair->recv_counters;
+
+    for (int i = 0; i < rtc::PACKET_CLASS_COUNT; ++i) {
+      printf("%-8s %6llu packets %8llu bytes\n",
+             rtc::packet_class_to_string(i),
+             (unsigned long long)counters.npackets[i],
+             (unsigned long long)counters.nbytes[i]);
+    }
+
+    check(1 == counters.npackets[rtc::PACKET_CLASS_STUN], "counted the binding request");
+    check(NUM_RTP == counters.npackets[rtc::PACKET_CLASS_RTP] && NUM_RTP * RTP_SIZE == counters.nbytes[rtc::PACKET_CLASS_RTP], "counted the RTP packets");
+    check(NUM_RTCP == counters.npackets[rtc::PACKET_CLASS_RTCP] && NUM_RTCP * RTCP_SIZE == counters.nbytes[rtc::PACKET_CLASS_RTCP], "counted the RTCP packets");
+    check(NUM_UNKNOWN == counters.npackets[rtc::PACKET_CLASS_UNKNOWN], "counted the unknown packets");
+    check(0 == counters.npackets[rtc::PACKET_CLASS_DTLS], "no DTLS packets");
+    check(NUM_RTP + NUM_RTCP == pair->nsrtp_errors, "media without a handshake can't be unprotected");
+    check(1 == stream->stun_stats.nmalformed, "counted the malformed stun message");
+
+    client.close();
+    stream->local_candidates[0]->conn.close();
+    uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+  }
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+/* a straightforward version of the rules to compare with */
+static int expected_class(uint8_t first, uint8_t second) {
+  if (first <= 3) {
+    return rtc::PACKET_CLASS_STUN;
+  }
+  if (first >= 20 && first <= 63) {
+    return rtc::PACKET_CLASS_DTLS;
+  }
+  if (first >= 128 && first <= 191) {
+    return (second >= 192 && second <= 223) ? rtc::PACKET_CLASS_RTCP : rtc::PACKET_CLASS_RTP;
+  }
+  return rtc::PACKET_CLASS_UNKNOWN;
+}
+
+static void pump(rtc::ConnectionUDP& client, ice::Stream* stream) {
+  for (int i = 0; i < 50; ++i) {
+    client.update();
+    stream->update();
+  }
+}
+
+static void send_packet(rtc::ConnectionUDP& client, rtc::Endpoint& dest, uint8_t first, uint8_t second, uint32_t nbytes) {
+  uint8_t buffer[256];
+  memset(buffer, 0x00, sizeof(buffer));
+  buffer[0] = first;
+  buffer[1] = second;
+  client.sendTo(dest, buffer, nbytes);
+}
@@ -1,9 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <openssl/engine.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#include <stun/IntegrityKey.h>
+
+static bool compare_with_integrity_key(std::string key, std::string data, unsigned char* expected);
 
 int main() {
   printf("\n\ntest_hmac_sha1\n\n");
@@ -42,4 +46,54 @@ int main() {
     printf("%02X ", result[i]);
   }
   printf("\n\n");
+
+  /* the precomputed key schedule must give the same result, also for keys larger than the sha1 block size. */
+  std::string long_key = key + key + key;
+  unsigned char long_result[20];
+  HMAC(EVP_sha1(), long_key.c_str(), long_key.size(), (const unsigned char*)data.c_str(), data.size(), long_result, &len);
+
+  if (!compare_with_integrity_key(key, data, result) 
+      || !compare_with_integrity_key(long_key, data, long_result)) 
+  {
+    printf("Error: stun::IntegrityKey computed a different hash.\n");
+    exit(1);
+  }
+
+  printf("stun::IntegrityKey computed the same hashes.\n\n");
+
+  return 0;
+}
+
+static bool compare_with_integrity_key(std::string key, std::string data, unsigned char* expected) {
+
+  unsigned char result[20];
+  unsigned char batch_result[3][20];
+  stun::IntegrityKey ikey;
+  stun::IntegrityJob jobs[3];
+
+  if (!ikey.setKey(key)) {
+    return false;
+  }
+
+  if (!ikey.compute((const uint8_t*)data.c_str(), data.size(), result)) {
+    return false;
+  }
+
+  for (int i = 0; i < 3; ++i) {
+    jobs[i].data = (const uint8_t*)data.c_str();
+    jobs[i].nbytes = data.size();
+    jobs[i].output = batch_result[i];
+  }
+
+  if (!ikey.computeBatch(jobs, 3)) {
+    return false;
+  }
+
+  for (int i = 0; i < 3; ++i) {
+    if (0 != memcmp(batch_result[i], expected, 20)) {
+      return false;
+    }
+  }
+
+  return 0 == memcmp(result, expected, 20);
 }
@@ -22,7 +22,7 @@
 
 #define PASSWORD "Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC"  /* our ice-pwd value */
 
-static void on_udp_data(std::string rip, uint16_t rport, std::string lip, uint16_t lport, uint8_t* data, uint32_t nbytes, void* user);             /* gets called when we recieve data on our 'candidate' */
+static void on_udp_data(rtc::Packet* pkt, void* user);                            /* gets called when we recieve data on our 'candidate' */
 static void on_dtls_data(uint8_t* data, uint32_t nbytes, void* user);            /* gets called when we need to send DTLS related data */ 
 
 rtc::ConnectionUDP* udp_ptr = NULL;
@@ -142,10 +142,11 @@ int main() {
   return 0;
 }
 
-static void on_udp_data(std::string rip, uint16_t rport, 
-                        std::string lip, uint16_t lport, 
-                        uint8_t* data, uint32_t nbytes, void* user) 
-{
+static void on_udp_data(rtc::Packet* pkt, void* user) {
+
+  uint8_t* data = pkt->data;
+  uint32_t nbytes = pkt->nbytes;
+
   stun::Message msg;
   stun::Reader* stun = static_cast<stun::Reader*>(user);
   int r = stun->process(data, nbytes, &msg);
@@ -40,7 +40,7 @@ static void on_rtp_packet(rtp::PacketVP8* pkt, void* user);
 
 #endif
 
-static void on_rtp_data(ice::Stream* stream, ice::CandidatePair* pair, uint8_t* data, uint32_t nbytes, void* user);
+static void on_rtp_data(ice::Stream* stream, ice::CandidatePair* pair, rtc::Packet* pkt, void* user);
 
 int main() {
 
@@ -151,8 +151,10 @@ int main() {
 
 static void on_rtp_data(ice::Stream* stream, 
                         ice::CandidatePair* pair, 
-                        uint8_t* data, uint32_t nbytes, void* user) 
+                        rtc::Packet* pkt, void* user) 
 {
+  uint8_t* data = pkt->data;
+  uint32_t nbytes = pkt->nbytes;
 
   printf("on_rtp_data - vebose: received RTP data, %u bytes.\n", nbytes);
 
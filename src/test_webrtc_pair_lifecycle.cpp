@@ -0,0 +1,246 @@
+/*
+
+  test_webrtc_pair_lifecycle
+  --------------------------
+
+  Walks the candidate pairs of an ice::Agent through their states: checks
+  without USE-CANDIDATE create succeeded pairs, dtls from an address that
+  didn't pass a check doesn't create one, a nomination selects a pair and
+  removes the losing ones, a nomination with a higher priority
+  moves the media to another pair (the srtp keys are the stream's, so
+  they keep working), idle pairs are removed
+  and when the selected pair loses consent the fallback takes over. We run
+  the timer wheel ourself, so the timeouts don't take real time.
+
+  There is no DTLS handshake in this test; we give the stream srtp keys
+  the way the handshake would.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ice/Agent.h>
+#include <test_webrtc_utils.h>
+
+#define PORT 45490
+#define NUM_CLIENTS 4
+#define UFRAG "5PN2qmWqBl"
+#define PWD "Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC"
+#define REMOTE_UFRAG "remote"
+#define REMOTE_PWD "2lYQsc6pTIZc9IdXUzmGcBLy2sa6Ga8p"
+#define LOW_PRIORITY 0x6e0001ff                                /* the PRIORITY of a prflx candidate */
+#define HIGH_PRIORITY 0x7e0001ff                               /* the PRIORITY of a host candidate */
+#define RTP_SIZE 160
+
+struct Client {
+  rtc::ConnectionUDP conn;
+  uint32_t nrtp;                                               /* the RTP packets we received */
+};
+
+static Client clients[NUM_CLIENTS];
+static rtc::Endpoint dest;
+static uint32_t ntransactions = 0;
+
+static void pump(ice::Stream* stream, int num);
+static void advance(ice::AgentContext& context, ice::Stream* stream, uint64_t millis);
+static void send_check(Client& client, ice::Stream* stream, uint32_t priority, bool nominate);
+static int send_rtp(ice::Stream* stream);
+static void client_on_data(rtc::Packet* pkt, void* user);
+
+int main() {
+
+  printf("\n\ntest_webrtc_pair_lifecycle\n\n");
+
+  ice::AgentContext context;
+  ice::Agent agent;
+  ice::Stream* stream = new ice::Stream(STREAM_FLAG_RTCP_MUX);
+
+  /* no certificate: there is no handshake. The clients don't answer our consent checks, their own checks are consent. */
+  check(0 == context.init(64), "init the agent context");
+
+  stream->addLocalCandidate(new ice::Candidate("127.0.0.1", PORT));
+  agent.setContext(&context);
+  agent.addStream(stream);
+  agent.setCredentials(UFRAG, PWD);
+  agent.setRemoteCredentials(REMOTE_UFRAG, REMOTE_PWD);
+  check(stream->init(), "init the stream");
+  check(dest.set("127.0.0.1", PORT), "create the destination endpoint");
+
+  for (int i = 0; i < NUM_CLIENTS; ++i) {
+    check(clients[i].conn.bind("127.0.0.1", PORT + 1 + i), "bind a client");
+    clients[i].conn.on_data = client_on_data;
+    clients[i].conn.user = &clients[i];
+    clients[i].nrtp = 0;
+  }
+
+  const rtc::Endpoint& local = stream->local_candidates[0]->endpoint;
+  Client& c1 = clients[0];
+  Client& c2 = clients[1];
+  Client& c3 = clients[2];
+  Client& c4 = clients[3];
+
+  /* checks without USE-CANDIDATE */
+  {
+    send_check(c1, stream, LOW_PRIORITY, false);
+    send_check(c2, stream, LOW_PRIORITY, false);
+    pump(stream, 50);
+
+    check(2 == stream->pairs.size(), "each check created a pair");
+    check(ice::CANDIDATE_PAIR_STATE_SUCCEEDED == stream->pairs[0]->state && ice::CANDIDATE_PAIR_STATE_SUCCEEDED == stream->pairs[1]->state, "the pairs we answered a check on succeeded");
+    check(NULL == stream->selected && -3 == send_rtp(stream), "nothing is selected, so we can't send");
+  }
+
+  /* only a check creates a pair; a dtls record from another address is dropped */
+  {
+    uint8_t record[64];
+    memset(record, 0x00, sizeof(record));
+    record[0] = 22;
+    c4.conn.sendTo(dest, record, sizeof(record));
+    pump(stream, 50);
+
+    check(2 == stream->pairs.size() && NULL == stream->findPair(c4.conn.endpoint, local), "dtls doesn't create a pair");
+    check(NULL == stream->dtls, "dtls without a pair doesn't start a handshake");
+  }
+
+  /* a nomination selects the pair and the pairs that weren't nominated are removed */
+  ice::CandidatePair* p1 = stream->findPair(c1.conn.endpoint, local);
+  {
+    size_t nbytes = stream->getMemoryUsage();
+
+    send_check(c1, stream, LOW_PRIORITY, true);
+    pump(stream, 50);
+
+    printf("memory of the stream before the nomination: %zu bytes, after: %zu bytes.\n", nbytes, stream->getMemoryUsage());
+
+    check(ice::CANDIDATE_PAIR_STATE_NOMINATED == p1->state && p1 == stream->selected, "the nominated pair is selected");
+    check(1 == stream->pairs.size() && 1 == stream->remote_candidates.size(), "the losing pair and its remote candidate are removed");
+    check(stream->getMemoryUsage() < nbytes, "the memory of the losing pairs is given back");
+    check(-4 == send_rtp(stream), "we can't send before the handshake");
+
+    uint8_t key[SRTP_PARSER_MASTER_LEN];
+    memset(key, 0x42, sizeof(key));
+    stream->dtls = new ice::DtlsTransport();
+    check(0 == stream->dtls->srtp_out.init("SRTP_AES128_CM_SHA1_80", false, key, key + SRTP_PARSER_MASTER_KEY_LEN), "give the stream srtp keys");
+  }
+
+  /* media only goes to the selected pair */
+  ice::CandidatePair* p2 = NULL;
+  {
+    send_check(c2, stream, HIGH_PRIORITY, false);
+    pump(stream, 50);
+
+    p2 = stream->findPair(c2.conn.endpoint, local);
+    check(NULL != p2 && ice::CANDIDATE_PAIR_STATE_SUCCEEDED == p2->state && 2 == stream->pairs.size(), "a new check creates a pair again");
+    check(p1 == stream->selected, "a check without USE-CANDIDATE doesn't change the selected pair");
+
+    check(0 == send_rtp(stream), "send to the selected pair");
+    pump(stream, 50);
+    check(1 == c1.nrtp && 0 == c2.nrtp, "only the selected pair got the media");
+  }
+
+  /* a nomination with a higher priority moves the media */
+  {
+    send_check(c2, stream, HIGH_PRIORITY, true);
+    pump(stream, 50);
+
+    check(p2 == stream->selected, "the higher priority pair is selected");
+    check(2 == stream->pairs.size() && ice::CANDIDATE_PAIR_STATE_NOMINATED == p1->state, "the other nominated pair stays as fallback");
+
+    check(0 == send_rtp(stream), "send to the new selected pair");
+    pump(stream, 50);
+    check(1 == c1.nrtp && 1 == c2.nrtp, "the media goes to the new pair");
+
+    send_check(c1, stream, LOW_PRIORITY, true);
+    pump(stream, 50);
+    check(p2 == stream->selected, "a nomination with a lower priority doesn't change the selected pair");
+  }
+
+  /* pairs that aren't selected and don't receive anything are removed */
+  {
+    send_check(c3, stream, LOW_PRIORITY, false);
+    pump(stream, 50);
+    check(3 == stream->pairs.size(), "a check from another address created a pair");
+
+    for (int i = 0; i < (2 * ICE_PAIR_IDLE_TIMEOUT) / 1000 + 1; ++i) {
+      send_check(c1, stream, LOW_PRIORITY, true);
+      send_check(c2, stream, HIGH_PRIORITY, true);
+      advance(context, stream, 1000);
+    }
+
+    check(NULL == stream->findPair(c3.conn.endpoint, local) && 2 == stream->pairs.size(), "the idle pair is removed");
+    check(p2 == stream->selected && p1 == stream->findPair(c1.conn.endpoint, local), "the pairs that receive data stay");
+  }
+
+  /* when the selected pair loses consent the fallback is selected */
+  {
+    for (int i = 0; i < ICE_CONSENT_TIMEOUT / 1000 + 1; ++i) {
+      send_check(c1, stream, LOW_PRIORITY, true);
+      advance(context, stream, 1000);
+    }
+
+    check(1 == stream->pairs.size() && p1 == stream->selected, "the pair without consent is removed and the fallback is selected");
+
+    check(0 == send_rtp(stream), "send to the fallback with the keys of the stream");
+    pump(stream, 50);
+    check(2 == c1.nrtp && 1 == c2.nrtp, "the media goes to the fallback");
+  }
+
+  /* without consent nothing is left */
+  {
+    advance(context, stream, ICE_CONSENT_TIMEOUT + 1000);
+
+    check(0 == stream->pairs.size() && 0 == stream->remote_candidates.size(), "all pairs and remote candidates are removed");
+    check(NULL == stream->selected && -3 == send_rtp(stream), "nothing is selected anymore");
+  }
+
+  for (int i = 0; i < NUM_CLIENTS; ++i) {
+    clients[i].conn.close();
+  }
+  stream->local_candidates[0]->conn.close();
+  uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void pump(ice::Stream* stream, int num) {
+  for (int i = 0; i < num; ++i) {
+    for (int k = 0; k < NUM_CLIENTS; ++k) {
+      clients[k].conn.update();
+    }
+    stream->update();
+  }
+}
+
+/* moves the clock of the wheel forward one tick at a time, so the timers fire in order. */
+static void advance(ice::AgentContext& context, ice::Stream* stream, uint64_t millis) {
+  uint64_t end = context.timers.now() + millis;
+  while (context.timers.now() < end) {
+    context.timers.update(context.timers.now() + TIMER_WHEEL_DEFAULT_RESOLUTION);
+    pump(stream, 2);
+  }
+}
+
+static void send_check(Client& client, ice::Stream* stream, uint32_t priority, bool nominate) {
+  uint8_t buffer[256];
+  client.conn.sendTo(dest, buffer, write_request(buffer, sizeof(buffer), UFRAG ":" REMOTE_UFRAG, &stream->integrity_key, priority, nominate, ++ntransactions));
+}
+
+static int send_rtp(ice::Stream* stream) {
+  uint8_t rtp[RTP_SIZE + 64];
+  memset(rtp, 0x00, sizeof(rtp));
+  rtp[0] = 0x80;
+  rtp[1] = 96;
+  rtp[11] = 7;
+  return stream->sendRTP(rtp, RTP_SIZE);
+}
+
+static void client_on_data(rtc::Packet* pkt, void* user) {
+
+  Client* client = static_cast<Client*>(user);
+
+  if (rtc::PACKET_CLASS_RTP == rtc::classify_packet(pkt->data, pkt->nbytes)) {
+    client->nrtp++;
+  }
+}
@@ -0,0 +1,153 @@
+/*
+
+  test_webrtc_pair_lookup
+  -----------------------
+
+  Measures how long ice::Stream::findPair() takes with 2 up to 10.000
+  candidate pairs in a stream. We look up the pairs round robin, so the
+  cache of the last found pair never hits and every lookup goes through
+  the hash; then we look up the same pair over and over, which is what
+  a stream with one selected pair does. The cost per lookup must stay
+  flat when the number of pairs grows.
+
+  We also check that every pair is found, that endpoints without a pair
+  aren't, and that removing pairs keeps the other ones reachable.
+
+  Usage: ./test_webrtc_pair_lookup [number of lookups]
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <uv.h>
+#include <ice/Stream.h>
+#include <test_webrtc_utils.h>
+
+#define NUM_LOOKUPS 2000000
+#define LOCAL_PORT 50000
+#define MAX_FLAT_RATIO 10.0                                               /* the max cost of a lookup with the most pairs compared to 2 pairs; a linear scan would be thousands of times slower. */
+
+static double run(uint32_t npairs, uint32_t nlookups);
+static void make_remote(uint32_t i, rtc::Endpoint& ep);
+
+int main(int argc, char** argv) {
+
+  uint32_t nlookups = NUM_LOOKUPS;
+  uint32_t counts[] = { 2, 10, 100, 1000, 10000 };
+  uint32_t ncounts = sizeof(counts) / sizeof(counts[0]);
+  double first = 0.0;
+  double last = 0.0;
+
+  printf("\n\ntest_webrtc_pair_lookup\n\n");
+
+  if (argc > 1) {
+    nlookups = atoi(argv[1]);
+    check(nlookups > 0, "the number of lookups is valid");
+  }
+
+  printf("%-10s %12s %16s %16s\n", "pairs", "lookups", "ns (round robin)", "ns (same pair)");
+
+  for (uint32_t i = 0; i < ncounts; ++i) {
+    last = run(counts[i], nlookups);
+    if (0 == i) {
+      first = last;
+    }
+  }
+
+  printf("\n");
+  check(last < first * MAX_FLAT_RATIO, "the cost of a lookup stays flat");
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+/* returns the ns per lookup, round robin */
+static double run(uint32_t npairs, uint32_t nlookups) {
+
+  ice::Stream stream;
+  rtc::Endpoint local;
+  rtc::Endpoint remote;
+  std::vector<ice::CandidatePair*> created;
+  std::vector<rtc::Endpoint> remotes;
+  uint32_t nfound = 0;
+
+  check(local.set("127.0.0.1", LOCAL_PORT), "create the local endpoint");
+  stream.addLocalCandidate(new ice::Candidate(local));
+
+  for (uint32_t i = 0; i < npairs; ++i) {
+    make_remote(i, remote);
+    ice::CandidatePair* pair = stream.createPair(remote, local);
+    if (!pair) {
+      check(false, "create a pair");
+    }
+    created.push_back(pair);
+    remotes.push_back(remote);
+  }
+
+  /* round robin */
+  uint64_t start = uv_hrtime();
+  for (uint32_t i = 0; i < nlookups; ++i) {
+    uint32_t dx = i % npairs;
+    if (stream.findPair(remotes[dx], local) == created[dx]) {
+      nfound++;
+    }
+  }
+  double ns_round_robin = double(uv_hrtime() - start) / nlookups;
+  check(nfound == nlookups, "found all pairs");
+
+  /* the same pair */
+  nfound = 0;
+  remote = created[npairs / 2]->remote_endpoint;
+  start = uv_hrtime();
+  for (uint32_t i = 0; i < nlookups; ++i) {
+    if (NULL != stream.findPair(remote, local)) {
+      nfound++;
+    }
+  }
+  double ns_same = double(uv_hrtime() - start) / nlookups;
+  check(nfound == nlookups, "found the same pair");
+
+  printf("%-10u %12u %16.1f %16.1f\n", npairs, nlookups, ns_round_robin, ns_same);
+
+  /* an endpoint without pair, and the local endpoint with another port */
+  make_remote(npairs, remote);
+  check(NULL == stream.findPair(remote, local), "no pair for an unknown remote endpoint");
+  check(NULL == stream.findRemoteCandidate(remote), "no candidate for an unknown remote endpoint");
+
+  rtc::Endpoint other_local;
+  other_local.set("127.0.0.1", LOCAL_PORT + 1);
+  check(NULL == stream.findPair(created[0]->remote_endpoint, other_local), "no pair for an unknown local endpoint");
+  check(NULL != stream.findLocalCandidate(local), "found the local candidate");
+
+  /* remove every other pair; the other ones must still be found. */
+  uint32_t nremoved = 0;
+  for (uint32_t i = 0; i < npairs; i += 2) {
+    if (stream.removePair(created[i])) {
+      nremoved++;
+    }
+  }
+  check((npairs + 1) / 2 == nremoved, "remove every other pair");
+
+  for (uint32_t i = 0; i < npairs; ++i) {
+    make_remote(i, remote);
+    ice::CandidatePair* found = stream.findPair(remote, local);
+    if ((i & 1) ? (found != created[i]) : (NULL != found)) {
+      check(false, "find the pairs we didn't remove");
+    }
+    if ((i & 1) ? (NULL == stream.findRemoteCandidate(remote)) : (NULL != stream.findRemoteCandidate(remote))) {
+      check(false, "the remote candidates of the removed pairs are removed");
+    }
+  }
+
+  check(npairs / 2 == stream.pairs.size(), "the removed pairs are gone");
+  check(npairs / 2 == stream.remote_candidates.size(), "the remote candidates of the removed pairs are gone");
+
+  return ns_round_robin;
+}
+
+/* a peer behind many ports and addresses */
+static void make_remote(uint32_t i, rtc::Endpoint& ep) {
+  char ip[32];
+  sprintf(ip, "10.0.%u.%u", (i / 250) & 0xFF, (i % 250) + 1);
+  ep.set(ip, 40000 + (i % 1000));
+}
@@ -0,0 +1,166 @@
+/*
+
+  test_webrtc_port_mux
+  --------------------
+
+  Runs two streams on one shared socket with ice::PortMux. A binding
+  request is routed on the ufrag in its USERNAME and, when it's
+  authenticated, the route for the remote endpoint is learned so the
+  (non stun) data that follows reaches the same stream. Also checks the
+  route table with a large number of routes.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <ice/PortMux.h>
+#include <ice/Stream.h>
+#include <test_webrtc_utils.h>
+
+#define MUX_PORT 45410
+
+class TestState {
+public:
+  TestState():nstun(0),ndata(0) {}
+  uint32_t nstun;
+  uint32_t ndata;
+};
+
+static void on_stream_data(ice::Stream* stream, rtc::Packet* pkt, void* user);
+static void send_data(rtc::ConnectionUDP& client, rtc::Endpoint& dest);
+static void run(ice::PortMux& mux, rtc::ConnectionUDP** clients, int nclients);
+
+int main() {
+
+  printf("\n\ntest_webrtc_port_mux\n\n");
+
+  ice::PortMux mux;
+  ice::Stream stream_a;
+  ice::Stream stream_b;
+  TestState state_a;
+  TestState state_b;
+  stun::IntegrityKey key_a;
+  stun::IntegrityKey key_b;
+  rtc::ConnectionUDP client_a;
+  rtc::ConnectionUDP client_b;
+  rtc::ConnectionUDP client_c;
+  rtc::ConnectionUDP* clients[] = { &client_a, &client_b, &client_c };
+  rtc::Endpoint dest;
+
+  check(mux.init("127.0.0.1", MUX_PORT), "bind the shared socket");
+  check(dest.set("127.0.0.1", MUX_PORT), "create the destination");
+  check(client_a.bind("127.0.0.1", MUX_PORT + 1), "bind client a");
+  check(client_b.bind("127.0.0.1", MUX_PORT + 2), "bind client b");
+  check(client_c.bind("127.0.0.1", MUX_PORT + 3), "bind client c");
+
+  stream_a.setCredentials("ufraga", "passwordpasswordpassworda");
+  stream_b.setCredentials("ufragb", "passwordpasswordpasswordb");
+  key_a.setKey("passwordpasswordpassworda");
+  key_b.setKey("passwordpasswordpasswordb");
+
+  stream_a.on_data = on_stream_data;
+  stream_a.user_data = &state_a;
+  stream_b.on_data = on_stream_data;
+  stream_b.user_data = &state_b;
+
+  check(stream_a.initShared(&mux), "init stream a on the shared socket");
+  check(stream_b.initShared(&mux), "init stream b on the shared socket");
+  check(stream_a.local_candidates[0]->endpoint == mux.conn.endpoint, "the local candidate uses the shared port");
+
+  /* data from an unknown endpoint is dropped */
+  send_data(client_a, dest);
+  run(mux, clients, 3);
+  check(0 == state_a.ndata + state_b.ndata && 1 == mux.nunrouted, "drop data from an unknown endpoint");
+
+  /* a request is routed on the ufrag and the route is learned */
+  send_request(client_a, dest, "ufraga:remote", &key_a, false);
+  send_request(client_b, dest, "ufragb:remote", &key_b, false);
+  run(mux, clients, 3);
+  check(1 == state_a.nstun && 1 == state_b.nstun, "route the requests on the ufrag");
+  check(2 == mux.nlearned, "learn the routes");
+
+  send_data(client_a, dest);
+  send_data(client_b, dest);
+  send_data(client_b, dest);
+  run(mux, clients, 3);
+  check(1 == state_a.ndata && 2 == state_b.ndata, "route the data on the learned routes");
+
+  /* a request with an invalid integrity reaches the stream (which rejects it) but doesn't create a route */
+  send_request(client_c, dest, "ufraga:remote", &key_b, false);
+  run(mux, clients, 3);
+  check(2 == state_a.nstun && 2 == mux.nlearned, "don't learn a route for a forged request");
+  send_data(client_c, dest);
+  run(mux, clients, 3);
+  check(1 == state_a.ndata, "don't route data for a forged request");
+
+  /* removed routes and streams */
+  mux.removeRoute(client_a.endpoint);
+  check(NULL == mux.findRoute(client_a.endpoint) && &stream_b == mux.findRoute(client_b.endpoint), "remove a route");
+  mux.removeStream(&stream_b);
+  check(NULL == mux.findRoute(client_b.endpoint), "remove a stream and its routes");
+
+  /* new credentials (an ice restart) register the stream on its new ufrag */
+  stream_a.setCredentials("restarta", "passwordpasswordpasswordr");
+  check(NULL == mux.findStream("ufraga") && &stream_a == mux.findStream("restarta"), "register the new ufrag");
+  check(1 == mux.nstreams, "one stream on the mux");
+
+  /* a large route table */
+  {
+    const uint32_t count = 100000;
+    std::vector<rtc::Endpoint> endpoints(count);
+    uint32_t nfound = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+      struct sockaddr_in addr;
+      memset(&addr, 0x00, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(0x0A000000 + (i >> 4));
+      addr.sin_port = htons(1024 + (i & 0xF));
+      endpoints[i].set(&addr);
+      mux.addRoute(endpoints[i], (i & 1) ? &stream_a : &stream_b);
+    }
+
+    for (uint32_t i = 0; i < count; i += 2) {
+      mux.removeRoute(endpoints[i]);
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      ice::Stream* expected = (i & 1) ? &stream_a : NULL;
+      if (mux.findRoute(endpoints[i]) == expected) {
+        nfound++;
+      }
+    }
+
+    check(count == nfound, "find all routes in a large table");
+  }
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void on_stream_data(ice::Stream* stream, rtc::Packet* pkt, void* user) {
+  TestState* state = static_cast<TestState*>(user);
+  if (pkt->nbytes >= 20 && 0 == pkt->data[0]) {
+    state->nstun++;
+  }
+  else {
+    state->ndata++;
+  }
+}
+
+static void send_data(rtc::ConnectionUDP& client, rtc::Endpoint& dest) {
+  uint8_t buffer[100];
+  memset(buffer, 0x80, sizeof(buffer));
+  client.sendTo(dest, buffer, sizeof(buffer));
+}
+
+static void run(ice::PortMux& mux, rtc::ConnectionUDP** clients, int nclients) {
+  for (int i = 0; i < 10; ++i) {
+    mux.update();
+    for (int j = 0; j < nclients; ++j) {
+      clients[j]->update();
+    }
+  }
+}
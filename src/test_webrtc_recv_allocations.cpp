@@ -0,0 +1,233 @@
+/*
+
+  test_webrtc_recv_allocations
+  ----------------------------
+
+  Makes sure the receive chain doesn't allocate. We replace malloc() and
+  friends with versions that count the calls and run an ice::Agent with one
+  stream on each of the ConnectionUDP backends. A client sends binding
+  requests to it; each one goes through the socket, the candidate, the
+  stream and the agent (verification, pair lookup, consent) and the agent
+  sends a response back. The first request creates the candidate pair, so
+  we warm up first; after that not a single allocation may happen, also
+  not on the client that sends the requests and receives the responses.
+
+  Then the client sends SRTP and SRTCP, which goes through the pair lookup
+  and unprotect of the agent to the on_rtp and on_rtcp callbacks of the
+  stream. Instead of a handshake we give both sides the same fixed key, as
+  test_webrtc_pair_lifecycle does. libsrtp creates the state of an SSRC
+  with its first packet, so we warm up again before we count.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ice/Agent.h>
+#include <srtp/ParserSRTP.h>
+#define TEST_WEBRTC_COUNT_HEAP
+#include <test_webrtc_utils.h>
+
+#define NUM_WARMUP 10
+#define NUM_REQUESTS 2000
+#define BURST 16
+#define UFRAG "5PN2qmWqBl"
+#define PWD "Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC"
+#define NUM_MEDIA 2000                                                     /* the number of RTP and of RTCP packets we send */
+#define RTP_SIZE 172
+#define RTCP_SIZE 8                                                        /* a receiver report without report blocks */
+
+static uint32_t nresponses = 0;
+static uint32_t nrtp = 0;
+static uint32_t nrtcp = 0;
+
+static void on_response(rtc::Packet* pkt, void* user);
+static void on_rtp(ice::Stream* stream, ice::CandidatePair* pair, rtc::Packet* pkt, void* user);
+static void on_rtcp(ice::Stream* stream, ice::CandidatePair* pair, rtc::Packet* pkt, void* user);
+static void send_media(rtc::ConnectionUDP& client, rtc::Endpoint& dest, srtp::ParserSRTP& srtp, uint16_t seq);
+static void run(const char* name, rtc::ConnectionUDPMode mode, uint16_t port);
+
+/* --------------------------------------------------------------------- */
+
+int main() {
+
+  printf("\n\ntest_webrtc_recv_allocations\n\n");
+
+  run("libuv", rtc::CONNECTION_UDP_MODE_LIBUV, 45440);
+  run("batched", rtc::CONNECTION_UDP_MODE_BATCHED, 45450);
+  run("io_uring", rtc::CONNECTION_UDP_MODE_URING, 45460);
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void run(const char* name, rtc::ConnectionUDPMode mode, uint16_t port) {
+
+  ice::AgentContext context;
+  ice::Agent agent;
+  ice::Stream* stream = new ice::Stream();
+  ice::Candidate* cand = new ice::Candidate("127.0.0.1", port);
+  rtc::ConnectionUDP client;
+  rtc::Endpoint dest;
+  uint8_t request[256];
+  uint32_t nbytes = 0;
+  uint32_t nsent = 0;
+  char msg[128];
+
+  nresponses = 0;
+
+  /* the agent needs certificates for dtls in init(); we only use its stun handling, so we give it a context without them and init the stream ourself. */
+  check(0 == context.init(64), "init the agent context");
+  cand->conn.mode = mode;
+  stream->addLocalCandidate(cand);
+  agent.setContext(&context);
+  agent.addStream(stream);
+  agent.setCredentials(UFRAG, PWD);
+  check(stream->init(), "init the stream");
+
+  client.mode = mode;
+  client.on_data = on_response;
+  check(client.bind("127.0.0.1", port + 1), "bind the client");
+  check(dest.set("127.0.0.1", port), "create the destination endpoint");
+
+  nbytes = write_request(request, sizeof(request), UFRAG ":remote", &stream->integrity_key, TEST_REQUEST_PRIORITY, true, 3);
+  check(nbytes > 0, "write the binding request");
+
+  /* the first request creates the pair */
+  for (uint32_t i = 0; i < NUM_WARMUP; ++i) {
+    client.sendTo(dest, request, nbytes);
+    nsent++;
+    for (int j = 0; j < 1000 && nresponses < nsent; ++j) {
+      client.update();
+      stream->update();
+    }
+  }
+
+  check(NUM_WARMUP == nresponses && 1 == stream->pairs.size(), "the warmup requests created a pair");
+
+  /* and from now on nothing may allocate. */
+  heap_ncalls = 0;
+  heap_counting = true;
+
+  for (int k = 0; k < 100000 && nresponses < NUM_WARMUP + NUM_REQUESTS; ++k) {
+    for (uint32_t i = 0; i < BURST && nsent < NUM_WARMUP + NUM_REQUESTS && nsent - nresponses < 64; ++i) {
+      client.sendTo(dest, request, nbytes);
+      nsent++;
+    }
+    client.update();
+    stream->update();
+  }
+
+  heap_counting = false;
+
+  printf("%-10s %u requests, %u responses, %llu allocations.\n", name, nsent, nresponses, (unsigned long long)heap_ncalls);
+
+  snprintf(msg, sizeof(msg), "%s: the agent answered all requests", name);
+  check(NUM_WARMUP + NUM_REQUESTS == nresponses && NUM_WARMUP + NUM_REQUESTS == stream->stun_stats.naccepted, msg);
+
+  snprintf(msg, sizeof(msg), "%s: no allocations from recvmsg to the response", name);
+  check(0 == heap_ncalls, msg);
+
+  /* srtp */
+  {
+    uint8_t key[SRTP_PARSER_MASTER_LEN];
+    srtp::ParserSRTP client_srtp;
+    uint16_t seq = 0;
+
+    memset(key, 0x42, sizeof(key));
+    stream->dtls = new ice::DtlsTransport();
+    stream->pairs[0]->dtls = stream->dtls;
+    stream->on_rtp = on_rtp;
+    stream->on_rtcp = on_rtcp;
+    nrtp = 0;
+    nrtcp = 0;
+
+    check(0 == stream->dtls->srtp_in.init("SRTP_AES128_CM_SHA1_80", true, key, key + SRTP_PARSER_MASTER_KEY_LEN), "give the stream srtp keys");
+    check(0 == client_srtp.init("SRTP_AES128_CM_SHA1_80", false, key, key + SRTP_PARSER_MASTER_KEY_LEN), "give the client the same keys");
+
+    for (uint32_t i = 0; i < NUM_WARMUP; ++i) {
+      send_media(client, dest, client_srtp, seq++);
+      for (int j = 0; j < 1000 && nrtcp < seq; ++j) {
+        client.update();
+        stream->update();
+      }
+    }
+
+    check(NUM_WARMUP == nrtp && NUM_WARMUP == nrtcp, "the warmup media arrived");
+
+    heap_ncalls = 0;
+    heap_counting = true;
+
+    for (int k = 0; k < 100000 && nrtcp < NUM_WARMUP + NUM_MEDIA; ++k) {
+      for (uint32_t i = 0; i < BURST / 2 && seq < NUM_WARMUP + NUM_MEDIA && seq - nrtcp < 32; ++i) {
+        send_media(client, dest, client_srtp, seq++);
+      }
+      client.update();
+      stream->update();
+    }
+
+    heap_counting = false;
+
+    printf("%-10s %u rtp, %u rtcp, %llu allocations.\n", name, nrtp, nrtcp, (unsigned long long)heap_ncalls);
+
+    snprintf(msg, sizeof(msg), "%s: the stream got all rtp and rtcp", name);
+    check(NUM_WARMUP + NUM_MEDIA == nrtp && NUM_WARMUP + NUM_MEDIA == nrtcp && 0 == stream->pairs[0]->nsrtp_errors, msg);
+
+    snprintf(msg, sizeof(msg), "%s: no allocations from recvmsg to on_rtp and on_rtcp", name);
+    check(0 == heap_ncalls, msg);
+  }
+
+  client.close();
+  cand->conn.close();
+  uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+}
+
+static void on_response(rtc::Packet* pkt, void* user) {
+  if (pkt->nbytes >= 20 && 0x01 == pkt->data[0] && 0x01 == pkt->data[1]) {
+    nresponses++;
+  }
+}
+
+static void on_rtp(ice::Stream*, ice::CandidatePair*, rtc::Packet* pkt, void*) {
+  if (RTP_SIZE == pkt->nbytes) {
+    nrtp++;
+  }
+}
+
+static void on_rtcp(ice::Stream*, ice::CandidatePair*, rtc::Packet* pkt, void*) {
+  if (RTCP_SIZE == pkt->nbytes) {
+    nrtcp++;
+  }
+}
+
+/* protects and sends one rtp and one rtcp packet; the buffers have room for the auth tags and the srtcp index. */
+static void send_media(rtc::ConnectionUDP& client, rtc::Endpoint& dest, srtp::ParserSRTP& srtp, uint16_t seq) {
+
+  uint8_t rtp[RTP_SIZE + 64];
+  uint8_t rtcp[RTCP_SIZE + 64];
+  int len = 0;
+
+  memset(rtp, 0x00, sizeof(rtp));
+  rtp[0] = 0x80;
+  rtp[1] = 96;
+  rtp[2] = seq >> 8;
+  rtp[3] = seq & 0xFF;
+  rtp[11] = 7;
+
+  len = srtp.protectRTP(rtp, RTP_SIZE);
+  if (len > 0) {
+    client.sendTo(dest, rtp, len);
+  }
+
+  memset(rtcp, 0x00, sizeof(rtcp));
+  rtcp[0] = 0x80;
+  rtcp[1] = 201;
+  rtcp[3] = 1;
+  rtcp[7] = 7;
+
+  /* ParserSRTP::protectRTCP() isn't implemented yet, so we use the session directly. */
+  len = RTCP_SIZE;
+  if (err_status_ok == srtp_protect_rtcp(srtp.session, rtcp, &len)) {
+    client.sendTo(dest, rtcp, len);
+  }
+}
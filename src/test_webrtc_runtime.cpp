@@ -0,0 +1,176 @@
+/*
+
+  test_webrtc_runtime
+  -------------------
+
+  Runs a rtc::Runtime on its own thread and checks that the tasks posted
+  from another thread run in order, that a timer on the wheel of the runtime
+  fires without anybody calling update(), that an idle runtime doesn't
+  wake up, and that a connection on the loop of the runtime receives data.
+  Finally we run a runtime on the default loop with the polled API.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <uv.h>
+#include <rtc/Runtime.h>
+#include <rtc/Connection.h>
+#include <test_webrtc_utils.h>
+
+#define NUM_TASKS 10000
+#define NUM_PACKETS 100
+#define PACKET_SIZE 160
+#define TIMER_DELAY 50
+
+static std::atomic<uint32_t> ntasks(0);
+static std::atomic<uint32_t> nunordered(0);
+static std::atomic<uint32_t> nreceived(0);
+static std::atomic<bool> timer_fired(false);
+static std::atomic<bool> is_stopped(false);
+static uint32_t next_task = 0;
+static rtc::Timer timer;
+
+static void wait_for(std::atomic<uint32_t>& value, uint32_t expected);
+static void on_task(rtc::Runtime* runtime, void* user);
+static void on_start_timer(rtc::Runtime* runtime, void* user);
+static void on_timer(rtc::Timer* timer, void* user);
+static void on_stop(rtc::Runtime* runtime, void* user);
+static void on_data(rtc::Packet* pkt, void* user);
+
+int main() {
+
+  printf("\n\ntest_webrtc_runtime\n\n");
+
+  /* a runtime on its own thread */
+  {
+    rtc::Runtime runtime;
+    rtc::ConnectionUDP receiver;
+    rtc::ConnectionUDP sender;
+    rtc::Endpoint dest;
+    uint8_t packet[PACKET_SIZE];
+
+    check(0 == runtime.init(), "init the runtime");
+
+    runtime.on_stop = on_stop;
+    runtime.user = &receiver;
+
+    /* the loop doesn't run yet, so we can bind on this thread. */
+    receiver.loop = runtime.loop;
+    receiver.on_data = on_data;
+    check(receiver.bind("127.0.0.1", 45391), "bind the receiver on the loop of the runtime");
+
+    check(0 == runtime.start(), "start the runtime");
+
+    for (uint32_t i = 0; i < NUM_TASKS; ++i) {
+      runtime.post(on_task, (void*)(uintptr_t)i);
+    }
+    wait_for(ntasks, NUM_TASKS);
+    check(NUM_TASKS == ntasks.load() && 0 == nunordered.load(), "the posted tasks ran in order");
+
+    /* the wheel is only used on the loop thread, so we start the timer from a task. */
+    uint64_t start = uv_hrtime();
+    runtime.post(on_start_timer, &runtime);
+    for (int i = 0; i < 1000 && false == timer_fired.load(); ++i) {
+      usleep(1000);
+    }
+    check(timer_fired.load(), "the timer fired");
+    check((uv_hrtime() - start) / 1000000ull >= TIMER_DELAY - runtime.timers.resolution, "the timer didn't fire early (the wheel has a precision of one slot)");
+
+    /* without active timers or traffic the runtime sleeps. */
+    uint64_t nticks = runtime.nticks;
+    usleep(100000);
+    check(nticks == runtime.nticks, "an idle runtime doesn't tick");
+
+    /* the sender runs on the default loop of this thread */
+    check(sender.bind("127.0.0.1", 45390), "bind the sender");
+    check(dest.set("127.0.0.1", 45391), "create the destination endpoint");
+
+    for (uint32_t i = 0; i < NUM_PACKETS; ++i) {
+      memset(packet, i & 0xFF, PACKET_SIZE);
+      sender.sendTo(dest, packet, PACKET_SIZE);
+      sender.update();
+    }
+    wait_for(nreceived, NUM_PACKETS);
+    check(NUM_PACKETS == nreceived.load(), "the connection on the runtime received all packets");
+
+    printf("runtime: %llu tasks, %llu wakeups, %llu ticks.\n",
+           (unsigned long long)runtime.ntasks,
+           (unsigned long long)runtime.nwakeups,
+           (unsigned long long)runtime.nticks);
+
+    runtime.stop();
+    check(is_stopped.load(), "on_stop was called");
+
+    sender.close();
+    uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+  }
+
+  /* the polled API on the default loop */
+  {
+    rtc::Runtime runtime;
+
+    ntasks = 0;
+    next_task = 0;
+    timer_fired = false;
+
+    check(0 == runtime.init(uv_default_loop()), "init a runtime on the default loop");
+
+    runtime.post(on_task, (void*)(uintptr_t)0);
+    runtime.post(on_start_timer, &runtime);
+    runtime.poll();
+    check(1 == ntasks.load(), "poll() runs the posted tasks");
+
+    for (int i = 0; i < 1000 && false == timer_fired.load(); ++i) {
+      runtime.poll();
+      usleep(1000);
+    }
+    check(timer_fired.load(), "poll() runs the timers");
+
+    runtime.stop();
+    check(0 == runtime.nclosing, "stop() closes the handles of a runtime that isn't running");
+  }
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void wait_for(std::atomic<uint32_t>& value, uint32_t expected) {
+  for (int i = 0; i < 2000 && value.load() < expected; ++i) {
+    usleep(1000);
+  }
+}
+
+static void on_task(rtc::Runtime* runtime, void* user) {
+  uint32_t seq = (uint32_t)(uintptr_t)user;
+  if (seq != next_task) {
+    nunordered++;
+  }
+  next_task = seq + 1;
+  ntasks++;
+}
+
+static void on_start_timer(rtc::Runtime* runtime, void* user) {
+  timer.on_timeout = on_timer;
+  timer.user = runtime;
+  runtime->timers.start(&timer, TIMER_DELAY);
+}
+
+static void on_timer(rtc::Timer* t, void* user) {
+  timer_fired = true;
+}
+
+static void on_stop(rtc::Runtime* runtime, void* user) {
+  rtc::ConnectionUDP* receiver = static_cast<rtc::ConnectionUDP*>(user);
+  receiver->close();
+  is_stopped = true;
+}
+
+static void on_data(rtc::Packet* pkt, void* user) {
+  if (PACKET_SIZE == pkt->nbytes) {
+    nreceived++;
+  }
+}
@@ -0,0 +1,223 @@
+/*
+
+  test_webrtc_sessions
+  --------------------
+
+  Runs many sessions on one ice::SessionManager. We count the heap bytes
+  (with our own malloc() and free()) that an idle session costs, check
+  that the sessions share the certificate, that binding requests are
+  routed on the ufrag and the learned remote endpoint of the right
+  session, and that removing a session removes it from both indices and
+  gives back all its memory. Adding and removing must not get slower
+  when there are more sessions.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ice/SessionManager.h>
+#define TEST_WEBRTC_COUNT_HEAP
+#include <test_webrtc_utils.h>
+
+#define PORT 45480
+#define NUM_SESSIONS 10000
+#define NUM_TIMED 1000                                        /* we compare the time of the first and last NUM_TIMED sessions we add */
+#define MAX_SESSION_BYTES (10 * 1024)                         /* a session must use less heap than this, idle or with a pair (without the SSL object of a handshake) */
+#define MAX_SLOWDOWN 10                                       /* the last sessions may not be added this many times slower than the first */
+#define PWD "Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC"
+
+static void pump(ice::SessionManager& manager, rtc::ConnectionUDP& client);
+static void send_nomination(rtc::ConnectionUDP& client, rtc::Endpoint& dest, ice::Stream* stream);
+static void make_ufrag(char* ufrag, uint32_t i);
+static ice::Agent* create_session(uint32_t i);
+
+/* --------------------------------------------------------------------- */
+
+int main() {
+
+  printf("\n\ntest_webrtc_sessions\n\n");
+
+  ice::SessionManager manager;
+  rtc::ConnectionUDP client_a;
+  rtc::ConnectionUDP client_b;
+  rtc::Endpoint dest;
+  std::vector<ice::Agent*> agents;
+  char ufrag[32];
+  int64_t heap_added = 0;
+
+  check(manager.init("127.0.0.1", PORT), "init the manager with a generated certificate");
+  check(client_a.bind("127.0.0.1", PORT + 1), "bind the first client");
+  check(client_b.bind("127.0.0.1", PORT + 2), "bind the second client");
+  check(dest.set("127.0.0.1", PORT), "create the destination endpoint");
+
+  /* add the sessions */
+  {
+    uint64_t t_first = 0;
+    uint64_t t_last = 0;
+
+    agents.reserve(NUM_SESSIONS);
+
+    heap_nbytes = 0;
+    heap_counting = true;
+
+    for (uint32_t i = 0; i < NUM_SESSIONS; ++i) {
+
+      uint64_t t0 = uv_hrtime();
+      ice::Agent* agent = create_session(i);
+      if (0 != manager.addSession(agent)) {
+        check(false, "add a session");
+      }
+      uint64_t t1 = uv_hrtime();
+
+      if (i < NUM_TIMED) {
+        t_first += t1 - t0;
+      }
+      else if (i >= NUM_SESSIONS - NUM_TIMED) {
+        t_last += t1 - t0;
+      }
+
+      agents.push_back(agent);
+    }
+
+    heap_counting = false;
+
+    heap_added = heap_nbytes;
+    int64_t per_session = heap_nbytes / NUM_SESSIONS;
+    size_t reported = manager.getMemoryUsage() / NUM_SESSIONS;
+
+    printf("%u sessions: %lld heap bytes per idle session, %zu reported; %.1f ns per add (first %u), %.1f ns (last %u).\n",
+           NUM_SESSIONS, (long long)per_session, reported,
+           double(t_first) / NUM_TIMED, NUM_TIMED, double(t_last) / NUM_TIMED, NUM_TIMED);
+
+    check(NUM_SESSIONS == manager.sessions.size() && NUM_SESSIONS == manager.mux.nstreams, "added all sessions");
+    check(per_session < MAX_SESSION_BYTES, "an idle session is small");
+    check(reported <= (size_t)per_session && reported * 2 >= (size_t)per_session, "the reported memory matches the heap use");
+    check(t_last < t_first * MAX_SLOWDOWN, "adding a session doesn't get slower with more sessions");
+  }
+
+  /* they share one certificate */
+  {
+    check(agents[0]->context == &manager.context && agents[NUM_SESSIONS - 1]->context == &manager.context, "the sessions share the context");
+
+    std::string sdp = agents[0]->getSDP();
+    std::string fingerprint;
+    check(manager.context.dtls_ctx.getFingerprint(fingerprint), "get the fingerprint");
+    check(std::string::npos != sdp.find(fingerprint), "the sdp advertises the shared certificate");
+  }
+
+  /* a ufrag can only be used by one session */
+  {
+    ice::Agent* agent = create_session(7);
+    check(0 != manager.addSession(agent), "a second session with the same ufrag is rejected");
+    delete agent;
+    check(agents[7] == manager.findSession(std::string("s0000007")), "the first session with the ufrag is still found");
+  }
+
+  /* the requests are routed to their session and we learn the remote endpoints */
+  ice::Agent* agent_a = agents[17];
+  ice::Agent* agent_b = agents[4242];
+  {
+    send_nomination(client_a, dest, agent_a->streams[0]);
+    send_nomination(client_b, dest, agent_b->streams[0]);
+    pump(manager, client_a);
+    pump(manager, client_b);
+
+    make_ufrag(ufrag, 17);
+    check(agent_a == manager.findSession(std::string(ufrag)), "find a session on its ufrag");
+    check(1 == agent_a->streams[0]->pairs.size() && 1 == agent_b->streams[0]->pairs.size(), "each session got its pair");
+    check(0 == agents[18]->streams[0]->pairs.size(), "other sessions didn't get a pair");
+    check(agent_a == manager.findSession(client_a.endpoint) && agent_b == manager.findSession(client_b.endpoint), "find a session on the remote endpoint");
+    check(2 == manager.mux.nlearned, "learned two routes");
+
+    printf("a session with a pair uses %zu bytes.\n", agent_a->getMemoryUsage());
+    check(agent_a->getMemoryUsage() < MAX_SESSION_BYTES, "a session with a pair is small");
+  }
+
+  /* removing a session removes it from both indices */
+  {
+    uint64_t t0 = uv_hrtime();
+    check(0 == manager.removeSession(agent_a), "remove a session");
+    uint64_t t1 = uv_hrtime();
+
+    printf("removed a session with a pair in %.1f us.\n", double(t1 - t0) / 1000.0);
+
+    check(NULL == manager.findSession(std::string(ufrag)), "the ufrag is gone");
+    check(NULL == manager.findSession(client_a.endpoint), "the route is gone");
+    check(agent_b == manager.findSession(client_b.endpoint), "the other session is still routed");
+    check(NUM_SESSIONS - 1 == manager.sessions.size() && NUM_SESSIONS - 1 == manager.mux.nstreams, "one session less");
+    check(agent_b == manager.sessions[agent_b->session_index], "the session index is kept up to date");
+
+    /* data from the removed session isn't routed anymore */
+    uint64_t nunrouted = manager.mux.nunrouted;
+    uint8_t rtp[64];
+    memset(rtp, 0x00, sizeof(rtp));
+    rtp[0] = 0x80;
+    client_a.sendTo(dest, rtp, sizeof(rtp));
+    pump(manager, client_a);
+    check(nunrouted + 1 == manager.mux.nunrouted, "data for the removed session is dropped");
+  }
+
+  /* remove all sessions, the memory must be given back */
+  {
+    uint64_t t0 = uv_hrtime();
+
+    heap_nbytes = 0;
+    heap_counting = true;
+
+    for (uint32_t i = 0; i < NUM_SESSIONS; ++i) {
+      if (agents[i] != agent_a && 0 != manager.removeSession(agents[i])) {
+        check(false, "remove a session");
+      }
+    }
+
+    heap_counting = false;
+
+    uint64_t t1 = uv_hrtime();
+
+    printf("removed %u sessions: %.1f ns per remove, %lld heap bytes given back.\n", NUM_SESSIONS - 1, double(t1 - t0) / (NUM_SESSIONS - 1), (long long)-heap_nbytes);
+
+    check(0 == manager.sessions.size() && 0 == manager.mux.nstreams, "all sessions are removed");
+    check(NUM_SESSIONS == manager.nadded && NUM_SESSIONS == manager.nremoved, "counted the sessions");
+    check(-heap_nbytes >= (heap_added / 100) * 95, "the memory of the sessions is given back (the index tables and session list keep their size)");
+  }
+
+  manager.shutdown();
+  check(false == manager.mux.conn.is_open && false == manager.mux.conn.is_closing, "shutdown closes the shared socket");
+
+  client_a.close();
+  client_b.close();
+  uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static ice::Agent* create_session(uint32_t i) {
+
+  char ufrag[32];
+  ice::Agent* agent = new ice::Agent();
+  ice::Stream* stream = new ice::Stream(STREAM_FLAG_RTCP_MUX);
+
+  make_ufrag(ufrag, i);
+  agent->addStream(stream);
+  agent->setCredentials(ufrag, PWD);
+
+  return agent;
+}
+
+static void make_ufrag(char* ufrag, uint32_t i) {
+  sprintf(ufrag, "s%07u", i);
+}
+
+static void pump(ice::SessionManager& manager, rtc::ConnectionUDP& client) {
+  for (int i = 0; i < 50; ++i) {
+    client.update();
+    manager.update();
+  }
+}
+
+static void send_nomination(rtc::ConnectionUDP& client, rtc::Endpoint& dest, ice::Stream* stream) {
+  std::string username = stream->ice_ufrag + ":remote";
+  send_request(client, dest, username.c_str(), &stream->integrity_key, true);
+}
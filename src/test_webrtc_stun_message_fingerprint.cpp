@@ -1,5 +1,8 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <zlib.h>
 #include <stun/Utils.h>
+#include <stun/MessageView.h>
 #include <stun/Reader.h>
 #include <stun/Writer.h>
 
@@ -46,6 +49,27 @@ int main() {
  stun::Reader reader;
  // reader.on_message = on_stun_message;
  reader.process((uint8_t*)req, sizeof(req) - 1, &msg);
+
+ /* compute the fingerprint with stun::crc32_ieee() and compare it with the sample value and zlib. */
+ std::vector<uint8_t> buffer(req, req + sizeof(req) - 1);
+ uint32_t fingerprint = 0;
+ uint32_t zlib_fingerprint = crc32(0L, req, sizeof(req) - 9) ^ 0x5354554e;
+
+ if (!stun::compute_fingerprint(buffer, fingerprint) 
+     || 0xe57a3bcf != fingerprint 
+     || zlib_fingerprint != fingerprint) 
+ {
+   printf("Error: invalid fingerprint: %08X, expected: E57A3BCF, zlib: %08X\n", fingerprint, zlib_fingerprint);
+   exit(1);
+ }
+
+ stun::MessageView view;
+ if (0 != view.parse(req, sizeof(req) - 1) || !stun::verify_fingerprint(&view)) {
+   printf("Error: cannot verify the fingerprint of the sample request.\n");
+   exit(1);
+ }
+
+ printf("Fingerprint: %08X, verified using the `%s` crc32 kernel.\n\n", fingerprint, stun::crc32_ieee_kernel_name());
  
  return 0;
 }
@@ -39,10 +39,15 @@
 
 */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <stun/Utils.h>
 #include <stun/Reader.h>
 #include <stun/Writer.h>
+#include <stun/MessageView.h>
+#include <stun/BindingResponder.h>
+#include <stun/BufferWriter.h>
 
 #define USE_WEBRTC 1
 #if USE_WEBRTC
@@ -175,4 +180,49 @@ static void create_stun_message() {
   stun::Message msg;
   stun::Reader reader;
   reader.process(&writer.buffer[0], writer.buffer.size(), &msg);
+
+  /* the fast path must create exactly the same response for the same request. */
+  uint8_t request[] = { 0x00, 0x01, 0x00, 0x00, 0x21, 0x12, 0xA4, 0x42, 
+                        0x66, 0x36, 0x76, 0x2f, 0x4e, 0x31, 0x41, 0x6f, 0x49, 0x39, 0x79, 0x4a };
+  uint8_t fast[STUN_BINDING_RESPONSE_SIZE];
+  stun::MessageView view;
+  stun::BindingResponder responder;
+  stun::IntegrityKey key;
+
+  key.setKey("75C96DDDFC38D194FEDF75986CF962A2D56F3B65F1F7");
+  responder.setKey(&key);
+  view.parse(request, sizeof(request));
+
+  int nbytes = responder.write(&view, 0xC0A83801, 55164, fast); /* 192.168.56.1 */
+  if (nbytes != writer.buffer.size() || 0 != memcmp(fast, &writer.buffer[0], nbytes)) {
+    printf("Error: the stun::BindingResponder created a different response than the stun::Writer.\n");
+    exit(1);
+  }
+
+  printf("stun::BindingResponder created the same response.\n");
+
+  /* and the writer that uses a fixed buffer must create the same response too. */
+  uint8_t fixed[128];
+  uint32_t transaction[3] = { 0x6636762f, 0x4e31416f, 0x4939794a };
+  stun::BufferWriter buffer_writer(fixed, sizeof(fixed));
+
+  buffer_writer.begin(stun::STUN_BINDING_RESPONSE, transaction);
+  buffer_writer.writeXorMappedAddress(0xC0A83801, 55164);
+  nbytes = buffer_writer.finish(&key, true);
+  if (nbytes != writer.buffer.size() || 0 != memcmp(fixed, &writer.buffer[0], nbytes)) {
+    printf("Error: the stun::BufferWriter created a different response than the stun::Writer.\n");
+    exit(1);
+  }
+
+  /* a message that doesn't fit must fail and never write past the end of the buffer. */
+  memset(fixed, 0xEE, sizeof(fixed));
+  stun::BufferWriter small_writer(fixed, 40);
+  small_writer.begin(stun::STUN_BINDING_REQUEST, transaction);
+  small_writer.writeUsername("5PN2qmWqBl:4hRBmfKHuXjOgkVJ", 27);
+  if (small_writer.finish(&key, true) >= 0 || fixed[40] != 0xEE) {
+    printf("Error: the stun::BufferWriter didn't detect that the message doesn't fit.\n");
+    exit(1);
+  }
+
+  printf("stun::BufferWriter created the same response.\n");
 }
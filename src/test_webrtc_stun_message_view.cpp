@@ -0,0 +1,148 @@
+/*
+
+  test_webrtc_stun_message_view
+  -----------------------------
+
+  Parses the RFC 5769 test vectors with the stun::MessageView and checks the
+  decoded values. Also makes sure that truncated/malformed data is rejected
+  and that non-stun data (DTLS, RTP) is detected as such.
+
+  See: http://tools.ietf.org/html/rfc5769
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stun/MessageView.h>
+#include <stun/IntegrityKey.h>
+#include <stun/Utils.h>
+#include <test_webrtc_utils.h>
+
+int main() {
+
+  printf("\n\ntest_webrtc_stun_message_view\n\n");
+
+  /* http://tools.ietf.org/html/rfc5769#section-2.1 */
+  const unsigned char req[] =
+    "\x00\x01\x00\x58"
+    "\x21\x12\xa4\x42"
+    "\xb7\xe7\xa7\x01\xbc\x34\xd6\x86\xfa\x87\xdf\xae"
+    "\x80\x22\x00\x10"
+    "STUN test client"
+    "\x00\x24\x00\x04"
+    "\x6e\x00\x01\xff"
+    "\x80\x29\x00\x08"
+    "\x93\x2f\xf9\xb1\x51\x26\x3b\x36"
+    "\x00\x06\x00\x09"
+    "\x65\x76\x74\x6a\x3a\x68\x36\x76\x59\x20\x20\x20"
+    "\x00\x08\x00\x14"
+    "\x9a\xea\xa7\x0c\xbf\xd8\xcb\x56\x78\x1e\xf2\xb5"
+    "\xb2\xd3\xf2\x49\xc1\xb5\x71\xa2"
+    "\x80\x28\x00\x04"
+    "\xe5\x7a\x3b\xcf";
+
+  /* http://tools.ietf.org/html/rfc5769#section-2.2 */
+  const unsigned char respv4[] =
+    "\x01\x01\x00\x3c"
+    "\x21\x12\xa4\x42"
+    "\xb7\xe7\xa7\x01\xbc\x34\xd6\x86\xfa\x87\xdf\xae"
+    "\x80\x22\x00\x0b"
+    "\x74\x65\x73\x74\x20\x76\x65\x63\x74\x6f\x72\x20"
+    "\x00\x20\x00\x08"
+    "\x00\x01\xa1\x47\xe1\x12\xa6\x43"
+    "\x00\x08\x00\x14"
+    "\x2b\x91\xf5\x99\xfd\x9e\x90\xc3\x8c\x74\x89\xf9"
+    "\x2a\xf9\xba\x53\xf0\x6b\xe7\xd7"
+    "\x80\x28\x00\x04"
+    "\xc0\x7d\x4c\x96";
+
+  stun::MessageView view;
+  const uint8_t* username = NULL;
+  const uint8_t* sha1 = NULL;
+  uint16_t username_len = 0;
+  uint32_t prio = 0;
+  uint32_t crc = 0;
+  uint64_t tie_breaker = 0;
+  uint8_t family = 0;
+  uint16_t port = 0;
+  uint32_t ip = 0;
+
+  /* request */
+  check(0 == view.parse(req, sizeof(req) - 1), "parse the sample request");
+  check(stun::STUN_BINDING_REQUEST == view.type, "message type is a binding request");
+  check(6 == view.nattributes, "request has 6 attributes");
+  check(0xb7e7a701 == view.transaction[0], "transaction id");
+  check(view.findUsername(&username, &username_len), "find the username");
+  check(9 == username_len && 0 == memcmp(username, "evtj:h6vY", 9), "username value");
+  check(view.findPriority(&prio) && 0x6e0001ff == prio, "priority value");
+  check(view.findIceControlled(&tie_breaker) && 0x932ff9b151263b36llu == tie_breaker, "ice-controlled value");
+  check(view.findMessageIntegrity(&sha1) && 0x9a == sha1[0] && 0xa2 == sha1[19], "message integrity value");
+  check(view.findFingerprint(&crc) && 0xe57a3bcf == crc, "fingerprint value");
+  check(false == view.hasAttribute(stun::STUN_ATTR_USE_CANDIDATE), "no use-candidate");
+
+  /* verification, the sample request is sent to `evtj` */
+  stun::IntegrityKey key;
+  stun::IntegrityKey wrong_key;
+  key.setKey("VOkJxbRl1RmTxUk/WvJxBt");
+  wrong_key.setKey("VOkJxbRl1RmTxUk/WvJxBT");
+  check(stun::verify_fingerprint(&view), "verify the fingerprint");
+  check(stun::verify_username(&view, "evtj"), "verify the username");
+  check(false == stun::verify_username(&view, "evt"), "reject a username prefix w/o colon");
+  check(false == stun::verify_username(&view, "h6vY"), "reject the remote ufrag");
+  check(stun::verify_message_integrity(&view, &key), "verify the message integrity");
+  check(false == stun::verify_message_integrity(&view, &wrong_key), "reject the message integrity for a different key");
+  check(stun::STUN_VERIFY_OK == stun::verify_request(&view, "evtj", &key), "verify the request");
+  check(stun::STUN_VERIFY_INVALID_USERNAME == stun::verify_request(&view, "abcd", &key), "reject a request for a different ufrag");
+  check(stun::STUN_VERIFY_INVALID_INTEGRITY == stun::verify_request(&view, "evtj", &wrong_key), "reject a request with a different key");
+
+  uint8_t tampered[sizeof(req)];
+  memcpy(tampered, req, sizeof(req) - 1);
+  tampered[30] ^= 0x01; /* change the software value */
+  check(0 == view.parse(tampered, sizeof(req) - 1), "parse the tampered request");
+  check(stun::STUN_VERIFY_INVALID_FINGERPRINT == stun::verify_request(&view, "evtj", &key), "reject a tampered request");
+
+  /* response */
+  check(0 == view.parse(respv4, sizeof(respv4) - 1), "parse the sample IPv4 response");
+  check(stun::STUN_BINDING_RESPONSE == view.type, "message type is a binding response");
+  check(view.findXorMappedAddress(&family, &port, &ip), "find the xor-mapped-address");
+  check(STUN_IP4 == family && 32853 == port && 0xC0000201 == ip, "xor-mapped-address is 192.0.2.1:32853");
+
+  /* truncated data, wrong length and non-stun data */
+  uint8_t copy[sizeof(req)];
+  memcpy(copy, req, sizeof(req) - 1);
+  check(-1 == view.parse(copy, sizeof(req) - 5), "reject a truncated message");
+
+  copy[3] = 0x5C;
+  check(-1 == view.parse(copy, sizeof(req) - 1), "reject an invalid message-length");
+
+  memcpy(copy, req, sizeof(req) - 1);
+  copy[23] = 0xF0; /* length of the software attribute runs out of bounds */
+  check(-1 == view.parse(copy, sizeof(req) - 1), "reject an attribute that runs out of bounds");
+
+  memcpy(copy, req, sizeof(req) - 1);
+  copy[0] = 0x16; /* DTLS handshake */
+  check(1 == view.parse(copy, sizeof(req) - 1), "detect DTLS");
+
+  copy[0] = 0x80; /* RTP */
+  check(1 == view.parse(copy, sizeof(req) - 1), "detect RTP");
+
+  memcpy(copy, req, sizeof(req) - 1);
+  copy[4] = 0x00;
+  check(1 == view.parse(copy, sizeof(req) - 1), "detect an invalid cookie");
+
+  /* attributes are validated using the registry, see http://tools.ietf.org/html/rfc5389#section-7.3 */
+  memcpy(copy, req, sizeof(req) - 1);
+  copy[20] = 0x80; copy[21] = 0x99; /* software becomes an unknown comprehension-optional attribute */
+  check(0 == view.parse(copy, sizeof(req) - 1) && 5 == view.nattributes, "skip an unknown comprehension-optional attribute");
+
+  copy[20] = 0x00; copy[21] = 0x99; /* and now an unknown comprehension-required attribute */
+  check(-2 == view.parse(copy, sizeof(req) - 1) && 0x0099 == view.unknown_attribute, "reject an unknown comprehension-required attribute");
+
+  memcpy(copy, req, sizeof(req) - 1);
+  copy[40] = 0x80; copy[41] = 0x29; /* priority becomes an ICE-CONTROLLED with 4 bytes */
+  check(-1 == view.parse(copy, sizeof(req) - 1), "reject an attribute with an invalid length");
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
@@ -0,0 +1,190 @@
+/*
+
+  test_webrtc_stun_transactions
+  -----------------------------
+
+  Runs stun::TransactionTable on a simulated clock: checks the RFC 5389
+  retransmission schedule and timeout, matching a (signed) response with
+  its transaction, ignoring unknown and forged responses and running a
+  large number of outstanding transactions.
+
+  See: http://tools.ietf.org/html/rfc5389#section-7.2.1
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <uv.h>
+#include <rtc/TimerWheel.h>
+#include <stun/BufferWriter.h>
+#include <stun/MessageView.h>
+#include <stun/TransactionTable.h>
+#include <test_webrtc_utils.h>
+
+class TestState {
+public:
+  TestState():nresults(0),result(-1) {}
+  std::vector<uint64_t> send_times;
+  uint32_t nresults;
+  int result;
+};
+
+static uint64_t now = 0;
+
+static bool on_send(stun::Transaction* trans, const uint8_t* data, uint32_t nbytes, void* user);
+static void on_result(stun::Transaction* trans, int result, stun::MessageView* response, void* user);
+static stun::Transaction* create_request(stun::TransactionTable& table, stun::IntegrityKey* key, TestState* state);
+static int create_response(stun::Transaction* trans, stun::IntegrityKey* key, uint8_t* buffer, uint32_t capacity);
+
+int main() {
+
+  printf("\n\ntest_webrtc_stun_transactions\n\n");
+
+  rtc::TimerWheel wheel;
+  stun::TransactionTable table;
+  stun::IntegrityKey key;
+  stun::IntegrityKey wrong_key;
+  stun::MessageView view;
+  uint8_t response[128];
+  int nbytes;
+
+  key.setKey("Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC");
+  wrong_key.setKey("VOkJxbRl1RmTxUk/WvJxBt");
+
+  wheel.init(now);
+  check(0 == table.init(&wheel, 4), "init the table");
+
+  /* the retransmission schedule: 0, 500, 1500, 3500, 7500, 15500, 31500 and a timeout at 31500 + 16 * 500 */
+  {
+    TestState state;
+    check(NULL != create_request(table, &key, &state), "start a transaction");
+
+    for (now = 0; now <= 40000; now += 10) {
+      wheel.update(now);
+    }
+
+    uint64_t expected[] = { 0, 500, 1500, 3500, 7500, 15500, 31500 };
+    check(7 == state.send_times.size(), "we sent 7 requests");
+    for (size_t i = 0; i < state.send_times.size(); ++i) {
+      check(expected[i] == state.send_times[i], "retransmit at the RFC 5389 time");
+    }
+    check(1 == state.nresults && stun::STUN_TRANSACTION_TIMEOUT == state.result, "the transaction timed out");
+    check(1 == table.ntimedout && 6 == table.nretransmits, "the stats are updated");
+  }
+
+  /* a success response is matched; one with a different key is ignored */
+  {
+    TestState state;
+    stun::Transaction* trans = create_request(table, &key, &state);
+    check(NULL != trans, "start another transaction");
+
+    nbytes = create_response(trans, &wrong_key, response, sizeof(response));
+    check(0 == view.parse(response, nbytes), "parse the forged response");
+    check(table.process(&view) < 0 && 0 == state.nresults, "ignore a response with an invalid integrity");
+
+    nbytes = create_response(trans, &key, response, sizeof(response));
+    check(0 == view.parse(response, nbytes), "parse the response");
+    check(0 == table.process(&view), "match the response");
+    check(1 == state.nresults && stun::STUN_TRANSACTION_SUCCESS == state.result, "the transaction succeeded");
+    check(1 == table.process(&view), "a duplicate response is not matched");
+    check(1 == table.nunmatched && 1 == table.nrejected, "the stats are updated");
+
+    /* no more retransmits after a response */
+    for (; now <= 80000; now += 10) {
+      wheel.update(now);
+    }
+    check(1 == state.send_times.size() && 1 == state.nresults, "no retransmits after the response");
+  }
+
+  /* the pool is limited and cancelled transactions are reused */
+  {
+    TestState state;
+    stun::Transaction* all[5];
+    for (int i = 0; i < 4; ++i) {
+      all[i] = create_request(table, NULL, &state);
+    }
+    all[4] = table.create();
+    check(NULL != all[3] && NULL == all[4], "the pool is limited to its capacity");
+    for (int i = 0; i < 4; ++i) {
+      table.cancel(all[i]);
+    }
+    check(NULL != create_request(table, NULL, &state), "cancelled transactions are reused");
+  }
+
+  /* many outstanding transactions; each one must be found by its id */
+  {
+    const uint32_t count = 200000;
+    stun::TransactionTable big;
+    TestState state;
+    std::vector<stun::Transaction*> all(count);
+
+    check(0 == big.init(&wheel, count), "init a large table");
+
+    uint64_t t0 = uv_hrtime();
+    for (uint32_t i = 0; i < count; ++i) {
+      all[i] = create_request(big, NULL, &state);
+    }
+    uint64_t t1 = uv_hrtime();
+
+    for (uint32_t i = 0; i < count; ++i) {
+      nbytes = create_response(all[i], NULL, response, sizeof(response));
+      view.parse(response, nbytes);
+      if (0 != big.process(&view)) {
+        check(false, "match a response in the large table");
+      }
+    }
+    uint64_t t2 = uv_hrtime();
+
+    check(count == state.nresults && count == big.nsucceeded, "matched all responses in the large table");
+    printf("\n%u transactions: %.1f ns per start, %.1f ns per matched response.\n\n", count, double(t1 - t0) / count, double(t2 - t1) / count);
+  }
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static bool on_send(stun::Transaction* trans, const uint8_t* data, uint32_t nbytes, void* user) {
+  TestState* state = static_cast<TestState*>(user);
+  state->send_times.push_back(now);
+  return true;
+}
+
+static void on_result(stun::Transaction* trans, int result, stun::MessageView* response, void* user) {
+  TestState* state = static_cast<TestState*>(user);
+  state->nresults++;
+  state->result = result;
+}
+
+static stun::Transaction* create_request(stun::TransactionTable& table, stun::IntegrityKey* key, TestState* state) {
+
+  stun::Transaction* trans = table.create();
+  if (!trans) {
+    return NULL;
+  }
+
+  stun::BufferWriter writer(trans->request, sizeof(trans->request));
+  writer.begin(stun::STUN_BINDING_REQUEST, trans->transaction);
+  writer.writeUsername("evtj:h6vY", 9);
+  writer.writePriority(0x6e0001ff);
+  writer.writeIceControlling(0x932ff9b151263b36llu);
+
+  trans->key = key;
+  trans->user = state;
+  trans->on_send = on_send;
+  trans->on_result = on_result;
+
+  if (0 != table.start(trans, writer.finish(key, true))) {
+    return NULL;
+  }
+
+  return trans;
+}
+
+static int create_response(stun::Transaction* trans, stun::IntegrityKey* key, uint8_t* buffer, uint32_t capacity) {
+  stun::BufferWriter writer(buffer, capacity);
+  writer.begin(stun::STUN_BINDING_RESPONSE, trans->transaction);
+  writer.writeXorMappedAddress(0xC0000201, 32853);
+  return writer.finish(key, true);
+}
@@ -0,0 +1,113 @@
+/*
+
+  test_webrtc_task_queue
+  ----------------------
+
+  Pushes tasks on a rtc::TaskQueue from several threads while one thread
+  pops them, and checks that every task arrives once and that the tasks of
+  each producer arrive in order. Also checks that two connections with
+  reuse_port can bind the same port, which is what the ice::WorkerPool
+  depends on.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <uv.h>
+#include <rtc/TaskQueue.h>
+#include <rtc/Connection.h>
+#include <test_webrtc_utils.h>
+
+#define NUM_PRODUCERS 4
+#define NUM_TASKS 100000
+
+class TestTask : public rtc::Task {
+public:
+  uint32_t producer;
+  uint32_t seq;
+};
+
+static rtc::TaskQueue queue;
+static uint32_t producer_ids[NUM_PRODUCERS];
+static uint32_t next_seq[NUM_PRODUCERS];
+static uint32_t nreceived = 0;
+static uint32_t nunordered = 0;
+
+static void producer_thread(void* user);
+static void on_task(rtc::Task* task, void* user);
+
+int main() {
+
+  printf("\n\ntest_webrtc_task_queue\n\n");
+
+  check(NULL == queue.pop(), "an empty queue returns NULL");
+
+  uv_thread_t threads[NUM_PRODUCERS];
+
+  for (uint32_t i = 0; i < NUM_PRODUCERS; ++i) {
+    producer_ids[i] = i;
+    next_seq[i] = 0;
+    check(0 == uv_thread_create(&threads[i], producer_thread, &producer_ids[i]), "start a producer");
+  }
+
+  rtc::Task* task = NULL;
+  while (nreceived < NUM_PRODUCERS * NUM_TASKS) {
+    task = queue.pop();
+    if (task) {
+      task->run(task, task->user);
+    }
+  }
+
+  for (uint32_t i = 0; i < NUM_PRODUCERS; ++i) {
+    uv_thread_join(&threads[i]);
+  }
+
+  printf("received %u tasks from %u producers.\n", nreceived, NUM_PRODUCERS);
+
+  check(NULL == queue.pop(), "the queue is empty");
+  check(0 == nunordered, "the tasks of each producer arrived in order");
+
+  /* two sockets on the same port, as the workers of a pool use them. */
+  {
+    rtc::ConnectionUDP a;
+    rtc::ConnectionUDP b;
+    rtc::ConnectionUDP c;
+
+    a.reuse_port = true;
+    b.reuse_port = true;
+
+    check(a.bind("127.0.0.1", 45340), "bind the first reuseport socket");
+    check(b.bind("127.0.0.1", 45340), "bind the second reuseport socket on the same port");
+    check(false == c.bind("127.0.0.1", 45340), "a socket without reuse_port cannot bind the port");
+  }
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void producer_thread(void* user) {
+
+  uint32_t id = *(uint32_t*)user;
+
+  for (uint32_t i = 0; i < NUM_TASKS; ++i) {
+    TestTask* task = new TestTask();
+    task->run = on_task;
+    task->producer = id;
+    task->seq = i;
+    queue.push(task);
+  }
+}
+
+static void on_task(rtc::Task* task, void* user) {
+
+  TestTask* test_task = static_cast<TestTask*>(task);
+
+  if (next_seq[test_task->producer] != test_task->seq) {
+    nunordered++;
+  }
+
+  next_seq[test_task->producer] = test_task->seq + 1;
+  nreceived++;
+
+  delete test_task;
+}
@@ -0,0 +1,133 @@
+/*
+
+  test_webrtc_udp_benchmark
+  -------------------------
+
+  Measures the packets per second that rtc::ConnectionUDP moves over the
+  loopback interface with each of its backends (libuv, batched recvmmsg /
+  sendmmsg and io_uring), so you can pick the backend per host. The sender
+  keeps at most WINDOW packets in flight so we measure the throughput of the
+  backends and not the size of the socket buffers.
+
+  Usage: ./test_webrtc_udp_benchmark [number of packets]
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rtc/Connection.h>
+#include <rtc/Uring.h>
+
+#define NUM_PACKETS 200000
+#define PACKET_SIZE 200
+#define BURST 32
+#define WINDOW 128
+
+static uint32_t nreceived = 0;
+static uint32_t ninvalid = 0;
+
+static void check(bool result, const char* what);
+static void on_data(rtc::Packet* pkt, void* user);
+static void run(const char* name, rtc::ConnectionUDPMode mode, uint16_t port, uint32_t npackets);
+
+int main(int argc, char** argv) {
+
+  uint32_t npackets = NUM_PACKETS;
+
+  printf("\n\ntest_webrtc_udp_benchmark\n\n");
+
+  if (argc > 1) {
+    npackets = atoi(argv[1]);
+    check(npackets > 0, "the number of packets is valid");
+  }
+
+  printf("%-10s %12s %12s %12s %12s\n", "backend", "packets", "pps", "send calls", "recv calls");
+
+  run("libuv", rtc::CONNECTION_UDP_MODE_LIBUV, 45410, npackets);
+  run("batched", rtc::CONNECTION_UDP_MODE_BATCHED, 45420, npackets);
+  run("io_uring", rtc::CONNECTION_UDP_MODE_URING, 45430, npackets);
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void run(const char* name, rtc::ConnectionUDPMode mode, uint16_t port, uint32_t npackets) {
+
+  rtc::ConnectionUDP sender;
+  rtc::ConnectionUDP receiver;
+  rtc::Endpoint dest;
+  uint8_t packet[PACKET_SIZE];
+  uint32_t nsent = 0;
+  uint32_t nidle = 0;
+
+  nreceived = 0;
+  ninvalid = 0;
+
+  sender.mode = mode;
+  receiver.mode = mode;
+  receiver.on_data = on_data;
+
+  check(sender.bind("127.0.0.1", port), "bind the sender");
+  check(receiver.bind("127.0.0.1", port + 1), "bind the receiver");
+  check(dest.set("127.0.0.1", port + 1), "create the destination endpoint");
+
+  if (rtc::CONNECTION_UDP_MODE_URING == mode && NULL == sender.uring) {
+    printf("%-10s not supported on this host.\n", name);
+    return;
+  }
+
+  memset(packet, 0xAB, sizeof(packet));
+
+  uint64_t start = uv_hrtime();
+
+  /* both connections run on the default loop, so one update() runs both. */
+  while (nreceived < npackets) {
+
+    uint32_t in_flight = nsent - nreceived;
+    uint32_t received_before = nreceived;
+
+    for (uint32_t i = 0; i < BURST && nsent < npackets && in_flight < WINDOW; ++i, ++in_flight) {
+      sender.sendTo(dest, packet, sizeof(packet));
+      nsent++;
+    }
+
+    sender.update();
+
+    /* give up when packets were lost. */
+    if (received_before == nreceived && nsent == npackets) {
+      if (++nidle > 100000) {
+        break;
+      }
+    }
+    else {
+      nidle = 0;
+    }
+  }
+
+  double seconds = (uv_hrtime() - start) / 1e9;
+
+  printf("%-10s %12u %12.0f %12llu %12llu\n",
+         name,
+         nreceived,
+         nreceived / seconds,
+         (unsigned long long)sender.nsend_calls,
+         (unsigned long long)receiver.nrecv_calls);
+
+  check(0 == ninvalid, "all packets are valid");
+  check(nreceived >= npackets - (npackets / 100), "received at least 99% of the packets");
+}
+
+static void check(bool result, const char* what) {
+  if (!result) {
+    printf("FAILED: %s\n", what);
+    exit(1);
+  }
+}
+
+static void on_data(rtc::Packet* pkt, void* user) {
+  if (PACKET_SIZE != pkt->nbytes || 0xAB != pkt->data[0] || 0xAB != pkt->data[PACKET_SIZE - 1]) {
+    ninvalid++;
+  }
+  nreceived++;
+}
@@ -0,0 +1,312 @@
+/*
+
+  test_webrtc_udp_send
+  --------------------
+
+  Sends datagrams over the loopback interface with rtc::ConnectionUDP, both
+  with sendTo() and by writing directly into a rtc::SendSlot, using the libuv,
+  the batched and (when the kernel supports it) the io_uring backend. Checks that every datagram arrives and that all
+  send slots return to the pool. When the kernel supports UDP GSO/GRO we
+  also send a packet train, like the packets of a keyframe, and check that
+  it's sent with a few GSO sends and arrives as the same datagrams. The
+  receiver retains some of the receive buffers past the data callback and
+  we check that they keep their data and metadata, including the kernel
+  timestamp. Finally we overflow a small receive buffer and check that
+  getStats() reports the drops and the queue depth. The send and receive
+  pools only allocate what's used, and the connections of a loop share
+  their receive pool.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rtc/Connection.h>
+#include <test_webrtc_utils.h>
+
+#define NUM_PACKETS 1000
+#define PACKET_SIZE 160
+#define TRAIN_PACKETS 45
+#define TRAIN_PACKET_SIZE 1200
+#define TRAIN_LAST_SIZE 700
+#define RETAIN_INTERVAL 10                                                 /* retain every n-th receive buffer */
+#define OVERFLOW_PACKETS 200
+#define OVERFLOW_RECV_SIZE 4096                                            /* SO_RCVBUF of the overflow test; the kernel doubles it */
+
+static uint32_t nreceived = 0;
+static uint32_t ninvalid = 0;
+static uint32_t ntrain = 0;
+static uint32_t ntrain_invalid = 0;
+static rtc::RecvBuffer* retained[NUM_PACKETS / RETAIN_INTERVAL];
+static uint32_t nretained = 0;
+
+static void on_data(rtc::Packet* pkt, void* user);
+static void on_train_data(rtc::Packet* pkt, void* user);
+static void run(rtc::ConnectionUDPMode mode, uint16_t port);
+static void run_train(uint16_t port);
+static void run_overflow(rtc::ConnectionUDPMode mode, uint16_t port);
+
+int main() {
+
+  printf("\n\ntest_webrtc_udp_send\n\n");
+
+  /* the pool itself */
+  {
+    rtc::SendPool pool;
+    rtc::SendSlot* slots[4];
+
+    check(0 == pool.init(4), "init the pool");
+    check(0 == pool.nslots, "the slots are allocated when needed");
+    for (int i = 0; i < 4; ++i) {
+      slots[i] = pool.acquire();
+    }
+    check(NULL != slots[3] && NULL == pool.acquire(), "the pool is limited to its size");
+    check(4 == pool.high_water && 1 == pool.nexhausted, "the stats are updated");
+
+    pool.release(slots[1]);
+    check(slots[1] == pool.acquire(), "a released slot is reused");
+
+    for (int i = 0; i < 4; ++i) {
+      pool.release(slots[i]);
+    }
+    check(0 == pool.nused, "all slots are released");
+  }
+
+  /* the connections of a loop share their receive buffers */
+  {
+    rtc::ConnectionUDP a;
+    rtc::ConnectionUDP b;
+    a.mode = rtc::CONNECTION_UDP_MODE_LIBUV;
+    b.mode = rtc::CONNECTION_UDP_MODE_BATCHED;
+    check(a.bind("127.0.0.1", 45300) && b.bind("127.0.0.1", 45301), "bind two connections on one loop");
+    check(NULL != a.recv_pool && a.recv_pool == b.recv_pool, "they share the receive pool");
+    check(0 == a.recv_pool->nbuffers, "the receive buffers are allocated when needed");
+    a.close();
+    b.close();
+    uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+  }
+
+  run(rtc::CONNECTION_UDP_MODE_LIBUV, 45310);
+  run(rtc::CONNECTION_UDP_MODE_BATCHED, 45320);
+  run(rtc::CONNECTION_UDP_MODE_URING, 45360);
+  run_train(45330);
+  run_overflow(rtc::CONNECTION_UDP_MODE_LIBUV, 45370);
+  run_overflow(rtc::CONNECTION_UDP_MODE_BATCHED, 45380);
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void run(rtc::ConnectionUDPMode mode, uint16_t port) {
+
+  rtc::ConnectionUDP sender;
+  rtc::ConnectionUDP receiver;
+  rtc::Endpoint dest;
+  uint8_t packet[PACKET_SIZE];
+
+  nreceived = 0;
+  ninvalid = 0;
+  nretained = 0;
+
+  sender.mode = mode;
+  receiver.mode = mode;
+  receiver.on_data = on_data;
+  receiver.user = &receiver;
+
+  check(sender.bind("127.0.0.1", port), "bind the sender");
+  check(receiver.bind("127.0.0.1", port + 1), "bind the receiver");
+  check(dest.set("127.0.0.1", port + 1), "create the destination endpoint");
+
+  for (uint32_t i = 0; i < NUM_PACKETS; ++i) {
+
+    if (i & 1) {
+      rtc::SendSlot* slot = sender.acquireSlot();
+      if (!slot) {
+        check(false, "acquire a send slot");
+      }
+      memset(slot->data, i & 0xFF, PACKET_SIZE);
+      slot->nbytes = PACKET_SIZE;
+      sender.submit(slot, dest);
+    }
+    else {
+      memset(packet, i & 0xFF, PACKET_SIZE);
+      sender.sendTo(dest, packet, PACKET_SIZE);
+    }
+
+    /* give the receiver some time so we don't overflow the socket buffer. */
+    if (99 == (i % 100)) {
+      for (int j = 0; j < 5; ++j) {
+        sender.update();
+        receiver.update();
+      }
+    }
+  }
+
+  for (int j = 0; j < 100 && nreceived < NUM_PACKETS; ++j) {
+    sender.update();
+    receiver.update();
+  }
+
+  printf("%s: %u packets with %llu send calls and %llu receive calls, pool high water: %u.\n",
+         (NULL != sender.uring) ? "io_uring" : (rtc::CONNECTION_UDP_MODE_BATCHED == sender.mode) ? "batched" : "libuv",
+         nreceived,
+         (unsigned long long)sender.nsend_calls,
+         (unsigned long long)receiver.nrecv_calls,
+         sender.send_pool.high_water);
+
+  check(NUM_PACKETS == nreceived && 0 == ninvalid, "received all packets");
+  check(NUM_PACKETS == sender.nsend_packets && 0 == sender.nsend_dropped, "sent all packets");
+  check(0 == sender.send_pool.nused, "all send slots returned to the pool");
+  check(NUM_PACKETS / RETAIN_INTERVAL == nretained, "retained receive buffers");
+
+  /* packets are sent in order, packet i is filled with i & 0xFF. */
+  uint32_t nvalid = 0;
+  for (uint32_t i = 0; i < nretained; ++i) {
+    rtc::RecvBuffer* buf = retained[i];
+    uint8_t expected = (i * RETAIN_INTERVAL) & 0xFF;
+    if (PACKET_SIZE == buf->nbytes
+        && expected == buf->data[0]
+        && expected == buf->data[PACKET_SIZE - 1]
+        && &receiver == buf->socket
+        && port == buf->remote.getPort()
+        && buf->arrival > 0
+        && (!receiver.has_timestamps || buf->timestamp > 0))
+      {
+        nvalid++;
+      }
+    buf->release();
+  }
+
+  check(nretained == nvalid, "retained receive buffers keep their data and metadata");
+}
+
+static void run_train(uint16_t port) {
+
+  rtc::ConnectionUDP sender;
+  rtc::ConnectionUDP receiver;
+  rtc::Endpoint dest;
+  uint8_t packet[TRAIN_PACKET_SIZE];
+
+  sender.mode = rtc::CONNECTION_UDP_MODE_BATCHED;
+  receiver.mode = rtc::CONNECTION_UDP_MODE_BATCHED;
+  receiver.on_data = on_train_data;
+
+  check(sender.bind("127.0.0.1", port), "bind the train sender");
+  check(receiver.bind("127.0.0.1", port + 1), "bind the train receiver");
+  check(dest.set("127.0.0.1", port + 1), "create the train destination endpoint");
+
+  if (!sender.has_gso) {
+    printf("skipping the packet train, the kernel doesn't support UDP GSO.\n");
+    return;
+  }
+
+  for (uint32_t i = 0; i < TRAIN_PACKETS; ++i) {
+    uint32_t nbytes = (i + 1 == TRAIN_PACKETS) ? TRAIN_LAST_SIZE : TRAIN_PACKET_SIZE;
+    memset(packet, i & 0xFF, nbytes);
+    packet[0] = i;
+    sender.sendTo(dest, packet, nbytes);
+  }
+
+  sender.flush();
+
+  for (int j = 0; j < 100 && ntrain < TRAIN_PACKETS; ++j) {
+    receiver.update();
+  }
+
+  printf("train: %u packets with %llu send calls (%llu GSO), received with %llu receive calls (%llu coalesced reads, gro: %s).\n",
+         ntrain,
+         (unsigned long long)sender.nsend_calls,
+         (unsigned long long)sender.nsend_gso,
+         (unsigned long long)receiver.nrecv_calls,
+         (unsigned long long)receiver.nrecv_gro,
+         (receiver.has_gro) ? "yes" : "no");
+
+  check(TRAIN_PACKETS == sender.nsend_packets && 0 == sender.nsend_dropped, "sent the train");
+  check(1 == sender.nsend_calls && 1 == sender.nsend_gso, "the train is sent with one GSO send");
+  check(TRAIN_PACKETS == ntrain && 0 == ntrain_invalid, "received the train as separate datagrams in order");
+  check(0 == sender.send_pool.nused, "all train slots returned to the pool");
+}
+
+/* the receiver doesn't read while we send, so the kernel drops what doesn't fit in its small buffer. */
+static void run_overflow(rtc::ConnectionUDPMode mode, uint16_t port) {
+
+  rtc::ConnectionUDP sender;
+  rtc::ConnectionUDP receiver;
+  rtc::ConnectionUDPStats stats;
+  rtc::Endpoint dest;
+  uint8_t packet[PACKET_SIZE];
+
+  nreceived = 0;
+  ninvalid = 0;
+  nretained = 0;
+
+  sender.mode = mode;
+  receiver.mode = mode;
+  receiver.on_data = on_data;
+  receiver.user = &receiver;
+  receiver.socket_recv_size = OVERFLOW_RECV_SIZE;
+
+  /* the kernel counts dropped GRO reads, not datagrams. */
+  sender.offload = false;
+  receiver.offload = false;
+
+  check(sender.bind("127.0.0.1", port), "bind the overflow sender");
+  check(receiver.bind("127.0.0.1", port + 1), "bind the overflow receiver");
+  check(dest.set("127.0.0.1", port + 1), "create the overflow destination endpoint");
+
+  for (uint32_t i = 0; i < OVERFLOW_PACKETS; ++i) {
+    memset(packet, i & 0xFF, PACKET_SIZE);
+    sender.sendTo(dest, packet, PACKET_SIZE);
+  }
+  sender.flush();
+
+  check(0 == receiver.getStats(stats), "get the stats of the receiver");
+
+  printf("overflow: %u bytes queued, %llu dropped, receive buffer: %u bytes, send buffer: %u bytes, timestamps: %s.\n",
+         stats.recv_queue_bytes,
+         (unsigned long long)stats.nrecv_overflow,
+         stats.recv_buffer_size,
+         stats.send_buffer_size,
+         (stats.has_timestamps) ? "yes" : "no");
+
+  check(stats.recv_buffer_size > 0 && stats.recv_buffer_size <= 4 * OVERFLOW_RECV_SIZE, "the receive buffer size is applied");
+  check(stats.recv_queue_bytes > 0, "the receive queue depth is reported");
+  check(stats.nrecv_overflow > 0, "the kernel drops are reported");
+
+  for (int j = 0; j < 10; ++j) {
+    receiver.update();
+  }
+
+  for (uint32_t i = 0; i < nretained; ++i) {
+    retained[i]->release();
+  }
+
+  check(nreceived > 0 && nreceived + stats.nrecv_overflow == OVERFLOW_PACKETS, "received what the kernel didn't drop");
+  check(receiver.nrecv_overflow == stats.nrecv_overflow, "the drop counter of the connection is up to date");
+}
+
+static void on_data(rtc::Packet* pkt, void* user) {
+  uint8_t* data = pkt->data;
+  if (PACKET_SIZE != pkt->nbytes || data[0] != data[PACKET_SIZE - 1] || pkt->remote->getPort() + 1 != pkt->local->getPort()) {
+    ninvalid++;
+  }
+
+  /* keep the buffer after this callback returns. */
+  rtc::ConnectionUDP* conn = static_cast<rtc::ConnectionUDP*>(user);
+  if (0 == (nreceived % RETAIN_INTERVAL) && pkt->socket == conn && pkt->buffer && data == pkt->buffer->data) {
+    pkt->buffer->retain();
+    retained[nretained++] = pkt->buffer;
+  }
+
+  nreceived++;
+}
+
+static void on_train_data(rtc::Packet* pkt, void* user) {
+  uint8_t* data = pkt->data;
+  uint32_t nbytes = pkt->nbytes;
+  uint32_t expected = (ntrain + 1 == TRAIN_PACKETS) ? TRAIN_LAST_SIZE : TRAIN_PACKET_SIZE;
+  if (expected != nbytes || data[0] != (ntrain & 0xFF) || data[nbytes - 1] != (ntrain & 0xFF)) {
+    ntrain_invalid++;
+  }
+  ntrain++;
+}
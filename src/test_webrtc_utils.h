@@ -0,0 +1,132 @@
+/*
+
+  test_webrtc_utils
+  -----------------
+
+  What the test programs share. check() prints the result of a test and
+  exits when it failed. write_request() and send_request() create the
+  binding request of a controlling agent that most tests send; the
+  PRIORITY and ICE-CONTROLLING values are the ones the stun tests expect.
+
+  Define TEST_WEBRTC_COUNT_HEAP before including this file to replace
+  malloc() and friends with versions that count the calls (heap_ncalls)
+  and the heap bytes in use (heap_nbytes) while heap_counting is true.
+  Only include it like that from one file of a program.
+
+ */
+#ifndef TEST_WEBRTC_UTILS_H
+#define TEST_WEBRTC_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rtc/Connection.h>
+#include <rtc/Endpoint.h>
+#include <stun/BufferWriter.h>
+#include <stun/IntegrityKey.h>
+
+#define TEST_REQUEST_PRIORITY 0x6e0001ff                              /* the PRIORITY of the requests we send */
+#define TEST_REQUEST_TIE_BREAKER 0x932ff9b151263b36llu                /* the ICE-CONTROLLING tie breaker of the requests we send */
+
+static inline void check(bool result, const char* what) {
+  printf("%s: %s\n", (result) ? "ok    " : "FAILED", what);
+  if (!result) {
+    exit(1);
+  }
+}
+
+/* writes a binding request into buffer and returns its size; id is the last word of the transaction id. Doesn't allocate. */
+static inline uint32_t write_request(uint8_t* buffer, uint32_t nbytes, const char* username, stun::IntegrityKey* key, uint32_t priority, bool nominate, uint32_t id) {
+  uint32_t transaction[3] = { 1, 2, id };
+  stun::BufferWriter writer(buffer, nbytes);
+  writer.begin(stun::STUN_BINDING_REQUEST, transaction);
+  writer.writeUsername(username, strlen(username));
+  writer.writePriority(priority);
+  writer.writeIceControlling(TEST_REQUEST_TIE_BREAKER);
+  if (nominate) {
+    writer.writeUseCandidate();
+  }
+  return writer.finish(key, true);
+}
+
+static inline void send_request(rtc::ConnectionUDP& client, rtc::Endpoint& dest, const char* username, stun::IntegrityKey* key, bool nominate) {
+  uint8_t buffer[256];
+  client.sendTo(dest, buffer, write_request(buffer, sizeof(buffer), username, key, TEST_REQUEST_PRIORITY, nominate, 3));
+}
+
+/* --------------------------------------------------------------------- */
+
+#if defined(TEST_WEBRTC_COUNT_HEAP)
+
+#include <malloc.h>
+
+extern "C" {
+  void* __libc_malloc(size_t nbytes);
+  void* __libc_calloc(size_t count, size_t nbytes);
+  void* __libc_realloc(void* ptr, size_t nbytes);
+  void* __libc_memalign(size_t alignment, size_t nbytes);
+  void __libc_free(void* ptr);
+}
+
+static bool heap_counting = false;                                    /* set to count the allocations */
+static uint64_t heap_ncalls = 0;                                      /* the number of allocations while counting */
+static int64_t heap_nbytes = 0;                                       /* the heap bytes allocated minus the bytes freed while counting */
+
+extern "C" {
+
+  void* malloc(size_t nbytes) {
+    void* ptr = __libc_malloc(nbytes);
+    if (heap_counting) {
+      heap_ncalls++;
+      heap_nbytes += (ptr) ? malloc_usable_size(ptr) : 0;
+    }
+    return ptr;
+  }
+
+  void* calloc(size_t count, size_t nbytes) {
+    void* ptr = __libc_calloc(count, nbytes);
+    if (heap_counting) {
+      heap_ncalls++;
+      heap_nbytes += (ptr) ? malloc_usable_size(ptr) : 0;
+    }
+    return ptr;
+  }
+
+  void* realloc(void* ptr, size_t nbytes) {
+    if (heap_counting) {
+      heap_ncalls++;
+      heap_nbytes -= (ptr) ? malloc_usable_size(ptr) : 0;
+    }
+    ptr = __libc_realloc(ptr, nbytes);
+    if (heap_counting) {
+      heap_nbytes += (ptr) ? malloc_usable_size(ptr) : 0;
+    }
+    return ptr;
+  }
+
+  void* memalign(size_t alignment, size_t nbytes) {
+    void* ptr = __libc_memalign(alignment, nbytes);
+    if (heap_counting) {
+      heap_ncalls++;
+      heap_nbytes += (ptr) ? malloc_usable_size(ptr) : 0;
+    }
+    return ptr;
+  }
+
+  int posix_memalign(void** ptr, size_t alignment, size_t nbytes) {
+    *ptr = memalign(alignment, nbytes);
+    return (*ptr) ? 0 : 12; /* ENOMEM */
+  }
+
+  void free(void* ptr) {
+    if (heap_counting && ptr) {
+      heap_nbytes -= malloc_usable_size(ptr);
+    }
+    __libc_free(ptr);
+  }
+
+} /* extern "C" */
+
+#endif
+
+#endif
@@ -0,0 +1,254 @@
+/*
+
+  test_webrtc_worker_pool
+  -----------------------
+
+  Runs one session on an ice::WorkerPool with a single worker. A binding
+  request for a ufrag that isn't pending is dropped before the worker
+  takes the lock of the pool, a request for a pending ufrag that fails
+  the integrity check doesn't claim the session, and the first request
+  that verifies claims it on the worker that received it.
+
+  Then we run a session on two workers and send checks and media from
+  many client ports; the kernel hands some of them to the worker that
+  doesn't run the session, which forwards them to the owner. When the
+  agent is removed the forwards are gone.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <ice/WorkerPool.h>
+#include <test_webrtc_utils.h>
+
+#define PORT 45500
+#define POOL_PORT 45520                                                    /* the pool with two workers */
+#define NUM_CLIENTS 16                                                     /* the ports we send from; the kernel spreads them over the workers */
+#define PWD "Q9wQj99nsQzldVI5ZuGXbEWRK5RhRXdC"
+
+class WorkerStats {
+public:
+  WorkerStats():nclaimed(0),nfiltered(0),nrejected(0),nforwarded(0),nforwards(0),nrtp(0),nsnapshots(0) {}
+  ice::Worker* worker;
+  std::atomic<uint64_t> nclaimed;
+  std::atomic<uint64_t> nfiltered;
+  std::atomic<uint64_t> nrejected;
+  std::atomic<uint64_t> nforwarded;
+  std::atomic<uint64_t> nforwards;                                         /* the size of the forward table */
+  std::atomic<uint64_t> nrtp;                                              /* the rtp packets the pairs of our agents received */
+  std::atomic<uint32_t> nsnapshots;
+};
+
+static uint32_t nresponses = 0;
+
+static void run_two_workers();
+static void snapshot(WorkerStats& stats);
+static void wait_for(WorkerStats& stats, std::atomic<uint64_t>& value, uint64_t expected);
+static void on_snapshot(rtc::Runtime* runtime, void* user);
+static void on_response(rtc::Packet* pkt, void* user);
+
+int main() {
+
+  printf("\n\ntest_webrtc_worker_pool\n\n");
+
+  ice::WorkerPool pool;
+  ice::AgentContext context;
+  ice::Agent* agent = new ice::Agent();
+  ice::Stream* stream = new ice::Stream(STREAM_FLAG_RTCP_MUX);
+  rtc::ConnectionUDP client;
+  rtc::ConnectionUDP other_client;
+  rtc::Endpoint dest;
+  stun::IntegrityKey key;
+  stun::IntegrityKey forged_key;
+  WorkerStats stats;
+
+  key.setKey(PWD);
+  forged_key.setKey("notthepasswordnotthepassword");
+
+  /* without a handshake we don't need certificates, so we give the agent a context without one. */
+  check(0 == context.init(64), "init the agent context");
+  agent->setContext(&context);
+  agent->addStream(stream);
+  agent->setCredentials("ufrag", PWD);
+
+  check(0 == pool.start("127.0.0.1", PORT, 1, false), "start the pool");
+  check(0 == pool.addAgent(agent), "add the agent");
+  check(client.bind("127.0.0.1", PORT + 1), "bind the client");
+  check(other_client.bind("127.0.0.1", PORT + 2), "bind the other client");
+  check(dest.set("127.0.0.1", PORT), "create the destination endpoint");
+
+  stats.worker = pool.workers[0];
+
+  /* an unknown ufrag never reaches the lock */
+  send_request(client, dest, "unknown:remote", &key, false);
+  wait_for(stats, stats.nfiltered, 1);
+  check(1 == stats.nfiltered.load() && 0 == stats.nrejected.load(), "drop a request for an unknown ufrag");
+
+  /* a forged request for a pending ufrag doesn't claim the agent */
+  send_request(client, dest, "ufrag:remote", &forged_key, false);
+  wait_for(stats, stats.nrejected, 1);
+  check(1 == stats.nrejected.load() && 0 == stats.nclaimed.load(), "don't claim the agent for a forged request");
+
+  /* the first request that verifies claims the agent */
+  send_request(client, dest, "ufrag:remote", &key, false);
+  wait_for(stats, stats.nclaimed, 1);
+  check(1 == stats.nclaimed.load() && 1 == stats.nrejected.load(), "claim the agent for a verified request");
+
+  /* a claimed ufrag isn't pending anymore, the mux of the worker routes it */
+  send_request(other_client, dest, "ufrag:remote", &forged_key, false);
+  send_request(other_client, dest, "unknown:remote", &key, false);
+  wait_for(stats, stats.nfiltered, 2);
+  check(2 == stats.nfiltered.load() && 1 == stats.nrejected.load() && 1 == stats.nclaimed.load(), "the worker routes the claimed ufrag itself");
+
+  pool.stop();
+
+  run_two_workers();
+
+  printf("\nAll tests passed.\n\n");
+
+  return 0;
+}
+
+static void run_two_workers() {
+
+  ice::WorkerPool pool;
+  ice::AgentContext context;
+  ice::Agent* agent = new ice::Agent();
+  ice::Stream* stream = new ice::Stream(STREAM_FLAG_RTCP_MUX);
+  rtc::ConnectionUDP clients[NUM_CLIENTS];
+  rtc::Endpoint dest;
+  stun::IntegrityKey key;
+  WorkerStats owner_stats;
+  WorkerStats other_stats;
+
+  key.setKey(PWD);
+
+  check(0 == context.init(64), "init the context of the second agent");
+  agent->setContext(&context);
+  agent->addStream(stream);
+  agent->setCredentials("ufrag", PWD);
+
+  check(0 == pool.start("127.0.0.1", POOL_PORT, 2, false), "start a pool with two workers");
+  check(0 == pool.addAgent(agent), "add the agent to the pool with two workers");
+  check(dest.set("127.0.0.1", POOL_PORT), "create the destination endpoint of the pool");
+
+  uint32_t nbound = 0;
+  for (uint32_t i = 0; i < NUM_CLIENTS; ++i) {
+    if (clients[i].bind("127.0.0.1", POOL_PORT + 1 + i)) {
+      nbound++;
+    }
+    clients[i].on_data = on_response;
+  }
+
+  check(NUM_CLIENTS == nbound, "bind the clients");
+
+  /* the first client claims the session */
+  send_request(clients[0], dest, "ufrag:remote", &key, false);
+  for (int i = 0; i < 1000 && 0 == nresponses; ++i) {
+    clients[0].update();
+    usleep(1000);
+  }
+
+  check(NULL != agent->worker.load() && 1 == nresponses, "one of the workers claims the agent");
+
+  owner_stats.worker = agent->worker.load();
+  other_stats.worker = (owner_stats.worker == pool.workers[0]) ? pool.workers[1] : pool.workers[0];
+
+  /* the checks from all ports reach the agent, also the ones that arrive on the other worker */
+  nresponses = 0;
+  for (uint32_t i = 0; i < NUM_CLIENTS; ++i) {
+    send_request(clients[i], dest, "ufrag:remote", &key, false);
+  }
+
+  for (int i = 0; i < 1000 && nresponses < NUM_CLIENTS; ++i) {
+    clients[0].update();
+    usleep(1000);
+  }
+
+  snapshot(other_stats);
+  check(NUM_CLIENTS == nresponses, "the agent answers the checks from all ports");
+  check(0 < other_stats.nforwarded.load() && 0 < other_stats.nforwards.load(), "the other worker forwards the checks to the owner");
+  check(0 == other_stats.nclaimed.load() && 0 == other_stats.nrejected.load(), "the other worker doesn't claim the agent");
+
+  /* the media that follows is forwarded on the remote endpoint */
+  for (uint32_t i = 0; i < NUM_CLIENTS; ++i) {
+    uint8_t rtp[100];
+    memset(rtp, 0x00, sizeof(rtp));
+    rtp[0] = 0x80;
+    rtp[1] = 96;
+    clients[i].sendTo(dest, rtp, sizeof(rtp));
+  }
+
+  wait_for(owner_stats, owner_stats.nrtp, NUM_CLIENTS);
+  check(NUM_CLIENTS == owner_stats.nrtp.load(), "the media from all ports reaches the pairs of the agent");
+
+  /* without the agent the other worker forgets its forwards */
+  check(0 == pool.removeAgent(agent), "remove the agent");
+  for (int i = 0; i < 1000; ++i) {
+    snapshot(other_stats);
+    if (0 == other_stats.nforwards.load()) {
+      break;
+    }
+  }
+
+  check(0 == other_stats.nforwards.load(), "removing the agent removes the forwards");
+
+  pool.stop();
+
+  for (uint32_t i = 0; i < NUM_CLIENTS; ++i) {
+    clients[i].close();
+  }
+
+  uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+}
+
+/* the stats of the worker are only written on its thread, so we copy them there. */
+static void snapshot(WorkerStats& stats) {
+  uint32_t nsnapshots = stats.nsnapshots.load();
+  stats.worker->runtime.post(on_snapshot, &stats);
+  while (nsnapshots == stats.nsnapshots.load()) {
+    usleep(1000);
+  }
+}
+
+static void wait_for(WorkerStats& stats, std::atomic<uint64_t>& value, uint64_t expected) {
+  for (int i = 0; i < 1000; ++i) {
+    snapshot(stats);
+    if (value.load() >= expected) {
+      return;
+    }
+  }
+}
+
+static void on_snapshot(rtc::Runtime* runtime, void* user) {
+
+  WorkerStats* stats = static_cast<WorkerStats*>(user);
+  ice::Worker* worker = stats->worker;
+  uint64_t nrtp = 0;
+
+  for (size_t i = 0; i < worker->agents.size(); ++i) {
+    ice::Agent* agent = worker->agents[i];
+    for (size_t k = 0; k < agent->streams.size(); ++k) {
+      for (size_t j = 0; j < agent->streams[k]->pairs.size(); ++j) {
+        nrtp += agent->streams[k]->pairs[j]->recv_counters.npackets[rtc::PACKET_CLASS_RTP];
+      }
+    }
+  }
+
+  stats->nclaimed.store(worker->nclaimed);
+  stats->nfiltered.store(worker->nfiltered);
+  stats->nrejected.store(worker->nrejected);
+  stats->nforwarded.store(worker->nforwarded);
+  stats->nforwards.store(worker->forwards.size());
+  stats->nrtp.store(nrtp);
+  stats->nsnapshots.fetch_add(1);
+}
+
+static void on_response(rtc::Packet* pkt, void*) {
+  stun::MessageView msg;
+  if (0 == msg.parse(pkt->data, pkt->nbytes) && stun::STUN_BINDING_RESPONSE == msg.type) {
+    nresponses++;
+  }
+}
@@ -1,6 +1,21 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <zlib.h>
+#include <uv.h>
+#include <vector>
+#include <stun/Utils.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define HAVE_RDTSC 1
+#endif
+
+typedef uint32_t(*crc_func)(uint32_t crc, const uint8_t* data, uint32_t nbytes);
+
+static uint32_t zlib_crc(uint32_t crc, const uint8_t* data, uint32_t nbytes);
+static bool compare_random_buffers();
+static void benchmark(const char* name, crc_func func, uint32_t nbytes);
 
 int main() {
 
@@ -29,5 +44,101 @@ int main() {
 
  printf("Checksum: %u\n\n", checksum);
 
+ /* compare our kernels with zlib */
+ printf("stun::crc32_ieee() uses the `%s` kernel.\n", stun::crc32_ieee_kernel_name());
+
+ if (checksum != stun::crc32_ieee(0, req, sizeof(req))
+     || checksum != stun::crc32_ieee_table(0, req, sizeof(req)))
+ {
+   printf("Error: stun::crc32_ieee() computed a different checksum for the RFC 5769 request.\n");
+   exit(1);
+ }
+
+ /* the fingerprint of the sample is computed over everything but the last 8 bytes. */
+ uint32_t fingerprint = stun::crc32_ieee(0, req, sizeof(req) - 9) ^ 0x5354554e;
+ if (0xe57a3bcf != fingerprint) {
+   printf("Error: invalid fingerprint for the RFC 5769 request: %08X\n", fingerprint);
+   exit(1);
+ }
+
+ if (!compare_random_buffers()) {
+   exit(1);
+ }
+
+ printf("Checksums of random buffers are the same as zlib.\n\n");
+
+ uint32_t sizes[] = { 64, 100, 1500, 65536 };
+ for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+   benchmark("zlib", zlib_crc, sizes[i]);
+   benchmark("table", stun::crc32_ieee_table, sizes[i]);
+   benchmark(stun::crc32_ieee_kernel_name(), stun::crc32_ieee, sizes[i]);
+   printf("\n");
+ }
+
   return 0;
 }
+
+static uint32_t zlib_crc(uint32_t crc, const uint8_t* data, uint32_t nbytes) {
+  return crc32(crc, data, nbytes);
+}
+
+/* random lengths and offsets so we test all the tail and alignment paths. */
+static bool compare_random_buffers() {
+
+  std::vector<uint8_t> buffer(8192 + 16);
+
+  srand(1234);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = rand() & 0xFF;
+  }
+
+  for (int i = 0; i < 20000; ++i) {
+    uint32_t offset = rand() % 16;
+    uint32_t nbytes = (i < 300) ? i : (rand() % 8192);
+    uint32_t start = rand();
+    uint8_t* data = &buffer[offset];
+    uint32_t expected = crc32(start, data, nbytes);
+
+    if (expected != stun::crc32_ieee(start, data, nbytes)) {
+      printf("Error: stun::crc32_ieee() failed for %u bytes at offset %u.\n", nbytes, offset);
+      return false;
+    }
+
+    if (expected != stun::crc32_ieee_table(start, data, nbytes)) {
+      printf("Error: stun::crc32_ieee_table() failed for %u bytes at offset %u.\n", nbytes, offset);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void benchmark(const char* name, crc_func func, uint32_t nbytes) {
+
+  std::vector<uint8_t> buffer(nbytes, 0x5A);
+  uint32_t iterations = (64 * 1024 * 1024) / nbytes;
+  uint32_t crc = 0;
+
+  uint64_t t0 = uv_hrtime();
+#if HAVE_RDTSC
+  uint64_t c0 = __rdtsc();
+#endif
+
+  for (uint32_t i = 0; i < iterations; ++i) {
+    crc = func(crc, &buffer[0], nbytes);
+  }
+
+#if HAVE_RDTSC
+  uint64_t c1 = __rdtsc();
+#endif
+  uint64_t t1 = uv_hrtime();
+
+  double total = double(iterations) * nbytes;
+  double ns = double(t1 - t0);
+
+#if HAVE_RDTSC
+  printf("%12s, %6u bytes: %6.2f bytes/cycle, %6.2f bytes/ns (crc: %08X)\n", name, nbytes, total / double(c1 - c0), total / ns, crc);
+#else
+  printf("%12s, %6u bytes: %6.2f bytes/ns (crc: %08X)\n", name, nbytes, total / ns, crc);
+#endif
+}